@@ -0,0 +1,22 @@
+#include "bin_loader.h"
+
+BinLoader::BinLoader(BlockSink &sink, uint32_t base) : _sink(sink), _base(base), _offset(0)
+{
+}
+
+hex_parse_status_t BinLoader::feed(const uint8_t *data, uint32_t size)
+{
+    int ret = _sink.write(_base + _offset, data, size);
+    _offset += size;
+    return ret ? HEX_PARSE_REJECTED : HEX_PARSE_OK;
+}
+
+int BinLoader::busy()
+{
+    return _sink.busy();
+}
+
+int BinLoader::flush()
+{
+    return _sink.sync();
+}
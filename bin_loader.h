@@ -0,0 +1,73 @@
+#ifndef BIN_LOADER_H
+#define BIN_LOADER_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "image_decoder.h"
+
+/** Streams a raw binary image into a sink with no decoding at all. With a
+ *  PageWriter as the sink every whole page goes to the flash straight from
+ *  the caller's buffer, so loading runs at the speed of the flash.
+ *
+ *  A binary has no end record, the image ends where the caller stops feeding
+ *  it, and anything can be a binary so detect() always says yes. Add it to an
+ *  ImageLoader last.
+ *
+ * Example:
+ * @code
+ * PageWriter pages(flash);
+ * BinLoader loader(pages, 0);
+ *
+ * loader.feed(image, image_size);
+ * loader.flush();
+ * @endcode
+ */
+class BinLoader : public ImageDecoder {
+
+public:
+    /** Create a loader
+     *  @param sink is where the image goes, usually a PageWriter
+     *  @param base is the address of the first byte of the image
+     */
+    BinLoader(BlockSink &sink, uint32_t base);
+
+    /** Send the next piece of the image
+     *  @param data is the data, it must stay valid until busy() returns 0
+     *  @param size is the number of bytes in data
+     *  @return HEX_PARSE_OK, or HEX_PARSE_REJECTED if the sink refused part of it
+     */
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size);
+
+    /** Check if the sink still owns the last piece fed
+     *  @return 1 while it does, otherwise 0
+     */
+    virtual int busy();
+
+    /** Write out anything held back and wait for the sink
+     *  @return 0 on success, -1 on failure
+     */
+    virtual int flush();
+
+    virtual int detect(const uint8_t *data, uint32_t size) {
+        (void)data;
+        (void)size;
+        return 1;
+    }
+
+    virtual const char *name() const {
+        return "bin";
+    }
+
+    /** Get the number of bytes fed so far
+     */
+    uint32_t size() const {
+        return _offset;
+    }
+
+private:
+    BlockSink &_sink;
+    uint32_t _base;
+    uint32_t _offset;
+};
+
+#endif
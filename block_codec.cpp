@@ -0,0 +1,140 @@
+#include "string.h"
+#include "block_codec.h"
+
+#define MIN_MATCH       3
+#define MAX_MATCH       (0x3f + MIN_MATCH)
+#define MAX_LITERAL     0x80
+#define MAX_OFFSET      0x100
+#define HASH_SIZE       256
+
+/** Hash the 3 bytes a match has to start with
+ *   @param p is the first byte
+ *   @return an index into the match table
+ */
+static inline uint8_t hash3(const uint8_t *p)
+{
+    return (uint8_t)((p[0] * 33) ^ (p[1] * 7) ^ p[2]);
+}
+
+/** Remember where the strings starting inside a run or match were
+ *   @param head is the match table
+ *   @param in is the block
+ *   @param from is the first position to add
+ *   @param to is one past the last position to add
+ *   @param size is the size of the block
+ */
+static void hash_skipped(uint16_t *head, const uint8_t *in, uint32_t from, uint32_t to, uint32_t size)
+{
+    for (; (from < to) && (from + MIN_MATCH <= size); from++) {
+        head[hash3(&in[from])] = (uint16_t)(from + 1);
+    }
+}
+
+/** Write out pending literals
+ *   @param out is the output position
+ *   @param lit is the first literal
+ *   @param cnt is the number of literals
+ *   @return the new output position
+ */
+static uint8_t *flush_literals(uint8_t *out, const uint8_t *lit, uint32_t cnt)
+{
+    while (cnt) {
+        uint32_t n = (cnt > MAX_LITERAL) ? MAX_LITERAL : cnt;
+        *out++ = (uint8_t)(n - 1);
+        memcpy(out, lit, n);
+        out += n;
+        lit += n;
+        cnt -= n;
+    }
+    return out;
+}
+
+uint32_t block_compress(const uint8_t *in, uint32_t size, uint8_t *out)
+{
+    // last position each hash was seen at, +1 so 0 is empty
+    uint16_t head[HASH_SIZE];
+    uint8_t *start = out;
+    const uint8_t *lit = in;
+    uint32_t i = 0;
+    memset(head, 0, sizeof(head));
+
+    while (i + MIN_MATCH <= size) {
+        uint32_t max = size - i;
+        uint32_t len = 1;
+        if (max > MAX_MATCH) {
+            max = MAX_MATCH;
+        }
+        // runs of 0x00/0xff padding are the common case
+        while ((len < max) && (in[i + len] == in[i])) {
+            len++;
+        }
+        if (len >= MIN_MATCH) {
+            out = flush_literals(out, lit, &in[i] - lit);
+            *out++ = (uint8_t)(0x80 | (len - MIN_MATCH));
+            *out++ = in[i];
+            hash_skipped(head, in, i, i + len, size);
+            i += len;
+            lit = &in[i];
+            continue;
+        }
+        uint8_t h = hash3(&in[i]);
+        uint32_t cand = head[h];
+        head[h] = (uint16_t)(i + 1);
+        if (cand && ((i + 1 - cand) <= MAX_OFFSET)) {
+            const uint8_t *m = &in[cand - 1];
+            len = 0;
+            while ((len < max) && (m[len] == in[i + len])) {
+                len++;
+            }
+            if (len >= MIN_MATCH) {
+                out = flush_literals(out, lit, &in[i] - lit);
+                *out++ = (uint8_t)(0xc0 | (len - MIN_MATCH));
+                *out++ = (uint8_t)(i + 1 - cand - 1);
+                hash_skipped(head, in, i + 1, i + len, size);
+                i += len;
+                lit = &in[i];
+                continue;
+            }
+        }
+        i++;
+    }
+    out = flush_literals(out, lit, &in[size] - lit);
+    return (uint32_t)(out - start);
+}
+
+int32_t block_expand(const uint8_t *in, uint32_t size, uint8_t *out, uint32_t out_size)
+{
+    const uint8_t *end = in + size;
+    uint32_t n = 0;
+    while (in < end) {
+        uint8_t t = *in++;
+        uint32_t len;
+        if (t < 0x80) {
+            len = t + 1;
+            if (((uint32_t)(end - in) < len) || ((n + len) > out_size)) {
+                return -1;
+            }
+            memcpy(&out[n], in, len);
+            in += len;
+        } else {
+            len = (t & 0x3f) + MIN_MATCH;
+            if ((in == end) || ((n + len) > out_size)) {
+                return -1;
+            }
+            if (t < 0xc0) {
+                memset(&out[n], *in++, len);
+            } else {
+                uint32_t off = (uint32_t)(*in++) + 1;
+                if (off > n) {
+                    return -1;
+                }
+                // may overlap the bytes being written so copy forwards
+                for (uint32_t k = 0; k < len; k++) {
+                    out[n + k] = out[n - off + k];
+                }
+            }
+        }
+        n += len;
+    }
+    return (int32_t)n;
+}
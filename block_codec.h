@@ -0,0 +1,35 @@
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+
+#include "stdint.h"
+
+/* A byte oriented LZ/RLE codec for single blocks of firmware. Every block is
+ * coded on its own so a lost block never stops the next one decoding.
+ *
+ * Token byte:
+ *  0x00-0x7f literal, (t + 1) bytes follow
+ *  0x80-0xbf run, (t & 0x3f) + 3 copies of the byte that follows
+ *  0xc0-0xff match, (t & 0x3f) + 3 bytes copied from (next byte + 1) back
+ */
+
+// worst case output for size bytes of input
+#define BLOCK_CODEC_BOUND(size)     ((size) + ((size) + 127) / 128)
+
+/** Compress a block
+ *   @param in is the data to compress
+ *   @param size is the number of bytes in data
+ *   @param out is where the compressed data is written, at least BLOCK_CODEC_BOUND(size) bytes
+ *   @return the size of the compressed data
+ */
+uint32_t block_compress(const uint8_t *in, uint32_t size, uint8_t *out);
+
+/** Expand a compressed block
+ *   @param in is the compressed data
+ *   @param size is the number of bytes in data
+ *   @param out is where the block is written
+ *   @param out_size is the size of out
+ *   @return the size of the block or -1 if the data is corrupt or does not fit in out
+ */
+int32_t block_expand(const uint8_t *in, uint32_t size, uint8_t *out, uint32_t out_size);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef BLOCK_SINK_H
+#define BLOCK_SINK_H
+
+#include "stdint.h"
+
+/** Destination for decoded blocks (serial port, flash, a file on the host...).
+ *  Writes are non-blocking: the sink owns the buffer passed to write() until
+ *  busy() returns 0, so the caller can decode into another buffer meanwhile.
+ */
+class BlockSink {
+public:
+    virtual ~BlockSink() {}
+
+    /** Start draining a block
+     *  @param addr is the target address of the first byte
+     *  @param data is the block, it must stay valid until busy() returns 0
+     *  @param size is the number of bytes in data
+     *  @return 0 if the block was accepted, -1 if the sink is still busy
+     */
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size) = 0;
+
+    /** Check for an outstanding block
+     *  @return 1 while the last accepted block is still draining, otherwise 0
+     */
+    virtual int busy() = 0;
+
+    /** Start erasing a flash sector. Sinks that are not flash have nothing to do
+     *  @param addr is the address of the sector
+     *  @param size is the size of the sector
+     *  @return 0 if the erase was accepted, -1 if the sink is still busy
+     */
+    virtual int erase(uint32_t addr, uint32_t size) {
+        (void)addr;
+        (void)size;
+        return busy() ? -1 : 0;
+    }
+
+    /** Wait until everything written so far has reached its destination
+     *  @return 0 on success, -1 if the sink gave up
+     */
+    virtual int sync() {
+        while (busy());
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "buffered_serial.h"
+
+BufferedSerial::BufferedSerial(PinName tx, PinName rx) : RawSerial(tx, rx), _rx_flow(RxFlowNone)
+{
+    serial_tx_ring_init(&_tx);
+    serial_rx_ring_init(&_rx);
+    attach(this, &BufferedSerial::tx_irq, TxIrq);
+    attach(this, &BufferedSerial::rx_irq, RxIrq);
+}
+
+size_t BufferedSerial::write(const uint8_t *data, size_t size)
+{
+    size_t cnt = serial_tx_ring_put(&_tx, data, size);
+    // THRE only fires when the FIFO drains so an idle transmitter needs a kick
+    __disable_irq();
+    serial_tx_fifo_fill(&_serial, &_tx);
+    __enable_irq();
+    return cnt;
+}
+
+size_t BufferedSerial::tx_pending()
+{
+    return serial_tx_ring_used(&_tx);
+}
+
+void BufferedSerial::set_rx_flow(RxFlow type, PinName rts)
+{
+    _rx_flow = type;
+#if DEVICE_SERIAL_FC
+    if (Rts == type) {
+        set_flow_control(RTS, rts);
+    }
+#endif
+}
+
+uint32_t BufferedSerial::rx_peek(const uint8_t **data)
+{
+    return serial_rx_peek(&_rx, data);
+}
+
+void BufferedSerial::rx_consume(uint32_t size)
+{
+    if (!serial_rx_consume(&_rx, size)) {
+        return;
+    }
+    __disable_irq();
+    if (XonXoff == _rx_flow) {
+        serial_tx_send_urgent(&_serial, &_tx, XON);
+    } else if (Rts == _rx_flow) {
+        // pick up whatever the hardware held while the ring was full
+        serial_irq_set(&_serial, (SerialIrq)RxIrq, 1);
+        serial_rx_fifo_drain(&_serial, &_rx);
+    }
+    __enable_irq();
+}
+
+uint32_t BufferedSerial::rx_overrun()
+{
+    return _rx.overrun;
+}
+
+void BufferedSerial::tx_irq()
+{
+    serial_tx_fifo_fill(&_serial, &_tx);
+}
+
+void BufferedSerial::rx_irq()
+{
+    if (!serial_rx_fifo_drain(&_serial, &_rx)) {
+        return;
+    }
+    if (XonXoff == _rx_flow) {
+        serial_tx_send_urgent(&_serial, &_tx, XOFF);
+    } else if (Rts == _rx_flow) {
+        // leave data in the UART FIFO so it drops RTS
+        serial_irq_set(&_serial, (SerialIrq)RxIrq, 0);
+    }
+}
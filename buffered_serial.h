@@ -0,0 +1,98 @@
+#ifndef BUFFERED_SERIAL_H
+#define BUFFERED_SERIAL_H
+
+#include "mbed.h"
+#include "serial_tx.h"
+#include "serial_rx.h"
+
+/** A RawSerial with interrupt driven transmit and receive rings. write() only
+ * copies into the transmit ring and the TX interrupt refills the UART FIFO a
+ * FIFO at a time, so the caller does not wait on the line. The RX interrupt
+ * empties the receive FIFO into a ring that is read in place with rx_peek().
+ *
+ * Example:
+ * @code
+ * BufferedSerial pc(USBTX, USBRX);
+ *
+ * int main() {
+ *     const uint8_t *data;
+ *     pc.set_rx_flow(BufferedSerial::XonXoff);
+ *     while (1) {
+ *         uint32_t size = pc.rx_peek(&data);
+ *         pc.write(data, size);
+ *         pc.rx_consume(size);
+ *     }
+ * }
+ * @endcode
+ */
+class BufferedSerial : public RawSerial {
+
+public:
+    enum RxFlow {
+        RxFlowNone = 0,
+        XonXoff,
+        Rts
+    };
+
+    /** Create a BufferedSerial port, connected to the specified transmit and receive pins
+     *
+     *  @param tx Transmit pin
+     *  @param rx Receive pin
+     */
+    BufferedSerial(PinName tx, PinName rx);
+
+    /** Queue data to send
+     *
+     *  @param data The data to send
+     *  @param size The number of bytes in data
+     *
+     *  @returns The number of bytes queued, less than size when the ring is full
+     */
+    size_t write(const uint8_t *data, size_t size);
+
+    /** Get the number of bytes not yet handed to the UART
+     *
+     *  @returns The number of queued bytes
+     */
+    size_t tx_pending();
+
+    /** Select how the sender is held off when the receive ring fills.
+     *  XonXoff sends XOFF/XON in band, so only use it when the data going back
+     *  to the sender can not contain those bytes. Rts stops draining the UART
+     *  and lets the hardware deassert RTS on its FIFO level.
+     *
+     *  @param type The flow control type
+     *  @param rts The RTS pin when type is Rts
+     */
+    void set_rx_flow(RxFlow type, PinName rts = NC);
+
+    /** Get received data without copying it
+     *
+     *  @param data Set to the oldest unread byte
+     *
+     *  @returns The number of contiguous bytes at data
+     */
+    uint32_t rx_peek(const uint8_t **data);
+
+    /** Release data returned by rx_peek()
+     *
+     *  @param size The number of bytes that have been used
+     */
+    void rx_consume(uint32_t size);
+
+    /** Get the number of received bytes lost to a full ring
+     *
+     *  @returns The overrun count
+     */
+    uint32_t rx_overrun();
+
+private:
+    void tx_irq();
+    void rx_irq();
+
+    serial_tx_ring_t _tx;
+    serial_rx_ring_t _rx;
+    RxFlow _rx_flow;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "stdint.h"
+
+/* CRC-32 as zip, gzip, zlib and the build's .crc files have it (reflected
+ * 0x04c11db7, starting from and finished with ~0). Values are the finished
+ * CRC, so crc32_update(0, ...) starts one and a value can be handed to
+ * crc32_combine() as it is.
+ *
+ * crc32_update() runs slicing-by-8, 8 bytes a step through 8 KB of const
+ * tables, which stay in flash on the target. On x86 hosts built with GCC it
+ * folds 64 bytes a step with PCLMULQDQ when the CPU has it.
+ */
+
+// 1 to use PCLMULQDQ on x86 hosts that have it
+#ifndef CRC32_PCLMUL
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CRC32_PCLMUL    1
+#else
+#define CRC32_PCLMUL    0
+#endif
+#endif
+
+/** Add data to a CRC
+ *   @param crc is the CRC so far, 0 to start
+ *   @param data is the data to add
+ *   @param size is the number of bytes in data
+ *   @return the updated crc
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t size);
+
+/** Add data to a CRC with the slicing-by-8 tables only, what the target runs
+ *   @param crc is the CRC so far, 0 to start
+ *   @param data is the data to add
+ *   @param size is the number of bytes in data
+ *   @return the updated crc
+ */
+uint32_t crc32_update_sliced(uint32_t crc, const uint8_t *data, uint32_t size);
+
+/** Add a run of the same byte to a CRC, e.g. the 0xff between records. It
+ *   takes steps of a doubling size so a large gap costs no more than a few
+ *   small ones
+ *   @param crc is the CRC so far, 0 to start
+ *   @param value is the byte
+ *   @param size is the number of bytes in the run
+ *   @return the updated crc
+ */
+uint32_t crc32_fill(uint32_t crc, uint8_t value, uint32_t size);
+
+/** Get the CRC of two pieces of data back to back from the CRC of each, so
+ *   pieces decoded apart need no second pass
+ *   @param crc1 is the CRC of the first piece
+ *   @param crc2 is the CRC of the second piece
+ *   @param size2 is the number of bytes in the second piece
+ *   @return the CRC of both
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint32_t size2);
+
+#endif
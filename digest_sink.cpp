@@ -0,0 +1,49 @@
+#include "digest_sink.h"
+#include "crc32.h"
+
+DigestSink::DigestSink(BlockSink &next) : _next(next)
+{
+    reset();
+}
+
+void DigestSink::reset()
+{
+    _started = 0;
+    _ordered = 1;
+    _origin = 0;
+    _size = 0;
+    _crc = 0;
+    sha256_init(&_sha);
+}
+
+int DigestSink::write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    // a busy sink gets the same data again, so only count what it took
+    if (_next.write(addr, data, size)) {
+        return -1;
+    }
+    if (!_started) {
+        _started = 1;
+        _origin = addr;
+    }
+    uint32_t offset = addr - _origin;
+    if ((addr < _origin) || (offset < _size)) {
+        _ordered = 0;
+    }
+    if (!_ordered || !size) {
+        return 0;
+    }
+    _crc = crc32_fill(_crc, 0xff, offset - _size);
+    _crc = crc32_update(_crc, data, size);
+    sha256_fill(&_sha, 0xff, offset - _size);
+    sha256_update(&_sha, data, size);
+    _size = offset + size;
+    return 0;
+}
+
+void DigestSink::sha256(uint8_t *digest) const
+{
+    // finish a copy so the image can go on
+    sha256_t sha = _sha;
+    sha256_final(&sha, digest);
+}
@@ -0,0 +1,93 @@
+#ifndef DIGEST_SINK_H
+#define DIGEST_SINK_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "sha256.h"
+
+/** Passes writes on to another sink and keeps the CRC-32 and the SHA-256 of
+ *  the image they make as it goes, the same as crc32 and sha256sum of the
+ *  .bin: from the first address written, with gaps between writes counted as
+ *  0xff. The image is checked as it is decoded instead of being read back
+ *  afterwards.
+ *
+ *  Writes have to come in address order, as the records of a linker's hex
+ *  do. Data that goes backwards leaves the digest not valid() rather than
+ *  wrong, the sink behind still gets it.
+ *
+ * Example:
+ * @code
+ * PageWriter pages(flash);
+ * DigestSink digest(pages);
+ * HexPipeline pipeline(digest, us_ticker_read);
+ * ...
+ * uint8_t hash[SHA256_SIZE];
+ * digest.sha256(hash);
+ * if (!digest.valid() || memcmp(hash, signed_hash, SHA256_SIZE)) {
+ *     error("image SHA-256 does not match\n");
+ * }
+ * @endcode
+ */
+class DigestSink : public BlockSink {
+
+public:
+    DigestSink(BlockSink &next);
+
+    /** Forget the image so far, for the next one
+     */
+    void reset();
+
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size);
+
+    virtual int busy() {
+        return _next.busy();
+    }
+
+    virtual int erase(uint32_t addr, uint32_t size) {
+        return _next.erase(addr, size);
+    }
+
+    virtual int sync() {
+        return _next.sync();
+    }
+
+    /** Get the CRC-32 of the image written so far
+     */
+    uint32_t crc32() const {
+        return _crc;
+    }
+
+    /** Get the SHA-256 of the image written so far
+     *  @param digest is where the SHA256_SIZE bytes are written
+     */
+    void sha256(uint8_t *digest) const;
+
+    /** Get the address of the first byte of the image
+     */
+    uint32_t origin() const {
+        return _origin;
+    }
+
+    /** Get the number of bytes from origin() to the end of the last write
+     */
+    uint32_t size() const {
+        return _size;
+    }
+
+    /** Check the digest covers the image, 0 if a write went backwards
+     */
+    int valid() const {
+        return _ordered;
+    }
+
+private:
+    BlockSink &_next;
+    uint8_t _started;
+    uint8_t _ordered;
+    uint32_t _origin;
+    uint32_t _size;
+    uint32_t _crc;
+    sha256_t _sha;
+};
+
+#endif
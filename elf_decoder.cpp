@@ -0,0 +1,164 @@
+#include "string.h"
+#include "elf_decoder.h"
+
+/** Read a little endian word from any alignment
+ *   @param p is the first byte
+ *   @return the word
+ */
+static inline uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+ElfDecoder::ElfDecoder(BlockSink &sink) : _sink(sink), _state(ELF_STATE_HEADER), _pos(0), _want(0), _entry(0), _phoff(0),
+    _phentsize(0), _phnum(0), _phdr(0), _count(0), _index(0), _cnt(0)
+{
+}
+
+hex_parse_status_t ElfDecoder::feed(const uint8_t *data, uint32_t size)
+{
+    hex_parse_status_t status = (ELF_STATE_DONE == _state) ? HEX_PARSE_EOF : HEX_PARSE_OK;
+    while (size && (HEX_PARSE_OK == status) && (_pos <= _want)) {
+        uint32_t n;
+        if (_pos < _want) {
+            // nothing that is needed, sections, symbols or debug info
+            n = _want - _pos;
+            if (n > size) {
+                n = size;
+            }
+            data += n;
+            size -= n;
+            _pos += n;
+            continue;
+        }
+        if (ELF_STATE_DATA == _state) {
+            const elf_segment_t *segment = &_segments[_index];
+            n = segment->offset + segment->size - _pos;
+            if (n > size) {
+                n = size;
+            }
+            while (_sink.busy());
+            if (_sink.write(segment->addr + (_pos - segment->offset), data, n)) {
+                return HEX_PARSE_REJECTED;
+            }
+            data += n;
+            size -= n;
+            _pos += n;
+            _want = _pos;
+            if (_pos == (segment->offset + segment->size)) {
+                if (++_index == _count) {
+                    _state = ELF_STATE_DONE;
+                    status = HEX_PARSE_EOF;
+                } else {
+                    _want = _segments[_index].offset;
+                }
+            }
+            continue;
+        }
+        // the ELF header or a program header, put together in _buf
+        uint32_t len = (ELF_STATE_HEADER == _state) ? ELF_HEADER_SIZE : ELF_PHDR_SIZE;
+        n = len - _cnt;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(&_buf[_cnt], data, n);
+        _cnt += n;
+        data += n;
+        size -= n;
+        _pos += n;
+        _want = _pos;
+        if (len == _cnt) {
+            _cnt = 0;
+            status = (ELF_STATE_HEADER == _state) ? header() : phdr();
+        }
+    }
+    if ((HEX_PARSE_OK == status) && (_pos > _want)) {
+        // what is needed next has already gone by
+        _pos = _want;
+        status = HEX_PARSE_SEEK;
+    }
+    return status;
+}
+
+int ElfDecoder::busy()
+{
+    return _sink.busy();
+}
+
+int ElfDecoder::flush()
+{
+    int ret = _sink.sync();
+    return (ELF_STATE_DONE == _state) ? ret : -1;
+}
+
+int ElfDecoder::detect(const uint8_t *data, uint32_t size)
+{
+    static const uint8_t magic[4] = {0x7f, 'E', 'L', 'F'};
+    uint32_t n = (size < sizeof(magic)) ? size : sizeof(magic);
+    if (memcmp(data, magic, n)) {
+        return 0;
+    }
+    return (n < sizeof(magic)) ? -1 : 1;
+}
+
+/** Check the ELF header in _buf and go to the program headers
+ *   @return HEX_PARSE_OK or HEX_PARSE_CKSUM_FAIL
+ */
+hex_parse_status_t ElfDecoder::header()
+{
+    // 32 bit, little endian, version 1
+    if ((detect(_buf, ELF_HEADER_SIZE) <= 0) || (1 != _buf[4]) || (1 != _buf[5]) || (1 != _buf[6])) {
+        return HEX_PARSE_CKSUM_FAIL;
+    }
+    _entry = le32(&_buf[24]);
+    _phoff = le32(&_buf[28]);
+    _phentsize = le16(&_buf[42]);
+    _phnum = le16(&_buf[44]);
+    if (!_phnum || (_phentsize < ELF_PHDR_SIZE)) {
+        return HEX_PARSE_CKSUM_FAIL;
+    }
+    _state = ELF_STATE_PHDRS;
+    _phdr = 0;
+    _want = _phoff;
+    return HEX_PARSE_OK;
+}
+
+/** Add the program header in _buf to the segments, kept in file order, and
+ *   go to the next one or to the first segment after the last
+ *   @return HEX_PARSE_OK, HEX_PARSE_EOF if there is nothing to load or
+ *    HEX_PARSE_LINE_OVERRUN if there are too many segments
+ */
+hex_parse_status_t ElfDecoder::phdr()
+{
+    uint32_t offset = le32(&_buf[4]);
+    uint32_t size = le32(&_buf[16]);
+    if ((ELF_PT_LOAD == le32(&_buf[0])) && size) {
+        if (ELF_MAX_SEGMENTS == _count) {
+            return HEX_PARSE_LINE_OVERRUN;
+        }
+        uint8_t i = _count++;
+        for (; i && (_segments[i - 1].offset > offset); i--) {
+            _segments[i] = _segments[i - 1];
+        }
+        _segments[i].offset = offset;
+        _segments[i].size = size;
+        _segments[i].addr = le32(&_buf[12]);
+    }
+    if (++_phdr < _phnum) {
+        _want = _phoff + (uint32_t)_phdr * _phentsize;
+        return HEX_PARSE_OK;
+    }
+    if (!_count) {
+        _state = ELF_STATE_DONE;
+        return HEX_PARSE_EOF;
+    }
+    _state = ELF_STATE_DATA;
+    _index = 0;
+    _want = _segments[0].offset;
+    return HEX_PARSE_OK;
+}
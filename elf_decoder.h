@@ -0,0 +1,121 @@
+#ifndef ELF_DECODER_H
+#define ELF_DECODER_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "image_decoder.h"
+
+#define ELF_HEADER_SIZE     52
+#define ELF_PHDR_SIZE       32
+#define ELF_PT_LOAD         1
+// loadable segments that can be kept track of
+#ifndef ELF_MAX_SEGMENTS
+#define ELF_MAX_SEGMENTS    8
+#endif
+
+typedef struct {
+    uint32_t offset;    // where the segment's bytes are in the file
+    uint32_t size;      // bytes in the file, the rest up to p_memsz is zeroed at run time
+    uint32_t addr;      // physical (load) address
+} elf_segment_t;
+
+/** Loads a 32 bit little endian ELF (.axf, .elf) straight from the build,
+ *  no hex conversion. The file bytes of every PT_LOAD segment go to the
+ *  sink at the segment's physical address, straight from the input, and
+ *  the rest of the file (symbols, debug info) is skipped.
+ *
+ *  Segments are loaded in file order whatever order the program headers
+ *  list them in, so when the program headers come first (GNU ld) the file
+ *  streams through once with nothing held back but a header. armlink puts
+ *  them at the end, then feed() returns HEX_PARSE_SEEK once they are read
+ *  and the caller goes back to seek_offset() for the data.
+ *
+ *  Like BinLoader the sink reads from the caller's buffer, keep it until
+ *  busy() returns 0.
+ *
+ * Example:
+ * @code
+ * ElfDecoder elf(pages);
+ *
+ * do {
+ *     status = elf.feed(&axf[pos], size - pos);
+ *     pos = (HEX_PARSE_SEEK == status) ? elf.seek_offset() : size;
+ *     while (elf.busy());
+ * } while (HEX_PARSE_SEEK == status);
+ * elf.flush();
+ * @endcode
+ */
+class ElfDecoder : public ImageDecoder {
+
+public:
+    /** Create a decoder in front of a sink
+     *  @param sink is where the segments are sent, usually a PageWriter
+     */
+    ElfDecoder(BlockSink &sink);
+
+    /** Decode the next piece of the file
+     *  @param data is the input, it must stay valid until busy() returns 0
+     *  @param size is the number of bytes in data
+     *  @return HEX_PARSE_OK when it was consumed, HEX_PARSE_EOF once every
+     *   segment is loaded, HEX_PARSE_SEEK to go on from seek_offset(),
+     *   HEX_PARSE_CKSUM_FAIL if it is not an ELF this can load,
+     *   HEX_PARSE_LINE_OVERRUN with more than ELF_MAX_SEGMENTS segments or
+     *   HEX_PARSE_REJECTED if the sink refused a segment
+     */
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size);
+
+    virtual uint32_t seek_offset() const {
+        return _want;
+    }
+
+    virtual int busy();
+
+    /** Wait for the sink
+     *  @return 0 on success, -1 on failure or a file that ended early
+     */
+    virtual int flush();
+
+    /** An ELF starts with 0x7f and "ELF"
+     */
+    virtual int detect(const uint8_t *data, uint32_t size);
+
+    virtual const char *name() const {
+        return "elf";
+    }
+
+    /** Get the entry point from the ELF header
+     */
+    uint32_t entry() const {
+        return _entry;
+    }
+
+private:
+    typedef enum {
+        ELF_STATE_HEADER = 0,
+        ELF_STATE_PHDRS,
+        ELF_STATE_DATA,
+        ELF_STATE_DONE
+    } elf_state_t;
+
+    hex_parse_status_t header();
+    hex_parse_status_t phdr();
+
+    BlockSink &_sink;
+    elf_state_t _state;
+    // file offset of the next byte fed and of the next byte needed
+    uint32_t _pos;
+    uint32_t _want;
+    uint32_t _entry;
+    uint32_t _phoff;
+    uint16_t _phentsize;
+    uint16_t _phnum;
+    uint16_t _phdr;
+    uint8_t _count;
+    uint8_t _index;
+    // a header being put together
+    uint32_t _cnt;
+    uint8_t _buf[ELF_HEADER_SIZE];
+    elf_segment_t _segments[ELF_MAX_SEGMENTS];
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "flash_layout.h"
+
+int32_t flash_sector(uint32_t addr, uint32_t *start, uint32_t *size)
+{
+    if (addr >= FLASH_SIZE) {
+        return -1;
+    }
+    if (addr < 0x10000) {
+        *size = 0x1000;
+        *start = addr & ~0xfff;
+        return addr >> 12;
+    }
+    *size = 0x8000;
+    *start = addr & ~0x7fff;
+    return 16 + ((addr - 0x10000) >> 15);
+}
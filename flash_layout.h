@@ -0,0 +1,21 @@
+#ifndef FLASH_LAYOUT_H
+#define FLASH_LAYOUT_H
+
+#include "stdint.h"
+
+// unit the image is programmed in, one IAP copy to flash
+#define FLASH_PAGE_SIZE     512
+#define FLASH_SIZE          0x80000
+#define FLASH_PAGES         (FLASH_SIZE / FLASH_PAGE_SIZE)
+#define FLASH_SECTORS       30
+
+/** Find the erase sector holding an address. LPC176x: 16 sectors of 4 KB
+ *   followed by 14 of 32 KB
+ *   @param addr is the address
+ *   @param start is set to the address of the sector
+ *   @param size is set to the size of the sector
+ *   @return the sector number or -1 when addr is not in flash
+ */
+int32_t flash_sector(uint32_t addr, uint32_t *start, uint32_t *size);
+
+#endif
@@ -0,0 +1,138 @@
+#include "string.h"
+#include "frame_link.h"
+
+uint16_t link_crc16(uint16_t crc, const uint8_t *data, uint32_t size)
+{
+    // nibble table keeps this small enough for the target
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+    };
+    while (size--) {
+        uint8_t c = *data++;
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (c >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (c & 0xf)];
+    }
+    return crc;
+}
+
+uint32_t link_frame_pack(const link_frame_t *frame, uint8_t *out)
+{
+    uint16_t crc;
+    out[0] = frame->type;
+    out[1] = frame->seq;
+    out[2] = (uint8_t)(frame->addr);
+    out[3] = (uint8_t)(frame->addr >> 8);
+    out[4] = (uint8_t)(frame->addr >> 16);
+    out[5] = (uint8_t)(frame->addr >> 24);
+    out[6] = (uint8_t)(frame->raw_len);
+    out[7] = (uint8_t)(frame->raw_len >> 8);
+    memcpy(&out[LINK_HDR_SIZE], frame->payload, frame->len);
+    crc = link_crc16(0xffff, out, LINK_HDR_SIZE + frame->len);
+    out[LINK_HDR_SIZE + frame->len] = (uint8_t)crc;
+    out[LINK_HDR_SIZE + frame->len + 1] = (uint8_t)(crc >> 8);
+    return LINK_HDR_SIZE + frame->len + LINK_CRC_SIZE;
+}
+
+uint32_t link_escape(const uint8_t *in, uint32_t size, uint8_t *out, uint32_t out_size, uint32_t *used)
+{
+    uint32_t i = 0, n = 0;
+    for (; i < size; i++) {
+        uint8_t c = in[i];
+        if ((LINK_FLAG == c) || (LINK_ESC == c)) {
+            if (n + 2 > out_size) {
+                break;
+            }
+            out[n++] = LINK_ESC;
+            c ^= 0x20;
+        } else if (n == out_size) {
+            break;
+        }
+        out[n++] = c;
+    }
+    *used = i;
+    return n;
+}
+
+uint32_t link_frame_encode(const link_frame_t *frame, uint8_t *out)
+{
+    uint8_t packed[LINK_MAX_PACKED];
+    uint32_t size = link_frame_pack(frame, packed);
+    uint32_t used;
+    uint32_t n = 0;
+    out[n++] = LINK_FLAG;
+    n += link_escape(packed, size, &out[n], LINK_MAX_FRAME - 2, &used);
+    out[n++] = LINK_FLAG;
+    return n;
+}
+
+void link_rx_init(link_rx_t *rx)
+{
+    memset(rx, 0, sizeof(link_rx_t));
+}
+
+/** Check a completed frame and fill in its fields
+ *   @param rx is the receiver holding the frame
+ *   @param frame is filled in from rx
+ *   @return 1 if the frame is good, otherwise 0
+ */
+static uint8_t frame_complete(link_rx_t *rx, link_frame_t *frame)
+{
+    const uint8_t *b = rx->buf;
+    uint32_t len;
+    if (rx->cnt < (LINK_HDR_SIZE + LINK_CRC_SIZE)) {
+        // back to back flags or line noise
+        return 0;
+    }
+    len = rx->cnt - LINK_CRC_SIZE;
+    if (link_crc16(0xffff, b, len) != (uint16_t)(b[len] | (b[len + 1] << 8))) {
+        rx->crc_errors++;
+        return 0;
+    }
+    frame->type = b[0];
+    frame->seq = b[1];
+    frame->addr = b[2] | (b[3] << 8) | (b[4] << 16) | ((uint32_t)b[5] << 24);
+    frame->raw_len = b[6] | (b[7] << 8);
+    frame->len = (uint16_t)(len - LINK_HDR_SIZE);
+    frame->payload = &b[LINK_HDR_SIZE];
+    return 1;
+}
+
+uint32_t link_rx_feed(link_rx_t *rx, const uint8_t *data, uint32_t size, link_frame_t *frame)
+{
+    uint32_t i = 0;
+    frame->type = 0;
+    while (i < size) {
+        uint8_t c = data[i++];
+        if (LINK_FLAG == c) {
+            uint8_t done = rx->in_frame && frame_complete(rx, frame);
+            // a flag both ends one frame and starts the next
+            rx->in_frame = 1;
+            rx->cnt = 0;
+            rx->esc = 0;
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        if (!rx->in_frame) {
+            continue;
+        }
+        if (LINK_ESC == c) {
+            rx->esc = 1;
+            continue;
+        }
+        if (rx->esc) {
+            c ^= 0x20;
+            rx->esc = 0;
+        }
+        if (rx->cnt == sizeof(rx->buf)) {
+            // too long to be a frame, wait for the next flag
+            rx->in_frame = 0;
+            rx->crc_errors++;
+            continue;
+        }
+        rx->buf[rx->cnt++] = c;
+    }
+    return i;
+}
@@ -0,0 +1,97 @@
+#ifndef FRAME_LINK_H
+#define FRAME_LINK_H
+
+#include "stdint.h"
+
+/* Frames on the wire:
+ *
+ *  FLAG | escaped(type, seq, addr[4], raw_len[2], payload, crc16[2]) | FLAG
+ *
+ * Multi-byte fields are little endian and the CRC is CRC-16/CCITT over
+ * everything between the flags before escaping. FLAG and ESC never appear
+ * inside a frame, they are sent as ESC followed by the byte ^ 0x20.
+ */
+#define LINK_FLAG           0x7e
+#define LINK_ESC            0x7d
+#define LINK_HDR_SIZE       8
+#define LINK_CRC_SIZE       2
+#define LINK_MAX_PAYLOAD    512
+// largest frame before escaping
+#define LINK_MAX_PACKED     (LINK_HDR_SIZE + LINK_MAX_PAYLOAD + LINK_CRC_SIZE)
+// worst case encoded frame, every byte escaped
+#define LINK_MAX_FRAME      (2 + 2 * LINK_MAX_PACKED)
+
+typedef enum {
+    LINK_DATA = 1,      // payload is raw_len bytes for addr
+    LINK_PACKED = 2,    // payload is block_compress() output that expands to raw_len bytes
+    LINK_END = 3,       // no more data follows
+    LINK_ACK = 4        // seq is the next frame the receiver expects
+} link_frame_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint32_t addr;
+    uint16_t raw_len;
+    uint16_t len;
+    const uint8_t *payload;
+} link_frame_t;
+
+/** Receiver state for pulling frames out of a byte stream
+ */
+typedef struct {
+    uint8_t buf[LINK_MAX_PACKED];
+    uint32_t cnt;
+    uint8_t esc;
+    uint8_t in_frame;
+    uint32_t crc_errors;
+} link_rx_t;
+
+/** Calculate CRC-16/CCITT
+ *   @param crc is the running value, 0xffff to start
+ *   @param data is the data to add
+ *   @param size is the number of bytes in data
+ *   @return the updated crc
+ */
+uint16_t link_crc16(uint16_t crc, const uint8_t *data, uint32_t size);
+
+/** Build a frame without the flags or escaping
+ *   @param frame is the frame to pack, len bytes of payload
+ *   @param out is where the frame is written, at least LINK_MAX_PACKED bytes
+ *   @return the number of bytes written to out
+ */
+uint32_t link_frame_pack(const link_frame_t *frame, uint8_t *out);
+
+/** Escape part of a packed frame for the wire
+ *   @param in is the packed data
+ *   @param size is the number of bytes in data
+ *   @param out is where the escaped bytes are written
+ *   @param out_size is the space in out, an escaped pair is never split
+ *   @param used is set to the number of bytes of in that were escaped
+ *   @return the number of bytes written to out
+ */
+uint32_t link_escape(const uint8_t *in, uint32_t size, uint8_t *out, uint32_t out_size, uint32_t *used);
+
+/** Build a frame ready to send
+ *   @param frame is the frame to encode, len bytes of payload
+ *   @param out is where the encoded frame is written, at least LINK_MAX_FRAME bytes
+ *   @return the number of bytes written to out
+ */
+uint32_t link_frame_encode(const link_frame_t *frame, uint8_t *out);
+
+/** Reset a receiver
+ *   @param rx is the receiver
+ */
+void link_rx_init(link_rx_t *rx);
+
+/** Feed received bytes until a frame completes
+ *   @param rx is the receiver
+ *   @param data is the received data
+ *   @param size is the number of bytes in data
+ *   @param frame is filled in when a frame with a good CRC completes, payload points into
+ *    rx and stays valid until the next call. frame->type is 0 if no frame completed
+ *   @return the number of bytes used, stops right after a complete frame
+ */
+uint32_t link_rx_feed(link_rx_t *rx, const uint8_t *data, uint32_t size, link_frame_t *frame);
+
+#endif
@@ -0,0 +1,193 @@
+#include "string.h"
+#include "hex_file_system.h"
+
+HexFileHandle::HexFileHandle(HexFileSystem &fs) : _fs(fs), _pos(0)
+{
+}
+
+ssize_t HexFileHandle::write(const void *buffer, size_t length)
+{
+    (void)buffer;
+    (void)length;
+    return -1;
+}
+
+int HexFileHandle::close()
+{
+    _fs._index.close();
+    _fs._open = 0;
+    return 0;
+}
+
+ssize_t HexFileHandle::read(void *buffer, size_t length)
+{
+    uint8_t *out = (uint8_t *)buffer;
+    _fs._stats.reads++;
+    if (_pos >= _fs._size) {
+        return 0;
+    }
+    if (length > (_fs._size - _pos)) {
+        length = _fs._size - _pos;
+    }
+    // a read over more than one block is decoded in one pass
+    if ((_pos / HEXFS_BLOCK_SIZE) != ((_pos + length - 1) / HEXFS_BLOCK_SIZE)) {
+        int ret = _fs.span(_pos, out, length);
+        if (ret < 0) {
+            return -1;
+        }
+        if (0 == ret) {
+            _pos += length;
+            return length;
+        }
+    }
+    size_t done = 0;
+    while (done < length) {
+        const uint8_t *data = _fs.block(_pos);
+        if (!data) {
+            return done ? (ssize_t)done : -1;
+        }
+        uint32_t offset = _pos % HEXFS_BLOCK_SIZE;
+        uint32_t n = HEXFS_BLOCK_SIZE - offset;
+        n = (n < (length - done)) ? n : (length - done);
+        memcpy(&out[done], &data[offset], n);
+        done += n;
+        _pos += n;
+    }
+    return done;
+}
+
+int HexFileHandle::isatty()
+{
+    return 0;
+}
+
+off_t HexFileHandle::lseek(off_t offset, int whence)
+{
+    off_t pos = offset;
+    if (SEEK_CUR == whence) {
+        pos += _pos;
+    } else if (SEEK_END == whence) {
+        pos += _fs._size;
+    } else if (SEEK_SET != whence) {
+        return -1;
+    }
+    if (pos < 0) {
+        return -1;
+    }
+    _pos = pos;
+    return pos;
+}
+
+int HexFileHandle::fsync()
+{
+    return 0;
+}
+
+off_t HexFileHandle::flen()
+{
+    return _fs._size;
+}
+
+HexFileSystem::HexFileSystem(const char *name, const char *hex_path, const char *index_path) :
+    FileSystemLike(name), _hex_path(hex_path), _index_path(index_path), _handle(*this), _open(0), _size(0), _tick(0)
+{
+    memset(_used, 0, sizeof(_used));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+mbed::FileHandle *HexFileSystem::open(const char *filename, int flags)
+{
+    if (_open || strcmp(filename, "image.bin") || ((flags & 3) != O_RDONLY)) {
+        return NULL;
+    }
+    // there is no modification time to go by, a hash of the hex tells if the index is stale
+    if (_index.open(_hex_path, _index_path, 0)) {
+        return NULL;
+    }
+    _size = _index.header().end;
+    memset(_used, 0, sizeof(_used));
+    _handle._pos = 0;
+    _open = 1;
+    return &_handle;
+}
+
+/** Get the decoded block an address is in, from the cache or the hex file
+ *  @return the block, or NULL if the hex file can not be read
+ */
+const uint8_t *HexFileSystem::block(uint32_t addr)
+{
+    addr -= addr % HEXFS_BLOCK_SIZE;
+    int32_t i = find(addr);
+    if (i >= 0) {
+        _used[i] = ++_tick;
+        _stats.hits++;
+        return _data[i];
+    }
+    uint32_t v = victim();
+    _stats.misses++;
+    if (_index.read(addr, _data[v], HEXFS_BLOCK_SIZE)) {
+        _used[v] = 0;
+        return NULL;
+    }
+    _addr[v] = addr;
+    _used[v] = ++_tick;
+    return _data[v];
+}
+
+/** Decode a read over more than one block in one pass, unless all of it is
+ *  cached already, and keep the whole blocks in it in the cache
+ *  @return 0 when the data was read, 1 to read it from the cache instead, -1
+ *   if the hex file can not be read
+ */
+int HexFileSystem::span(uint32_t addr, uint8_t *data, uint32_t size)
+{
+    uint32_t start = addr - (addr % HEXFS_BLOCK_SIZE);
+    uint32_t blocks = 0, cached = 0;
+    for (uint32_t a = start; a < (addr + size); a += HEXFS_BLOCK_SIZE) {
+        blocks++;
+        cached += (find(a) >= 0) ? 1 : 0;
+    }
+    if (cached == blocks) {
+        return 1;
+    }
+    _stats.misses += blocks - cached;
+    if (_index.read(addr, data, size)) {
+        return -1;
+    }
+    // the last whole blocks read are the ones left in the cache
+    uint32_t a = (start < addr) ? (start + HEXFS_BLOCK_SIZE) : start;
+    for (; (a + HEXFS_BLOCK_SIZE) <= (addr + size); a += HEXFS_BLOCK_SIZE) {
+        int32_t i = find(a);
+        uint32_t v = (i >= 0) ? (uint32_t)i : victim();
+        memcpy(_data[v], &data[a - addr], HEXFS_BLOCK_SIZE);
+        _addr[v] = a;
+        _used[v] = ++_tick;
+    }
+    return 0;
+}
+
+/** Look for a block in the cache
+ *  @return its slot, or -1
+ */
+int32_t HexFileSystem::find(uint32_t addr)
+{
+    for (uint32_t i = 0; i < HEXFS_BLOCKS; i++) {
+        if (_used[i] && (_addr[i] == addr)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/** Get the least recently used slot, an empty one first
+ */
+uint32_t HexFileSystem::victim()
+{
+    uint32_t v = 0;
+    for (uint32_t i = 1; i < HEXFS_BLOCKS; i++) {
+        if (_used[i] < _used[v]) {
+            v = i;
+        }
+    }
+    return v;
+}
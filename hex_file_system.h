@@ -0,0 +1,112 @@
+#ifndef HEX_FILE_SYSTEM_H
+#define HEX_FILE_SYSTEM_H
+
+#include "stdint.h"
+#include "FileSystemLike.h"
+#include "hex_index.h"
+
+// decoded blocks kept between reads, and their size
+#ifndef HEXFS_BLOCKS
+#define HEXFS_BLOCKS        4
+#endif
+#ifndef HEXFS_BLOCK_SIZE
+#define HEXFS_BLOCK_SIZE    256
+#endif
+
+typedef struct {
+    uint32_t reads;     // read() calls
+    uint32_t hits;      // blocks found in the cache
+    uint32_t misses;    // blocks decoded from the hex file
+} hex_file_system_stats_t;
+
+class HexFileSystem;
+
+/** The binary of the hex image, address 0 at offset 0. Only handed out by
+ *  HexFileSystem::open()
+ */
+class HexFileHandle : public mbed::FileHandle {
+
+public:
+    virtual ssize_t write(const void *buffer, size_t length);
+    virtual int close();
+    virtual ssize_t read(void *buffer, size_t length);
+    virtual int isatty();
+    virtual off_t lseek(off_t offset, int whence);
+    virtual int fsync();
+    virtual off_t flen();
+
+private:
+    friend class HexFileSystem;
+    HexFileHandle(HexFileSystem &fs);
+
+    HexFileSystem &_fs;
+    uint32_t _pos;
+};
+
+/** A read only file system with one file, image.bin, which is an Intel HEX
+ *  file seen as the binary it describes. Nothing is converted up front: a
+ *  read() decodes only the records it needs, found through a HexIndex, and
+ *  gaps between records read as 0xff. A read over more than one block is
+ *  decoded in one pass straight into the caller's buffer and its whole
+ *  blocks are kept in a cache of HEXFS_BLOCKS, a smaller read goes through
+ *  the cache.
+ *  The file runs from address 0 to the end of the highest record, like the
+ *  .bin files in test/, so code that reads images through FILE* or a
+ *  FileHandle can take a hex image as it is.
+ *
+ *  The index is built next to the hex file the first time the file is
+ *  opened, or when the hex has changed, and is reused after that. One handle
+ *  can be open at a time.
+ *
+ * Example:
+ * @code
+ * LocalFileSystem local("local");
+ * HexFileSystem hex("hex", "/local/image.hex", "/local/image.hix");
+ *
+ * FILE *f = fopen("/hex/image.bin", "rb");
+ * fseek(f, 0x10000, SEEK_SET);
+ * fread(buf, 1, 4096, f);
+ * fclose(f);
+ * @endcode
+ */
+class HexFileSystem : public mbed::FileSystemLike {
+
+public:
+    /** @param name is the mount point, "hex" for /hex
+     *  @param hex_path is the hex file
+     *  @param index_path is where its index is kept
+     */
+    HexFileSystem(const char *name, const char *hex_path, const char *index_path);
+
+    /** Open image.bin, read only
+     *  @return the handle, or NULL for another name, a write, a second handle
+     *   or a hex file that can not be indexed
+     */
+    virtual mbed::FileHandle *open(const char *filename, int flags);
+
+    const hex_file_system_stats_t &stats() const {
+        return _stats;
+    }
+
+private:
+    friend class HexFileHandle;
+    const uint8_t *block(uint32_t addr);
+    int span(uint32_t addr, uint8_t *data, uint32_t size);
+    int32_t find(uint32_t addr);
+    uint32_t victim();
+
+    const char *_hex_path;
+    const char *_index_path;
+    HexIndex _index;
+    HexFileHandle _handle;
+    uint8_t _open;
+    uint32_t _size;
+    // cached blocks, by address, the least recently used one is replaced
+    uint32_t _tick;
+    uint32_t _addr[HEXFS_BLOCKS];
+    uint32_t _used[HEXFS_BLOCKS];
+    uint8_t _data[HEXFS_BLOCKS][HEXFS_BLOCK_SIZE];
+    hex_file_system_stats_t _stats;
+};
+
+#endif
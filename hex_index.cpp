@@ -0,0 +1,310 @@
+#include "string.h"
+#include "hex_index.h"
+
+HexIndex::HexIndex() : _hex(0), _index(0), _rebuilt(0)
+{
+    memset(&_header, 0, sizeof(_header));
+}
+
+HexIndex::~HexIndex()
+{
+    close();
+}
+
+int HexIndex::open(const char *hex_path, const char *index_path, uint32_t stamp)
+{
+    close();
+    _hex = fopen(hex_path, "rb");
+    if (!_hex) {
+        return -1;
+    }
+    fseek(_hex, 0, SEEK_END);
+    uint32_t size = ftell(_hex);
+    if (!stamp) {
+        stamp = hash();
+    }
+    _index = fopen(index_path, "rb");
+    if (_index) {
+        hex_index_header_t h;
+        if ((1 == fread(&h, sizeof(h), 1, _index)) && !memcmp(h.magic, "HIDX", 4) && (HEX_INDEX_VERSION == h.version) &&
+            (HEX_INDEX_RECORDS == h.records) && (size == h.hex_size) && (stamp == h.stamp)) {
+            _header = h;
+            _rebuilt = 0;
+            return 0;
+        }
+        fclose(_index);
+        _index = 0;
+    }
+    memset(&_header, 0, sizeof(_header));
+    memcpy(_header.magic, "HIDX", 4);
+    _header.version = HEX_INDEX_VERSION;
+    _header.records = HEX_INDEX_RECORDS;
+    _header.hex_size = size;
+    _header.stamp = stamp;
+    _rebuilt = 1;
+    if (build(index_path)) {
+        close();
+        return -1;
+    }
+    return 0;
+}
+
+void HexIndex::close()
+{
+    if (_hex) {
+        fclose(_hex);
+        _hex = 0;
+    }
+    if (_index) {
+        fclose(_index);
+        _index = 0;
+    }
+}
+
+int HexIndex::read(uint32_t addr, uint8_t *data, uint32_t size)
+{
+    memset(data, 0xff, size);
+    if (!_index) {
+        return -1;
+    }
+    uint32_t limit = ((addr + size) < addr) ? 0xffffffff : (addr + size);
+    hex_index_entry_t e, next_entry;
+    // sorted, from the first entry that ends past addr to the first that starts past the read.
+    // Otherwise every entry that overlaps, in file order so the last record written wins
+    int32_t i = _header.sorted ? lookup(addr, &e) : (_header.entries ? 0 : -1);
+    if ((i >= 0) && !_header.sorted && entry(0, &e)) {
+        return -1;
+    }
+    for (; i >= 0; i++) {
+        if (_header.sorted && (e.start >= limit)) {
+            break;
+        }
+        uint32_t stop = _header.hex_size;
+        int more = ((uint32_t)i + 1 < _header.entries);
+        if (more) {
+            if (entry(i + 1, &next_entry)) {
+                return -1;
+            }
+            stop = next_entry.offset;
+        }
+        if ((e.start < limit) && (e.end > addr) && decode(e, stop, addr, data, size)) {
+            return -1;
+        }
+        if (!more) {
+            break;
+        }
+        e = next_entry;
+    }
+    return 0;
+}
+
+int32_t HexIndex::lookup(uint32_t addr, hex_index_entry_t *e)
+{
+    if (!_index) {
+        return -1;
+    }
+    if (!_header.sorted) {
+        for (uint32_t i = 0; i < _header.entries; i++) {
+            if (entry(i, e)) {
+                return -1;
+            }
+            if (e->end > addr) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    // the first entry that ends past addr
+    uint32_t lo = 0;
+    uint32_t hi = _header.entries;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (entry(mid, e)) {
+            return -1;
+        }
+        if (e->end > addr) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    if ((lo == _header.entries) || entry(lo, e)) {
+        return -1;
+    }
+    return lo;
+}
+
+/** Read through the hex file once and write the header and an entry every
+ *  HEX_INDEX_RECORDS records. The header goes in without its magic until the
+ *  entries are all written, so a build that fails or is cut short leaves a
+ *  sidecar open() rebuilds, and one that fails is removed
+ */
+int HexIndex::build(const char *index_path)
+{
+    _index = fopen(index_path, "wb");
+    if (!_index) {
+        return -1;
+    }
+    _header.start = 0xffffffff;
+    _header.sorted = 1;
+    hex_index_header_t placeholder = _header;
+    memset(placeholder.magic, 0, sizeof(placeholder.magic));
+    int ok = (1 == fwrite(&placeholder, sizeof(placeholder), 1, _index));
+    fseek(_hex, 0, SEEK_SET);
+    hex_index_entry_t e;
+    int open_entry = 0;
+    int pending = 1;
+    uint32_t base = 0;
+    uint32_t records = 0;
+    uint32_t offset;
+    int r;
+    while (ok && ((r = next(&offset)) > 0)) {
+        HexRecord record(_line, base);
+        hex_record_t type = record.type();
+        if ((DATA_RECORD == type) && record.length()) {
+            uint32_t start = record.address();
+            uint32_t end = start + record.length();
+            if (pending) {
+                if (open_entry) {
+                    ok = !add(e);
+                }
+                e.offset = offset;
+                e.base = base;
+                e.start = start;
+                e.end = end;
+                open_entry = 1;
+                pending = 0;
+            } else {
+                e.start = (start < e.start) ? start : e.start;
+                e.end = (end > e.end) ? end : e.end;
+            }
+        } else if (EXT_SEG_ADDR_RECORD == type) {
+            base = (((uint32_t)record[0] << 8) | record[1]) << 4;
+        } else if (EXT_LINEAR_ADDR_RECORD == type) {
+            base = (((uint32_t)record[0] << 8) | record[1]) << 16;
+        } else if (EOF_RECORD == type) {
+            break;
+        }
+        if (!(++records % HEX_INDEX_RECORDS)) {
+            pending = 1;
+        }
+    }
+    if (ok && (r < 0)) {
+        ok = 0;
+    }
+    if (ok && open_entry) {
+        ok = !add(e);
+    }
+    if (!_header.entries) {
+        _header.start = 0;
+    }
+    if (ok) {
+        fseek(_index, 0, SEEK_SET);
+        ok = (1 == fwrite(&_header, sizeof(_header), 1, _index));
+    }
+    ok &= !fclose(_index);
+    _index = ok ? fopen(index_path, "rb") : 0;
+    if (!_index) {
+        remove(index_path);
+        return -1;
+    }
+    return 0;
+}
+
+/** Write an entry and widen the header to cover it
+ */
+int HexIndex::add(const hex_index_entry_t &e)
+{
+    if (e.start < _header.end) {
+        _header.sorted = 0;
+    }
+    _header.entries++;
+    _header.start = (e.start < _header.start) ? e.start : _header.start;
+    _header.end = (e.end > _header.end) ? e.end : _header.end;
+    return (1 == fwrite(&e, sizeof(e), 1, _index)) ? 0 : -1;
+}
+
+int HexIndex::entry(uint32_t i, hex_index_entry_t *e)
+{
+    if (fseek(_index, sizeof(_header) + i * sizeof(*e), SEEK_SET) || (1 != fread(e, sizeof(*e), 1, _index))) {
+        return -1;
+    }
+    return 0;
+}
+
+/** Decode the records of an entry into the part of a read they overlap
+ *  @param stop is the offset of the next entry
+ */
+int HexIndex::decode(const hex_index_entry_t &e, uint32_t stop, uint32_t addr, uint8_t *data, uint32_t size)
+{
+    if (fseek(_hex, e.offset, SEEK_SET)) {
+        return -1;
+    }
+    uint32_t limit = ((addr + size) < addr) ? 0xffffffff : (addr + size);
+    uint32_t base = e.base;
+    uint32_t offset;
+    int r;
+    while (((r = next(&offset)) > 0) && (offset < stop)) {
+        HexRecord record(_line, base);
+        hex_record_t type = record.type();
+        if (DATA_RECORD == type) {
+            uint32_t start = record.address();
+            uint32_t end = start + record.length();
+            if ((end > addr) && (start < limit)) {
+                uint32_t lo = (start > addr) ? start : addr;
+                uint32_t hi = (end < limit) ? end : limit;
+                for (uint32_t a = lo; a < hi; a++) {
+                    data[a - addr] = record[a - start];
+                }
+            }
+        } else if (EXT_SEG_ADDR_RECORD == type) {
+            base = (((uint32_t)record[0] << 8) | record[1]) << 4;
+        } else if (EXT_LINEAR_ADDR_RECORD == type) {
+            base = (((uint32_t)record[0] << 8) | record[1]) << 16;
+        } else if (EOF_RECORD == type) {
+            break;
+        }
+    }
+    return (r < 0) ? -1 : 0;
+}
+
+/** Read the record at the file position into _line
+ *  @param offset is set to where its ':' is in the file
+ *  @return 1 for a good record, 0 at the end of the file, -1 for anything else
+ */
+int HexIndex::next(uint32_t *offset)
+{
+    int c;
+    while ((EOF != (c = getc(_hex))) && (c <= ' '));
+    if (EOF == c) {
+        return 0;
+    }
+    if (':' != c) {
+        return -1;
+    }
+    *offset = ftell(_hex) - 1;
+    _line[0] = ':';
+    if (8 != fread(&_line[1], 1, 8, _hex)) {
+        return -1;
+    }
+    uint32_t rest = (uint32_t)hex_nibbles(&_line[1]) * 2 + 2;
+    if (rest != fread(&_line[9], 1, rest, _hex)) {
+        return -1;
+    }
+    return HexRecord(_line, 0).valid() ? 1 : -1;
+}
+
+/** FNV-1a over the whole hex file, for a caller with nothing better to stamp it with
+ */
+uint32_t HexIndex::hash()
+{
+    uint32_t h = 2166136261u;
+    fseek(_hex, 0, SEEK_SET);
+    size_t n;
+    while ((n = fread(_line, 1, sizeof(_line), _hex)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            h = (h ^ _line[i]) * 16777619u;
+        }
+    }
+    return h;
+}
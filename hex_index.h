@@ -0,0 +1,114 @@
+#ifndef HEX_INDEX_H
+#define HEX_INDEX_H
+
+#include "stdint.h"
+#include "stdio.h"
+#include "hex_parser.h"
+#include "hex_record_reader.h"
+
+// records of the hex file between index entries
+#ifndef HEX_INDEX_RECORDS
+#define HEX_INDEX_RECORDS   64
+#endif
+#define HEX_INDEX_VERSION   1
+
+typedef struct {
+    char magic[4];      // "HIDX"
+    uint32_t version;
+    uint32_t records;   // HEX_INDEX_RECORDS the index was built with
+    uint32_t hex_size;  // size of the hex file it was built from
+    uint32_t stamp;     // from the caller, or a hash of the hex file
+    uint32_t entries;
+    uint32_t start;     // lowest address with data
+    uint32_t end;       // one past the highest
+    uint32_t sorted;    // every entry starts at or after the end of the one before
+} hex_index_header_t;
+
+typedef struct {
+    uint32_t offset;    // in the hex file of the first data record of the entry
+    uint32_t base;      // upper address in force at that record
+    uint32_t start;     // lowest address of the data records up to the next entry
+    uint32_t end;       // one past the highest
+} hex_index_entry_t;
+
+/** Random access to the data of an Intel HEX file without decoding it from
+ *  the start. Every HEX_INDEX_RECORDS records the index notes where the next
+ *  data record is, the upper address (extended linear or segment) in force
+ *  there and the addresses the data records up to the next entry cover. A
+ *  read finds the entries it overlaps and decodes only their records.
+ *
+ *  The index is kept in a sidecar file next to the hex and is used straight
+ *  from there, an entry is 16 bytes on disk and none are held in RAM. Images
+ *  that are built in address order, which is nearly all of them, get sorted
+ *  entries and a read is a binary search. Otherwise every entry is checked.
+ *
+ *  The sidecar is rebuilt when the hex file is not the one it was built
+ *  from: a different size, or a different stamp. The stamp is anything the
+ *  caller knows changes with the file, its modification time on a host.
+ *  With a stamp of 0 a hash of the whole file is used, which still reads the
+ *  hex once but decodes nothing.
+ *
+ * Example:
+ * @code
+ * HexIndex index;
+ * if (!index.open("/local/image.hex", "/local/image.hix", 0)) {
+ *     index.read(0x10000, buf, 4096);
+ * }
+ * @endcode
+ */
+class HexIndex {
+
+public:
+    HexIndex();
+    ~HexIndex();
+
+    /** Open a hex file and its index, building the index if it is missing or stale
+     *  @param hex_path is the hex file
+     *  @param index_path is the sidecar, created or replaced as needed
+     *  @param stamp changes whenever the hex does, or 0 to hash the file
+     *  @return 0 on success, -1 if a file can not be opened or the hex is broken
+     */
+    int open(const char *hex_path, const char *index_path, uint32_t stamp);
+
+    void close();
+
+    /** Read data from the image, gaps read as 0xff
+     *  @param addr is the address of the first byte
+     *  @param data is filled with size bytes
+     *  @return 0 on success, -1 on a read error or a bad record
+     */
+    int read(uint32_t addr, uint8_t *data, uint32_t size);
+
+    /** Find the first entry that holds data at or above an address
+     *  @param entry is set to it
+     *  @return its number, or -1 if there is none
+     */
+    int32_t lookup(uint32_t addr, hex_index_entry_t *entry);
+
+    const hex_index_header_t &header() const {
+        return _header;
+    }
+
+    /** Check if open() found the sidecar stale, or missing, and built it
+     */
+    int rebuilt() const {
+        return _rebuilt;
+    }
+
+private:
+    int build(const char *index_path);
+    int add(const hex_index_entry_t &e);
+    int entry(uint32_t i, hex_index_entry_t *e);
+    int decode(const hex_index_entry_t &e, uint32_t stop, uint32_t addr, uint8_t *data, uint32_t size);
+    int next(uint32_t *offset);
+    uint32_t hash();
+
+    FILE *_hex;
+    FILE *_index;
+    hex_index_header_t _header;
+    int _rebuilt;
+    // the record next() read, the longest one there can be
+    uint8_t _line[11 + 255 * 2];
+};
+
+#endif
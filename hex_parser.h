@@ -0,0 +1,67 @@
+#ifndef HEX_PARSER_H
+#define HEX_PARSER_H
+
+#include "stdint.h"
+
+typedef enum {
+    HEX_PARSE_OK = 0,
+    HEX_PARSE_EOF,
+    HEX_PARSE_UNALIGNED,
+    HEX_PARSE_LINE_OVERRUN,
+    HEX_PARSE_CKSUM_FAIL,
+    HEX_PARSE_UNINIT,
+    HEX_PARSE_REJECTED,
+    HEX_PARSE_SEEK,
+    // a data record runs past the top of the 32 bit address space
+    HEX_PARSE_WRAP
+} hex_parse_status_t;
+
+// one piece of a stream that is not in one place
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+} hex_iovec_t;
+
+typedef enum {
+    DATA_RECORD = 0,
+    EOF_RECORD = 1,
+    EXT_SEG_ADDR_RECORD = 2,
+    START_SEG_ADDR_RECORD = 3,
+    EXT_LINEAR_ADDR_RECORD = 4,
+    START_LINEAR_ADDR_RECORD = 5
+} hex_record_t;
+
+typedef union hex_line_t hex_line_t;
+union __attribute__((packed)) hex_line_t {
+    uint8_t buf[0x25];
+    struct __attribute__((packed)) {
+        uint8_t  byte_count;
+        uint16_t address;
+        uint8_t  record_type;
+        uint8_t  data[0x20];
+        uint8_t  checksum;
+    };
+};
+
+/** Decode a chunk of an Intel HEX image into a binary buffer. The parser keeps its
+ *   state between calls so an image can be fed in pieces of any size. New code
+ *   should use HexPushParser (hex_push_parser.h), which calls back with each
+ *   record instead of filling a buffer.
+ *   @param hex_blob is the ascii hex data to decode
+ *   @param hex_blob_size is the number of bytes in hex_blob
+ *   @param hex_parse_cnt is set to the number of hex_blob bytes consumed
+ *   @param bin_buf is where the decoded data is written
+ *   @param bin_buf_size is the size of bin_buf. Unused space is filled with 0xff
+ *   @param bin_buf_address is set to the address of the first byte in bin_buf
+ *   @param bin_buf_cnt is set to the number of bytes decoded into bin_buf
+ *   @return HEX_PARSE_OK when all of hex_blob was consumed, HEX_PARSE_UNALIGNED when a
+ *    record does not start where the data in bin_buf ends (it is returned by the next
+ *    call), HEX_PARSE_EOF at the end record, HEX_PARSE_CKSUM_FAIL on a bad record or
+ *    HEX_PARSE_WRAP for a record that runs past 0xffffffff
+ *
+ *   The sizes are per call, an image of any size is fed in chunks and the caller
+ *   keeps the running total of hex_parse_cnt in 64 bits if it needs one.
+ */
+hex_parse_status_t parse_hex_blob(uint8_t *hex_blob, uint32_t hex_blob_size, uint32_t *hex_parse_cnt, uint8_t *bin_buf, uint32_t bin_buf_size, uint32_t *bin_buf_address, uint32_t *bin_buf_cnt);
+
+#endif
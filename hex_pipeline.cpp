@@ -0,0 +1,60 @@
+#include "string.h"
+#include "hex_pipeline.h"
+
+HexPipeline::HexPipeline(BlockSink &sink, clock_fn now_us) : _sink(sink), _now(now_us), _start(0), _started(0), _parser(*this), _entry(0), _runs(sink, _buf[0], HEX_BLOCK_SIZE, now_us)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+hex_parse_status_t HexPipeline::feed(const uint8_t *hex, uint32_t size)
+{
+    hex_iovec_t iov = {hex, size};
+    return feedv(&iov, 1);
+}
+
+hex_parse_status_t HexPipeline::feedv(const hex_iovec_t *iov, uint32_t count)
+{
+    if (!_started) {
+        _started = 1;
+        _start = _now();
+    }
+    uint32_t stall_us = _runs.stall_us();
+    uint32_t t = _now();
+    hex_parse_status_t status = _parser.feedv(iov, count);
+    if ((HEX_PARSE_EOF == status) && _runs.send()) {
+        status = HEX_PARSE_REJECTED;
+    }
+    // waiting for the sink in on_data() is not parsing
+    t = _now() - t - (_runs.stall_us() - stall_us);
+    _stats.blocks = _runs.blocks();
+    _stats.stall_us = _runs.stall_us();
+    _stats.parse_us += t;
+    // the sink was started before the parse so if it is still going the parse cost nothing
+    if (_sink.busy()) {
+        _stats.hidden_us += t;
+    }
+    return status;
+}
+
+int HexPipeline::on_data(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    return _runs.add(addr, data, size);
+}
+
+int HexPipeline::flush()
+{
+    // an image cut short of its EOF record still has a run in the fill buffer
+    int ret = _runs.flush();
+    _stats.blocks = _runs.blocks();
+    _stats.stall_us = _runs.stall_us();
+    _stats.total_us = _now() - _start;
+    return ret;
+}
+
+int HexPipeline::detect(const uint8_t *data, uint32_t size)
+{
+    if (!size) {
+        return -1;
+    }
+    return (':' == data[0]) ? 1 : 0;
+}
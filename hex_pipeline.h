@@ -0,0 +1,115 @@
+#ifndef HEX_PIPELINE_H
+#define HEX_PIPELINE_H
+
+#include "stdint.h"
+#include "hex_parser.h"
+#include "hex_push_parser.h"
+#include "block_sink.h"
+#include "image_decoder.h"
+#include "run_buffer.h"
+
+// amount of hex the target feeds at a time, and the largest run sent to the sink
+#define HEX_BLOCK_SIZE  512
+
+typedef struct {
+    uint32_t blocks;    // blocks handed to the sink
+    uint32_t parse_us;  // time spent parsing
+    uint32_t hidden_us; // parse time that ran while the sink was draining
+    uint32_t stall_us;  // time spent waiting for the sink to release a buffer
+    uint32_t total_us;  // first feed() to the end of flush()
+} hex_pipeline_stats_t;
+
+/** Decodes hex into one of two buffers while the sink drains the other one.
+ *  It is the handler of a HexPushParser, records with contiguous addresses
+ *  are collected into a run of up to HEX_BLOCK_SIZE bytes and a gap, a full
+ *  buffer or the end of the image sends it.
+ *
+ * Example:
+ * @code
+ * HexPipeline pipeline(sink, us_ticker_read);
+ *
+ * do {
+ *     status = pipeline.feed(hex, HEX_BLOCK_SIZE);
+ *     hex += HEX_BLOCK_SIZE;
+ * } while (HEX_PARSE_OK == status);
+ * pipeline.flush();
+ * @endcode
+ */
+class HexPipeline : public ImageDecoder {
+
+public:
+    typedef uint32_t (*clock_fn)(void);
+
+    /** Create a pipeline in front of a sink
+     *  @param sink is where decoded blocks are sent
+     *  @param now_us returns a free running microsecond count used for the stats
+     */
+    HexPipeline(BlockSink &sink, clock_fn now_us);
+
+    /** Decode a chunk of hex and queue the result to the sink. Chunks can be any
+     *   size, the blocks sent to the sink are the same however the image is split.
+     *   Each block is a run of contiguous data at its real address, so put a
+     *   PageWriter in front of a flash sink.
+     *  @param hex is the ascii hex data
+     *  @param size is the number of bytes in hex
+     *  @return HEX_PARSE_OK when the chunk was consumed, HEX_PARSE_EOF at the end
+     *   of the image, HEX_PARSE_REJECTED if the sink refused a block or the
+     *   HexPushParser error
+     */
+    virtual hex_parse_status_t feed(const uint8_t *hex, uint32_t size);
+
+    /** Decode hex that arrived in pieces, e.g. USB packets, without gathering
+     *   it first. A record split between pieces is read across them
+     *  @param iov is the pieces in stream order
+     *  @param count is the number of pieces
+     *  @return the same as feed()
+     */
+    virtual hex_parse_status_t feedv(const hex_iovec_t *iov, uint32_t count);
+
+    /** Send any data still being collected and wait for the sink to drain it
+     *  @return 0 on success, -1 if the sink could not deliver everything
+     */
+    virtual int flush();
+
+    /** Intel HEX starts with the ':' of the first record
+     */
+    virtual int detect(const uint8_t *data, uint32_t size);
+
+    virtual const char *name() const {
+        return "hex";
+    }
+
+    const hex_pipeline_stats_t &stats() const {
+        return _stats;
+    }
+
+    /** Get the entry point from a start address record, 0 if there was none
+     */
+    uint32_t entry() const {
+        return _entry;
+    }
+
+    // HexPushParser handler
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size);
+    void on_segment(uint32_t base) {
+        (void)base;
+    }
+    void on_entry(uint32_t addr) {
+        _entry = addr;
+    }
+    void on_eof() {
+    }
+
+private:
+    BlockSink &_sink;
+    clock_fn _now;
+    uint32_t _start;
+    uint8_t _started;
+    HexPushParser<HexPipeline> _parser;
+    uint32_t _entry;
+    RunBuffer _runs;
+    uint8_t _buf[2][HEX_BLOCK_SIZE];
+    hex_pipeline_stats_t _stats;
+};
+
+#endif
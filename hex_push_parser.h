@@ -0,0 +1,361 @@
+#ifndef HEX_PUSH_PARSER_H
+#define HEX_PUSH_PARSER_H
+
+#include "stdint.h"
+#include "string.h"
+#include "hex_parser.h"
+
+// longest record, ':' then count, address, type, 255 data bytes and checksum in hex
+#define HEX_RECORD_SIZE (1 + (4 + 255 + 1) * 2)
+
+/** Converts a character representation of a hex to real value.
+ *   @param c is the hex value in char format
+ *   @return the value of the hex
+ */
+static inline uint8_t hex_nibble(uint8_t c)
+{
+    return (c & 0x10) ? /*0-9*/ c & 0xf : /*A-F, a-f*/ (c & 0xf) + 9;
+}
+
+/** Converts two hex characters to a byte
+ *   @param s is the first of the characters
+ *   @return the value of the byte
+ */
+static inline uint8_t hex_nibbles(const uint8_t *s)
+{
+    return (hex_nibble(s[0]) << 4) | hex_nibble(s[1]);
+}
+
+/** Event driven Intel HEX parser. Feed it chunks of any size and it calls
+ *  the handler for every record, no output buffer, no 0xff padding and no
+ *  bookkeeping between calls for the caller. The handler is a template
+ *  parameter so the calls are resolved, and usually inlined, at compile time.
+ *
+ *  The handler provides:
+ *  @code
+ *  // data at its full address, data is only valid during the call. Return
+ *  //  non-zero to stop, feed() then returns HEX_PARSE_REJECTED
+ *  int on_data(uint32_t addr, const uint8_t *data, uint32_t size);
+ *  // an extended segment or linear address record set the upper address
+ *  void on_segment(uint32_t base);
+ *  // a start segment or start linear address record
+ *  void on_entry(uint32_t addr);
+ *  // the end of file record
+ *  void on_eof();
+ *  @endcode
+ *
+ *  A record is decoded where it sits in the input, or read across the pieces
+ *  handed to one feedv(), only one split across two calls is copied. The
+ *  record length comes from its byte count so an image that ends without a
+ *  line end still reaches its end of file record.
+ *
+ * Example:
+ * @code
+ * HexPushParser<Flasher> parser(flasher);
+ *
+ * do {
+ *     status = parser.feed(data, size);
+ * } while (HEX_PARSE_OK == status);
+ * @endcode
+ */
+template <typename Handler>
+class HexPushParser {
+
+public:
+    HexPushParser(Handler &handler) : _handler(handler), _base(0), _eof(0), _cnt(0), _pos(0), _at(0) {
+    }
+
+    /** Parse the next chunk of the image
+     *  @param data is the ascii hex
+     *  @param size is the number of bytes in data
+     *  @return HEX_PARSE_OK when the chunk was consumed, HEX_PARSE_EOF at the end
+     *   of file record, HEX_PARSE_CKSUM_FAIL on a bad record or anything but
+     *   white space between records, HEX_PARSE_WRAP for data past 0xffffffff,
+     *   or HEX_PARSE_REJECTED if the handler refused data
+     */
+    hex_parse_status_t feed(const uint8_t *data, uint32_t size) {
+        hex_iovec_t iov = {data, size};
+        return feedv(&iov, 1);
+    }
+
+    /** Parse the next chunks of the image from wherever they are, e.g. USB
+     *   packets still in their endpoint buffers. A record that runs from one
+     *   fragment into the next is read across them, not copied, only one that
+     *   runs past the last fragment is kept for the next call
+     *  @param iov is the fragments in stream order
+     *  @param count is the number of fragments
+     *  @return the same as feed()
+     */
+    hex_parse_status_t feedv(const hex_iovec_t *iov, uint32_t count) {
+        hex_parse_status_t status = _eof ? HEX_PARSE_EOF : HEX_PARSE_OK;
+        for (uint32_t i = 0; (i < count) && (HEX_PARSE_OK == status); _pos += iov[i].size, i++) {
+            const uint8_t *data = iov[i].data;
+            uint32_t size = iov[i].size;
+            while (size && (HEX_PARSE_OK == status)) {
+                if (_cnt) {
+                    // a record split across calls, put it together in _line
+                    uint32_t len = (_cnt < 3) ? 3 : record_size(_line);
+                    uint32_t n = len - _cnt;
+                    if (n > size) {
+                        n = size;
+                    }
+                    memcpy(&_line[_cnt], data, n);
+                    _cnt += n;
+                    data += n;
+                    size -= n;
+                    if ((_cnt >= 3) && (_cnt == record_size(_line))) {
+                        _cnt = 0;
+                        TextReader line(&_line[1]);
+                        status = record(line);
+                    }
+                    continue;
+                }
+                if (':' != *data) {
+                    // line ends between records
+                    if (*data > ' ') {
+                        _at = _pos + (data - iov[i].data);
+                        return HEX_PARSE_CKSUM_FAIL;
+                    }
+                    data++;
+                    size--;
+                    continue;
+                }
+                _at = _pos + (data - iov[i].data);
+                if ((size >= 3) && (size >= record_size(data))) {
+                    uint32_t len = record_size(data);
+                    TextReader text(&data[1]);
+                    status = record(text);
+                    data += len;
+                    size -= len;
+                    continue;
+                }
+                // the record runs on into the next fragments
+                GatherReader gather(iov, count, i, data - iov[i].data);
+                if (gather.has(3)) {
+                    GatherReader peek = gather;
+                    peek.next();
+                    if (gather.has(11 + (uint32_t)peek.byte() * 2)) {
+                        gather.next();
+                        status = record(gather);
+                        for (; i < gather.index(); i++) {
+                            _pos += iov[i].size;
+                        }
+                        data = iov[i].data + gather.offset();
+                        size = iov[i].size - gather.offset();
+                        continue;
+                    }
+                }
+                // and on past the last one, keep it for the next call
+                memcpy(_line, data, size);
+                _cnt = size;
+                _pos += iov[i].size;
+                while (++i < count) {
+                    memcpy(&_line[_cnt], iov[i].data, iov[i].size);
+                    _cnt += iov[i].size;
+                    _pos += iov[i].size;
+                }
+                return status;
+            }
+        }
+        return status;
+    }
+
+    /** Forget the image fed so far, to parse another one into the same handler
+     */
+    void reset() {
+        _base = 0;
+        _eof = 0;
+        _cnt = 0;
+        _pos = 0;
+        _at = 0;
+    }
+
+    /** Check if a record is only partly fed
+     *  @return 1 if it is, otherwise 0
+     */
+    int pending() const {
+        return _cnt ? 1 : 0;
+    }
+
+    /** Get where the last record started, counted over every call in 64 bits
+     *   so it holds for a stream of any size. After an error it is the record
+     *   at fault
+     */
+    uint64_t record_offset() const {
+        return _at;
+    }
+
+private:
+    static uint32_t record_size(const uint8_t *record) {
+        return 11 + (uint32_t)hex_nibbles(&record[1]) * 2;
+    }
+
+    /** Record characters in one place
+     */
+    class TextReader {
+    public:
+        TextReader(const uint8_t *text) : _text(text) {
+        }
+        uint8_t byte() {
+            uint8_t b = hex_nibbles(_text);
+            _text += 2;
+            return b;
+        }
+        void bytes(uint8_t *out, uint32_t count) {
+            for (uint32_t i = 0; i < count; i++, _text += 2) {
+                out[i] = hex_nibbles(_text);
+            }
+        }
+    private:
+        const uint8_t *_text;
+    };
+
+    /** Record characters spread over fragments
+     */
+    class GatherReader {
+    public:
+        GatherReader(const hex_iovec_t *iov, uint32_t count, uint32_t index, uint32_t offset) :
+            _iov(iov), _count(count), _index(index), _offset(offset) {
+        }
+        /** Check if there are at least n more characters
+         */
+        int has(uint32_t n) const {
+            uint32_t i = _index;
+            uint32_t left = _iov[i].size - _offset;
+            while (left < n) {
+                if (++i >= _count) {
+                    return 0;
+                }
+                left += _iov[i].size;
+            }
+            return 1;
+        }
+        uint8_t next() {
+            while (_offset == _iov[_index].size) {
+                _index++;
+                _offset = 0;
+            }
+            return _iov[_index].data[_offset++];
+        }
+        uint8_t byte() {
+            if ((_offset + 2) <= _iov[_index].size) {
+                // both characters in this piece
+                uint8_t b = hex_nibbles(&_iov[_index].data[_offset]);
+                _offset += 2;
+                return b;
+            }
+            uint8_t hi = hex_nibble(next());
+            return (hi << 4) | hex_nibble(next());
+        }
+        void bytes(uint8_t *out, uint32_t count) {
+            while (count) {
+                // the whole pairs in this piece, then the one split by its end
+                uint32_t n = (_iov[_index].size - _offset) / 2;
+                if (n > count) {
+                    n = count;
+                }
+                const uint8_t *s = &_iov[_index].data[_offset];
+                for (uint32_t i = 0; i < n; i++, s += 2) {
+                    out[i] = hex_nibbles(s);
+                }
+                _offset += n * 2;
+                out += n;
+                count -= n;
+                if (count) {
+                    *out++ = byte();
+                    count--;
+                }
+            }
+        }
+        uint32_t index() const {
+            return _index;
+        }
+        uint32_t offset() const {
+            return _offset;
+        }
+    private:
+        const hex_iovec_t *_iov;
+        uint32_t _count;
+        uint32_t _index;
+        uint32_t _offset;
+    };
+
+    /** Check a whole record and pass it to the handler
+     *  @param text reads the record, from just after its ':'
+     *  @return HEX_PARSE_OK, HEX_PARSE_EOF or the error
+     */
+    template <typename Reader>
+    hex_parse_status_t record(Reader &text) {
+        uint8_t count = text.byte();
+        uint8_t addr_hi = text.byte();
+        uint8_t addr_lo = text.byte();
+        uint8_t type = text.byte();
+        uint8_t sum = count + addr_hi + addr_lo + type;
+        text.bytes(_data, count);
+        for (uint32_t i = 0; i < count; i++) {
+            sum += _data[i];
+        }
+        if ((uint8_t)(sum + text.byte())) {
+            return HEX_PARSE_CKSUM_FAIL;
+        }
+        uint32_t offset = ((uint32_t)addr_hi << 8) | addr_lo;
+        switch (type) {
+            case DATA_RECORD:
+                if (count && ((_base + offset + count - 1) < (_base + offset))) {
+                    return HEX_PARSE_WRAP;
+                }
+                if (count && _handler.on_data(_base + offset, _data, count)) {
+                    return HEX_PARSE_REJECTED;
+                }
+                break;
+
+            case EOF_RECORD:
+                _eof = 1;
+                _handler.on_eof();
+                return HEX_PARSE_EOF;
+
+            case EXT_SEG_ADDR_RECORD:
+            case EXT_LINEAR_ADDR_RECORD:
+                if (2 != count) {
+                    return HEX_PARSE_CKSUM_FAIL;
+                }
+                _base = ((uint32_t)_data[0] << 8) | _data[1];
+                _base <<= (EXT_SEG_ADDR_RECORD == type) ? 4 : 16;
+                _handler.on_segment(_base);
+                break;
+
+            case START_SEG_ADDR_RECORD:
+            case START_LINEAR_ADDR_RECORD:
+                if (4 != count) {
+                    return HEX_PARSE_CKSUM_FAIL;
+                }
+                if (START_SEG_ADDR_RECORD == type) {
+                    // CS:IP
+                    uint32_t cs = ((uint32_t)_data[0] << 8) | _data[1];
+                    uint32_t ip = ((uint32_t)_data[2] << 8) | _data[3];
+                    _handler.on_entry((cs << 4) + ip);
+                } else {
+                    _handler.on_entry(((uint32_t)_data[0] << 24) | ((uint32_t)_data[1] << 16) |
+                                      ((uint32_t)_data[2] << 8) | _data[3]);
+                }
+                break;
+
+            default:
+                break;
+        }
+        return HEX_PARSE_OK;
+    }
+
+    Handler &_handler;
+    uint32_t _base;
+    uint8_t _eof;
+    // characters of a split record in _line
+    uint32_t _cnt;
+    // stream offset of the fragment being parsed and of the last record, over all calls
+    uint64_t _pos;
+    uint64_t _at;
+    uint8_t _line[HEX_RECORD_SIZE];
+    uint8_t _data[255];
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef HEX_RECORD_READER_H
+#define HEX_RECORD_READER_H
+
+#include <iterator>
+#include "stdint.h"
+#include "hex_parser.h"
+#include "hex_push_parser.h"
+
+/** View of one record of an Intel HEX image in memory. Nothing is decoded
+ *  until it is asked for, the type, length and address are two characters
+ *  each and the payload is decoded a byte at a time or all at once.
+ */
+class HexRecord {
+
+public:
+    HexRecord() : _text(0), _base(0) {
+    }
+
+    /** @param text is the record, starting at its ':'
+     *  @param base is the upper address set by the records before it
+     */
+    HexRecord(const uint8_t *text, uint32_t base) : _text(text), _base(base) {
+    }
+
+    hex_record_t type() const {
+        return (hex_record_t)hex_nibbles(&_text[7]);
+    }
+
+    /** Get the number of payload bytes
+     */
+    uint8_t length() const {
+        return hex_nibbles(&_text[1]);
+    }
+
+    /** Get the 16 bit address field
+     */
+    uint16_t offset() const {
+        return ((uint16_t)hex_nibbles(&_text[3]) << 8) | hex_nibbles(&_text[5]);
+    }
+
+    /** Get the full address of the first payload byte
+     */
+    uint32_t address() const {
+        return _base + offset();
+    }
+
+    /** Get the number of characters in the record, without the line end
+     */
+    uint32_t size() const {
+        return 11 + (uint32_t)length() * 2;
+    }
+
+    const uint8_t *text() const {
+        return _text;
+    }
+
+    /** Decode one payload byte
+     */
+    uint8_t operator[](uint32_t i) const {
+        return hex_nibbles(&_text[9 + i * 2]);
+    }
+
+    /** Decode the payload
+     *  @param out must hold length() bytes
+     *  @return the number of bytes decoded
+     */
+    uint32_t decode(uint8_t *out) const {
+        uint32_t len = length();
+        const uint8_t *s = &_text[9];
+        for (uint32_t i = 0; i < len; i++, s += 2) {
+            out[i] = hex_nibbles(s);
+        }
+        return len;
+    }
+
+    /** Check the checksum
+     *  @return 1 if the record is good, otherwise 0
+     */
+    int valid() const {
+        uint8_t sum = 0;
+        uint32_t len = length() + 5;
+        for (uint32_t i = 0; i < len; i++) {
+            sum += hex_nibbles(&_text[1 + i * 2]);
+        }
+        return !sum;
+    }
+
+private:
+    const uint8_t *_text;
+    uint32_t _base;
+};
+
+/** Walks the records of an Intel HEX image that is already in memory (a
+ *  buffer or an mmapped file) without copying or decoding anything. It is a
+ *  forward range of HexRecord views so the standard algorithms work on it:
+ *
+ * @code
+ * HexRecordReader records(hex, hex_size);
+ * uint32_t in_window = std::count_if(records.begin(), records.end(), InWindow(0x1000, 0x2000));
+ * for (HexRecordReader::iterator it = records.begin(); it != records.end(); ++it) {
+ *     if (DATA_RECORD == it->type()) {
+ *         bytes += it->length();
+ *     }
+ * }
+ * @endcode
+ *
+ *  The grammar is the one parse_hex_blob and HexPushParser read, the length
+ *  of a record comes from its byte count and only white space may come
+ *  between records. Iteration ends after the end of file record, at the end
+ *  of the buffer, or at anything that is not a whole record; stopped() tells
+ *  the last one apart. Extended segment and linear address records set the
+ *  upper address of the records after them.
+ */
+class HexRecordReader {
+
+public:
+    class iterator {
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef HexRecord value_type;
+        typedef int32_t difference_type;
+        typedef const HexRecord *pointer;
+        typedef const HexRecord &reference;
+
+        iterator() : _end(0), _base(0) {
+        }
+
+        iterator(const uint8_t *pos, const uint8_t *end) : _end(end), _base(0) {
+            settle(pos);
+        }
+
+        reference operator*() const {
+            return _record;
+        }
+
+        pointer operator->() const {
+            return &_record;
+        }
+
+        iterator &operator++() {
+            const uint8_t *next = _record.text() + _record.size();
+            switch (_record.type()) {
+                case EOF_RECORD:
+                    _record = HexRecord();
+                    return *this;
+
+                case EXT_SEG_ADDR_RECORD:
+                    _base = (((uint32_t)_record[0] << 8) | _record[1]) << 4;
+                    break;
+
+                case EXT_LINEAR_ADDR_RECORD:
+                    _base = (((uint32_t)_record[0] << 8) | _record[1]) << 16;
+                    break;
+
+                default:
+                    break;
+            }
+            settle(next);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator it = *this;
+            ++(*this);
+            return it;
+        }
+
+        bool operator==(const iterator &other) const {
+            return _record.text() == other._record.text();
+        }
+
+        bool operator!=(const iterator &other) const {
+            return _record.text() != other._record.text();
+        }
+
+    private:
+        /** Find the record at pos, past any line ends, or become end(). An
+         *  upper address record has to have the two bytes it is read for
+         */
+        void settle(const uint8_t *pos) {
+            while ((pos < _end) && (*pos <= ' ')) {
+                pos++;
+            }
+            _record = HexRecord();
+            if (((_end - pos) < 11) || (':' != *pos)) {
+                return;
+            }
+            HexRecord record(pos, _base);
+            hex_record_t type = record.type();
+            if (((uint32_t)(_end - pos) < record.size()) ||
+                (((EXT_SEG_ADDR_RECORD == type) || (EXT_LINEAR_ADDR_RECORD == type)) && (2 != record.length()))) {
+                return;
+            }
+            _record = record;
+        }
+
+        const uint8_t *_end;
+        uint32_t _base;
+        HexRecord _record;
+    };
+
+    /** @param data is the image, it is read in place and must outlive the reader
+     *  @param size is the number of bytes in data
+     */
+    HexRecordReader(const uint8_t *data, uint32_t size) : _data(data), _size(size) {
+    }
+
+    iterator begin() const {
+        return iterator(_data, _data + _size);
+    }
+
+    iterator end() const {
+        return iterator();
+    }
+
+    /** Check why the records ran out
+     *  @param last is the last record iteration produced, or HexRecord() if
+     *   there were none
+     *  @return 1 if something that is not a record comes after it, 0 at the end
+     *   of file record or the end of the buffer
+     */
+    int stopped(const HexRecord &last) const {
+        const uint8_t *pos = _data;
+        if (last.text()) {
+            if (EOF_RECORD == last.type()) {
+                return 0;
+            }
+            pos = last.text() + last.size();
+        }
+        const uint8_t *end = _data + _size;
+        while ((pos < end) && (*pos <= ' ')) {
+            pos++;
+        }
+        return pos != end;
+    }
+
+private:
+    const uint8_t *_data;
+    uint32_t _size;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef MBED_FILESYSTEMLIKE_H
+#define MBED_FILESYSTEMLIKE_H
+
+/* Host stand-in for the mbed FileSystemLike.h, only the FileHandle and
+ * FileSystemLike interfaces, without the FileBase name lookup that the
+ * retargeted stdio uses. Put host/ ahead of mbed/ on the include path.
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+namespace mbed {
+
+class FileHandle {
+
+public:
+    virtual ssize_t write(const void *buffer, size_t length) = 0;
+    virtual int close() = 0;
+    virtual ssize_t read(void *buffer, size_t length) = 0;
+    virtual int isatty() = 0;
+    virtual off_t lseek(off_t offset, int whence) = 0;
+    virtual int fsync() = 0;
+
+    virtual off_t flen() {
+        off_t pos = lseek(0, SEEK_CUR);
+        if (pos == -1) {
+            return -1;
+        }
+        off_t res = lseek(0, SEEK_END);
+        lseek(pos, SEEK_SET);
+        return res;
+    }
+
+    virtual ~FileHandle() {
+    }
+};
+
+class FileSystemLike {
+
+public:
+    FileSystemLike(const char *name) : _name(name) {
+    }
+
+    virtual ~FileSystemLike() {
+    }
+
+    virtual FileHandle *open(const char *filename, int flags) = 0;
+
+    const char *getName() {
+        return _name;
+    }
+
+private:
+    const char *_name;
+};
+
+} // namespace mbed
+
+#endif
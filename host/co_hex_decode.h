@@ -0,0 +1,212 @@
+#ifndef CO_HEX_DECODE_H
+#define CO_HEX_DECODE_H
+
+/* C++20 coroutine front end for HexPushParser, for host tools that take
+ * images from many pipes, sockets or devices at once on one thread. Each
+ * co_hex_decode() keeps its parser and its input buffer in the coroutine
+ * frame, suspends when its source has nothing to read and is resumed by
+ * the EventLoop once it has.
+ */
+#include <coroutine>
+#include <vector>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include "hex_push_parser.h"
+
+// bytes each coroutine reads at a time, kept in its frame
+#ifndef CO_HEX_READ_SIZE
+#define CO_HEX_READ_SIZE    512
+#endif
+
+/** Coroutine returned by co_hex_decode(). It runs until its first suspend
+ *  when it is created and keeps the parse status once it has finished.
+ */
+class HexTask {
+
+public:
+    struct promise_type {
+        hex_parse_status_t status = HEX_PARSE_UNINIT;
+
+        HexTask get_return_object() {
+            return HexTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_value(hex_parse_status_t s) {
+            status = s;
+        }
+        void unhandled_exception() {
+            status = HEX_PARSE_UNINIT;
+        }
+    };
+
+    HexTask(HexTask &&other) : _handle(other._handle) {
+        other._handle = nullptr;
+    }
+
+    ~HexTask() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    int done() const {
+        return _handle.done();
+    }
+
+    /** Get the status the decode finished with
+     */
+    hex_parse_status_t status() const {
+        return _handle.promise().status;
+    }
+
+private:
+    explicit HexTask(std::coroutine_handle<promise_type> handle) : _handle(handle) {
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+/** poll() based loop that resumes the coroutines waiting on file descriptors
+ */
+class EventLoop {
+
+public:
+    /** Resume h once fd is readable
+     */
+    void wait_readable(int fd, std::coroutine_handle<> h) {
+        _fds.push_back({fd, POLLIN, 0});
+        _waiting.push_back(h);
+    }
+
+    /** Wait for at least one descriptor and resume every coroutine whose
+     *  descriptor is ready
+     *  @param timeout_ms is the poll() timeout
+     *  @return the number of coroutines still waiting
+     */
+    size_t run_once(int timeout_ms) {
+        if (_fds.empty()) {
+            return 0;
+        }
+        if (poll(_fds.data(), _fds.size(), timeout_ms) <= 0) {
+            return _fds.size();
+        }
+        // resumed coroutines may wait again, so take the ready ones out first
+        std::vector<std::coroutine_handle<> > ready;
+        size_t kept = 0;
+        for (size_t i = 0; i < _fds.size(); i++) {
+            if (_fds[i].revents) {
+                ready.push_back(_waiting[i]);
+            } else {
+                _fds[kept] = _fds[i];
+                _waiting[kept] = _waiting[i];
+                kept++;
+            }
+        }
+        _fds.resize(kept);
+        _waiting.resize(kept);
+        for (size_t i = 0; i < ready.size(); i++) {
+            ready[i].resume();
+        }
+        return _fds.size();
+    }
+
+private:
+    std::vector<struct pollfd> _fds;
+    std::vector<std::coroutine_handle<> > _waiting;
+};
+
+/** Non-blocking file descriptor (pipe, socket, tty) as an awaitable source.
+ *  A wake with nothing to read after all gives -1 and the caller awaits
+ *  again, nothing ever blocks the loop.
+ *
+ * @code
+ * int32_t n;
+ * while ((n = co_await source.read(buf, sizeof(buf))) < 0);
+ * @endcode
+ */
+class FdSource {
+
+public:
+    FdSource(EventLoop &loop, int fd) : _loop(loop), _fd(fd) {
+    }
+
+    struct ReadAwaiter {
+        FdSource &source;
+        uint8_t *buf;
+        uint32_t size;
+        ssize_t n;
+
+        bool await_ready() {
+            n = read_once();
+            return (n >= 0) || !would_block();
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            source._loop.wait_readable(source._fd, h);
+        }
+        /** @return the number of bytes read, 0 at the end of the stream or on an
+         *   error, -1 if there was nothing to read after all and it has to be
+         *   awaited again
+         */
+        int32_t await_resume() {
+            if (n < 0) {
+                // back from the loop, errno is long gone by now
+                n = read_once();
+            }
+            if ((n < 0) && would_block()) {
+                return -1;
+            }
+            return (n > 0) ? (int32_t)n : 0;
+        }
+
+        /** read() again when a signal cuts it short
+         */
+        ssize_t read_once() {
+            ssize_t r;
+            while (((r = ::read(source._fd, buf, size)) < 0) && (EINTR == errno));
+            return r;
+        }
+        static bool would_block() {
+            return (EAGAIN == errno) || (EWOULDBLOCK == errno);
+        }
+    };
+
+    ReadAwaiter read(uint8_t *buf, uint32_t size) {
+        return ReadAwaiter{*this, buf, size, 0};
+    }
+
+private:
+    EventLoop &_loop;
+    int _fd;
+};
+
+/** Decode a hex image from an async source into a HexPushParser handler
+ *  @param source has read(buf, size), awaitable for the number of bytes read, 0 at
+ *   the end or -1 to await it again
+ *  @param handler gets the on_data(), on_segment(), on_entry() and on_eof() calls
+ *  @return the task, its status() is HEX_PARSE_EOF once the whole image arrived
+ */
+template <typename Source, typename Handler>
+HexTask co_hex_decode(Source &source, Handler &handler)
+{
+    HexPushParser<Handler> parser(handler);
+    uint8_t buf[CO_HEX_READ_SIZE];
+    hex_parse_status_t status = HEX_PARSE_OK;
+    while (HEX_PARSE_OK == status) {
+        int32_t n;
+        while ((n = co_await source.read(buf, sizeof(buf))) < 0);
+        if (!n) {
+            // the source ended before the end of file record
+            break;
+        }
+        status = parser.feed(buf, n);
+    }
+    co_return status;
+}
+
+#endif
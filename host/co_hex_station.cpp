@@ -0,0 +1,119 @@
+/* Receives the same hex image over many pipes at once on a single thread.
+ * Every upload is a co_hex_decode() coroutine on its own pipe. The writers
+ * trickle the image into the pipes in random sized pieces from the same
+ * thread, so the decoders keep running dry and getting resumed. Every
+ * decoded image is compared with a reference binary.
+ *
+ * Build from the project root:
+ *   g++ -std=c++20 -O2 -I. -Ihost -o co_hex_station host/co_hex_station.cpp
+ *
+ * Usage:
+ *   co_hex_station <image.hex> <reference.bin> [uploads] [max_piece]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <vector>
+#include "co_hex_decode.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+typedef struct {
+    int rd;
+    int wr;
+    uint32_t sent;
+} upload_t;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <reference.bin> [uploads] [max_piece]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> hex_file, ref_file;
+    if (read_file(argv[1], hex_file) || read_file(argv[2], ref_file)) {
+        perror("fopen");
+        return 1;
+    }
+    const uint8_t *hex = hex_file.data();
+    uint32_t hex_size = hex_file.size();
+    const uint8_t *ref = ref_file.data();
+    uint32_t ref_size = ref_file.size();
+    uint32_t count = (argc > 3) ? strtoul(argv[3], 0, 0) : 200;
+    uint32_t max_piece = (argc > 4) ? strtoul(argv[4], 0, 0) : 4096;
+
+    // one stream on its own for comparison
+    ImageHandler single;
+    uint32_t t = host_us();
+    HexPushParser<ImageHandler> parser(single);
+    parser.feed(hex, hex_size);
+    uint32_t single_us = host_us() - t;
+
+    EventLoop loop;
+    std::vector<upload_t> uploads(count);
+    std::vector<FdSource> sources;
+    std::vector<ImageHandler> handlers(count);
+    std::vector<HexTask> tasks;
+    sources.reserve(count);
+    tasks.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        int fds[2];
+        if (pipe(fds)) {
+            perror("pipe");
+            return 1;
+        }
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+        uploads[i].rd = fds[0];
+        uploads[i].wr = fds[1];
+        uploads[i].sent = 0;
+        sources.push_back(FdSource(loop, fds[0]));
+        // runs up to its first read and waits there
+        tasks.push_back(co_hex_decode(sources[i], handlers[i]));
+    }
+
+    uint32_t writing = count;
+    uint32_t resumes = 0;
+    t = host_us();
+    while (1) {
+        for (uint32_t i = 0; i < count; i++) {
+            upload_t *u = &uploads[i];
+            if (u->wr < 0) {
+                continue;
+            }
+            uint32_t n = 1 + rand() % max_piece;
+            if (n > (hex_size - u->sent)) {
+                n = hex_size - u->sent;
+            }
+            ssize_t w = write(u->wr, &hex[u->sent], n);
+            if (w > 0) {
+                u->sent += w;
+            }
+            if (u->sent == hex_size) {
+                close(u->wr);
+                u->wr = -1;
+                writing--;
+            }
+        }
+        size_t waiting = loop.run_once(writing ? 0 : 1000);
+        resumes++;
+        if (!writing && !waiting) {
+            break;
+        }
+    }
+    uint32_t total_us = host_us() - t;
+
+    uint32_t matched = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        close(uploads[i].rd);
+        matched += tasks[i].done() && (HEX_PARSE_EOF == tasks[i].status()) && handlers[i].matches(ref, ref_size);
+    }
+    double mb = (double)hex_size * count;
+    printf("uploads    %lu of %lu bytes, pieces up to %lu bytes\n", (unsigned long)count, (unsigned long)hex_size, (unsigned long)max_piece);
+    printf("matched    %lu\n", (unsigned long)matched);
+    printf("loop       %lu passes on one thread\n", (unsigned long)resumes);
+    printf("time       %lu us, %.1f MB/s of hex in total\n", (unsigned long)total_us, mb / total_us);
+    printf("single     %lu us, %.1f MB/s of hex for one stream parsed in place\n", (unsigned long)single_us, (double)hex_size / single_us);
+    return (matched == count) ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/* Decodes a hex image and times CRC-32 of the binary a bit at a time, with
+ * the slicing-by-8 tables the target uses and with crc32_update(), PCLMULQDQ
+ * folding where the CPU has it. Then decodes it again with the CRC kept
+ * inline as the parser hands out data, the way DigestSink does, and with a
+ * second pass over the binary afterwards. Last the binary is cut into random
+ * pieces whose CRCs go together with crc32_combine(). Every CRC has to be
+ * the same.
+ *
+ * The image is the one given, or random data of mb MB (default 32) with a
+ * 64 byte gap in every 4 KB so the 0xff fill is part of it.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o crc32_bench host/crc32_bench.cpp crc32.cpp
+ *
+ * Usage:
+ *   crc32_bench [mb | image.hex]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "crc32.h"
+#include "hex_push_parser.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define RUNS        3
+#define PIECES      16
+
+/** ImageHandler that keeps the CRC inline when asked to
+ */
+class BinHandler : public ImageHandler {
+public:
+    BinHandler(int inline_crc) : ImageHandler(0xffffffff), crc(0), ordered(1), _inline(inline_crc), _end(0) {
+        image.reserve(64 << 20);
+    }
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (addr < image.size()) {
+            ordered = 0;
+        }
+        if (_inline && ordered) {
+            crc = crc32_fill(crc, 0xff, addr - _end);
+            crc = crc32_update(crc, data, size);
+            _end = addr + size;
+        }
+        return ImageHandler::on_data(addr, data, size);
+    }
+
+    uint32_t crc;
+    int ordered;
+
+private:
+    int _inline;
+    uint32_t _end;
+};
+
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t *data, size_t size)
+{
+    crc = ~crc;
+    while (size--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static void put_record(std::string &s, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t size)
+{
+    char text[8 + 2 * 255 + 4];
+    uint8_t sum = size + (offset >> 8) + offset + type;
+    int n = sprintf(text, ":%02X%04X%02X", size, offset, type);
+    for (uint8_t i = 0; i < size; i++) {
+        n += sprintf(&text[n], "%02X", data[i]);
+        sum += data[i];
+    }
+    sprintf(&text[n], "%02X\n", (uint8_t)-sum);
+    s += text;
+}
+
+static void print_row(const char *name, uint32_t us, size_t bytes, uint32_t crc)
+{
+    printf("%-28s %9.2f %9.1f   %08lx\n", name, us / 1000.0, bytes / 1048576.0 * 1e6 / (us ? us : 1), (unsigned long)crc);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string hex;
+    if ((argc > 1) && !strchr("0123456789", argv[1][0])) {
+        if (read_file(argv[1], hex)) {
+            perror(argv[1]);
+            return 2;
+        }
+    } else {
+        uint32_t mb = (argc > 1) ? atoi(argv[1]) : 32;
+        std::vector<uint8_t> data((size_t)mb << 20);
+        srand(1);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = rand();
+        }
+        for (size_t i = 0; i < data.size(); i += 16) {
+            if (!(i & 0xffff)) {
+                uint8_t seg[2] = {(uint8_t)(i >> 24), (uint8_t)(i >> 16)};
+                put_record(hex, EXT_LINEAR_ADDR_RECORD, 0, seg, 2);
+            }
+            if ((i & 0xfff) >= 64) {
+                put_record(hex, DATA_RECORD, i, &data[i], 16);
+            }
+        }
+        put_record(hex, EOF_RECORD, 0, 0, 0);
+    }
+
+    printf("%-28s %9s %9s   %s\n", "", "ms", "MB/s", "crc32");
+    int ok = 1;
+    uint32_t want = 0;
+    std::vector<uint8_t> bin;
+    // quickest of RUNS for each decode
+    const char *names[3] = {"decode", "decode + crc32 inline", "decode, then crc32"};
+    for (int way = 0; way < 3; way++) {
+        uint32_t best = 0, crc = 0;
+        int ordered = 1;
+        for (int run = 0; run < RUNS; run++) {
+            BinHandler handler(1 == way);
+            HexPushParser<BinHandler> parser(handler);
+            uint32_t t = host_us();
+            hex_parse_status_t status = parser.feed((const uint8_t *)hex.data(), hex.size());
+            crc = handler.crc;
+            if (2 == way) {
+                crc = crc32_update(0, handler.image.data(), handler.image.size());
+            }
+            t = host_us() - t;
+            if (HEX_PARSE_EOF != status) {
+                fprintf(stderr, "the image does not decode (%d)\n", (int)status);
+                return 1;
+            }
+            ordered = handler.ordered;
+            best = (!run || (t < best)) ? t : best;
+            if (!way) {
+                bin.swap(handler.image);
+            }
+        }
+        if ((1 == way) && !ordered) {
+            printf("records go backwards, no inline crc32\n");
+        } else if (way) {
+            ok &= (crc == want);
+        }
+        print_row(names[way], best, hex.size(), crc);
+        if (!way) {
+            uint32_t t = host_us();
+            want = crc32_bitwise(0, bin.data(), bin.size());
+            print_row("bitwise", host_us() - t, bin.size(), want);
+            for (int run = 0; run < RUNS; run++) {
+                t = host_us();
+                crc = crc32_update_sliced(0, bin.data(), bin.size());
+                t = host_us() - t;
+                best = (!run || (t < best)) ? t : best;
+            }
+            ok &= (crc == want);
+            print_row("slicing-by-8", best, bin.size(), crc);
+            for (int run = 0; run < RUNS; run++) {
+                t = host_us();
+                crc = crc32_update(0, bin.data(), bin.size());
+                t = host_us() - t;
+                best = (!run || (t < best)) ? t : best;
+            }
+            ok &= (crc == want);
+            const char *name = "crc32_update";
+#if CRC32_PCLMUL
+            name = __builtin_cpu_supports("pclmul") ? "crc32_update, pclmul" : name;
+#endif
+            print_row(name, best, bin.size(), crc);
+        }
+    }
+
+    // random cuts, each piece on its own and put together
+    std::vector<size_t> cuts;
+    cuts.push_back(0);
+    for (int i = 1; i < PIECES; i++) {
+        cuts.push_back(bin.size() ? (((size_t)rand() << 16) ^ rand()) % bin.size() : 0);
+    }
+    cuts.push_back(bin.size());
+    std::sort(cuts.begin(), cuts.end());
+    uint32_t t = host_us();
+    uint32_t crc = 0;
+    for (int i = 0; i < PIECES; i++) {
+        uint32_t piece = crc32_update(0, &bin[0] + cuts[i], cuts[i + 1] - cuts[i]);
+        crc = crc32_combine(crc, piece, cuts[i + 1] - cuts[i]);
+    }
+    ok &= (crc == want);
+    print_row("16 pieces combined", host_us() - t, bin.size(), crc);
+    printf("%s\n", ok ? "all the same" : "they DIFFER");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+#ifndef MBED_DEVICE_H
+#define MBED_DEVICE_H
+
+/* Host stand-in for the target device.h, only enough for serial_api.h.
+ * Put host/ ahead of the target directories on the include path.
+ */
+#include <stdint.h>
+#include <pthread.h>
+
+#define DEVICE_SERIAL           1
+#define DEVICE_SERIAL_FC        1
+
+typedef enum {
+    USBTX = 0,
+    USBRX = 1,
+
+    // Not connected
+    NC = (int)0xFFFFFFFF
+} PinName;
+
+#define HOST_UART_FIFO_DEPTH    16
+#define HOST_UART_TX_BATCH      256
+
+/* A simulated UART. Bytes leave (and arrive) at the configured baud rate and
+ * a worker thread plays the part of the UART interrupt.
+ */
+struct serial_s {
+    int fd;
+    uint32_t baud;
+    uint64_t byte_ns;
+    pthread_mutex_t lock;
+    pthread_t thread;
+    volatile int running;
+
+    // time the last queued byte finishes on the wire
+    uint64_t tx_done_ns;
+    // a byte was queued since the last THRE interrupt
+    uint8_t thre_armed;
+    uint32_t tx_len;
+    uint8_t tx_buf[HOST_UART_TX_BATCH];
+    uint32_t tx_overrun;
+
+    // receive side, only when the port is a terminal
+    int rx_fd;
+    uint64_t rx_next_ns;
+    uint32_t rx_head;
+    uint32_t rx_tail;
+    uint8_t rx_fifo[HOST_UART_FIFO_DEPTH];
+    uint32_t rx_overrun;
+    int flow;
+
+    void (*handler)(uint32_t id, int event);
+    uint32_t id;
+    volatile uint8_t irq_enabled[2];
+};
+
+#endif
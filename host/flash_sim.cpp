@@ -0,0 +1,105 @@
+/* Loads an image into SimFlash through ImageLoader and PageWriter and
+ * compares the result with a reference binary such as test/mbed.bin. The
+ * format (Intel HEX, S-record, UF2, ELF or raw binary) is told from the first
+ * bytes.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o flash_sim host/flash_sim.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp srec_decoder.cpp uf2_decoder.cpp elf_decoder.cpp bin_loader.cpp image_loader.cpp page_writer.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   flash_sim <image> <out.bin> [reference.bin] [program_us] [erase_us]
+ *
+ * A raw binary is loaded at address 0. The default timings are the LPC176x's,
+ * about 1 ms to program a 512 byte page and 100 ms per sector erase.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hex_pipeline.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "page_writer.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image> <out.bin> [reference.bin] [program_us] [erase_us]\n", argv[0]);
+        return 2;
+    }
+    const char *reference = (argc > 3) ? argv[3] : 0;
+    uint32_t program_us = (argc > 4) ? strtoul(argv[4], 0, 0) : 1000;
+    uint32_t erase_us = (argc > 5) ? strtoul(argv[5], 0, 0) : 100000;
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    uint32_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *image_data = (uint8_t *)malloc(size);
+    if (fread(image_data, 1, size, in) != size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+
+    SimFlash flash(program_us, erase_us);
+    PageWriter pages(flash);
+    HexPipeline hex(pages, host_us);
+    SrecDecoder srec(pages);
+    Uf2Decoder uf2(pages);
+    ElfDecoder elf(pages);
+    BinLoader bin(pages, 0);
+    ImageLoader image;
+    image.add(hex);
+    image.add(srec);
+    image.add(uf2);
+    image.add(elf);
+    // the length of the file is known so a binary can be loaded too
+    image.add(bin);
+    int ok = 1;
+    hex_parse_status_t status;
+    uint32_t pos = 0;
+    uint32_t start = host_us();
+    do {
+        // the size of a USB MSC transfer
+        uint32_t n = ((size - pos) < 4096) ? (size - pos) : 4096;
+        status = image.feed(&image_data[pos], n);
+        while (image.busy());
+        // an ELF with the program headers at the end goes back for the data
+        pos = (HEX_PARSE_SEEK == status) ? image.seek_offset() : (pos + n);
+    } while (((HEX_PARSE_OK == status) || (HEX_PARSE_SEEK == status)) && (pos < size));
+    ok &= !image.flush();
+    if ((HEX_PARSE_OK != status) && (HEX_PARSE_EOF != status)) {
+        printf("decode failed (status %d)\n", status);
+        ok = 0;
+    } else if ((HEX_PARSE_EOF != status) && (image.decoder() != &bin)) {
+        // without an end record the image is still loaded, but say so
+        printf("no end record\n");
+    }
+    uint32_t total_us = host_us() - start;
+    flash.save(argv[2]);
+
+    const page_writer_stats_t &s = pages.stats();
+    printf("input      %lu bytes of %s\n", (unsigned long)size, image.name());
+    printf("pages      %lu programmed (%lu without a copy), %lu all 0xff left erased\n",
+           (unsigned long)s.pages, (unsigned long)s.direct, (unsigned long)s.elided);
+    printf("erases     %lu\n", (unsigned long)s.erases);
+    printf("rejected   %lu writes, %lu flash faults\n", (unsigned long)s.rejected, (unsigned long)flash.faults());
+    printf("time       %lu us, flash busy %lu us\n", (unsigned long)total_us, (unsigned long)flash.busy_us());
+    ok &= !s.rejected && !flash.faults();
+    if (reference) {
+        int match = image_files_match(argv[2], reference);
+        printf("reference  %s\n", match ? "match" : "MISMATCH");
+        ok &= match;
+    }
+    free(image_data);
+    return ok ? 0 : 1;
+}
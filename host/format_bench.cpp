@@ -0,0 +1,179 @@
+/* Times the image decoders against each other on the same image. The hex
+ * file is used as it is, the reference binary is turned into S-records (16
+ * bytes a record like the hex), UF2 and ELF, and each is decoded in target sized
+ * pieces into a sink that only counts, then loaded through ImageLoader into
+ * a SimFlash and compared with the reference.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o format_bench host/format_bench.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp srec_decoder.cpp uf2_decoder.cpp elf_decoder.cpp bin_loader.cpp image_loader.cpp page_writer.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   format_bench <image.hex> <reference.bin> [out_prefix]
+ *
+ * With out_prefix the generated images are kept as <out_prefix>.srec, .uf2 and .elf.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "hex_pipeline.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "page_writer.h"
+#include "image_formats.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define RUNS    50
+
+/** Sink that takes everything at once and counts it
+ */
+class CountSink : public BlockSink {
+public:
+    CountSink() : bytes(0), writes(0) {}
+
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size) {
+        (void)addr;
+        (void)data;
+        bytes += size;
+        writes++;
+        return 0;
+    }
+
+    virtual int busy() {
+        return 0;
+    }
+
+    uint32_t bytes;
+    uint32_t writes;
+};
+
+static void save(const char *prefix, const char *ext, const uint8_t *data, uint32_t size)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", prefix, ext);
+    FILE *f = fopen(path, "wb");
+    if (f) {
+        fwrite(data, 1, size, f);
+        fclose(f);
+    }
+}
+
+/** Feed an image to a decoder in HEX_BLOCK_SIZE pieces the way the target does
+ *  @return the status at the end
+ */
+static hex_parse_status_t decode(ImageDecoder &decoder, const uint8_t *data, uint32_t size)
+{
+    hex_parse_status_t status = HEX_PARSE_OK;
+    uint32_t pos = 0;
+    while ((pos < size) && ((HEX_PARSE_OK == status) || (HEX_PARSE_SEEK == status))) {
+        uint32_t n = ((size - pos) < HEX_BLOCK_SIZE) ? (size - pos) : HEX_BLOCK_SIZE;
+        status = decoder.feed(&data[pos], n);
+        while (decoder.busy());
+        pos = (HEX_PARSE_SEEK == status) ? decoder.seek_offset() : (pos + n);
+    }
+    if (decoder.flush()) {
+        status = HEX_PARSE_REJECTED;
+    }
+    return status;
+}
+
+/** Load an image through ImageLoader into flash and check it
+ *  @return 1 if the flash matches the reference, otherwise 0
+ */
+static int load(const uint8_t *data, uint32_t size, const char *reference, const char **name)
+{
+    SimFlash flash(0, 0);
+    PageWriter pages(flash);
+    HexPipeline hex(pages, host_us);
+    SrecDecoder srec(pages);
+    Uf2Decoder uf2(pages);
+    ElfDecoder elf(pages);
+    BinLoader bin(pages, 0);
+    ImageLoader image;
+    image.add(hex);
+    image.add(srec);
+    image.add(uf2);
+    image.add(elf);
+    image.add(bin);
+    hex_parse_status_t status = decode(image, data, size);
+    *name = image.name();
+    flash.save("/tmp/format_bench.bin");
+    return (HEX_PARSE_REJECTED != status) && (HEX_PARSE_CKSUM_FAIL != status) && !pages.stats().rejected &&
+           !flash.faults() && image_files_match("/tmp/format_bench.bin", reference);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <reference.bin> [out_prefix]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> hex_file, bin_file;
+    if (read_file(argv[1], hex_file) || read_file(argv[2], bin_file)) {
+        perror("fopen");
+        return 1;
+    }
+    const uint8_t *hex = hex_file.data();
+    uint32_t hex_size = hex_file.size();
+    const uint8_t *bin = bin_file.data();
+    uint32_t bin_size = bin_file.size();
+    char *srec = (char *)malloc(bin_size * 3 + 1024);
+    uint32_t srec_size = srec_from_bin(bin, bin_size, 0, 16, srec);
+    uint8_t *uf2 = (uint8_t *)malloc(bin_size * 2 + UF2_BLOCK_SIZE);
+    uint32_t uf2_size = uf2_from_bin(bin, bin_size, 0, uf2);
+    uint8_t *elf = (uint8_t *)malloc(bin_size + 1024);
+    uint32_t elf_size = elf_from_bin(bin, bin_size, 0, elf);
+    if (argc > 3) {
+        save(argv[3], ".srec", (const uint8_t *)srec, srec_size);
+        save(argv[3], ".uf2", uf2, uf2_size);
+        save(argv[3], ".elf", elf, elf_size);
+    }
+
+    struct {
+        const char *name;
+        const uint8_t *data;
+        uint32_t size;
+    } images[5] = {
+        {"hex", hex, hex_size},
+        {"srec", (const uint8_t *)srec, srec_size},
+        {"uf2", uf2, uf2_size},
+        {"elf", elf, elf_size},
+        {"bin", bin, bin_size},
+    };
+    printf("%-6s %8s %8s %10s %10s %8s %s\n", "format", "size", "decoded", "in MB/s", "out MB/s", "vs hex", "check");
+    double hex_rate = 0;
+    int ok = 1;
+    for (int i = 0; i < 5; i++) {
+        CountSink sink;
+        uint32_t t = host_us();
+        for (int r = 0; r < RUNS; r++) {
+            HexPipeline hex_decoder(sink, host_us);
+            SrecDecoder srec_decoder(sink);
+            Uf2Decoder uf2_decoder(sink);
+            ElfDecoder elf_decoder(sink);
+            BinLoader bin_decoder(sink, 0);
+            ImageDecoder *decoders[5] = {&hex_decoder, &srec_decoder, &uf2_decoder, &elf_decoder, &bin_decoder};
+            decode(*decoders[i], images[i].data, images[i].size);
+        }
+        t = host_us() - t;
+        uint32_t decoded = sink.bytes / RUNS;
+        double rate = (double)decoded * RUNS / t;
+        if (!i) {
+            hex_rate = rate;
+        }
+        const char *detected;
+        int match = load(images[i].data, images[i].size, argv[2], &detected) && !strcmp(detected, images[i].name);
+        ok &= match;
+        printf("%-6s %8lu %8lu %10.1f %10.1f %7.2fx %s (%s)\n", images[i].name, (unsigned long)images[i].size, (unsigned long)decoded,
+               (double)images[i].size * RUNS / t, rate, rate / hex_rate, match ? "match" : "MISMATCH", detected);
+    }
+    free(srec);
+    free(uf2);
+    free(elf);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#ifndef HEATSHRINK_PACK_H
+#define HEATSHRINK_PACK_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "unpack.h"
+
+/* Host side heatshrink encoder for making test images, greedy matching with
+ * hash chains. Uses the HEATSHRINK_WINDOW_BITS/HEATSHRINK_LOOKAHEAD_BITS the
+ * target decoder was built with.
+ */
+
+typedef struct {
+    uint8_t *out;
+    uint32_t pos;
+    uint32_t bits;
+    uint32_t bit_cnt;
+} hs_bit_writer_t;
+
+static inline void hs_put_bits(hs_bit_writer_t *w, uint32_t value, uint32_t n)
+{
+    while (n--) {
+        w->bits = (w->bits << 1) | ((value >> n) & 1);
+        if (++w->bit_cnt == 8) {
+            w->out[w->pos++] = (uint8_t)w->bits;
+            w->bits = 0;
+            w->bit_cnt = 0;
+        }
+    }
+}
+
+/** Compress a buffer
+ *   @param in is the data to compress
+ *   @param size is the number of bytes in data
+ *   @param out is where the stream is written, at least size * 9 / 8 + 1 bytes
+ *   @return the size of the stream
+ */
+static inline uint32_t heatshrink_pack(const uint8_t *in, uint32_t size, uint8_t *out)
+{
+    const uint32_t window = 1UL << HEATSHRINK_WINDOW_BITS;
+    const uint32_t max_len = 1UL << HEATSHRINK_LOOKAHEAD_BITS;
+    // a back-reference costs 1 + W + L bits, a literal 9
+    const uint32_t min_len = (1 + HEATSHRINK_WINDOW_BITS + HEATSHRINK_LOOKAHEAD_BITS) / 9 + 1;
+    int32_t *head = (int32_t *)malloc(65536 * sizeof(int32_t));
+    int32_t *prev = (int32_t *)malloc((size + 1) * sizeof(int32_t));
+    hs_bit_writer_t w = {out, 0, 0, 0};
+    memset(head, 0xff, 65536 * sizeof(int32_t));
+
+    uint32_t i = 0;
+    while (i < size) {
+        uint32_t best_len = 0, best_dist = 0;
+        if (i + 1 < size) {
+            uint32_t h = in[i] | (in[i + 1] << 8);
+            for (int32_t c = head[h], steps = 0; (c >= 0) && ((i - c) <= window) && (steps < 256); c = prev[c], steps++) {
+                uint32_t len = 0;
+                while ((len < max_len) && (i + len < size) && (in[c + len] == in[i + len])) {
+                    len++;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = i - c;
+                    if (len == max_len) {
+                        break;
+                    }
+                }
+            }
+        }
+        uint32_t step = (best_len >= min_len) ? best_len : 1;
+        if (step > 1) {
+            hs_put_bits(&w, 0, 1);
+            hs_put_bits(&w, best_dist - 1, HEATSHRINK_WINDOW_BITS);
+            hs_put_bits(&w, best_len - 1, HEATSHRINK_LOOKAHEAD_BITS);
+        } else {
+            hs_put_bits(&w, 1, 1);
+            hs_put_bits(&w, in[i], 8);
+        }
+        for (uint32_t end = i + step; i < end; i++) {
+            if (i + 1 < size) {
+                uint32_t h = in[i] | (in[i + 1] << 8);
+                prev[i] = head[h];
+                head[h] = i;
+            }
+        }
+    }
+    if (w.bit_cnt) {
+        hs_put_bits(&w, 0, 8 - w.bit_cnt);
+    }
+    free(head);
+    free(prev);
+    return w.pos;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef HEX_IMAGE_H
+#define HEX_IMAGE_H
+
+/* What the host tools share for taking a hex file apart: reading a whole
+ * file, a HexPushParser handler base and the handler that lays the data out
+ * as a flash image from address 0.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "stdint.h"
+
+/** Read a whole file, or what there is of a pipe
+ *  @param path is the file
+ *  @param out is a std::vector<uint8_t> or std::string, replaced with the file
+ *  @return 0 on success, -1 if it can not be read
+ */
+template <typename Buffer>
+static int read_file(const char *path, Buffer &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    char buf[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out.insert(out.end(), buf, buf + n);
+    }
+    int ret = ferror(f) ? -1 : 0;
+    fclose(f);
+    return ret;
+}
+
+/** Base of the HexPushParser handlers in the host tools. It notes the end of
+ *  file record and ignores the address records, a handler adds on_data()
+ *  and hides whichever of the others it needs.
+ */
+class HexHandler {
+public:
+    HexHandler() : eof(0) {
+    }
+
+    void on_segment(uint32_t base) {
+        (void)base;
+    }
+    void on_entry(uint32_t addr) {
+        (void)addr;
+    }
+    void on_eof() {
+        eof = 1;
+    }
+
+    int eof;
+};
+
+/** HexPushParser handler that places the data in a flash image from address
+ *  0, gaps as 0xff. Data past max_size is refused and counted.
+ */
+class ImageHandler : public HexHandler {
+public:
+    ImageHandler(uint32_t max_size = 16u << 20) : rejected(0), _max_size(max_size) {
+    }
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (((uint64_t)addr + size) > _max_size) {
+            rejected++;
+            return -1;
+        }
+        if ((addr + size) > image.size()) {
+            image.resize(addr + size, 0xff);
+        }
+        memcpy(&image[addr], data, size);
+        return 0;
+    }
+
+    /** Compare with a reference, anything past the shorter one must be 0xff
+     */
+    int matches(const uint8_t *ref, uint32_t size) const {
+        uint32_t n = (size < image.size()) ? size : image.size();
+        if (memcmp(ref, image.data(), n)) {
+            return 0;
+        }
+        for (uint32_t i = n; i < size; i++) {
+            if (0xff != ref[i]) {
+                return 0;
+            }
+        }
+        for (uint32_t i = n; i < image.size(); i++) {
+            if (0xff != image[i]) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    std::vector<uint8_t> image;
+    uint32_t rejected;
+
+private:
+    uint32_t _max_size;
+};
+
+#endif
@@ -0,0 +1,192 @@
+/* Random reads out of a hex file through HexIndex, against decoding the
+ * file from the start up to the window each time. Builds the sidecar, opens
+ * it again to check it is reused with the file's modification time and
+ * with a hash as the stamp, then reads windows at random addresses both
+ * ways and checks them against the reference. Last it changes a copy of
+ * the hex and checks the sidecar is rebuilt, then breaks a record in it and
+ * checks open() fails every time and leaves no sidecar behind.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o hex_index_bench host/hex_index_bench.cpp hex_index.cpp
+ *
+ * Usage:
+ *   hex_index_bench <image.hex> <reference.bin> [read_size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <vector>
+#include "hex_index.h"
+#include "hex_push_parser.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define READS   1000
+#define HIX     "/tmp/hex_index_bench.hix"
+#define COPY    "/tmp/hex_index_bench.hex"
+
+/** HexPushParser handler that keeps the part of each record in a window and
+ *  stops once the records are past it, the file being in address order
+ */
+class WindowHandler : public HexHandler {
+public:
+    WindowHandler(uint32_t addr, uint8_t *data, uint32_t size) : _addr(addr), _data(data), _size(size) {
+        memset(data, 0xff, size);
+    }
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (addr >= (_addr + _size)) {
+            return 1;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            if (((addr + i) >= _addr) && ((addr + i) < (_addr + _size))) {
+                _data[addr + i - _addr] = data[i];
+            }
+        }
+        return 0;
+    }
+
+private:
+    uint32_t _addr;
+    uint8_t *_data;
+    uint32_t _size;
+};
+
+/** Read a window by decoding the file from the start
+ */
+static void read_from_start(const char *path, uint32_t addr, uint8_t *data, uint32_t size)
+{
+    FILE *f = fopen(path, "rb");
+    WindowHandler window(addr, data, size);
+    HexPushParser<WindowHandler> parser(window);
+    uint8_t chunk[4096];
+    size_t n;
+    while (f && ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) && (HEX_PARSE_OK == parser.feed(chunk, n)));
+    if (f) {
+        fclose(f);
+    }
+}
+
+static uint32_t mtime(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) ? 0 : (uint32_t)st.st_mtime;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <reference.bin> [read_size]\n", argv[0]);
+        return 2;
+    }
+    uint32_t read_size = (argc > 3) ? strtoul(argv[3], 0, 0) : 4096;
+    std::vector<uint8_t> ref;
+    if (read_file(argv[2], ref)) {
+        perror("fopen");
+        return 1;
+    }
+
+    int ok = 1;
+    HexIndex index;
+    remove(HIX);
+    uint32_t t = host_us();
+    if (index.open(argv[1], HIX, mtime(argv[1]))) {
+        fprintf(stderr, "%s: can not index\n", argv[1]);
+        return 1;
+    }
+    uint32_t build_us = host_us() - t;
+    const hex_index_header_t &h = index.header();
+    printf("%s: %lu entries of %lu records, 0x%08lx-0x%08lx, %s\n", argv[1], (unsigned long)h.entries, (unsigned long)h.records,
+           (unsigned long)h.start, (unsigned long)h.end, h.sorted ? "sorted" : "not in address order");
+    printf("%-28s %9lu us\n", "build", (unsigned long)build_us);
+    t = host_us();
+    ok &= !index.open(argv[1], HIX, mtime(argv[1])) && !index.rebuilt();
+    printf("%-28s %9lu us %s\n", "reopen, stamped by mtime", (unsigned long)(host_us() - t), index.rebuilt() ? "rebuilt" : "reused");
+    remove(HIX);
+    index.open(argv[1], HIX, 0);
+    t = host_us();
+    ok &= !index.open(argv[1], HIX, 0) && !index.rebuilt();
+    printf("%-28s %9lu us %s\n", "reopen, stamped by hash", (unsigned long)(host_us() - t), index.rebuilt() ? "rebuilt" : "reused");
+
+    std::vector<uint8_t> a(read_size), b(read_size);
+    std::vector<uint32_t> addrs(READS);
+    srand(1);
+    uint32_t span = (h.end - h.start) ? (h.end - h.start) : 1;
+    for (int i = 0; i < READS; i++) {
+        addrs[i] = h.start + (uint32_t)(((uint64_t)rand() * span) / ((uint64_t)RAND_MAX + 1));
+    }
+    uint32_t mismatches = 0;
+    t = host_us();
+    for (int i = 0; i < READS; i++) {
+        if (index.read(addrs[i], &a[0], read_size)) {
+            mismatches++;
+        }
+    }
+    uint32_t index_us = host_us() - t;
+    t = host_us();
+    for (int i = 0; i < READS; i++) {
+        read_from_start(argv[1], addrs[i], &b[0], read_size);
+    }
+    uint32_t start_us = host_us() - t;
+    for (int i = 0; i < READS; i++) {
+        index.read(addrs[i], &a[0], read_size);
+        for (uint32_t j = 0; j < read_size; j++) {
+            uint32_t addr = addrs[i] + j;
+            uint8_t expect = (addr < ref.size()) ? ref[addr] : 0xff;
+            if (a[j] != expect) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    printf("%-28s %9.1f us a read of %lu bytes\n", "index", (double)index_us / READS, (unsigned long)read_size);
+    printf("%-28s %9.1f us a read\n", "decode from the start", (double)start_us / READS);
+    printf("%-28s %9lu\n", "mismatches", (unsigned long)mismatches);
+    ok &= !mismatches;
+
+    // a copy that then gets a line end added, with no stamp so the hash notices
+    FILE *in = fopen(argv[1], "rb");
+    int c;
+    FILE *out = fopen(COPY, "wb");
+    while (in && out && (EOF != (c = fgetc(in)))) {
+        fputc(c, out);
+    }
+    if (in) {
+        fclose(in);
+    }
+    if (out) {
+        fclose(out);
+    }
+    HexIndex copy;
+    remove(HIX);
+    ok &= !copy.open(COPY, HIX, 0) && copy.rebuilt();
+    out = fopen(COPY, "ab");
+    if (out) {
+        fputc('\n', out);
+        fclose(out);
+    }
+    ok &= !copy.open(COPY, HIX, 0) && copy.rebuilt();
+    printf("%-28s %s\n", "changed hex", copy.rebuilt() ? "rebuilt" : "NOT REBUILT");
+
+    // the same copy with the second data record's checksum broken
+    out = fopen(COPY, "wb");
+    if (out) {
+        fputs(":020000040000FA\n:0400000001020304F2\n:0400040005060708DD\n:00000001FF\n", out);
+        fclose(out);
+    }
+    int broken = 1;
+    for (int i = 0; i < 2; i++) {
+        broken &= (0 != copy.open(COPY, HIX, 0));
+        in = fopen(HIX, "rb");
+        if (in) {
+            broken = 0;
+            fclose(in);
+        }
+    }
+    ok &= broken;
+    printf("%-28s %s\n", "broken record", broken ? "refused, no sidecar" : "OPENED");
+    remove(COPY);
+    remove(HIX);
+    return ok ? 0 : 1;
+}
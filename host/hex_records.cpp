@@ -0,0 +1,135 @@
+/* Walks the records of a hex image with HexRecordReader and the standard
+ * algorithms: records by type, bytes per 64k segment and the data in an
+ * address window. Then times a walk that only reads the record headers, one
+ * that checks and decodes every record, and HexPushParser on the same image.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o hex_records host/hex_records.cpp
+ *
+ * Usage:
+ *   hex_records <image.hex> [window_start window_end]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include "hex_record_reader.h"
+#include "hex_push_parser.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define RUNS    200
+
+/** HexPushParser handler that only counts
+ */
+class CountHandler : public HexHandler {
+public:
+    CountHandler() : bytes(0) {}
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        (void)addr;
+        (void)data;
+        bytes += size;
+        return 0;
+    }
+
+    uint32_t bytes;
+};
+
+static bool is_data(const HexRecord &record)
+{
+    return DATA_RECORD == record.type();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <image.hex> [window_start window_end]\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    uint32_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *hex = (uint8_t *)malloc(size);
+    if (fread(hex, 1, size, in) != size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+    uint32_t window_start = (argc > 3) ? strtoul(argv[2], 0, 0) : 0;
+    uint32_t window_end = (argc > 3) ? strtoul(argv[3], 0, 0) : 0x1000;
+
+    HexRecordReader records(hex, size);
+    uint32_t types[6] = {0};
+    std::map<uint32_t, uint32_t> segments;
+    HexRecord last;
+    for (HexRecordReader::iterator it = records.begin(); it != records.end(); ++it) {
+        if (it->type() < 6) {
+            types[it->type()]++;
+        }
+        if (DATA_RECORD == it->type()) {
+            segments[it->address() & 0xffff0000] += it->length();
+        }
+        last = *it;
+    }
+    printf("records    %ld (%lu data, %lu address, %lu start, %lu eof)%s\n", (long)std::distance(records.begin(), records.end()),
+           (unsigned long)types[DATA_RECORD], (unsigned long)(types[EXT_SEG_ADDR_RECORD] + types[EXT_LINEAR_ADDR_RECORD]),
+           (unsigned long)(types[START_SEG_ADDR_RECORD] + types[START_LINEAR_ADDR_RECORD]), (unsigned long)types[EOF_RECORD],
+           records.stopped(last) ? ", stopped at something that is not a record" : "");
+    for (std::map<uint32_t, uint32_t>::const_iterator it = segments.begin(); it != segments.end(); ++it) {
+        printf("segment    0x%08lx %lu bytes\n", (unsigned long)it->first, (unsigned long)it->second);
+    }
+    long in_window = std::count_if(records.begin(), records.end(), [=](const HexRecord &r) {
+        return is_data(r) && (r.address() < window_end) && ((r.address() + r.length()) > window_start);
+    });
+    printf("window     0x%lx-0x%lx has %ld data records\n", (unsigned long)window_start, (unsigned long)window_end, in_window);
+    HexRecordReader::iterator bad = std::find_if(records.begin(), records.end(), [](const HexRecord &r) {
+        return !r.valid();
+    });
+    if (bad != records.end()) {
+        printf("checksum   bad at offset %ld\n", (long)(bad->text() - hex));
+    }
+
+    // headers only, the framing speed
+    uint32_t bytes = 0;
+    uint32_t t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        for (HexRecordReader::iterator it = records.begin(); it != records.end(); ++it) {
+            bytes += is_data(*it) ? it->length() : 0;
+        }
+    }
+    uint32_t header_us = host_us() - t;
+
+    // every record checked and decoded
+    uint8_t data[255];
+    uint32_t decoded = 0;
+    t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        for (HexRecordReader::iterator it = records.begin(); it != records.end(); ++it) {
+            if (it->valid() && is_data(*it)) {
+                decoded += it->decode(data);
+            }
+        }
+    }
+    uint32_t decode_us = host_us() - t;
+
+    CountHandler handler;
+    t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        HexPushParser<CountHandler> parser(handler);
+        parser.feed(hex, size);
+    }
+    uint32_t push_us = host_us() - t;
+
+    printf("%-22s %10s\n", "walk", "hex MB/s");
+    printf("%-22s %10.1f\n", "headers only", (double)size * RUNS / header_us);
+    printf("%-22s %10.1f\n", "checked and decoded", (double)size * RUNS / decode_us);
+    printf("%-22s %10.1f\n", "HexPushParser", (double)size * RUNS / push_us);
+    free(hex);
+    return ((bytes == decoded) && (decoded == handler.bytes) && (bad == records.end())) ? 0 : 1;
+}
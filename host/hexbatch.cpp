@@ -0,0 +1,843 @@
+/* Converts a directory of small hex files to binaries in one go, for build
+ * jobs that turn out thousands of artifacts, where opening, reading and
+ * writing each file costs more than decoding it.
+ *
+ * Files go through io_uring: up to -q of them are in flight, each with its
+ * own decoding context (a HexPushParser with its read buffer and binary), and
+ * every open, read, close and write is queued on the ring, so one
+ * io_uring_enter() submits the next steps of many files and collects what
+ * finished. Files are opened into registered slots, so each open is linked
+ * with what follows it and a file takes two submissions: open and read, then
+ * close, open, write and close. A context is fed from its read completions
+ * and starts on the next file when its binary is written. -p converts with
+ * plain blocking open/read/write/close calls, one file after another, for
+ * comparison. The files in flight share one thread, so the time each takes
+ * grows with the queue depth while the batch gets done sooner.
+ *
+ * A binary starts at the first data record and gaps are 0xff, as hexconv
+ * writes them, into <out_dir> under the name of the hex with .bin. A file
+ * with a bad record or no end of file record is reported and gets no binary.
+ *
+ * bench converts the same files both ways, RUNS times each counting the
+ * quickest, and checks the binaries agree. gen writes a corpus to try it on.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o hexbatch host/hexbatch.cpp
+ *
+ * Usage:
+ *   hexbatch convert [-q depth] [-p] <in_dir> <out_dir>
+ *   hexbatch bench [-q depth] <in_dir> <out_dir>
+ *   hexbatch gen <dir> <count> [kb]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "hex_push_parser.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define QUEUE_DEPTH 256
+#define READ_SIZE   (32 * 1024)
+// a binary is built in RAM, refuse images that spread wider than this
+#define MAX_IMAGE   (64 * 1024 * 1024)
+#define RUNS        3
+
+typedef struct {
+    std::string in;
+    std::string out;
+    uint32_t us;        // from the first call for the file to its binary being closed
+    uint32_t hash;      // FNV-1a of the binary
+    const char *error;  // why it has no binary, NULL when it has one
+    int out_error;      // the error is about the binary, not the hex
+} batch_file_t;
+
+typedef struct {
+    uint32_t us;        // the whole batch
+    uint32_t calls;     // system calls, io_uring_enter() for the ring
+    uint32_t failed;    // files without a binary
+} batch_result_t;
+
+/** HexPushParser handler that builds the binary from the first data record
+ */
+class BinImage : public HexHandler {
+
+public:
+    BinImage() : _have(0), _origin(0), _error(0) {
+    }
+
+    void clear() {
+        bin.clear();
+        _have = 0;
+        eof = 0;
+        _error = 0;
+    }
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (!_have) {
+            _have = 1;
+            _origin = addr;
+        }
+        if (addr < _origin) {
+            _error = "a record below the first one";
+            return -1;
+        }
+        uint32_t off = addr - _origin;
+        if (((uint64_t)off + size) > MAX_IMAGE) {
+            _error = "image too large";
+            return -1;
+        }
+        if (bin.size() < (off + size)) {
+            bin.resize(off + size, 0xff);
+        }
+        memcpy(&bin[off], data, size);
+        return 0;
+    }
+
+    const char *error() const {
+        return _error;
+    }
+
+    std::vector<uint8_t> bin;
+
+private:
+    int _have;
+    uint32_t _origin;
+    const char *_error;
+};
+
+/** One file being converted: its parser, read buffer and binary
+ */
+class Context {
+
+public:
+    Context() : parser(image), buf(READ_SIZE), file(0), out_open(0), pos(0), written(0), pending(0), start(0), _status(HEX_PARSE_OK) {
+    }
+
+    void begin(batch_file_t *f) {
+        image.clear();
+        parser.reset();
+        file = f;
+        file->error = 0;
+        file->out_error = 0;
+        out_open = 0;
+        pos = 0;
+        written = 0;
+        pending = 0;
+        start = host_us();
+        _status = HEX_PARSE_OK;
+    }
+
+    /** Parse what the last read brought in
+     *  @param size is the number of bytes read, 0 at the end of the file
+     *  @return 1 while more of the file is wanted, otherwise 0
+     */
+    int feed(uint32_t size) {
+        if (size) {
+            _status = parser.feed(&buf[0], size);
+            pos += size;
+        }
+        if (!size || (HEX_PARSE_OK != _status)) {
+            if (image.error()) {
+                file->error = image.error();
+            } else if (HEX_PARSE_WRAP == _status) {
+                file->error = "data past the top of the address space";
+            } else if ((HEX_PARSE_OK != _status) && (HEX_PARSE_EOF != _status)) {
+                file->error = "bad record";
+            } else if (!image.eof) {
+                file->error = "no end of file record";
+            }
+            return 0;
+        }
+        return 1;
+    }
+
+    void fail(const char *error, int out = 0) {
+        if (!file->error) {
+            file->error = error;
+            file->out_error = out;
+        }
+    }
+
+    void end() {
+        file->us = host_us() - start;
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < image.bin.size(); i++) {
+            h = (h ^ image.bin[i]) * 16777619u;
+        }
+        file->hash = file->error ? 0 : h;
+    }
+
+    BinImage image;
+    HexPushParser<BinImage> parser;
+    std::vector<uint8_t> buf;
+    batch_file_t *file;
+    // the output is open in its io_uring slot
+    int out_open;
+    uint64_t pos;
+    uint32_t written;
+    // operations queued and not completed
+    int pending;
+    uint32_t start;
+
+private:
+    hex_parse_status_t _status;
+};
+
+/** The submission and completion rings of an io_uring, set up with the raw
+ *  system calls
+ */
+class Ring {
+
+public:
+    Ring() : _fd(-1), _sq(0), _cq(0), _sqes(0), _tail(0), _queued(0) {
+    }
+
+    ~Ring() {
+        if (_sqes) {
+            munmap(_sqes, _sqes_size);
+        }
+        if (_cq && (_cq != _sq)) {
+            munmap(_cq, _cq_size);
+        }
+        if (_sq) {
+            munmap(_sq, _sq_size);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    /** @param entries is the submission queue size, the completion queue is twice that
+     *  @return 0 on success, -1 when io_uring is not available
+     */
+    int init(uint32_t entries) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        // only this thread submits, completions are run when it waits for them
+        p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+        _fd = syscall(__NR_io_uring_setup, entries, &p);
+        if (_fd < 0) {
+            memset(&p, 0, sizeof(p));
+            _fd = syscall(__NR_io_uring_setup, entries, &p);
+        }
+        if (_fd < 0) {
+            return -1;
+        }
+        _sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            _sq_size = _cq_size = (_sq_size > _cq_size) ? _sq_size : _cq_size;
+        }
+        _sq = map(_sq_size, IORING_OFF_SQ_RING);
+        _cq = (p.features & IORING_FEAT_SINGLE_MMAP) ? _sq : map(_cq_size, IORING_OFF_CQ_RING);
+        _sqes = (struct io_uring_sqe *)map(_sqes_size, IORING_OFF_SQES);
+        if (!_sq || !_cq || !_sqes) {
+            return -1;
+        }
+        _sq_head = (uint32_t *)(_sq + p.sq_off.head);
+        _sq_tail = (uint32_t *)(_sq + p.sq_off.tail);
+        _sq_mask = *(uint32_t *)(_sq + p.sq_off.ring_mask);
+        _sq_entries = p.sq_entries;
+        _cq_head = (uint32_t *)(_cq + p.cq_off.head);
+        _cq_tail = (uint32_t *)(_cq + p.cq_off.tail);
+        _cq_mask = *(uint32_t *)(_cq + p.cq_off.ring_mask);
+        _cqes = (struct io_uring_cqe *)(_cq + p.cq_off.cqes);
+        // submission slot i always takes sqes[i]
+        uint32_t *array = (uint32_t *)(_sq + p.sq_off.array);
+        for (uint32_t i = 0; i < p.sq_entries; i++) {
+            array[i] = i;
+        }
+        _tail = *_sq_tail;
+        return 0;
+    }
+
+    /** Make a table of empty file slots, which opens fill and closes empty
+     *   without going through the process file table
+     *  @param count is the number of slots
+     *  @return 0 on success, -1 on an error
+     */
+    int slots(uint32_t count) {
+        struct io_uring_rsrc_register r;
+        memset(&r, 0, sizeof(r));
+        r.nr = count;
+        r.flags = IORING_RSRC_REGISTER_SPARSE;
+        return (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_FILES2, &r, sizeof(r)) < 0) ? -1 : 0;
+    }
+
+    /** Queue an operation, it goes to the kernel with the next submit()
+     *  @return the cleared entry to fill in, NULL if the queue is full and can not be submitted
+     */
+    struct io_uring_sqe *sqe(uint8_t opcode, int fd, uint64_t user_data) {
+        if (((_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE)) >= _sq_entries) && submit(0)) {
+            return 0;
+        }
+        struct io_uring_sqe *e = &_sqes[_tail & _sq_mask];
+        memset(e, 0, sizeof(*e));
+        e->opcode = opcode;
+        e->fd = fd;
+        e->user_data = user_data;
+        _tail++;
+        _queued++;
+        return e;
+    }
+
+    /** Hand the queued operations to the kernel and wait for completions
+     *  @param wait is the number of completions to wait for
+     *  @return 0 on success, -1 on an error
+     */
+    int submit(uint32_t wait) {
+        __atomic_store_n(_sq_tail, _tail, __ATOMIC_RELEASE);
+        int n;
+        do {
+            n = syscall(__NR_io_uring_enter, _fd, _queued, wait, wait ? IORING_ENTER_GETEVENTS : 0, (void *)0, 0);
+        } while ((n < 0) && (EINTR == errno));
+        if (n < 0) {
+            return -1;
+        }
+        _queued -= n;
+        return 0;
+    }
+
+    /** @return the oldest completion not seen yet, NULL when there is none
+     */
+    const struct io_uring_cqe *cqe() {
+        uint32_t head = *_cq_head;
+        if (head == __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+        return &_cqes[head & _cq_mask];
+    }
+
+    /** Give the completion from cqe() back to the kernel
+     */
+    void seen() {
+        __atomic_store_n(_cq_head, *_cq_head + 1, __ATOMIC_RELEASE);
+    }
+
+private:
+    uint8_t *map(size_t size, off_t what) {
+        void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, what);
+        return (MAP_FAILED == p) ? 0 : (uint8_t *)p;
+    }
+
+    int _fd;
+    uint8_t *_sq;
+    uint8_t *_cq;
+    struct io_uring_sqe *_sqes;
+    size_t _sq_size;
+    size_t _cq_size;
+    size_t _sqes_size;
+    uint32_t *_sq_head;
+    uint32_t *_sq_tail;
+    uint32_t _sq_mask;
+    uint32_t _sq_entries;
+    uint32_t *_cq_head;
+    uint32_t *_cq_tail;
+    uint32_t _cq_mask;
+    struct io_uring_cqe *_cqes;
+    // our copy of the submission tail and what is queued but not submitted
+    uint32_t _tail;
+    uint32_t _queued;
+};
+
+// what a completion was for, in the low byte of its user_data
+enum {
+    OP_OPEN_IN,
+    OP_READ,
+    OP_CLOSE_IN,
+    OP_OPEN_OUT,
+    OP_WRITE,
+    OP_CLOSE_OUT
+};
+
+/** Converts files through a Ring with one Context per file in flight.
+ *  Context i reads through file slot i and writes through slot depth + i,
+ *  so an open and what uses the file are linked into one submission: open
+ *  and the first read, then closing the input along with open, write and
+ *  close of the output
+ */
+class UringBatch {
+
+public:
+    UringBatch(std::vector<batch_file_t> &files, uint32_t depth) : _files(files), _next(0), _done(0) {
+        depth = (depth < files.size()) ? depth : files.size();
+        _contexts.resize(depth);
+        for (uint32_t i = 0; i < depth; i++) {
+            _contexts[i] = new Context;
+        }
+    }
+
+    ~UringBatch() {
+        for (size_t i = 0; i < _contexts.size(); i++) {
+            delete _contexts[i];
+        }
+    }
+
+    /** @return 0 when every file got its turn, -1 when io_uring failed
+     */
+    int run(batch_result_t &result) {
+        // no context queues more than four operations between submits
+        if (_ring.init(_contexts.size() * 4 + 4) || _ring.slots(_contexts.size() * 2 + 2)) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < _contexts.size(); i++) {
+            next_file(i);
+        }
+        while (_done < _files.size()) {
+            if (_ring.submit(1)) {
+                return -1;
+            }
+            result.calls++;
+            const struct io_uring_cqe *c;
+            while ((c = _ring.cqe())) {
+                uint64_t user_data = c->user_data;
+                int res = c->res;
+                _ring.seen();
+                complete(user_data >> 8, user_data & 0xff, res);
+            }
+        }
+        return 0;
+    }
+
+private:
+    /** Start context i on the next file, a file whose open can not be
+     *  queued is failed and the one after it tried
+     */
+    void next_file(uint32_t i) {
+        Context &ctx = *_contexts[i];
+        while (_next < _files.size()) {
+            ctx.begin(&_files[_next++]);
+            struct io_uring_sqe *e = queue(i, OP_OPEN_IN, AT_FDCWD);
+            if (e) {
+                e->addr = (uintptr_t)ctx.file->in.c_str();
+                e->open_flags = O_RDONLY;
+                e->file_index = i + 1;
+                e->flags = IOSQE_IO_LINK;
+                if (read(i)) {
+                    // nothing to link to, the open still completes
+                    e->flags = 0;
+                }
+                return;
+            }
+            ctx.end();
+            _done++;
+        }
+    }
+
+    /** Get an entry for an operation of context i
+     *  @return the entry, or NULL with the file failed when the ring has no
+     *   room and can not be submitted
+     */
+    struct io_uring_sqe *queue(uint32_t i, uint8_t op, int fd) {
+        static const uint8_t opcode[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE, IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE};
+        struct io_uring_sqe *e = _ring.sqe(opcode[op], fd, ((uint64_t)i << 8) | op);
+        if (!e) {
+            _contexts[i]->fail(strerror(errno), op >= OP_OPEN_OUT);
+            return 0;
+        }
+        _contexts[i]->pending++;
+        return e;
+    }
+
+    /** @return 0 when queued, -1 with the file failed when it can not be
+     */
+    int read(uint32_t i) {
+        Context &ctx = *_contexts[i];
+        struct io_uring_sqe *e = queue(i, OP_READ, i);
+        if (!e) {
+            return -1;
+        }
+        e->flags = IOSQE_FIXED_FILE;
+        e->addr = (uintptr_t)&ctx.buf[0];
+        e->len = ctx.buf.size();
+        e->off = ctx.pos;
+        return 0;
+    }
+
+    int close_file(uint32_t i, uint8_t op, uint32_t slot) {
+        struct io_uring_sqe *e = queue(i, op, 0);
+        if (!e) {
+            return -1;
+        }
+        e->file_index = slot + 1;
+        return 0;
+    }
+
+    /** The input is parsed, close it and write the binary
+     */
+    void output(uint32_t i) {
+        Context &ctx = *_contexts[i];
+        close_file(i, OP_CLOSE_IN, i);
+        if (!ctx.file->error) {
+            struct io_uring_sqe *e = queue(i, OP_OPEN_OUT, AT_FDCWD);
+            if (!e) {
+                return;
+            }
+            e->addr = (uintptr_t)ctx.file->out.c_str();
+            e->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+            e->len = 0644;
+            e->file_index = _contexts.size() + i + 1;
+            e->flags = IOSQE_IO_LINK;
+            if (write(i)) {
+                e->flags = 0;
+            }
+        }
+    }
+
+    int write(uint32_t i) {
+        Context &ctx = *_contexts[i];
+        struct io_uring_sqe *e = queue(i, OP_WRITE, _contexts.size() + i);
+        if (!e) {
+            return -1;
+        }
+        e->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+        e->addr = (uintptr_t)(ctx.image.bin.empty() ? 0 : &ctx.image.bin[ctx.written]);
+        e->len = ctx.image.bin.size() - ctx.written;
+        e->off = ctx.written;
+        if (close_file(i, OP_CLOSE_OUT, _contexts.size() + i)) {
+            e->flags = IOSQE_FIXED_FILE;
+        }
+        return 0;
+    }
+
+    void complete(uint32_t i, uint8_t op, int res) {
+        Context &ctx = *_contexts[i];
+        ctx.pending--;
+        switch (op) {
+            case OP_OPEN_IN:
+            case OP_OPEN_OUT:
+                // what was linked to a failed open comes back cancelled
+                if (res < 0) {
+                    ctx.fail(strerror(-res), OP_OPEN_OUT == op);
+                } else if (OP_OPEN_OUT == op) {
+                    ctx.out_open = 1;
+                }
+                break;
+
+            case OP_READ:
+                if (-ECANCELED == res) {
+                    break;
+                }
+                if (res < 0) {
+                    ctx.fail(strerror(-res));
+                    close_file(i, OP_CLOSE_IN, i);
+                } else if (ctx.feed(res)) {
+                    if (read(i)) {
+                        close_file(i, OP_CLOSE_IN, i);
+                    }
+                } else {
+                    output(i);
+                }
+                break;
+
+            case OP_WRITE:
+                if (-ECANCELED == res) {
+                    break;
+                }
+                if (res < 0) {
+                    ctx.fail(strerror(-res), 1);
+                } else if ((ctx.written += res) < ctx.image.bin.size()) {
+                    if (res) {
+                        // a short write, its linked close is cancelled and goes again with the rest
+                        write(i);
+                    } else {
+                        ctx.fail("no space", 1);
+                    }
+                }
+                break;
+
+            case OP_CLOSE_OUT:
+                if (res >= 0) {
+                    ctx.out_open = 0;
+                } else if ((-ECANCELED == res) && ctx.out_open && ctx.file->error) {
+                    // the write failed, its close did not run
+                    close_file(i, OP_CLOSE_OUT, _contexts.size() + i);
+                }
+                break;
+
+            default:
+                break;
+        }
+        if (!ctx.pending) {
+            ctx.end();
+            _done++;
+            next_file(i);
+        }
+    }
+
+    std::vector<batch_file_t> &_files;
+    std::vector<Context *> _contexts;
+    Ring _ring;
+    size_t _next;
+    size_t _done;
+};
+
+/** Converts the files one after another with blocking calls
+ */
+static void plain_batch(std::vector<batch_file_t> &files, batch_result_t &result)
+{
+    Context ctx;
+    for (size_t i = 0; i < files.size(); i++) {
+        ctx.begin(&files[i]);
+        int fd = open(ctx.file->in.c_str(), O_RDONLY);
+        result.calls++;
+        if (fd < 0) {
+            ctx.fail(strerror(errno));
+            ctx.end();
+            continue;
+        }
+        ssize_t n;
+        do {
+            n = read(fd, &ctx.buf[0], ctx.buf.size());
+            result.calls++;
+        } while ((n >= 0) && ctx.feed(n));
+        if (n < 0) {
+            ctx.fail(strerror(errno));
+        }
+        close(fd);
+        result.calls++;
+        if (!ctx.file->error) {
+            fd = open(ctx.file->out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            result.calls++;
+            if (fd < 0) {
+                ctx.fail(strerror(errno), 1);
+            } else {
+                std::vector<uint8_t> &bin = ctx.image.bin;
+                while (ctx.written < bin.size()) {
+                    n = write(fd, &bin[ctx.written], bin.size() - ctx.written);
+                    result.calls++;
+                    if (n <= 0) {
+                        ctx.fail(n ? strerror(errno) : "no space", 1);
+                        break;
+                    }
+                    ctx.written += n;
+                }
+                close(fd);
+                result.calls++;
+            }
+        }
+        ctx.end();
+    }
+}
+
+/** Lists the .hex files in in_dir, with their binaries in out_dir
+ */
+static int list_files(const char *in_dir, const char *out_dir, std::vector<batch_file_t> &files)
+{
+    DIR *d = opendir(in_dir);
+    if (!d) {
+        return -1;
+    }
+    std::vector<std::string> names;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        size_t len = strlen(e->d_name);
+        if ((len > 4) && !strcmp(&e->d_name[len - 4], ".hex")) {
+            names.push_back(std::string(e->d_name, len - 4));
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    files.resize(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        files[i].in = std::string(in_dir) + "/" + names[i] + ".hex";
+        files[i].out = std::string(out_dir) + "/" + names[i] + ".bin";
+        files[i].us = 0;
+        files[i].hash = 0;
+        files[i].error = 0;
+        files[i].out_error = 0;
+    }
+    return 0;
+}
+
+static int convert(std::vector<batch_file_t> &files, int plain, uint32_t depth, batch_result_t &result)
+{
+    memset(&result, 0, sizeof(result));
+    uint32_t t = host_us();
+    if (plain) {
+        plain_batch(files, result);
+    } else {
+        UringBatch batch(files, depth);
+        if (batch.run(result)) {
+            return -1;
+        }
+    }
+    result.us = host_us() - t;
+    for (size_t i = 0; i < files.size(); i++) {
+        result.failed += files[i].error ? 1 : 0;
+    }
+    return 0;
+}
+
+static void print_header()
+{
+    printf("%-12s %7s %7s %9s %10s %9s %9s %9s %9s\n", "", "files", "failed", "ms", "files/s", "calls", "p50 us", "p99 us", "max us");
+}
+
+static void print_result(const char *name, const std::vector<batch_file_t> &files, const batch_result_t &r)
+{
+    std::vector<uint32_t> us(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        us[i] = files[i].us;
+    }
+    std::sort(us.begin(), us.end());
+    size_t n = us.size();
+    printf("%-12s %7lu %7lu %9.1f %10.0f %9lu %9lu %9lu %9lu\n", name, (unsigned long)n, (unsigned long)r.failed, r.us / 1000.0,
+           n * 1e6 / (r.us ? r.us : 1), (unsigned long)r.calls, (unsigned long)(n ? us[n / 2] : 0),
+           (unsigned long)(n ? us[(n * 99) / 100] : 0), (unsigned long)(n ? us[n - 1] : 0));
+}
+
+static void put_record(FILE *f, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t size)
+{
+    uint8_t sum = size + (offset >> 8) + offset + type;
+    fprintf(f, ":%02X%04X%02X", size, offset, type);
+    for (uint8_t i = 0; i < size; i++) {
+        fprintf(f, "%02X", data[i]);
+        sum += data[i];
+    }
+    fprintf(f, "%02X\n", (uint8_t)-sum);
+}
+
+/** Writes count hex files of random data and random sizes up to twice kb
+ */
+static int generate(const char *dir, uint32_t count, uint32_t kb)
+{
+    mkdir(dir, 0755);
+    srand(1);
+    std::vector<uint8_t> data;
+    for (uint32_t i = 0; i < count; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%05lu.hex", dir, (unsigned long)i);
+        FILE *f = fopen(path, "w");
+        if (!f) {
+            perror(path);
+            return -1;
+        }
+        data.resize(1 + rand() % (kb * 2048));
+        for (size_t j = 0; j < data.size(); j++) {
+            data[j] = rand();
+        }
+        uint32_t addr = 0x08000000 + (rand() % 64) * 1024;
+        for (size_t j = 0; j < data.size(); j += 16) {
+            uint32_t a = addr + j;
+            if (!j || !(a & 0xffff)) {
+                uint8_t seg[2] = {(uint8_t)(a >> 24), (uint8_t)(a >> 16)};
+                put_record(f, EXT_LINEAR_ADDR_RECORD, 0, seg, 2);
+            }
+            put_record(f, DATA_RECORD, a, &data[j], ((data.size() - j) < 16) ? (data.size() - j) : 16);
+        }
+        put_record(f, EOF_RECORD, 0, 0, 0);
+        fclose(f);
+    }
+    return 0;
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s convert [-q depth] [-p] <in_dir> <out_dir>\n"
+            "       %s bench [-q depth] <in_dir> <out_dir>\n"
+            "       %s gen <dir> <count> [kb]\n", name, name, name);
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+    if (!strcmp(argv[1], "gen")) {
+        if ((argc < 4) || (argc > 5)) {
+            return usage(argv[0]);
+        }
+        uint32_t kb = (argc > 4) ? strtoul(argv[4], 0, 0) : 4;
+        if (!kb) {
+            return usage(argv[0]);
+        }
+        return generate(argv[2], strtoul(argv[3], 0, 0), kb) ? 1 : 0;
+    }
+    int bench = !strcmp(argv[1], "bench");
+    if (!bench && strcmp(argv[1], "convert")) {
+        return usage(argv[0]);
+    }
+    uint32_t depth = QUEUE_DEPTH;
+    int plain = 0;
+    int i = 2;
+    for (; (i < argc) && ('-' == argv[i][0]); i++) {
+        if ((i + 1 < argc) && !strcmp(argv[i], "-q")) {
+            depth = strtoul(argv[++i], 0, 0);
+            if (!depth || (depth > 4096)) {
+                return usage(argv[0]);
+            }
+        } else if (!bench && !strcmp(argv[i], "-p")) {
+            plain = 1;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if ((i + 2) != argc) {
+        return usage(argv[0]);
+    }
+    const char *in_dir = argv[i];
+    const char *out_dir = argv[i + 1];
+    mkdir(out_dir, 0755);
+
+    std::vector<batch_file_t> files;
+    if (list_files(in_dir, out_dir, files)) {
+        perror(in_dir);
+        return 1;
+    }
+    batch_result_t r;
+    if (!bench) {
+        if (convert(files, plain, depth, r)) {
+            perror("io_uring");
+            return 1;
+        }
+        for (size_t j = 0; j < files.size(); j++) {
+            if (files[j].error) {
+                fprintf(stderr, "%s: %s\n", (files[j].out_error ? files[j].out : files[j].in).c_str(), files[j].error);
+            }
+        }
+        print_header();
+        print_result(plain ? "plain" : "io_uring", files, r);
+        return r.failed ? 1 : 0;
+    }
+
+    // the quickest of RUNS for each, the binaries of the last runs compared
+    std::vector<batch_file_t> best[2];
+    batch_result_t best_r[2];
+    for (int mode = 0; mode < 2; mode++) {
+        for (int run = 0; run < RUNS; run++) {
+            if (convert(files, !mode, depth, r)) {
+                perror("io_uring");
+                return 1;
+            }
+            if (!run || (r.us < best_r[mode].us)) {
+                best[mode] = files;
+                best_r[mode] = r;
+            }
+        }
+    }
+    int same = 1;
+    for (size_t j = 0; j < files.size(); j++) {
+        same &= (best[0][j].hash == best[1][j].hash) && (!best[0][j].error == !best[1][j].error);
+    }
+    print_header();
+    print_result("plain", best[0], best_r[0]);
+    char name[32];
+    snprintf(name, sizeof(name), "io_uring/%lu", (unsigned long)depth);
+    print_result(name, best[1], best_r[1]);
+    printf("%s\n", same ? "binaries agree" : "binaries DIFFER");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,666 @@
+/* Converts Intel HEX to binary and back on Linux, with HexPushParser doing
+ * the decoding the same as on the target.
+ *
+ * A file is mmapped with MADV_SEQUENTIAL and fed to the parser in slices,
+ * each slice dropped from the mapping once it is parsed so the memory used
+ * stays the same however big the file. "-" reads stdin or writes stdout, a
+ * pipe is read in 64 KB chunks. Output is gathered into 64 KB writes.
+ *
+ * hex2bin writes the binary from the lowest address, the first data record
+ * or -o, so an image linked at 0x08000000 does not start with 128 MB of
+ * nothing. Gaps between records are 0xff like everywhere else here, with -s
+ * they are left as holes in a sparse file instead (which read as zeros).
+ * Records may come in any order into a file, into a pipe they have to be in
+ * address order. -d prints the CRC-32 and SHA-256 of the binary, kept as it
+ * is written so nothing is read back, when the records are in address order.
+ *
+ * bin2hex writes records of 16 bytes (-r for up to 255) from address 0 (or
+ * -a), with extended linear address records at every 64 KB.
+ *
+ * -j runs reading, converting and writing on three threads, so the disk or
+ * the pipe at either end works while the conversion does. A reader thread
+ * read()s the input into CHUNKS buffers of CHUNK_SIZE and a writer thread
+ * writes OUT_BUFFERS buffers of BUF_SIZE. The buffers go round between the
+ * threads through SpscQueues and are used again, nothing is allocated once
+ * it runs.
+ *
+ * Build from the project root:
+ *   g++ -O2 -pthread -I. -Ihost -o hexconv host/hexconv.cpp crc32.cpp sha256.cpp
+ *
+ * Usage:
+ *   hexconv hex2bin [-j] [-s] [-d] [-o origin] <in.hex|-> <out.bin|->
+ *   hexconv bin2hex [-j] [-a address] [-r record_size] <in.bin|-> <out.hex|->
+ *
+ * host/hexconv_bench.cpp times it against other converters.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <thread>
+#include "crc32.h"
+#include "hex_push_parser.h"
+#include "hex_image.h"
+#include "sha256.h"
+#include "spsc_queue.h"
+
+#define BUF_SIZE    (64 * 1024)
+// mapped input parsed between dropping pages
+#define SLICE_SIZE  (1024 * 1024)
+// buffers going round the reader and the writer thread with -j
+#define CHUNK_SIZE  (256 * 1024)
+#define CHUNKS      8
+// how often a reader waiting on a pipe looks for a stop, in ms
+#define STOP_POLL   100
+#define OUT_BUFFERS 8
+
+typedef struct {
+    uint8_t *data;
+    uint64_t off;       // where it is written
+    uint32_t size;
+    int status;         // from the reader, 1 more to come, 0 the end or -errno
+} chunk_t;
+
+/** Gathers what is written into large writes, pwrite() at the offset into a
+ *  file, write() in order into anything else. The writes can be left to a
+ *  thread of their own
+ */
+class Output {
+
+public:
+    Output(int fd) : _fd(fd), _off(0), _len(0), _end(0), _error(0), _buf(_own), _buffers(0) {
+        struct stat st;
+        _seekable = !fstat(fd, &st) && S_ISREG(st.st_mode);
+    }
+
+    ~Output() {
+        delete[] _buffers;
+    }
+
+    /** Write from a thread of its own from now on, the buffers filled here
+     *   queue for it up to OUT_BUFFERS deep
+     */
+    void start_writer() {
+        _buffers = new uint8_t[OUT_BUFFERS * BUF_SIZE];
+        for (uint32_t i = 1; i < OUT_BUFFERS; i++) {
+            chunk_t c = {&_buffers[i * BUF_SIZE], 0, 0, 0};
+            _free.put(c);
+        }
+        _buf = _buffers;
+        _writer = std::thread(&Output::writer, this);
+    }
+
+    /** Write at an offset, which must be the end so far unless the output is seekable
+     *  @return 0 on success, -1 on an error
+     */
+    int put(uint64_t off, const uint8_t *data, uint32_t size) {
+        if (_buffers && (size > BUF_SIZE)) {
+            // the writer thread has the only file position, everything goes through it
+            for (uint32_t n = BUF_SIZE; size; off += n, data += n, size -= n) {
+                n = (size < BUF_SIZE) ? size : BUF_SIZE;
+                if (put(off, data, n)) {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+        if (_len && ((off != (_off + _len)) || ((_len + size) > BUF_SIZE))) {
+            flush();
+        }
+        if (!_seekable && (off != _end)) {
+            _error = ESPIPE;
+            return -1;
+        }
+        if (!_len) {
+            _off = off;
+        }
+        if (size > BUF_SIZE) {
+            emit(off, data, size);
+        } else {
+            memcpy(&_buf[_len], data, size);
+            _len += size;
+        }
+        if ((off + size) > _end) {
+            _end = off + size;
+        }
+        return _error ? -1 : 0;
+    }
+
+    /** Write count bytes of the same value at an offset
+     */
+    int fill(uint64_t off, uint8_t value, uint64_t count) {
+        uint8_t block[4096];
+        memset(block, value, sizeof(block));
+        while (count && !_error) {
+            uint32_t n = (count < sizeof(block)) ? (uint32_t)count : (uint32_t)sizeof(block);
+            put(off, block, n);
+            off += n;
+            count -= n;
+        }
+        return _error ? -1 : 0;
+    }
+
+    int flush() {
+        if (_len && _buffers) {
+            chunk_t c = {_buf, _off, _len, 1};
+            _full.put(c);
+            _buf = _free.get().data;
+        } else if (_len) {
+            emit(_off, _buf, _len);
+        }
+        _len = 0;
+        return _error ? -1 : 0;
+    }
+
+    /** Finish the output, a sparse file is extended to the end of the last write
+     */
+    int close() {
+        flush();
+        if (_writer.joinable()) {
+            chunk_t end = {0, 0, 0, 0};
+            _full.put(end);
+            _writer.join();
+        }
+        if (!_error && _seekable && ftruncate(_fd, _end)) {
+            _error = errno;
+        }
+        return _error ? -1 : 0;
+    }
+
+    int seekable() const {
+        return _seekable;
+    }
+
+    uint64_t end() const {
+        return _end;
+    }
+
+    int error() const {
+        return _error;
+    }
+
+private:
+    void writer() {
+        for (chunk_t c = _full.get(); c.data; c = _full.get()) {
+            emit(c.off, c.data, c.size);
+            _free.put(c);
+        }
+    }
+
+    void emit(uint64_t off, const uint8_t *data, uint32_t size) {
+        while (size && !_error) {
+            ssize_t n = _seekable ? pwrite(_fd, data, size, off) : write(_fd, data, size);
+            if (n < 0) {
+                if (EINTR != errno) {
+                    _error = errno;
+                }
+                continue;
+            }
+            data += n;
+            off += n;
+            size -= n;
+        }
+    }
+
+    int _fd;
+    int _seekable;
+    uint64_t _off;
+    uint32_t _len;
+    uint64_t _end;
+    std::atomic<int> _error;
+    // the buffer being filled, _own or one of _buffers with a writer thread
+    uint8_t *_buf;
+    uint8_t *_buffers;
+    std::thread _writer;
+    SpscQueue<chunk_t, OUT_BUFFERS> _full;
+    SpscQueue<chunk_t, OUT_BUFFERS> _free;
+    uint8_t _own[BUF_SIZE];
+};
+
+/** Hands a file to a sink in pieces, a mapping of the whole file when it can
+ *  be mapped, otherwise what read() gives
+ *  @return 0 when all of it was taken, 1 if the sink stopped, -1 on an error
+ */
+template <typename Sink>
+static int read_input(int fd, Sink &sink)
+{
+    struct stat st;
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size) {
+        uint8_t *map = (uint8_t *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED != map) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            int ret = 0;
+            for (off_t pos = 0; !ret && (pos < st.st_size); pos += SLICE_SIZE) {
+                uint32_t n = ((st.st_size - pos) < SLICE_SIZE) ? (uint32_t)(st.st_size - pos) : SLICE_SIZE;
+                ret = sink.chunk(&map[pos], n);
+                // parsed, the pages are not needed again
+                madvise(&map[pos], n, MADV_DONTNEED);
+            }
+            munmap(map, st.st_size);
+            return ret;
+        }
+    }
+    static uint8_t buf[BUF_SIZE];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return -1;
+        }
+        if (!n) {
+            return 0;
+        }
+        int ret = sink.chunk(buf, n);
+        if (ret) {
+            return ret;
+        }
+    }
+}
+
+/** The buffers and queues between the reader thread and the sink
+ */
+typedef struct {
+    int fd;
+    std::atomic<int> stop;
+    SpscQueue<chunk_t, CHUNKS> full;
+    SpscQueue<chunk_t, CHUNKS> free;
+    uint8_t data[CHUNKS][CHUNK_SIZE];
+} reader_t;
+
+static void reader_thread(reader_t *r)
+{
+    struct pollfd p = {r->fd, POLLIN, 0};
+    for (int status = 1; 1 == status;) {
+        chunk_t c = r->free.get();
+        c.size = 0;
+        c.status = 1;
+        // fill it, a pipe gives what it has at a time
+        while ((c.size < CHUNK_SIZE) && (1 == c.status)) {
+            // a file is always ready, a pipe is waited on a while at a time
+            if (!r->stop && (poll(&p, 1, STOP_POLL) <= 0)) {
+                continue;
+            }
+            ssize_t n = r->stop ? 0 : read(r->fd, &c.data[c.size], CHUNK_SIZE - c.size);
+            if (n > 0) {
+                c.size += n;
+            } else if (!n) {
+                c.status = 0;
+            } else if (EINTR != errno) {
+                c.status = -errno;
+            }
+        }
+        status = c.status;
+        r->full.put(c);
+    }
+}
+
+/** Hands the input to a sink the same as read_input(), read ahead on a
+ *  thread of its own into CHUNKS buffers
+ */
+template <typename Sink>
+static int read_input_threaded(int fd, Sink &sink)
+{
+    reader_t *r = new reader_t;
+    r->fd = fd;
+    r->stop = 0;
+    for (uint32_t i = 0; i < CHUNKS; i++) {
+        chunk_t c = {r->data[i], 0, 0, 1};
+        r->free.put(c);
+    }
+    std::thread reader(reader_thread, r);
+    int ret = 0;
+    for (;;) {
+        chunk_t c = r->full.get();
+        if (c.size) {
+            ret = sink.chunk(c.data, c.size);
+        }
+        if (ret) {
+            // the reader ends at its next chunk, take back what it filled
+            r->stop = 1;
+            while (c.status > 0) {
+                r->free.put(c);
+                c = r->full.get();
+            }
+            reader.join();
+            delete r;
+            return ret;
+        }
+        r->free.put(c);
+        if (c.status <= 0) {
+            reader.join();
+            delete r;
+            errno = -c.status;
+            return c.status ? -1 : 0;
+        }
+    }
+}
+
+/** HexPushParser handler that writes the data at its offset from the origin
+ */
+class BinWriter : public HexHandler {
+
+public:
+    BinWriter(Output &out, int sparse, int have_origin, uint32_t origin) :
+        _out(out), _sparse(sparse), _have_origin(have_origin), _origin(origin), _error(0),
+        _digest(0), _ordered(1), _crc(0) {
+        sha256_init(&_sha);
+    }
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (!_have_origin) {
+            _origin = addr;
+            _have_origin = 1;
+        }
+        if (addr < _origin) {
+            _error = "a record below the origin, give a lower one with -o";
+            return 1;
+        }
+        uint64_t off = addr - _origin;
+        if (!_out.seekable() && (off < _out.end())) {
+            _error = "records out of address order, write to a file";
+            return 1;
+        }
+        if ((off > _out.end()) && !(_sparse && _out.seekable()) && _out.fill(_out.end(), 0xff, off - _out.end())) {
+            return 1;
+        }
+        if (_digest) {
+            add_digest(off, data, size);
+        }
+        return _out.put(off, data, size) ? 1 : 0;
+    }
+    const char *error() const {
+        return _error;
+    }
+
+    /** Keep the CRC-32 and SHA-256 of the binary
+     */
+    void digest() {
+        _digest = 1;
+    }
+
+    /** Print the digests, or why there are none
+     *  @param name is the output for messages
+     */
+    void print_digest(const char *name) {
+        if (!_ordered) {
+            fprintf(stderr, "%s: records out of address order, no digest\n", name);
+            return;
+        }
+        uint8_t hash[SHA256_SIZE];
+        sha256_final(&_sha, hash);
+        fprintf(stderr, "crc32 %08lx sha256 ", (unsigned long)_crc);
+        for (int i = 0; i < SHA256_SIZE; i++) {
+            fprintf(stderr, "%02x", hash[i]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+private:
+    void add_digest(uint64_t off, const uint8_t *data, uint32_t size) {
+        uint64_t end = _sha.count;
+        if (off < end) {
+            _ordered = 0;
+        }
+        if (!_ordered) {
+            return;
+        }
+        // holes in a sparse file read as zeros
+        uint8_t fill = (_sparse && _out.seekable()) ? 0 : 0xff;
+        _crc = crc32_fill(_crc, fill, off - end);
+        sha256_fill(&_sha, fill, off - end);
+        _crc = crc32_update(_crc, data, size);
+        sha256_update(&_sha, data, size);
+    }
+
+    Output &_out;
+    int _sparse;
+    int _have_origin;
+    uint32_t _origin;
+    const char *_error;
+    int _digest;
+    int _ordered;
+    uint32_t _crc;
+    sha256_t _sha;
+};
+
+/** Feeds pieces of the hex to the parser
+ */
+class HexFeeder {
+
+public:
+    HexFeeder(HexPushParser<BinWriter> &parser) : status(HEX_PARSE_OK), _parser(parser) {
+    }
+
+    int chunk(const uint8_t *data, uint32_t size) {
+        status = _parser.feed(data, size);
+        return (HEX_PARSE_OK == status) ? 0 : 1;
+    }
+
+    hex_parse_status_t status;
+
+private:
+    HexPushParser<BinWriter> &_parser;
+};
+
+/** Turns pieces of a binary into records
+ */
+class HexWriter {
+
+public:
+    HexWriter(Output &out, uint32_t addr, uint32_t record) :
+        _out(out), _addr(addr), _record(record), _upper(0), _len(0), _pos(0), _overflow(0) {
+    }
+
+    int chunk(const uint8_t *data, uint32_t size) {
+        while (size) {
+            // a record does not cross a 64 KB boundary
+            uint32_t room = _record - _len;
+            uint32_t to_boundary = 0x10000 - ((_addr + _len) & 0xffff);
+            room = (room < to_boundary) ? room : to_boundary;
+            uint32_t n = (size < room) ? size : room;
+            memcpy(&_data[_len], data, n);
+            _len += n;
+            data += n;
+            size -= n;
+            if ((_len == _record) || (n == to_boundary)) {
+                if (emit()) {
+                    return -1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    /** Write what is left and the end of file record
+     */
+    int finish() {
+        if (emit()) {
+            return -1;
+        }
+        static const uint8_t eof[] = ":00000001FF\n";
+        return _out.put(_pos, eof, sizeof(eof) - 1);
+    }
+
+private:
+    int emit() {
+        if (!_len) {
+            return 0;
+        }
+        if (_overflow) {
+            return -1;
+        }
+        if ((_addr >> 16) != _upper) {
+            _upper = _addr >> 16;
+            uint8_t ext[2] = {(uint8_t)(_upper >> 8), (uint8_t)_upper};
+            if (line(EXT_LINEAR_ADDR_RECORD, 0, ext, 2)) {
+                return -1;
+            }
+        }
+        if (line(DATA_RECORD, _addr & 0xffff, _data, _len)) {
+            return -1;
+        }
+        // past the top of the 32 bit address space only if there is more
+        _overflow = ((_addr + _len) <= _addr);
+        _addr += _len;
+        _len = 0;
+        return 0;
+    }
+
+    int line(hex_record_t type, uint16_t offset, const uint8_t *data, uint32_t size) {
+        static const char digits[] = "0123456789ABCDEF";
+        uint8_t text[11 + 255 * 2 + 1];
+        uint8_t *p = text;
+        uint8_t sum = size + (offset >> 8) + offset + type;
+        *p++ = ':';
+        uint8_t head[4] = {(uint8_t)size, (uint8_t)(offset >> 8), (uint8_t)offset, (uint8_t)type};
+        for (uint32_t i = 0; i < 4; i++) {
+            *p++ = digits[head[i] >> 4];
+            *p++ = digits[head[i] & 0xf];
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            sum += data[i];
+            *p++ = digits[data[i] >> 4];
+            *p++ = digits[data[i] & 0xf];
+        }
+        sum = -sum;
+        *p++ = digits[sum >> 4];
+        *p++ = digits[sum & 0xf];
+        *p++ = '\n';
+        uint32_t n = p - text;
+        int ret = _out.put(_pos, text, n);
+        _pos += n;
+        return ret;
+    }
+
+    Output &_out;
+    uint32_t _addr;
+    uint32_t _record;
+    uint32_t _upper;
+    uint32_t _len;
+    uint64_t _pos;
+    int _overflow;
+    uint8_t _data[255];
+};
+
+static int open_in(const char *path)
+{
+    return strcmp(path, "-") ? open(path, O_RDONLY) : 0;
+}
+
+static int open_out(const char *path)
+{
+    return strcmp(path, "-") ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : 1;
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s hex2bin [-j] [-s] [-d] [-o origin] <in.hex|-> <out.bin|->\n"
+            "       %s bin2hex [-j] [-a address] [-r record_size] <in.bin|-> <out.hex|->\n", name, name);
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+    int hex2bin = !strcmp(argv[1], "hex2bin");
+    if (!hex2bin && strcmp(argv[1], "bin2hex")) {
+        return usage(argv[0]);
+    }
+    int sparse = 0;
+    int digest = 0;
+    int threads = 0;
+    int have_origin = 0;
+    uint32_t origin = 0;
+    uint32_t record = 16;
+    int i = 2;
+    for (; (i < argc) && ('-' == argv[i][0]) && argv[i][1]; i++) {
+        if (hex2bin && !strcmp(argv[i], "-s")) {
+            sparse = 1;
+        } else if (hex2bin && !strcmp(argv[i], "-d")) {
+            digest = 1;
+        } else if (!strcmp(argv[i], "-j")) {
+            threads = 1;
+        } else if ((i + 1 < argc) && ((hex2bin && !strcmp(argv[i], "-o")) || (!hex2bin && !strcmp(argv[i], "-a")))) {
+            origin = strtoul(argv[++i], 0, 0);
+            have_origin = 1;
+        } else if ((i + 1 < argc) && !hex2bin && !strcmp(argv[i], "-r")) {
+            record = strtoul(argv[++i], 0, 0);
+            if (!record || (record > 255)) {
+                return usage(argv[0]);
+            }
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if ((i + 2) != argc) {
+        return usage(argv[0]);
+    }
+    int in = open_in(argv[i]);
+    if (in < 0) {
+        perror(argv[i]);
+        return 1;
+    }
+    int fd = open_out(argv[i + 1]);
+    if (fd < 0) {
+        perror(argv[i + 1]);
+        return 1;
+    }
+    // the 64 KB output buffer does not go on the stack
+    Output *out = new Output(fd);
+    if (threads) {
+        out->start_writer();
+    }
+    int ret = 0;
+    if (hex2bin) {
+        BinWriter bin(*out, sparse, have_origin, origin);
+        if (digest) {
+            bin.digest();
+        }
+        HexPushParser<BinWriter> parser(bin);
+        HexFeeder feeder(parser);
+        int r = threads ? read_input_threaded(in, feeder) : read_input(in, feeder);
+        if (r < 0) {
+            perror(argv[i]);
+            ret = 1;
+        } else if (bin.error()) {
+            fprintf(stderr, "%s: %s\n", argv[i], bin.error());
+            ret = 1;
+        } else if (HEX_PARSE_REJECTED == feeder.status) {
+            fprintf(stderr, "%s: %s\n", argv[i + 1], strerror(out->error()));
+            ret = 1;
+        } else if ((HEX_PARSE_OK != feeder.status) && (HEX_PARSE_EOF != feeder.status)) {
+            fprintf(stderr, "%s: %s at byte %llu\n", argv[i], (HEX_PARSE_WRAP == feeder.status) ? "data past the top of the address space" : "bad record",
+                    (unsigned long long)parser.record_offset());
+            ret = 1;
+        } else if (!bin.eof) {
+            fprintf(stderr, "%s: no end of file record\n", argv[i]);
+        }
+        if (digest && !ret) {
+            bin.print_digest(argv[i + 1]);
+        }
+    } else {
+        HexWriter hex(*out, origin, record);
+        if ((threads ? read_input_threaded(in, hex) : read_input(in, hex)) || hex.finish()) {
+            fprintf(stderr, "%s: %s\n", argv[i], out->error() ? strerror(out->error()) : "past the end of the 32 bit address space");
+            ret = 1;
+        }
+    }
+    if (out->close() && !ret) {
+        fprintf(stderr, "%s: %s\n", argv[i + 1], strerror(out->error()));
+        ret = 1;
+    }
+    delete out;
+    close(fd);
+    close(in);
+    return ret;
+}
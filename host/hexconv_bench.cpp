@@ -0,0 +1,174 @@
+/* Times hexconv hex2bin against the converters people usually have, over
+ * the test images and a synthetic image of random data linked at
+ * 0x08000000. Each converter runs RUNS times as its own process and counts
+ * with its quickest run, the peak resident memory comes from wait4(). The
+ * outputs are compared with hexconv's, objcopy is asked to fill the gaps
+ * with 0xff so it writes the same binary. Converters that are not installed
+ * are left out.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o hexconv_bench host/hexconv_bench.cpp
+ *   g++ -O2 -pthread -I. -Ihost -o hexconv host/hexconv.cpp crc32.cpp sha256.cpp
+ *
+ * Usage:
+ *   hexconv_bench <path/to/hexconv> [synthetic_mb] [image.hex]...
+ *
+ * Without images it uses the hex files in test/, run it from the project root.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include "host_clock.h"
+
+#define RUNS    5
+#define DIR     "/tmp/hexconv_bench"
+
+typedef struct {
+    uint32_t us;        // quickest run
+    long rss_kb;        // most resident memory of any run
+    int status;         // exit status of the last run, 127 when not installed
+} run_result_t;
+
+static run_result_t run(const std::string &cmd)
+{
+    run_result_t r = {0xffffffff, 0, 0};
+    for (int i = 0; i < RUNS; i++) {
+        uint32_t t = host_us();
+        pid_t pid = fork();
+        if (!pid) {
+            execl("/bin/sh", "sh", "-c", cmd.c_str(), (char *)0);
+            _exit(127);
+        }
+        int status = 0;
+        struct rusage ru;
+        memset(&ru, 0, sizeof(ru));
+        wait4(pid, &status, 0, &ru);
+        uint32_t us = host_us() - t;
+        r.us = (us < r.us) ? us : r.us;
+        r.rss_kb = (ru.ru_maxrss > r.rss_kb) ? ru.ru_maxrss : r.rss_kb;
+        r.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+        if (r.status) {
+            break;
+        }
+    }
+    return r;
+}
+
+static int same_file(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int same = fa && fb;
+    static uint8_t ba[65536], bb[65536];
+    while (same) {
+        size_t na = fread(ba, 1, sizeof(ba), fa);
+        size_t nb = fread(bb, 1, sizeof(bb), fb);
+        same = (na == nb) && !memcmp(ba, bb, na);
+        if (!na) {
+            break;
+        }
+    }
+    if (fa) {
+        fclose(fa);
+    }
+    if (fb) {
+        fclose(fb);
+    }
+    return same;
+}
+
+static int installed(const char *tool)
+{
+    std::string cmd = std::string("command -v ") + tool + " >/dev/null 2>&1";
+    return !system(cmd.c_str());
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) ? 0 : st.st_size;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <path/to/hexconv> [synthetic_mb] [image.hex]...\n", argv[0]);
+        return 2;
+    }
+    std::string hexconv = argv[1];
+    uint32_t mb = (argc > 2) ? strtoul(argv[2], 0, 0) : 32;
+    mkdir(DIR, 0755);
+
+    std::vector<std::string> inputs;
+    for (int i = 3; i < argc; i++) {
+        inputs.push_back(argv[i]);
+    }
+    if (inputs.empty()) {
+        const char *test[] = {"test/testapp.hex", "test/test_app_fast.hex", "test/test_app_slow.hex", "test/mbed.hex"};
+        inputs.assign(test, test + 4);
+    }
+    if (mb) {
+        char cmd[256];
+        snprintf(cmd, sizeof(cmd), "head -c %lu /dev/urandom > " DIR "/synthetic.bin && %s bin2hex -a 0x08000000 " DIR "/synthetic.bin " DIR "/synthetic.hex",
+                 (unsigned long)mb << 20, hexconv.c_str());
+        if (system(cmd)) {
+            fprintf(stderr, "can not make the synthetic image\n");
+            return 1;
+        }
+        inputs.push_back(DIR "/synthetic.hex");
+    }
+
+    int have_objcopy = installed("objcopy");
+    int have_srec_cat = installed("srec_cat");
+    printf("%-24s %9s %-22s %9s %8s %9s %s\n", "input", "hex KB", "converter", "ms", "MB/s", "peak KB", "output");
+    int ok = 1;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const std::string &in = inputs[i];
+        std::string ref = DIR "/hexconv.bin";
+        std::vector<std::string> names, cmds, outs;
+        names.push_back("hexconv");
+        cmds.push_back(hexconv + " hex2bin " + in + " " + ref);
+        outs.push_back(ref);
+        names.push_back("hexconv, sparse");
+        cmds.push_back(hexconv + " hex2bin -s " + in + " " DIR "/sparse.bin");
+        outs.push_back("");
+        names.push_back("hexconv, pipe");
+        cmds.push_back("cat " + in + " | " + hexconv + " hex2bin - - > " DIR "/pipe.bin");
+        outs.push_back(DIR "/pipe.bin");
+        names.push_back("hexconv -j");
+        cmds.push_back(hexconv + " hex2bin -j " + in + " " DIR "/threads.bin");
+        outs.push_back(DIR "/threads.bin");
+        names.push_back("hexconv -j, pipe");
+        cmds.push_back("cat " + in + " | " + hexconv + " hex2bin -j - - > " DIR "/threads_pipe.bin");
+        outs.push_back(DIR "/threads_pipe.bin");
+        if (have_objcopy) {
+            names.push_back("objcopy");
+            cmds.push_back("objcopy -I ihex -O binary --gap-fill 0xff " + in + " " DIR "/objcopy.bin");
+            outs.push_back(DIR "/objcopy.bin");
+        }
+        if (have_srec_cat) {
+            names.push_back("srec_cat");
+            cmds.push_back("srec_cat " + in + " -Intel -fill 0xff -over " + in + " -Intel -offset - -minimum-addr " + in + " -Intel -o " DIR "/srec_cat.bin -Binary");
+            outs.push_back(DIR "/srec_cat.bin");
+        }
+        double kb = file_size(in.c_str()) / 1024.0;
+        const char *base = strrchr(in.c_str(), '/');
+        for (size_t t = 0; t < cmds.size(); t++) {
+            run_result_t r = run(cmds[t]);
+            const char *result = r.status ? "failed" : "";
+            if (!r.status && !outs[t].empty() && (t > 0)) {
+                result = same_file(outs[t].c_str(), ref.c_str()) ? "same" : "differs";
+            }
+            ok &= !r.status || (t > 4);
+            printf("%-24s %9.0f %-22s %9.2f %8.1f %9ld %s\n", base ? base + 1 : in.c_str(), kb, names[t].c_str(),
+                   r.us / 1000.0, kb / 1024.0 * 1e6 / (r.us ? r.us : 1), r.rss_kb, result);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/* Streams a synthetic hex file of several GB through hexconv hex2bin, from
+ * a pipe into a pipe, so nothing of it ever sits on disk. The hex is 64 KB
+ * segments of 16 byte records, each behind its extended linear address
+ * record, laid out so the last segment ends at 0xffff0000. Every
+ * byte that comes out is checked. The file then ends with a record at
+ * 0xfffffff8 that runs past the top of the address space, which hexconv
+ * must refuse, naming the 64 bit byte offset where the record starts.
+ * Prints the throughput and hexconv's peak resident memory, which should
+ * not grow with the size of the input.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o hexconv_stream host/hexconv_stream.cpp
+ *   g++ -O2 -pthread -I. -Ihost -o hexconv host/hexconv.cpp crc32.cpp sha256.cpp
+ *
+ * Usage:
+ *   hexconv_stream <path/to/hexconv> [hex_gb] [hex2bin option]...
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include "host_clock.h"
+
+#define SEGMENT     0x10000
+#define RECORD      16
+
+static char hex_digit(uint8_t v)
+{
+    return "0123456789ABCDEF"[v & 0xf];
+}
+
+static void put_record(std::string &s, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t size)
+{
+    uint8_t sum = size + (offset >> 8) + offset + type;
+    char head[10] = {':', hex_digit(size >> 4), hex_digit(size), hex_digit(offset >> 12), hex_digit(offset >> 8),
+                     hex_digit(offset >> 4), hex_digit(offset), hex_digit(type >> 4), hex_digit(type), 0};
+    s += head;
+    for (uint8_t i = 0; i < size; i++) {
+        s += hex_digit(data[i] >> 4);
+        s += hex_digit(data[i]);
+        sum += data[i];
+    }
+    sum = -sum;
+    s += hex_digit(sum >> 4);
+    s += hex_digit(sum);
+    s += '\n';
+}
+
+static std::string segment_record(uint16_t segment)
+{
+    uint8_t d[2] = {(uint8_t)(segment >> 8), (uint8_t)segment};
+    std::string s;
+    put_record(s, 4, 0, d, 2);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <path/to/hexconv> [hex_gb] [hex2bin option]...\n", argv[0]);
+        return 2;
+    }
+    double gb = (argc > 2) ? strtod(argv[2], 0) : 8;
+
+    // one segment of data, the same in every segment, and its records
+    std::vector<uint8_t> data(SEGMENT);
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < SEGMENT; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+    std::string records;
+    for (uint32_t i = 0; i < SEGMENT; i += RECORD) {
+        put_record(records, 0, i, &data[i], RECORD);
+    }
+    uint64_t per_segment = segment_record(0).size() + records.size();
+    uint64_t segments = (uint64_t)(gb * (1 << 30)) / per_segment;
+    segments = (segments < 1) ? 1 : (segments > 0xfffe) ? 0xfffe : segments;
+    uint32_t first = 0xffff - segments;
+    uint8_t top[RECORD];
+    memset(top, 0x5a, sizeof(top));
+    std::string tail = segment_record(0xffff);
+    uint64_t wrap_at = segments * per_segment + tail.size();
+    put_record(tail, 0, 0xfff8, top, RECORD);
+    uint64_t hex_size = segments * per_segment + tail.size();
+
+    int to[2], from[2], err[2];
+    if (pipe(to) || pipe(from) || pipe(err)) {
+        perror("pipe");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    uint32_t t = host_us();
+    pid_t pid = fork();
+    if (!pid) {
+        dup2(to[0], 0);
+        dup2(from[1], 1);
+        dup2(err[1], 2);
+        close(to[1]);
+        close(from[0]);
+        close(err[0]);
+        std::vector<char *> args(argv + 1, argv + 2);
+        args.push_back((char *)"hex2bin");
+        for (int i = 3; i < argc; i++) {
+            args.push_back(argv[i]);
+        }
+        args.push_back((char *)"-");
+        args.push_back((char *)"-");
+        args.push_back(0);
+        execv(argv[1], &args[0]);
+        _exit(127);
+    }
+    close(to[0]);
+    close(from[1]);
+    close(err[1]);
+    fcntl(to[1], F_SETFL, O_NONBLOCK);
+
+    // feed the hex and check the binary as it comes, until hexconv is done
+    uint64_t out = 0;
+    uint64_t mismatch = ~0ULL;
+    uint64_t segment = 0;
+    std::string head = segment_record(first);
+    const std::string *piece = &head;
+    size_t sent = 0;
+    std::string message;
+    std::vector<uint8_t> buf(SEGMENT);
+    int open_fds = 3;
+    while (open_fds) {
+        struct pollfd p[3] = {{to[1], POLLOUT, 0}, {from[0], POLLIN, 0}, {err[0], POLLIN, 0}};
+        if (poll(p, 3, -1) < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            perror("poll");
+            return 1;
+        }
+        if (p[0].revents && (to[1] >= 0)) {
+            ssize_t n = write(to[1], piece->data() + sent, piece->size() - sent);
+            if ((n < 0) && (EAGAIN != errno)) {
+                // hexconv stopped reading, it gave up on the input
+                close(to[1]);
+                to[1] = -1;
+                open_fds--;
+            } else if (n > 0) {
+                sent += n;
+            }
+            if ((to[1] >= 0) && (sent == piece->size())) {
+                sent = 0;
+                if (piece == &head) {
+                    piece = &records;
+                } else if (piece == &records) {
+                    if (++segment < segments) {
+                        head = segment_record(first + segment);
+                        piece = &head;
+                    } else {
+                        piece = &tail;
+                    }
+                } else {
+                    close(to[1]);
+                    to[1] = -1;
+                    open_fds--;
+                }
+            }
+        }
+        if (p[1].revents && (from[0] >= 0)) {
+            ssize_t n = read(from[0], &buf[0], SEGMENT - (out % SEGMENT));
+            if (n <= 0) {
+                close(from[0]);
+                from[0] = -1;
+                open_fds--;
+            } else {
+                if ((~0ULL == mismatch) && memcmp(&buf[0], &data[out % SEGMENT], n)) {
+                    mismatch = out;
+                }
+                out += n;
+            }
+        }
+        if (p[2].revents && (err[0] >= 0)) {
+            char m[256];
+            ssize_t n = read(err[0], m, sizeof(m));
+            if (n <= 0) {
+                close(err[0]);
+                err[0] = -1;
+                open_fds--;
+            } else {
+                message.append(m, n);
+            }
+        }
+    }
+    int status = 0;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    wait4(pid, &status, 0, &ru);
+    uint32_t us = host_us() - t;
+
+    char expect[128];
+    snprintf(expect, sizeof(expect), "-: data past the top of the address space at byte %llu\n", (unsigned long long)wrap_at);
+    int exited = WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+    int ok = (~0ULL == mismatch) && (out == segments * SEGMENT) && (1 == exited) && (message == expect);
+    printf("%-24s %12llu bytes, %llu segments from 0x%04x0000\n", "hex in", (unsigned long long)hex_size,
+           (unsigned long long)segments, (unsigned)first);
+    printf("%-24s %12llu bytes%s\n", "binary out", (unsigned long long)out,
+           (~0ULL == mismatch) ? "" : ", MISMATCH");
+    printf("%-24s %12.2f s, %.1f MB/s of hex\n", "time", us / 1e6, hex_size / 1048576.0 * 1e6 / (us ? us : 1));
+    printf("%-24s %12ld KB\n", "hexconv peak RSS", ru.ru_maxrss);
+    printf("%-24s %s", "hexconv said", message.empty() ? "nothing\n" : message.c_str());
+    printf("%-24s %s", "expected", expect);
+    printf("%s\n", ok ? "pass" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/* Reads a hex image through HexFileSystem as /hex/image.bin: front to back
+ * in 4 KB reads, then at random offsets with lseek(), checking every byte
+ * against the reference. Prints the time and the cache hits for each, the
+ * RAM the file system takes and, for comparison, converting the whole hex
+ * into a binary in RAM. With an output path it also writes the binary out.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o hexfs_cat host/hexfs_cat.cpp hex_file_system.cpp hex_index.cpp
+ *
+ * Usage:
+ *   hexfs_cat <image.hex> <reference.bin> [out.bin]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "hex_file_system.h"
+#include "hex_push_parser.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define SEEKS   1000
+#define HIX     "/tmp/hexfs_cat.hix"
+
+static int check(const uint8_t *data, uint32_t pos, uint32_t size, const std::vector<uint8_t> &ref)
+{
+    for (uint32_t i = 0; i < size; i++) {
+        uint8_t expect = ((pos + i) < ref.size()) ? ref[pos + i] : 0xff;
+        if (data[i] != expect) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <reference.bin> [out.bin]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> ref;
+    if (read_file(argv[2], ref)) {
+        perror("fopen");
+        return 1;
+    }
+
+    remove(HIX);
+    HexFileSystem fs("hex", argv[1], HIX);
+    uint32_t t = host_us();
+    mbed::FileHandle *f = fs.open("image.bin", O_RDONLY);
+    if (!f) {
+        fprintf(stderr, "%s: can not open\n", argv[1]);
+        return 1;
+    }
+    printf("%-24s %9lu us, %lu bytes\n", "open, index built", (unsigned long)(host_us() - t), (unsigned long)f->flen());
+    int ok = !fs.open("image.bin", O_RDONLY) && !fs.open("other.bin", O_RDONLY);
+
+    FILE *out = (argc > 3) ? fopen(argv[3], "wb") : 0;
+    uint8_t buf[4096];
+    uint32_t pos = 0;
+    ssize_t n;
+    t = host_us();
+    while ((n = f->read(buf, sizeof(buf))) > 0) {
+        ok &= check(buf, pos, n, ref);
+        pos += n;
+        if (out) {
+            fwrite(buf, 1, n, out);
+        }
+    }
+    uint32_t us = host_us() - t;
+    if (out) {
+        fclose(out);
+    }
+    ok &= (n == 0) && (pos == (uint32_t)f->flen());
+    hex_file_system_stats_t s = fs.stats();
+    printf("%-24s %9lu us, %lu hits, %lu misses\n", "sequential 4 KB reads", (unsigned long)us, (unsigned long)s.hits, (unsigned long)s.misses);
+
+    srand(1);
+    uint32_t size = f->flen();
+    t = host_us();
+    for (int i = 0; i < SEEKS; i++) {
+        uint32_t at = (uint32_t)(((uint64_t)rand() * size) / ((uint64_t)RAND_MAX + 1));
+        uint32_t len = 1 + rand() % 600;
+        if (f->lseek(at, SEEK_SET) != (off_t)at) {
+            ok = 0;
+            continue;
+        }
+        n = f->read(buf, len);
+        ok &= (n >= 0) && check(buf, at, n, ref) && ((uint32_t)n == (((size - at) < len) ? (size - at) : len));
+    }
+    us = host_us() - t;
+    hex_file_system_stats_t r = fs.stats();
+    printf("%-24s %9lu us, %lu hits, %lu misses\n", "random seeks and reads", (unsigned long)us,
+           (unsigned long)(r.hits - s.hits), (unsigned long)(r.misses - s.misses));
+    ok &= (f->lseek(0, SEEK_END) == (off_t)size) && (f->read(buf, 1) == 0) && !f->close();
+
+    t = host_us();
+    FILE *in = fopen(argv[1], "rb");
+    ImageHandler bin;
+    HexPushParser<ImageHandler> parser(bin);
+    while (in && ((n = fread(buf, 1, sizeof(buf), in)) > 0) && (HEX_PARSE_OK == parser.feed(buf, n)));
+    if (in) {
+        fclose(in);
+    }
+    printf("%-24s %9lu us\n", "whole image converted", (unsigned long)(host_us() - t));
+    printf("%-24s %9lu bytes, against %lu for the whole binary\n", "RAM", (unsigned long)sizeof(fs), (unsigned long)bin.image.size());
+    printf("%s\n", ok ? "match" : "MISMATCH");
+    remove(HIX);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,627 @@
+/* Decodes, verifies, hashes and packs a batch of hex images on every core,
+ * scheduled two ways, and compares how long the batch takes and how busy
+ * the threads were.
+ *
+ * "thread per file" deals the images out to the threads in turn, each
+ * thread takes its images from start to finish on its own. "work stealing"
+ * runs the same steps as WorkPool tasks: an image over CHUNK_SIZE of hex is
+ * decoded as chunks in parallel, each chunk started from the address record
+ * ahead of it, and merged, verify waits for the decode, hash and pack wait
+ * for verify, and a large binary is packed in parts. Idle threads steal
+ * whatever is queued, so one big image does not leave the rest of the
+ * threads with nothing to do.
+ *
+ * Verify compares the binary with the .bin next to the hex, when there is
+ * one, with a missing tail taken as 0xff. The hash is the CRC-32 of the
+ * binary, each chunk keeps the CRC of what it decodes and the merge puts
+ * them together with crc32_combine(), so hash only reads the binary again
+ * for an image whose records go backwards. Pack is block_compress() over
+ * PACK_BLOCK blocks, as frames are sent. The batch is the images given, or
+ * the hex files in test/, times -r, and two images of -b MB (default 16),
+ * all read into RAM first so the disk plays no part.
+ *
+ * Build from the project root:
+ *   g++ -O2 -pthread -I. -Ihost -o hexpool host/hexpool.cpp block_codec.cpp crc32.cpp
+ *
+ * Usage:
+ *   hexpool [-t threads] [-r repeat] [-b big_mb] [image.hex]...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "block_codec.h"
+#include "crc32.h"
+#include "hex_push_parser.h"
+#include "hex_image.h"
+#include "work_pool.h"
+
+// hex text decoded by one task
+#define CHUNK_SIZE  (256 * 1024)
+#define PACK_BLOCK  4096
+// binary packed by one task
+#define PACK_PART   (64 * PACK_BLOCK)
+#define BIG_IMAGES  2
+#define RUNS        3
+
+typedef struct {
+    uint32_t addr;
+    uint32_t offset;    // into the piece's data
+    uint32_t size;
+} run_t;
+
+/** What one chunk of hex decoded to, runs of contiguous data in the order
+ *  the records came, and the CRC-32 of them from the first address with
+ *  0xff between
+ */
+class Piece : public HexHandler {
+
+public:
+    Piece() : status(HEX_PARSE_OK), ordered(1), crc(0), end(0) {
+    }
+
+    int on_data(uint32_t addr, const uint8_t *bytes, uint32_t size) {
+        if (!runs.empty() && (addr < end)) {
+            ordered = 0;
+        }
+        if (ordered && !runs.empty()) {
+            crc = crc32_fill(crc, 0xff, addr - end);
+        }
+        if (ordered) {
+            crc = crc32_update(crc, bytes, size);
+            end = (uint64_t)addr + size;
+        }
+        if (runs.empty() || ((runs.back().addr + runs.back().size) != addr)) {
+            run_t r = {addr, (uint32_t)data.size(), 0};
+            runs.push_back(r);
+        }
+        data.insert(data.end(), bytes, bytes + size);
+        runs.back().size += size;
+        return 0;
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<run_t> runs;
+    hex_parse_status_t status;
+    int ordered;        // crc covers the runs, none went backwards
+    uint32_t crc;
+    uint64_t end;       // end of the last run
+};
+
+/** One image and everything done to it
+ */
+class Job {
+
+public:
+    void reset() {
+        starts.clear();
+        pieces.clear();
+        bin.clear();
+        packed.clear();
+        origin = 0;
+        error = 0;
+        verified = -1;
+        hash = 0;
+        hashed = 0;
+    }
+
+    std::string name;
+    std::string hex;
+    std::vector<uint8_t> ref;
+    int have_ref;
+    // where each chunk starts in hex and where its address record is, or -1
+    std::vector<size_t> starts;
+    std::vector<long> bases;
+    std::vector<Piece> pieces;
+    std::vector<uint8_t> bin;
+    uint32_t origin;
+    const char *error;
+    int verified;       // 1 same as the reference, 0 differs, -1 no reference
+    uint32_t hash;      // CRC-32 of the binary
+    int hashed;         // hash came from the pieces
+    std::vector<uint32_t> packed;   // packed size of each part
+};
+
+/** Cut the hex into chunks of about chunk bytes at record starts and find
+ *  the address record each one runs under
+ */
+static void split(Job &job, size_t chunk)
+{
+    const char *hex = job.hex.data();
+    size_t size = job.hex.size();
+    job.starts.assign(1, 0);
+    job.bases.assign(1, -1);
+    for (size_t pos = chunk; pos < size; pos += chunk) {
+        const char *c = (const char *)memchr(hex + pos, ':', size - pos);
+        if (!c) {
+            break;
+        }
+        pos = c - hex;
+        job.starts.push_back(pos);
+        // back to the last extended address record, which the chunk starts from
+        long base = -1;
+        for (size_t at = pos; at > 0;) {
+            const char *r = (const char *)memrchr(hex, ':', at);
+            if (!r) {
+                break;
+            }
+            at = r - hex;
+            if (((at + 15) <= size) && !memcmp(&r[1], "02", 2) && ('0' == r[7]) && (('4' == r[8]) || ('2' == r[8]))) {
+                base = at;
+                break;
+            }
+        }
+        job.bases.push_back(base);
+    }
+    job.pieces.assign(job.starts.size(), Piece());
+}
+
+static void decode_piece(Job &job, size_t k)
+{
+    Piece &piece = job.pieces[k];
+    HexPushParser<Piece> parser(piece);
+    const uint8_t *hex = (const uint8_t *)job.hex.data();
+    if (job.bases[k] >= 0) {
+        parser.feed(hex + job.bases[k], 15);
+    }
+    size_t end = ((k + 1) < job.starts.size()) ? job.starts[k + 1] : job.hex.size();
+    piece.status = parser.feed(hex + job.starts[k], end - job.starts[k]);
+}
+
+/** Put the pieces together into the binary, from the lowest address up
+ */
+static void merge(Job &job)
+{
+    // pieces after the one with the end of file record are not part of the image
+    size_t last = 0;
+    for (; last < job.pieces.size(); last++) {
+        Piece &p = job.pieces[last];
+        if (p.eof || (HEX_PARSE_OK != p.status)) {
+            break;
+        }
+    }
+    if (last == job.pieces.size()) {
+        job.error = "no end of file record";
+        return;
+    }
+    if (!job.pieces[last].eof) {
+        job.error = (HEX_PARSE_WRAP == job.pieces[last].status) ? "data past the top of the address space" : "bad record";
+        return;
+    }
+    uint64_t lo = ~0ULL, hi = 0;
+    for (size_t k = 0; k <= last; k++) {
+        for (size_t r = 0; r < job.pieces[k].runs.size(); r++) {
+            const run_t &run = job.pieces[k].runs[r];
+            lo = (run.addr < lo) ? run.addr : lo;
+            hi = ((run.addr + (uint64_t)run.size) > hi) ? (run.addr + (uint64_t)run.size) : hi;
+        }
+    }
+    if (hi <= lo) {
+        return;
+    }
+    job.origin = lo;
+    // the pieces' CRCs one after another when they are in address order
+    uint64_t end = lo;
+    job.hash = 0;
+    job.hashed = 1;
+    for (size_t k = 0; job.hashed && (k <= last); k++) {
+        const Piece &p = job.pieces[k];
+        if (p.runs.empty()) {
+            continue;
+        }
+        if (!p.ordered || (p.runs[0].addr < end)) {
+            job.hashed = 0;
+            break;
+        }
+        job.hash = crc32_fill(job.hash, 0xff, p.runs[0].addr - end);
+        job.hash = crc32_combine(job.hash, p.crc, p.end - p.runs[0].addr);
+        end = p.end;
+    }
+    job.bin.assign(hi - lo, 0xff);
+    for (size_t k = 0; k <= last; k++) {
+        const Piece &p = job.pieces[k];
+        for (size_t r = 0; r < p.runs.size(); r++) {
+            memcpy(&job.bin[p.runs[r].addr - lo], &p.data[p.runs[r].offset], p.runs[r].size);
+        }
+    }
+    job.pieces.clear();
+}
+
+static void verify(Job &job)
+{
+    if (job.error || !job.have_ref) {
+        return;
+    }
+    const std::vector<uint8_t> &ref = job.ref;
+    const std::vector<uint8_t> &bin = job.bin;
+    size_t at = job.origin;
+    int same = 1;
+    for (size_t i = 0; same && (i < at) && (i < ref.size()); i++) {
+        same = (0xff == ref[i]);
+    }
+    size_t common = (ref.size() > at) ? (ref.size() - at) : 0;
+    common = (common < bin.size()) ? common : bin.size();
+    same = same && (!common || !memcmp(&bin[0], &ref[at], common));
+    for (size_t i = at + common; same && (i < ref.size()); i++) {
+        same = (0xff == ref[i]);
+    }
+    for (size_t i = common; same && (i < bin.size()); i++) {
+        same = (0xff == bin[i]);
+    }
+    job.verified = same;
+}
+
+static void hash(Job &job)
+{
+    if (!job.hashed) {
+        job.hash = crc32_update(0, job.bin.data(), job.bin.size());
+    }
+}
+
+static uint32_t pack_parts(const Job &job)
+{
+    return (job.bin.size() + PACK_PART - 1) / PACK_PART;
+}
+
+static void pack_part(Job &job, uint32_t part)
+{
+    uint8_t out[BLOCK_CODEC_BOUND(PACK_BLOCK)];
+    uint32_t end = (part + 1) * PACK_PART;
+    end = (end < job.bin.size()) ? end : job.bin.size();
+    uint32_t total = 0;
+    for (uint32_t at = part * PACK_PART; at < end; at += PACK_BLOCK) {
+        uint32_t n = ((end - at) < PACK_BLOCK) ? (end - at) : PACK_BLOCK;
+        total += block_compress(&job.bin[at], n, out);
+    }
+    job.packed[part] = total;
+}
+
+class ChunkTask : public WorkTask {
+public:
+    ChunkTask(Job &job, size_t k) : _job(job), _k(k) {
+    }
+    virtual void run(WorkPool &pool) {
+        (void)pool;
+        decode_piece(_job, _k);
+    }
+private:
+    Job &_job;
+    size_t _k;
+};
+
+class MergeTask : public WorkTask {
+public:
+    MergeTask(Job &job) : _job(job) {
+    }
+    virtual void run(WorkPool &pool) {
+        (void)pool;
+        merge(_job);
+    }
+private:
+    Job &_job;
+};
+
+/** Decodes a small image itself, a big one as chunk tasks and a merge that
+ *  what waits for the decode then waits for
+ */
+class DecodeTask : public WorkTask {
+public:
+    DecodeTask(Job &job) : _job(job) {
+    }
+    virtual void run(WorkPool &pool) {
+        split(_job, CHUNK_SIZE);
+        if (1 == _job.starts.size()) {
+            decode_piece(_job, 0);
+            merge(_job);
+            return;
+        }
+        MergeTask *m = new MergeTask(_job);
+        forward(*m);
+        std::vector<ChunkTask *> chunks;
+        for (size_t k = 0; k < _job.starts.size(); k++) {
+            chunks.push_back(new ChunkTask(_job, k));
+            m->after(*chunks.back());
+        }
+        pool.submit(m);
+        // the first chunks come off the back of this thread's queue first
+        for (size_t k = chunks.size(); k > 0; k--) {
+            pool.submit(chunks[k - 1]);
+        }
+    }
+private:
+    Job &_job;
+};
+
+class VerifyTask : public WorkTask {
+public:
+    VerifyTask(Job &job) : _job(job) {
+    }
+    virtual void run(WorkPool &pool) {
+        (void)pool;
+        verify(_job);
+    }
+private:
+    Job &_job;
+};
+
+class HashTask : public WorkTask {
+public:
+    HashTask(Job &job) : _job(job) {
+    }
+    virtual void run(WorkPool &pool) {
+        (void)pool;
+        hash(_job);
+    }
+private:
+    Job &_job;
+};
+
+class PackPartTask : public WorkTask {
+public:
+    PackPartTask(Job &job, uint32_t part) : _job(job), _part(part) {
+    }
+    virtual void run(WorkPool &pool) {
+        (void)pool;
+        pack_part(_job, _part);
+    }
+private:
+    Job &_job;
+    uint32_t _part;
+};
+
+class PackTask : public WorkTask {
+public:
+    PackTask(Job &job) : _job(job) {
+    }
+    virtual void run(WorkPool &pool) {
+        if (_job.error) {
+            return;
+        }
+        uint32_t parts = pack_parts(_job);
+        _job.packed.assign(parts, 0);
+        for (uint32_t i = parts; i > 1; i--) {
+            pool.submit(new PackPartTask(_job, i - 1));
+        }
+        if (parts) {
+            pack_part(_job, 0);
+        }
+    }
+private:
+    Job &_job;
+};
+
+typedef struct {
+    const char *error;
+    int verified;
+    uint32_t hash;
+    uint64_t bin;       // binary size
+    uint64_t packed;    // all parts packed
+} outcome_t;
+
+typedef struct {
+    uint64_t ns;        // the whole batch
+    uint64_t busy_ns;   // all threads together
+    uint32_t tasks;
+    uint32_t steals;
+} batch_result_t;
+
+static void thread_per_file(std::vector<Job> &jobs, uint32_t threads, batch_result_t &r)
+{
+    std::vector<uint64_t> busy(threads, 0);
+    std::vector<std::thread> pool;
+    uint64_t t = WorkPool::now_ns();
+    for (uint32_t i = 0; i < threads; i++) {
+        pool.push_back(std::thread([&jobs, &busy, threads, i]() {
+            uint64_t start = WorkPool::now_ns();
+            for (size_t j = i; j < jobs.size(); j += threads) {
+                Job &job = jobs[j];
+                split(job, job.hex.size() + 1);
+                decode_piece(job, 0);
+                merge(job);
+                verify(job);
+                hash(job);
+                if (!job.error) {
+                    job.packed.assign(pack_parts(job), 0);
+                    for (uint32_t p = 0; p < job.packed.size(); p++) {
+                        pack_part(job, p);
+                    }
+                }
+            }
+            busy[i] = WorkPool::now_ns() - start;
+        }));
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        pool[i].join();
+    }
+    r.ns = WorkPool::now_ns() - t;
+    r.busy_ns = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        r.busy_ns += busy[i];
+    }
+    r.tasks = jobs.size();
+    r.steals = 0;
+}
+
+static void work_stealing(std::vector<Job> &jobs, uint32_t threads, batch_result_t &r)
+{
+    WorkPool pool(threads);
+    uint64_t t = WorkPool::now_ns();
+    for (size_t j = 0; j < jobs.size(); j++) {
+        DecodeTask *decode = new DecodeTask(jobs[j]);
+        VerifyTask *check = new VerifyTask(jobs[j]);
+        HashTask *sum = new HashTask(jobs[j]);
+        PackTask *packer = new PackTask(jobs[j]);
+        check->after(*decode);
+        sum->after(*check);
+        packer->after(*check);
+        pool.submit(sum);
+        pool.submit(packer);
+        pool.submit(check);
+        pool.submit(decode);
+    }
+    pool.wait();
+    r.ns = WorkPool::now_ns() - t;
+    r.busy_ns = 0;
+    r.tasks = 0;
+    r.steals = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        r.busy_ns += pool.stats(i).busy_ns;
+        r.tasks += pool.stats(i).tasks;
+        r.steals += pool.stats(i).steals;
+    }
+}
+
+static void put_record(std::string &s, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t size)
+{
+    char text[8 + 2 * 255 + 4];
+    uint8_t sum = size + (offset >> 8) + offset + type;
+    int n = sprintf(text, ":%02X%04X%02X", size, offset, type);
+    for (uint8_t i = 0; i < size; i++) {
+        n += sprintf(&text[n], "%02X", data[i]);
+        sum += data[i];
+    }
+    sprintf(&text[n], "%02X\n", (uint8_t)-sum);
+    s += text;
+}
+
+/** An image of mb MB at address 0, test/mbed.bin over and over with every
+ *  4 KB a little different, or random data without it
+ */
+static void synthetic(Job &job, uint32_t mb, uint32_t seed)
+{
+    std::string tile;
+    read_file("test/mbed.bin", tile);
+    job.ref.resize((size_t)mb << 20);
+    srand(seed);
+    for (size_t i = 0; i < job.ref.size(); i++) {
+        job.ref[i] = tile.empty() ? rand() : (tile[i % tile.size()] ^ (uint8_t)(seed + (i >> 12)));
+    }
+    job.have_ref = 1;
+    job.hex.clear();
+    for (size_t i = 0; i < job.ref.size(); i += 16) {
+        if (!(i & 0xffff)) {
+            uint8_t seg[2] = {(uint8_t)(i >> 24), (uint8_t)(i >> 16)};
+            put_record(job.hex, EXT_LINEAR_ADDR_RECORD, 0, seg, 2);
+        }
+        put_record(job.hex, DATA_RECORD, i, &job.ref[i], 16);
+    }
+    put_record(job.hex, EOF_RECORD, 0, 0, 0);
+}
+
+static void print_result(const char *name, uint32_t threads, const batch_result_t &r)
+{
+    printf("%-18s %7lu %11.1f %7.1f %8lu %8lu\n", name, (unsigned long)threads, r.ns / 1e6,
+           100.0 * r.busy_ns / ((double)r.ns * threads), (unsigned long)r.tasks, (unsigned long)r.steals);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t threads = std::thread::hardware_concurrency();
+    uint32_t repeat = 8;
+    uint32_t big_mb = 16;
+    int i = 1;
+    for (; (i < argc) && ('-' == argv[i][0]); i++) {
+        if ((i + 1) >= argc) {
+            break;
+        } else if (!strcmp(argv[i], "-t")) {
+            threads = strtoul(argv[++i], 0, 0);
+        } else if (!strcmp(argv[i], "-r")) {
+            repeat = strtoul(argv[++i], 0, 0);
+        } else if (!strcmp(argv[i], "-b")) {
+            big_mb = strtoul(argv[++i], 0, 0);
+        } else {
+            break;
+        }
+    }
+    if (((i < argc) && ('-' == argv[i][0])) || !threads || !repeat) {
+        fprintf(stderr, "usage: %s [-t threads] [-r repeat] [-b big_mb] [image.hex]...\n", argv[0]);
+        return 2;
+    }
+    std::vector<std::string> inputs(argv + i, argv + argc);
+    if (inputs.empty()) {
+        const char *test[] = {"test/testapp.hex", "test/test_app_fast.hex", "test/test_app_slow.hex", "test/mbed.hex"};
+        inputs.assign(test, test + 4);
+    }
+
+    std::vector<Job> jobs;
+    for (uint32_t n = 0; n < repeat; n++) {
+        for (size_t k = 0; k < inputs.size(); k++) {
+            Job job;
+            job.name = inputs[k];
+            if (read_file(inputs[k].c_str(), job.hex)) {
+                perror(inputs[k].c_str());
+                return 1;
+            }
+            std::string ref;
+            size_t dot = inputs[k].rfind('.');
+            job.have_ref = (std::string::npos != dot) && !read_file((inputs[k].substr(0, dot) + ".bin").c_str(), ref);
+            job.ref.assign(ref.begin(), ref.end());
+            jobs.push_back(job);
+        }
+        // the big ones go in among the small ones
+        if ((n < BIG_IMAGES) && big_mb) {
+            Job job;
+            job.name = "synthetic";
+            synthetic(job, big_mb, n + 1);
+            jobs.push_back(job);
+        }
+    }
+    uint64_t hex_bytes = 0;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        hex_bytes += jobs[j].hex.size();
+    }
+    printf("%lu images, %.1f MB of hex, %lu threads\n", (unsigned long)jobs.size(), hex_bytes / 1048576.0, (unsigned long)threads);
+    printf("%-18s %7s %11s %7s %8s %8s\n", "scheduler", "threads", "makespan ms", "util %", "tasks", "steals");
+
+    // the quickest of RUNS for each, results of the last runs compared
+    std::vector<outcome_t> results[2];
+    const char *names[2] = {"thread per file", "work stealing"};
+    for (int s = 0; s < 2; s++) {
+        batch_result_t best = {0, 0, 0, 0};
+        for (int run = 0; run < RUNS; run++) {
+            for (size_t j = 0; j < jobs.size(); j++) {
+                jobs[j].reset();
+            }
+            batch_result_t r;
+            if (s) {
+                work_stealing(jobs, threads, r);
+            } else {
+                thread_per_file(jobs, threads, r);
+            }
+            if (!run || (r.ns < best.ns)) {
+                best = r;
+            }
+        }
+        print_result(names[s], threads, best);
+        for (size_t j = 0; j < jobs.size(); j++) {
+            outcome_t o = {jobs[j].error, jobs[j].verified, jobs[j].hash, jobs[j].bin.size(), 0};
+            for (size_t p = 0; p < jobs[j].packed.size(); p++) {
+                o.packed += jobs[j].packed[p];
+            }
+            results[s].push_back(o);
+        }
+    }
+
+    int ok = 1;
+    uint32_t failed = 0, verified = 0;
+    uint64_t bin_bytes = 0, packed_bytes = 0;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        const outcome_t &a = results[0][j];
+        const outcome_t &b = results[1][j];
+        ok &= (a.error == b.error) && (a.verified == b.verified) && (a.hash == b.hash) && (a.packed == b.packed);
+        if (b.error) {
+            fprintf(stderr, "%s: %s\n", jobs[j].name.c_str(), b.error);
+        }
+        if (!b.verified) {
+            fprintf(stderr, "%s: does not match the reference\n", jobs[j].name.c_str());
+        }
+        failed += (b.error || !b.verified) ? 1 : 0;
+        verified += (1 == b.verified) ? 1 : 0;
+        bin_bytes += b.bin;
+        packed_bytes += b.packed;
+    }
+    printf("%lu verified, %lu failed, %.1f MB packed to %.1f MB, %s\n", (unsigned long)verified, (unsigned long)failed,
+           bin_bytes / 1048576.0, packed_bytes / 1048576.0, ok ? "both agree" : "they DIFFER");
+    return (ok && !failed) ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#ifndef IMAGE_FORMATS_H
+#define IMAGE_FORMATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "uf2_decoder.h"
+
+/** Check for a run that is all 0xff, which the tools leave out of an image
+ */
+static inline int image_erased(const uint8_t *data, uint32_t size)
+{
+    while (size && (0xff == *data)) {
+        data++;
+        size--;
+    }
+    return !size;
+}
+
+/** Write one S-record
+ *  @return the number of characters written to out
+ */
+static inline uint32_t srec_record(char *out, int type, uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    static const int addr_size[10] = {2, 2, 3, 4, 0, 2, 3, 4, 3, 2};
+    uint8_t count = addr_size[type] + size + 1;
+    uint8_t sum = count;
+    uint32_t n = sprintf(out, "S%d%02X", type, count);
+    for (int i = addr_size[type] - 1; i >= 0; i--) {
+        uint8_t b = (uint8_t)(addr >> (i * 8));
+        sum += b;
+        n += sprintf(&out[n], "%02X", b);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        sum += data[i];
+        n += sprintf(&out[n], "%02X", data[i]);
+    }
+    n += sprintf(&out[n], "%02X\n", (uint8_t)~sum);
+    return n;
+}
+
+/** Turn a binary into S-records with record_size bytes each, using the
+ *  shortest address that reaches the end of the image like objcopy does.
+ *  Records that are all 0xff are left out
+ *  @param out must hold 3 * size plus a few hundred bytes
+ *  @return the size of the S-record image
+ */
+static inline uint32_t srec_from_bin(const uint8_t *bin, uint32_t size, uint32_t base, uint32_t record_size, char *out)
+{
+    uint32_t top = base + size - 1;
+    int type = (top <= 0xffff) ? 1 : ((top <= 0xffffff) ? 2 : 3);
+    uint32_t n = srec_record(out, 0, 0, (const uint8_t *)"hex_parser", 10);
+    for (uint32_t pos = 0; pos < size; pos += record_size) {
+        uint32_t len = ((size - pos) < record_size) ? (size - pos) : record_size;
+        if (!image_erased(&bin[pos], len)) {
+            n += srec_record(&out[n], type, base + pos, &bin[pos], len);
+        }
+    }
+    n += srec_record(&out[n], 10 - type, base, 0, 0);
+    return n;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/** Turn a binary into UF2 blocks of 256 bytes like uf2conv does, leaving out
+ *  the ones that are all 0xff
+ *  @param out must hold 2 * size plus a block
+ *  @return the size of the UF2 image
+ */
+static inline uint32_t uf2_from_bin(const uint8_t *bin, uint32_t size, uint32_t base, uint8_t *out)
+{
+    uint32_t blocks = 0;
+    for (uint32_t pos = 0; pos < size; pos += 256) {
+        uint32_t len = ((size - pos) < 256) ? (size - pos) : 256;
+        blocks += !image_erased(&bin[pos], len);
+    }
+    uint32_t n = 0;
+    for (uint32_t pos = 0; pos < size; pos += 256) {
+        uint32_t len = ((size - pos) < 256) ? (size - pos) : 256;
+        if (image_erased(&bin[pos], len)) {
+            continue;
+        }
+        uint8_t *block = &out[n * UF2_BLOCK_SIZE];
+        memset(block, 0, UF2_BLOCK_SIZE);
+        put_le32(&block[0], UF2_MAGIC_START0);
+        put_le32(&block[4], UF2_MAGIC_START1);
+        put_le32(&block[12], base + pos);
+        put_le32(&block[16], 256);
+        put_le32(&block[20], n);
+        put_le32(&block[24], blocks);
+        memcpy(&block[UF2_HEADER_SIZE], &bin[pos], len);
+        memset(&block[UF2_HEADER_SIZE + len], 0xff, 256 - len);
+        put_le32(&block[UF2_BLOCK_SIZE - 4], UF2_MAGIC_END);
+        n++;
+    }
+    return n * UF2_BLOCK_SIZE;
+}
+
+/** Turn a binary into an ELF the way GNU ld lays one out, program headers
+ *  first. The image is split in two PT_LOAD segments that the program headers
+ *  list back to front, and a block of junk stands in for the debug info
+ *  @param out must hold size plus a kilobyte
+ *  @return the size of the ELF
+ */
+static inline uint32_t elf_from_bin(const uint8_t *bin, uint32_t size, uint32_t base, uint8_t *out)
+{
+    uint32_t half = (size / 2) & ~3;
+    uint32_t data = 52 + 2 * 32;
+    memset(out, 0, data);
+    memcpy(out, "\x7f" "ELF\x01\x01\x01", 7);
+    out[16] = 2;        // ET_EXEC
+    out[18] = 40;       // EM_ARM
+    put_le32(&out[20], 1);
+    put_le32(&out[24], base | 1);
+    put_le32(&out[28], 52);
+    out[40] = 52;
+    out[42] = 32;
+    out[44] = 2;
+    const uint32_t segments[2][3] = {
+        {data + half, base + half, size - half},
+        {data, base, half},
+    };
+    for (int i = 0; i < 2; i++) {
+        uint8_t *phdr = &out[52 + i * 32];
+        put_le32(&phdr[0], 1);
+        put_le32(&phdr[4], segments[i][0]);
+        put_le32(&phdr[8], segments[i][1]);
+        put_le32(&phdr[12], segments[i][1]);
+        put_le32(&phdr[16], segments[i][2]);
+        put_le32(&phdr[20], segments[i][2]);
+    }
+    memcpy(&out[data], bin, size);
+    for (uint32_t i = 0; i < 512; i++) {
+        out[data + size + i] = (uint8_t)(i * 13);
+    }
+    return data + size + 512;
+}
+
+#endif
@@ -0,0 +1,163 @@
+/* Times three ways of parsing hex that arrives as USB sized packets scattered
+ * over a packet pool, the way an MSC or CDC endpoint leaves them: copying the
+ * packets into 512 byte sectors first, feeding the parser a packet at a time,
+ * and handing it the packets of a sector as an iovec with feedv(). Then feeds
+ * the image as random fragments (empty and one byte ones too) in random
+ * batches and compares every decode with the reference.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o iovec_bench host/iovec_bench.cpp
+ *
+ * Usage:
+ *   iovec_bench <image.hex> <reference.bin> [packet_size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "hex_push_parser.h"
+#include "host_clock.h"
+#include "hex_image.h"
+
+#define RUNS        100
+#define SECTOR_SIZE 512
+
+/** HexPushParser handler that only sums, so the timing is the parse
+ */
+class SumHandler : public HexHandler {
+public:
+    SumHandler() : sum(0) {}
+
+    int on_data(uint32_t addr, const uint8_t *data, uint32_t size) {
+        sum += addr;
+        for (uint32_t i = 0; i < size; i++) {
+            sum = sum * 31 + data[i];
+        }
+        return 0;
+    }
+
+    uint32_t sum;
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <reference.bin> [packet_size]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> hex_file, ref_file;
+    if (read_file(argv[1], hex_file) || read_file(argv[2], ref_file)) {
+        perror("fopen");
+        return 1;
+    }
+    const uint8_t *hex = hex_file.data();
+    uint32_t hex_size = hex_file.size();
+    const uint8_t *ref = ref_file.data();
+    uint32_t ref_size = ref_file.size();
+    uint32_t packet = (argc > 3) ? strtoul(argv[3], 0, 0) : 64;
+    if (!packet || (packet > SECTOR_SIZE)) {
+        packet = 64;
+    }
+
+    // every packet in its own slot of a pool, the slots in shuffled order
+    uint32_t packets = (hex_size + packet - 1) / packet;
+    uint32_t slot_size = (packet + 63) & ~63u;
+    std::vector<uint32_t> slot(packets);
+    for (uint32_t i = 0; i < packets; i++) {
+        slot[i] = i;
+    }
+    for (uint32_t i = packets - 1; i > 0; i--) {
+        uint32_t j = rand() % (i + 1);
+        uint32_t s = slot[i];
+        slot[i] = slot[j];
+        slot[j] = s;
+    }
+    std::vector<uint8_t> pool((size_t)packets * slot_size);
+    std::vector<hex_iovec_t> iov(packets);
+    for (uint32_t i = 0; i < packets; i++) {
+        uint32_t n = (i == packets - 1) ? hex_size - i * packet : packet;
+        uint8_t *p = &pool[(size_t)slot[i] * slot_size];
+        memcpy(p, &hex[i * packet], n);
+        iov[i].data = p;
+        iov[i].size = n;
+    }
+    uint32_t per_sector = SECTOR_SIZE / packet;
+
+    uint8_t sector[SECTOR_SIZE];
+    SumHandler staged;
+    uint32_t t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        HexPushParser<SumHandler> parser(staged);
+        for (uint32_t i = 0; i < packets; i += per_sector) {
+            uint32_t n = 0;
+            for (uint32_t j = i; (j < i + per_sector) && (j < packets); j++) {
+                memcpy(&sector[n], iov[j].data, iov[j].size);
+                n += iov[j].size;
+            }
+            parser.feed(sector, n);
+        }
+    }
+    uint32_t staged_us = host_us() - t;
+
+    SumHandler each;
+    t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        HexPushParser<SumHandler> parser(each);
+        for (uint32_t i = 0; i < packets; i++) {
+            parser.feed(iov[i].data, iov[i].size);
+        }
+    }
+    uint32_t each_us = host_us() - t;
+
+    SumHandler gathered;
+    t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        HexPushParser<SumHandler> parser(gathered);
+        for (uint32_t i = 0; i < packets; i += per_sector) {
+            uint32_t n = (packets - i < per_sector) ? packets - i : per_sector;
+            parser.feedv(&iov[i], n);
+        }
+    }
+    uint32_t gathered_us = host_us() - t;
+
+    // random fragments in random batches, empty ones included
+    uint32_t matched = 0;
+    uint32_t trials = 50;
+    for (uint32_t trial = 0; trial < trials; trial++) {
+        std::vector<hex_iovec_t> frags;
+        uint32_t max_frag = 1 + rand() % 600;
+        for (uint32_t pos = 0; pos < hex_size;) {
+            uint32_t n = rand() % (max_frag + 1);
+            if (n > hex_size - pos) {
+                n = hex_size - pos;
+            }
+            hex_iovec_t frag = {&hex[pos], n};
+            frags.push_back(frag);
+            pos += n;
+        }
+        ImageHandler handler;
+        HexPushParser<ImageHandler> parser(handler);
+        hex_parse_status_t status = HEX_PARSE_OK;
+        for (uint32_t i = 0; (i < frags.size()) && (HEX_PARSE_OK == status);) {
+            uint32_t n = 1 + rand() % 16;
+            if (n > frags.size() - i) {
+                n = frags.size() - i;
+            }
+            status = parser.feedv(&frags[i], n);
+            i += n;
+        }
+        matched += (HEX_PARSE_EOF == status) && handler.eof && handler.matches(ref, ref_size);
+    }
+
+    printf("packets    %lu of %lu bytes, %lu to a sector\n", (unsigned long)packets, (unsigned long)packet, (unsigned long)per_sector);
+    printf("%-24s %10s\n", "input", "hex MB/s");
+    printf("%-24s %10.1f\n", "copied into sectors", (double)hex_size * RUNS / staged_us);
+    printf("%-24s %10.1f\n", "feed() each packet", (double)hex_size * RUNS / each_us);
+    printf("%-24s %10.1f\n", "feedv() a sector", (double)hex_size * RUNS / gathered_us);
+    printf("random     %lu of %lu split and batched decodes matched\n", (unsigned long)matched, (unsigned long)trials);
+    int same = (staged.sum == each.sum) && (each.sum == gathered.sum);
+    if (!same) {
+        printf("sums       differ\n");
+    }
+    return (same && (matched == trials)) ? 0 : 1;
+}
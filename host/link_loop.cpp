@@ -0,0 +1,214 @@
+/* Runs the target side of the link (HexPipeline and PageWriter into LinkSink
+ * over the transmit and receive rings) on the UART from serial_api_host.c, with a
+ * LinkReceiver on the other end of the pseudo-terminal. The receiver can
+ * corrupt bytes on the way in to exercise the CRC and the resends, and hold
+ * off reading for hold_ms after every KB, the way a host sending XOFF does.
+ *
+ * A slow link, where a window takes longer than LINK_TIMEOUT_US to go out,
+ * has to be acknowledged all the same:
+ *   link_loop test/testapp.hex out.bin test/testapp.bin 9600
+ *   link_loop test/testapp.hex out.bin test/testapp.bin 115200 0 300
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -Imbed -o link_loop host/link_loop.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp page_writer.cpp flash_layout.cpp link_sink.cpp frame_link.cpp block_codec.cpp serial_rx.cpp serial_tx.cpp -x c host/serial_api_host.c -lpthread
+ *
+ * Usage:
+ *   link_loop <image.hex> <out.bin> [reference.bin] [baud] [corrupt_one_in] [hold_ms]
+ */
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include "hex_pipeline.h"
+#include "link_sink.h"
+#include "page_writer.h"
+#include "serial_rx.h"
+#include "serial_tx.h"
+#include "serial_host.h"
+#include "link_receiver.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+static serial_t uart;
+static serial_tx_ring_t tx;
+static serial_rx_ring_t rx;
+
+static void uart_irq(uint32_t id, SerialIrq event)
+{
+    (void)id;
+    if (TxIrq == event) {
+        serial_tx_fifo_fill(&uart, &tx);
+    } else {
+        serial_rx_fifo_drain(&uart, &rx);
+    }
+}
+
+/** The target's port, the same as SerialLinkPort without BufferedSerial
+ */
+class HostLinkPort : public LinkPort {
+public:
+    virtual uint32_t send(const uint8_t *data, uint32_t size) {
+        uint32_t cnt = serial_tx_ring_put(&tx, data, size);
+        host_irq_disable();
+        serial_tx_fifo_fill(&uart, &tx);
+        host_irq_enable();
+        return cnt;
+    }
+
+    virtual uint32_t recv(uint8_t *data, uint32_t size) {
+        const uint8_t *ring;
+        uint32_t n = serial_rx_peek(&rx, &ring);
+        if (n > size) {
+            n = size;
+        }
+        memcpy(data, ring, n);
+        serial_rx_consume(&rx, n);
+        return n;
+    }
+};
+
+typedef struct {
+    int fd;
+    FILE *out;
+    uint32_t corrupt;
+    uint32_t corrupted;
+    uint32_t hold_ms;
+    LinkReceiver *receiver;
+} receiver_t;
+
+static void *receiver_thread(void *arg)
+{
+    receiver_t *r = (receiver_t *)arg;
+    uint32_t quiet_since = host_us();
+    uint32_t received = 0;
+    while (!r->receiver->done()) {
+        uint8_t buf[256];
+        ssize_t n = read(r->fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if ((int32_t)(host_us() - quiet_since) > 10 * 1000000) {
+                break;
+            }
+            usleep(50);
+            continue;
+        }
+        if (r->hold_ms && ((received & ~1023u) != ((received + n) & ~1023u))) {
+            usleep(r->hold_ms * 1000);
+        }
+        received += n;
+        quiet_since = host_us();
+        for (ssize_t i = 0; r->corrupt && (i < n); i++) {
+            if (0 == (rand() % r->corrupt)) {
+                buf[i] ^= 1 << (rand() % 8);
+                r->corrupted++;
+            }
+        }
+        if (r->receiver->feed(buf, n)) {
+            fprintf(stderr, "bad packed frame\n");
+            break;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <out.bin> [reference.bin] [baud] [corrupt_one_in] [hold_ms]\n", argv[0]);
+        return 2;
+    }
+    const char *reference = (argc > 3) ? argv[3] : 0;
+    uint32_t baud = (argc > 4) ? strtoul(argv[4], 0, 0) : 921600;
+    uint32_t corrupt = (argc > 5) ? strtoul(argv[5], 0, 0) : 0;
+    uint32_t hold_ms = (argc > 6) ? strtoul(argv[6], 0, 0) : 0;
+
+    FILE *in = fopen(argv[1], "rb");
+    FILE *out = fopen(argv[2], "wb");
+    if (!in || !out) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long hex_size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    // room for the parser to run off the end like it does on hex_file
+    uint8_t *hex = (uint8_t *)calloc(hex_size + HEX_BLOCK_SIZE, 1);
+    if (fread(hex, 1, hex_size, in) != (size_t)hex_size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || grantpt(master) || unlockpt(master)) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char *slave_path = ptsname(master);
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (serial_host_open(&uart, slave_path, baud)) {
+        perror(slave_path);
+        return 1;
+    }
+    serial_tx_ring_init(&tx);
+    serial_rx_ring_init(&rx);
+    serial_irq_handler(&uart, uart_irq, 0);
+    serial_irq_set(&uart, TxIrq, 1);
+    serial_irq_set(&uart, RxIrq, 1);
+
+    LinkReceiver receiver(out, master);
+    receiver_t r = {master, out, corrupt, 0, hold_ms, &receiver};
+    pthread_t thread;
+    pthread_create(&thread, NULL, receiver_thread, &r);
+
+    HostLinkPort port;
+    LinkSink sink(port, host_us);
+    PageWriter pages(sink);
+    HexPipeline pipeline(pages, host_us);
+    hex_parse_status_t status;
+    uint8_t *pos = hex;
+    uint32_t start = host_us();
+    // the target's main loop
+    do {
+        status = pipeline.feed(pos, HEX_BLOCK_SIZE);
+        pos += HEX_BLOCK_SIZE;
+    } while ((HEX_PARSE_OK == status) && (pos < hex + hex_size));
+    int synced = pipeline.flush();
+    uint32_t total_us = host_us() - start;
+    pthread_join(thread, NULL);
+    serial_free(&uart);
+    close(slave);
+    close(master);
+    fclose(out);
+
+    const link_stats_t &s = sink.stats();
+    double raw_us = (double)s.raw_bytes * 10 * 1000000 / baud;
+    printf("status     %s, %s\n", (HEX_PARSE_EOF == status) ? "eof" : "failed", synced ? "not acknowledged" : "acknowledged");
+    printf("frames     %lu, %lu packed, %lu resent, %lu crc errors at the host (%lu bytes corrupted)\n",
+           (unsigned long)s.frames, (unsigned long)s.packed, (unsigned long)s.resends, (unsigned long)receiver.crc_errors(), (unsigned long)r.corrupted);
+    printf("image      %lu bytes in %lu on the wire (%.2fx)\n", (unsigned long)s.raw_bytes, (unsigned long)s.wire_bytes, (double)s.raw_bytes / s.wire_bytes);
+    printf("time       %lu us (raw stream %.0f us)\n", (unsigned long)total_us, raw_us);
+    printf("throughput %.0f B/s (%.2fx a raw stream)\n", s.raw_bytes * 1e6 / total_us, raw_us / total_us);
+    if (((double)LINK_MAX_FRAME * 10 * 1000000 / baud > LINK_TIMEOUT_US) || (hold_ms * 1000 > LINK_TIMEOUT_US)) {
+        printf("slow link  a frame can outlast the %lu ms timeout\n", (unsigned long)(LINK_TIMEOUT_US / 1000));
+    }
+    free(hex);
+    if (reference) {
+        int match = image_files_match(argv[2], reference);
+        printf("reference  %s\n", match ? "match" : "MISMATCH");
+        return (match && !synced) ? 0 : 1;
+    }
+    return synced ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#ifndef LINK_RECEIVER_H
+#define LINK_RECEIVER_H
+
+#include <stdio.h>
+#include <unistd.h>
+#include "frame_link.h"
+#include "block_codec.h"
+
+/** Host end of a LinkSink. Frames that arrive in order are expanded and
+ *  written to the output at their address less base, with 0xff in any gap, so
+ *  the file is the flash image. Every frame is answered with a cumulative ack
+ *  on ack_fd.
+ */
+class LinkReceiver {
+
+public:
+    LinkReceiver(FILE *out, int ack_fd, uint32_t base = 0) :
+        _out(out), _ack_fd(ack_fd), _base(base), _end(0), _expect(0), _done(0), _frames(0), _dropped(0), _bytes(0), _wire(0) {
+        link_rx_init(&_rx);
+    }
+
+    /** Process received bytes
+     *  @return 0, or -1 if a frame with a good CRC did not expand
+     */
+    int feed(const uint8_t *data, uint32_t size) {
+        _wire += size;
+        while (size) {
+            link_frame_t frame;
+            uint32_t used = link_rx_feed(&_rx, data, size, &frame);
+            data += used;
+            size -= used;
+            if (!frame.type) {
+                continue;
+            }
+            if (frame.seq != _expect) {
+                // go-back-N: anything out of order is sent again
+                _dropped++;
+            } else if (handle(&frame)) {
+                return -1;
+            }
+            ack();
+        }
+        return 0;
+    }
+
+    /** Check if the end frame has been received
+     */
+    int done() const {
+        return _done;
+    }
+
+    uint32_t frames() const {
+        return _frames;
+    }
+    uint32_t dropped() const {
+        return _dropped;
+    }
+    uint32_t crc_errors() const {
+        return _rx.crc_errors;
+    }
+    uint32_t bytes() const {
+        return _bytes;
+    }
+    uint32_t wire_bytes() const {
+        return _wire;
+    }
+
+private:
+    int handle(const link_frame_t *frame) {
+        uint8_t block[LINK_MAX_PAYLOAD];
+        int32_t n = frame->len;
+        if (LINK_PACKED == frame->type) {
+            n = block_expand(frame->payload, frame->len, block, sizeof(block));
+            if ((n != frame->raw_len) || place(frame->addr, block, n)) {
+                return -1;
+            }
+        } else if (LINK_DATA == frame->type) {
+            if (place(frame->addr, frame->payload, n)) {
+                return -1;
+            }
+        } else if (LINK_END == frame->type) {
+            _done = 1;
+            n = 0;
+        } else {
+            return 0;
+        }
+        _frames++;
+        _bytes += n;
+        _expect++;
+        return 0;
+    }
+
+    int place(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (addr < _base) {
+            return -1;
+        }
+        uint32_t offset = addr - _base;
+        // pages left erased on the target are never sent
+        fseek(_out, _end, SEEK_SET);
+        for (; _end < offset; _end++) {
+            fputc(0xff, _out);
+        }
+        fseek(_out, offset, SEEK_SET);
+        fwrite(data, 1, size, _out);
+        if (offset + size > _end) {
+            _end = offset + size;
+        }
+        return 0;
+    }
+
+    void ack() {
+        uint8_t buf[LINK_MAX_FRAME];
+        link_frame_t frame = {LINK_ACK, _expect, 0, 0, 0, 0};
+        uint32_t n = link_frame_encode(&frame, buf);
+        if (write(_ack_fd, buf, n) != (ssize_t)n) {
+            perror("ack");
+        }
+    }
+
+    FILE *_out;
+    int _ack_fd;
+    uint32_t _base;
+    uint32_t _end;
+    link_rx_t _rx;
+    uint8_t _expect;
+    int _done;
+    uint32_t _frames;
+    uint32_t _dropped;
+    uint32_t _bytes;
+    uint32_t _wire;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/* Receives the decoded image from a board built with HEX_LINK_OUTPUT=1, writes
+ * it to a file as a flash image from address 0 and optionally checks it
+ * against a reference such as test/mbed.bin.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o link_recv host/link_recv.cpp frame_link.cpp block_codec.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   link_recv <tty> <out.bin> [reference.bin] [baud]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "link_receiver.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+/** Map a baud rate to a termios speed
+ */
+static speed_t tty_speed(uint32_t baud)
+{
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+    }
+    return B921600;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <tty> <out.bin> [reference.bin] [baud]\n", argv[0]);
+        return 2;
+    }
+    const char *reference = (argc > 3) ? argv[3] : 0;
+    uint32_t baud = (argc > 4) ? strtoul(argv[4], 0, 0) : 921600;
+
+    int fd = open(argv[1], O_RDWR | O_NOCTTY);
+    FILE *out = fopen(argv[2], "wb");
+    if ((fd < 0) || !out) {
+        perror("open");
+        return 1;
+    }
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, tty_speed(baud));
+    // wake up for every byte but give up after a second of silence
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 10;
+    tcsetattr(fd, TCSANOW, &tio);
+
+    LinkReceiver rx(out, fd);
+    uint32_t start = 0;
+    while (!rx.done()) {
+        uint8_t buf[1024];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            continue;
+        }
+        if (!start) {
+            start = host_us();
+        }
+        if (rx.feed(buf, n)) {
+            fprintf(stderr, "bad packed frame\n");
+            return 1;
+        }
+    }
+    uint32_t total_us = host_us() - start;
+    fclose(out);
+    close(fd);
+
+    double raw_us = (double)rx.bytes() * 10 * 1000000 / baud;
+    printf("frames     %lu (%lu out of order, %lu crc errors)\n", (unsigned long)rx.frames(), (unsigned long)rx.dropped(), (unsigned long)rx.crc_errors());
+    printf("image      %lu bytes in %lu on the wire (%.2fx)\n", (unsigned long)rx.bytes(), (unsigned long)rx.wire_bytes(), (double)rx.bytes() / rx.wire_bytes());
+    printf("throughput %.0f B/s (%.2fx a raw stream)\n", rx.bytes() * 1e6 / total_us, raw_us / total_us);
+    if (reference) {
+        int match = image_files_match(argv[2], reference);
+        printf("reference  %s\n", match ? "match" : "MISMATCH");
+        return match ? 0 : 1;
+    }
+    return 0;
+}
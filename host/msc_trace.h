@@ -0,0 +1,127 @@
+#ifndef MSC_TRACE_H
+#define MSC_TRACE_H
+
+/* Recorded USB mass storage writes, for replaying a drag and drop upload on
+ * the host. A trace is the SCSI WRITE commands a host sent to the disk while
+ * a file was copied onto it, each one with the time it arrived, the sectors
+ * it wrote and their bytes. All fields are little endian:
+ *
+ *   header   "MSCT", version, sector size, file LBA, file size, write count,
+ *            host name (8 characters) and image name (32 characters)
+ *   write    time in us from the first write, LBA, sector count, then
+ *            count * sector size bytes, as many times as the write count
+ *
+ * The file LBA and size say where the dropped file went, a freshly formatted
+ * volume gives it contiguous clusters. Everything else written (FAT, directory
+ * entries, the host's own metadata files) is in the trace too.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define MSC_TRACE_VERSION   1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t sector_size;
+    uint32_t file_lba;
+    uint32_t file_size;
+    uint32_t writes;
+    char host[8];
+    char image[32];
+} msc_trace_header_t;
+
+typedef struct {
+    uint32_t time_us;
+    uint32_t lba;
+    uint32_t count;
+    const uint8_t *data;
+} msc_trace_write_t;
+
+/** A trace in memory, loaded from a file or being put together to save
+ */
+class MscTrace {
+
+public:
+    MscTrace() {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "MSCT", 4);
+        header.version = MSC_TRACE_VERSION;
+        header.sector_size = 512;
+    }
+
+    /** Read a trace file
+     *  @return 0 on success, -1 if it can not be read or is not a trace
+     */
+    int load(const char *path) {
+        FILE *f = fopen(path, "rb");
+        if (!f) {
+            return -1;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        _data.resize(size);
+        int ok = (size >= (long)sizeof(header)) && (fread(&_data[0], 1, size, f) == (size_t)size);
+        fclose(f);
+        if (!ok) {
+            return -1;
+        }
+        memcpy(&header, &_data[0], sizeof(header));
+        if (memcmp(header.magic, "MSCT", 4) || (MSC_TRACE_VERSION != header.version) || !header.sector_size) {
+            return -1;
+        }
+        writes.clear();
+        size_t pos = sizeof(header);
+        for (uint32_t i = 0; i < header.writes; i++) {
+            if ((pos + 12) > _data.size()) {
+                return -1;
+            }
+            msc_trace_write_t w;
+            memcpy(&w, &_data[pos], 12);
+            pos += 12;
+            if ((pos + (size_t)w.count * header.sector_size) > _data.size()) {
+                return -1;
+            }
+            w.data = &_data[pos];
+            pos += (size_t)w.count * header.sector_size;
+            writes.push_back(w);
+        }
+        return 0;
+    }
+
+    /** Add a write, data is copied when the trace is saved so it must stay
+     *  valid until then
+     */
+    void add(uint32_t time_us, uint32_t lba, uint32_t count, const uint8_t *data) {
+        msc_trace_write_t w = {time_us, lba, count, data};
+        writes.push_back(w);
+    }
+
+    /** Write the trace file
+     *  @return 0 on success, -1 on failure
+     */
+    int save(const char *path) {
+        FILE *f = fopen(path, "wb");
+        if (!f) {
+            return -1;
+        }
+        header.writes = writes.size();
+        int ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+        for (size_t i = 0; ok && (i < writes.size()); i++) {
+            ok = (fwrite(&writes[i], 12, 1, f) == 1) &&
+                 (fwrite(writes[i].data, header.sector_size, writes[i].count, f) == writes[i].count);
+        }
+        return (!fclose(f) && ok) ? 0 : -1;
+    }
+
+    msc_trace_header_t header;
+    std::vector<msc_trace_write_t> writes;
+
+private:
+    std::vector<uint8_t> _data;
+};
+
+#endif
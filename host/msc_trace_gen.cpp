@@ -0,0 +1,269 @@
+/* Makes MSC write traces (see msc_trace.h) of an image being dropped onto a
+ * freshly formatted 32 MB FAT16 disk, in the orders the desktop hosts use:
+ *
+ *   windows  directory entry and FAT first, the data front to back in 64 KB
+ *            writes, then the entry and the FAT again with the final size
+ *   macos    the data in 32 KB writes with the ._ AppleDouble file and the
+ *            .fseventsd log written in between, the last sector rewritten
+ *   linux    the data as 4 KB pages from writeback, now and then one page
+ *            ahead of the one before it, the FAT and directory at the end
+ *
+ * The timing assumes a full speed device, about 1 MB/s of bulk data.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o msc_trace_gen host/msc_trace_gen.cpp
+ *
+ * Usage:
+ *   msc_trace_gen <image> <out_prefix>
+ *
+ * Writes <out_prefix>_windows.msct, _macos.msct and _linux.msct.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <deque>
+#include <vector>
+#include "msc_trace.h"
+
+// 32 MB FAT16: boot sector, two FATs, 512 root entries, 4 KB clusters
+#define SECTOR_SIZE     512
+#define FAT_LBA         1
+#define FAT_SECTORS     32
+#define ROOT_LBA        (FAT_LBA + 2 * FAT_SECTORS)
+#define ROOT_SECTORS    32
+#define DATA_LBA        (ROOT_LBA + ROOT_SECTORS)
+#define CLUSTER_SECTORS 8
+// a full speed bulk endpoint moves about a byte a microsecond
+#define US_PER_SECTOR   512
+
+/** Builds the sectors a host writes and adds them to a trace
+ */
+class Volume {
+
+public:
+    Volume(MscTrace &trace) : _trace(trace), _time(0) {
+    }
+
+    /** Queue a write of count sectors starting at lba
+     */
+    void write(uint32_t lba, const uint8_t *data, uint32_t count) {
+        _sectors.push_back(std::vector<uint8_t>(data, data + count * SECTOR_SIZE));
+        _trace.add(_time, lba, count, &_sectors.back()[0]);
+        // the command and status phases cost a frame or so
+        _time += count * US_PER_SECTOR + 1000;
+    }
+
+    /** Write the first root directory sector with these entries
+     */
+    void directory(const uint8_t *entries, uint32_t count) {
+        uint8_t sector[SECTOR_SIZE];
+        memset(sector, 0, sizeof(sector));
+        memcpy(sector, entries, count * 32);
+        write(ROOT_LBA, sector, 1);
+    }
+
+    /** Write both FATs with chains for files of the given cluster counts
+     */
+    void fat(const uint32_t *clusters, uint32_t files) {
+        std::vector<uint8_t> table(FAT_SECTORS * SECTOR_SIZE, 0);
+        put16(&table[0], 0xfff8);
+        put16(&table[2], 0xffff);
+        uint32_t c = 2;
+        for (uint32_t f = 0; f < files; f++) {
+            for (uint32_t i = 0; i < clusters[f]; i++, c++) {
+                put16(&table[c * 2], (i + 1 < clusters[f]) ? (c + 1) : 0xffff);
+            }
+        }
+        uint32_t used = (c * 2 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        // only the sectors of the table that changed
+        write(FAT_LBA, &table[0], used);
+        write(FAT_LBA + FAT_SECTORS, &table[0], used);
+    }
+
+    static void put16(uint8_t *p, uint32_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    static void put32(uint8_t *p, uint32_t v) {
+        put16(p, v);
+        put16(&p[2], v >> 16);
+    }
+
+    /** Make a short name directory entry
+     */
+    static void entry(uint8_t *e, const char *name83, uint8_t attr, uint32_t cluster, uint32_t size) {
+        memset(e, 0, 32);
+        memcpy(e, name83, 11);
+        e[11] = attr;
+        put16(&e[26], cluster);
+        put32(&e[28], size);
+    }
+
+private:
+    MscTrace &_trace;
+    uint32_t _time;
+    // every write keeps its own copy, a deque so they do not move
+    std::deque<std::vector<uint8_t> > _sectors;
+};
+
+static uint32_t clusters_of(uint32_t size)
+{
+    return (size + CLUSTER_SECTORS * SECTOR_SIZE - 1) / (CLUSTER_SECTORS * SECTOR_SIZE);
+}
+
+/** Write count sectors of the file from sector first, as writes of at most max sectors
+ */
+static void write_data(Volume &vol, const std::vector<uint8_t> &file, uint32_t lba, uint32_t first, uint32_t count, uint32_t max)
+{
+    while (count) {
+        uint32_t n = (count < max) ? count : max;
+        vol.write(lba + first, &file[first * SECTOR_SIZE], n);
+        first += n;
+        count -= n;
+    }
+}
+
+static void windows(Volume &vol, const std::vector<uint8_t> &file, uint32_t size, const char *name83)
+{
+    uint32_t sectors = file.size() / SECTOR_SIZE;
+    uint32_t clusters = clusters_of(size);
+    uint8_t e[32];
+    Volume::entry(e, name83, 0x20, 2, 0);
+    vol.directory(e, 1);
+    vol.fat(&clusters, 1);
+    write_data(vol, file, DATA_LBA, 0, sectors, 128);
+    Volume::entry(e, name83, 0x20, 2, size);
+    vol.directory(e, 1);
+    vol.fat(&clusters, 1);
+}
+
+static void macos(Volume &vol, const std::vector<uint8_t> &file, uint32_t size, const char *name83)
+{
+    uint32_t sectors = file.size() / SECTOR_SIZE;
+    uint32_t clusters[3] = {clusters_of(size), 1, 1};
+    // the AppleDouble file and the event log go after the image
+    uint32_t apple_lba = DATA_LBA + clusters[0] * CLUSTER_SECTORS;
+    uint32_t events_lba = apple_lba + CLUSTER_SECTORS;
+    uint8_t meta[CLUSTER_SECTORS * SECTOR_SIZE];
+    uint8_t e[3 * 32];
+    char apple83[12];
+    memcpy(apple83, name83, sizeof(apple83));
+    memmove(&apple83[1], apple83, 7);
+    apple83[0] = '_';
+    Volume::entry(&e[0], name83, 0x20, 2, 0);
+    Volume::entry(&e[32], apple83, 0x20, 2 + clusters[0], 0);
+    Volume::entry(&e[64], "FSEVEN~1   ", 0x12, 3 + clusters[0], 0);
+    vol.directory(e, 3);
+    uint32_t half = sectors / 2;
+    write_data(vol, file, DATA_LBA, 0, half, 64);
+    memset(meta, 0, sizeof(meta));
+    memcpy(meta, "\0\5\26\7\0\2\0\0Mac OS X        ", 24);
+    vol.write(apple_lba, meta, CLUSTER_SECTORS);
+    write_data(vol, file, DATA_LBA, half, sectors - half, 64);
+    memset(meta, 0, sizeof(meta));
+    memcpy(meta, "1SLD", 4);
+    vol.write(events_lba, meta, 1);
+    // the last sector again once the size is known
+    vol.write(DATA_LBA + sectors - 1, &file[(sectors - 1) * SECTOR_SIZE], 1);
+    Volume::entry(&e[0], name83, 0x20, 2, size);
+    Volume::entry(&e[32], apple83, 0x20, 2 + clusters[0], 4096);
+    vol.directory(e, 3);
+    vol.fat(clusters, 3);
+}
+
+static void linux_host(Volume &vol, const std::vector<uint8_t> &file, uint32_t size, const char *name83)
+{
+    uint32_t sectors = file.size() / SECTOR_SIZE;
+    uint32_t clusters = clusters_of(size);
+    uint32_t pages = (sectors + 7) / 8;
+    srand(1);
+    for (uint32_t p = 0; p < pages; p++) {
+        if ((p + 1 < pages) && !(rand() % 6)) {
+            // writeback got to the next page first
+            write_data(vol, file, DATA_LBA, (p + 1) * 8, ((p + 2) * 8 <= sectors) ? 8 : (sectors - (p + 1) * 8), 8);
+            write_data(vol, file, DATA_LBA, p * 8, 8, 8);
+            p++;
+        } else {
+            write_data(vol, file, DATA_LBA, p * 8, ((p + 1) * 8 <= sectors) ? 8 : (sectors - p * 8), 8);
+        }
+    }
+    vol.fat(&clusters, 1);
+    uint8_t e[32];
+    Volume::entry(e, name83, 0x20, 2, size);
+    vol.directory(e, 1);
+}
+
+/** Make the 8.3 name of a path, "mbed.hex" is "MBED    HEX"
+ */
+static void short_name(const char *path, char *name83)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    memset(name83, ' ', 11);
+    name83[11] = 0;
+    int i = 0;
+    for (; *base && ('.' != *base) && (i < 8); base++, i++) {
+        name83[i] = toupper(*base);
+    }
+    const char *ext = strrchr(base, '.');
+    for (i = 0; ext && ext[i + 1] && (i < 3); i++) {
+        name83[8 + i] = toupper(ext[i + 1]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image> <out_prefix>\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    uint32_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    // whole sectors, the slack after the end of the file is zeros like a host sends
+    std::vector<uint8_t> file(((size + SECTOR_SIZE - 1) / SECTOR_SIZE) * SECTOR_SIZE, 0);
+    if (fread(&file[0], 1, size, in) != size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+    char name83[12];
+    short_name(argv[1], name83);
+    const char *base = strrchr(argv[1], '/');
+    base = base ? base + 1 : argv[1];
+
+    static const char *hosts[3] = {"windows", "macos", "linux"};
+    int ret = 0;
+    for (int h = 0; h < 3; h++) {
+        MscTrace trace;
+        trace.header.file_lba = DATA_LBA;
+        trace.header.file_size = size;
+        strncpy(trace.header.host, hosts[h], sizeof(trace.header.host) - 1);
+        strncpy(trace.header.image, base, sizeof(trace.header.image) - 1);
+        // the trace points into the volume's sectors until it is saved
+        Volume vol(trace);
+        if (0 == h) {
+            windows(vol, file, size, name83);
+        } else if (1 == h) {
+            macos(vol, file, size, name83);
+        } else {
+            linux_host(vol, file, size, name83);
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s_%s.msct", argv[2], hosts[h]);
+        if (trace.save(path)) {
+            perror(path);
+            ret = 1;
+            continue;
+        }
+        printf("%-32s %5lu writes, %lu us\n", path, (unsigned long)trace.writes.size(), (unsigned long)trace.writes.back().time_us);
+    }
+    return ret;
+}
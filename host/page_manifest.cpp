@@ -0,0 +1,342 @@
+/* Makes, compares and checks page hash manifests (see page_hash.h).
+ *
+ * "build" loads an image through ImageLoader, PageWriter and PageHashSink
+ * into SimFlash, the way the target programs it, and writes the manifest:
+ * the root and a leaf for every flash page. The root PageHashSink kept as
+ * the pages went by has to match the one worked out from the leaves. -f
+ * saves the flash as well, a file standing in for the target's.
+ *
+ * "diff" lists the pages two manifests disagree on, the pages an update
+ * from one image to the other programs.
+ *
+ * "verify" checks a flash file against a manifest a page at a time, each
+ * page with its proof against the root as the target does it with
+ * page_hash_check(). Every page is read, or with -s the pages that changed
+ * since the manifest of the image verified before, plus any -p pages
+ * suspected of being bad. -r is the root the release was signed with, the
+ * manifest has to hash to it.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o page_manifest host/page_manifest.cpp page_hash.cpp sha256.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp srec_decoder.cpp uf2_decoder.cpp elf_decoder.cpp bin_loader.cpp image_loader.cpp page_writer.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   page_manifest build [-f flash.bin] <image> <out.manifest>
+ *   page_manifest diff <old.manifest> <new.manifest>
+ *   page_manifest verify [-s old.manifest] [-p page]... [-r root] <manifest> <flash.bin>
+ *
+ * A manifest is "PHM1", the page size and the number of pages as 32 bit
+ * little endian words, the root and then the leaves in page order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "hex_pipeline.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "page_writer.h"
+#include "page_hash.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+#define MANIFEST_MAGIC  "PHM1"
+
+typedef struct {
+    uint8_t root[PAGE_HASH_SIZE];
+    std::vector<uint8_t> leaves;
+} manifest_t;
+
+/** Every level of the tree from the leaves up, levels[PAGE_HASH_DEPTH] is
+ *  the root
+ */
+static void build_tree(const std::vector<uint8_t> &leaves, std::vector<std::vector<uint8_t> > &levels)
+{
+    levels.assign(1, leaves);
+    for (uint32_t level = 1; level <= PAGE_HASH_DEPTH; level++) {
+        const std::vector<uint8_t> &below = levels[level - 1];
+        std::vector<uint8_t> nodes(below.size() / 2);
+        for (size_t i = 0; i < nodes.size(); i += PAGE_HASH_SIZE) {
+            page_hash_node(&below[2 * i], &below[2 * i + PAGE_HASH_SIZE], &nodes[i]);
+        }
+        levels.push_back(nodes);
+    }
+}
+
+static std::string hex_string(const uint8_t *hash)
+{
+    char text[2 * PAGE_HASH_SIZE + 1];
+    for (int i = 0; i < PAGE_HASH_SIZE; i++) {
+        sprintf(&text[2 * i], "%02x", hash[i]);
+    }
+    return text;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int save_manifest(const char *path, const manifest_t &m)
+{
+    uint8_t head[12];
+    memcpy(head, MANIFEST_MAGIC, 4);
+    put_u32(&head[4], FLASH_PAGE_SIZE);
+    put_u32(&head[8], FLASH_PAGES);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    int ok = (1 == fwrite(head, sizeof(head), 1, f)) && (1 == fwrite(m.root, sizeof(m.root), 1, f)) &&
+             (1 == fwrite(&m.leaves[0], m.leaves.size(), 1, f));
+    return (fclose(f) || !ok) ? -1 : 0;
+}
+
+/** Read a manifest and check its leaves hash to its root
+ *  @return 0 on success, otherwise -1 with a message printed
+ */
+static int load_manifest(const char *path, manifest_t &m)
+{
+    uint8_t head[12];
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    m.leaves.resize(FLASH_PAGES * PAGE_HASH_SIZE);
+    int ok = (1 == fread(head, sizeof(head), 1, f)) && (1 == fread(m.root, sizeof(m.root), 1, f)) &&
+             (1 == fread(&m.leaves[0], m.leaves.size(), 1, f));
+    fclose(f);
+    if (!ok || memcmp(head, MANIFEST_MAGIC, 4) || (FLASH_PAGE_SIZE != get_u32(&head[4])) || (FLASH_PAGES != get_u32(&head[8]))) {
+        fprintf(stderr, "%s: not a manifest for %u pages of %u bytes\n", path, FLASH_PAGES, FLASH_PAGE_SIZE);
+        return -1;
+    }
+    std::vector<std::vector<uint8_t> > levels;
+    build_tree(m.leaves, levels);
+    if (memcmp(&levels[PAGE_HASH_DEPTH][0], m.root, PAGE_HASH_SIZE)) {
+        fprintf(stderr, "%s: the leaves do not hash to the root\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int build(const char *flash_path, const char *image_path, const char *out)
+{
+    FILE *in = fopen(image_path, "rb");
+    if (!in) {
+        perror(image_path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(in);
+    uint32_t size = data.size();
+
+    manifest_t m;
+    m.leaves.resize(FLASH_PAGES * PAGE_HASH_SIZE);
+    SimFlash flash(0, 0);
+    PageHashSink hashes(flash, &m.leaves[0]);
+    PageWriter pages(hashes);
+    HexPipeline hex(pages, host_us);
+    SrecDecoder srec(pages);
+    Uf2Decoder uf2(pages);
+    ElfDecoder elf(pages);
+    BinLoader bin(pages, 0);
+    ImageLoader image;
+    image.add(hex);
+    image.add(srec);
+    image.add(uf2);
+    image.add(elf);
+    image.add(bin);
+    hex_parse_status_t status;
+    uint32_t pos = 0;
+    do {
+        n = ((size - pos) < 4096) ? (size - pos) : 4096;
+        status = image.feed(&data[pos], n);
+        while (image.busy());
+        pos = (HEX_PARSE_SEEK == status) ? image.seek_offset() : (pos + n);
+    } while (((HEX_PARSE_OK == status) || (HEX_PARSE_SEEK == status)) && (pos < size));
+    if (image.flush() || ((HEX_PARSE_OK != status) && (HEX_PARSE_EOF != status)) || pages.stats().rejected || flash.faults()) {
+        fprintf(stderr, "%s: does not load (status %d)\n", image_path, status);
+        return 1;
+    }
+
+    std::vector<std::vector<uint8_t> > levels;
+    build_tree(m.leaves, levels);
+    memcpy(m.root, &levels[PAGE_HASH_DEPTH][0], PAGE_HASH_SIZE);
+    uint8_t streamed[PAGE_HASH_SIZE];
+    hashes.root(streamed);
+    printf("image      %lu bytes of %s, %lu pages programmed, %lu left erased\n", (unsigned long)size, image.name(),
+           (unsigned long)pages.stats().pages, (unsigned long)pages.stats().elided);
+    printf("root       %s\n", hex_string(m.root).c_str());
+    if (!hashes.valid()) {
+        printf("pages went backwards, the root was worked out from the leaves\n");
+    } else if (memcmp(streamed, m.root, PAGE_HASH_SIZE)) {
+        fprintf(stderr, "the streamed root %s DIFFERS\n", hex_string(streamed).c_str());
+        return 1;
+    }
+    if (save_manifest(out, m)) {
+        perror(out);
+        return 1;
+    }
+    if (flash_path && flash.save(flash_path)) {
+        perror(flash_path);
+        return 1;
+    }
+    return 0;
+}
+
+/** Print runs of pages as first-last
+ */
+static void print_pages(const char *label, const std::vector<uint32_t> &list)
+{
+    printf("%-10s %lu", label, (unsigned long)list.size());
+    for (size_t i = 0; i < list.size();) {
+        size_t j = i;
+        while (((j + 1) < list.size()) && (list[j + 1] == (list[j] + 1))) {
+            j++;
+        }
+        printf((j > i) ? " %lu-%lu" : " %lu", (unsigned long)list[i], (unsigned long)list[j]);
+        i = j + 1;
+    }
+    printf("\n");
+}
+
+static void changed_pages(const manifest_t &a, const manifest_t &b, std::set<uint32_t> &pages)
+{
+    for (uint32_t i = 0; i < FLASH_PAGES; i++) {
+        if (memcmp(&a.leaves[i * PAGE_HASH_SIZE], &b.leaves[i * PAGE_HASH_SIZE], PAGE_HASH_SIZE)) {
+            pages.insert(i);
+        }
+    }
+}
+
+static int diff(const char *old_path, const char *new_path)
+{
+    manifest_t a, b;
+    if (load_manifest(old_path, a) || load_manifest(new_path, b)) {
+        return 1;
+    }
+    std::set<uint32_t> pages;
+    changed_pages(a, b, pages);
+    print_pages("changed", std::vector<uint32_t>(pages.begin(), pages.end()));
+    return 0;
+}
+
+static int verify(const char *since, const std::set<uint32_t> &suspects, const char *root, const char *path, const char *flash_path)
+{
+    manifest_t m;
+    if (load_manifest(path, m)) {
+        return 1;
+    }
+    if (root && (hex_string(m.root) != root)) {
+        fprintf(stderr, "%s: root %s is not the one given\n", path, hex_string(m.root).c_str());
+        return 1;
+    }
+    std::set<uint32_t> pages = suspects;
+    if (since) {
+        manifest_t before;
+        if (load_manifest(since, before)) {
+            return 1;
+        }
+        changed_pages(before, m, pages);
+    } else {
+        for (uint32_t i = 0; i < FLASH_PAGES; i++) {
+            pages.insert(i);
+        }
+    }
+    FILE *f = fopen(flash_path, "rb");
+    if (!f) {
+        perror(flash_path);
+        return 1;
+    }
+    std::vector<std::vector<uint8_t> > levels;
+    build_tree(m.leaves, levels);
+    std::vector<uint32_t> bad;
+    uint32_t read = 0;
+    uint32_t start = host_us();
+    for (std::set<uint32_t>::const_iterator it = pages.begin(); it != pages.end(); ++it) {
+        uint32_t index = *it;
+        uint8_t page[FLASH_PAGE_SIZE];
+        uint8_t proof[PAGE_HASH_DEPTH * PAGE_HASH_SIZE];
+        // past the end of the file is erased
+        memset(page, 0xff, sizeof(page));
+        if (!fseek(f, (long)index * FLASH_PAGE_SIZE, SEEK_SET) && fread(page, 1, sizeof(page), f)) {
+            read++;
+        }
+        for (uint32_t level = 0; level < PAGE_HASH_DEPTH; level++) {
+            memcpy(&proof[level * PAGE_HASH_SIZE], &levels[level][((index >> level) ^ 1) * PAGE_HASH_SIZE], PAGE_HASH_SIZE);
+        }
+        if (page_hash_check(index, page, proof, m.root)) {
+            bad.push_back(index);
+        }
+    }
+    uint32_t us = host_us() - start;
+    fclose(f);
+    printf("checked    %lu of %lu pages, %lu KB read, %lu us\n", (unsigned long)pages.size(), (unsigned long)FLASH_PAGES,
+           (unsigned long)(read * FLASH_PAGE_SIZE / 1024), (unsigned long)us);
+    print_pages("bad", bad);
+    return bad.empty() ? 0 : 1;
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s build [-f flash.bin] <image> <out.manifest>\n"
+            "       %s diff <old.manifest> <new.manifest>\n"
+            "       %s verify [-s old.manifest] [-p page]... [-r root] <manifest> <flash.bin>\n", name, name, name);
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+    const char *cmd = argv[1];
+    const char *flash_path = 0;
+    const char *since = 0;
+    const char *root = 0;
+    std::set<uint32_t> suspects;
+    int i = 2;
+    for (; (i + 1 < argc) && ('-' == argv[i][0]); i += 2) {
+        if (!strcmp(cmd, "build") && !strcmp(argv[i], "-f")) {
+            flash_path = argv[i + 1];
+        } else if (!strcmp(cmd, "verify") && !strcmp(argv[i], "-s")) {
+            since = argv[i + 1];
+        } else if (!strcmp(cmd, "verify") && !strcmp(argv[i], "-r")) {
+            root = argv[i + 1];
+        } else if (!strcmp(cmd, "verify") && !strcmp(argv[i], "-p") && (strtoul(argv[i + 1], 0, 0) < FLASH_PAGES)) {
+            suspects.insert(strtoul(argv[i + 1], 0, 0));
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if ((i + 2) != argc) {
+        return usage(argv[0]);
+    }
+    if (!strcmp(cmd, "build")) {
+        return build(flash_path, argv[i], argv[i + 1]);
+    }
+    if (!strcmp(cmd, "diff") && (2 == i)) {
+        return diff(argv[i], argv[i + 1]);
+    }
+    if (!strcmp(cmd, "verify")) {
+        return verify(since, suspects, root, argv[i], argv[i + 1]);
+    }
+    return usage(argv[0]);
+}
@@ -0,0 +1,71 @@
+/* Runs HexPipeline on the host against a simulated sink and reports how much
+ * of the parse time hides behind the sink.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o pipeline_sim host/pipeline_sim.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp
+ *
+ * Usage:
+ *   pipeline_sim <image.hex> <out.bin> [latency_us] [baud]
+ *
+ * out.bin is the decoded data back to back, host/flash_sim places it by address.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hex_pipeline.h"
+#include "sim_sink.h"
+#include "host_clock.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <out.bin> [latency_us] [baud]\n", argv[0]);
+        return 2;
+    }
+    uint32_t latency_us = (argc > 3) ? strtoul(argv[3], 0, 0) : 50;
+    uint32_t baud = (argc > 4) ? strtoul(argv[4], 0, 0) : 921600;
+
+    FILE *in = fopen(argv[1], "rb");
+    FILE *out = fopen(argv[2], "wb");
+    if (!in || !out) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long hex_size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    // the target reads whole blocks so leave a block of slack past the end
+    uint8_t *hex = (uint8_t *)calloc(hex_size + HEX_BLOCK_SIZE, 1);
+    if (fread(hex, 1, hex_size, in) != (size_t)hex_size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+
+    SimSink sink(out, latency_us, baud);
+    HexPipeline pipeline(sink, host_us);
+    hex_parse_status_t status;
+    uint8_t *loc = hex;
+    do {
+        status = pipeline.feed(loc, HEX_BLOCK_SIZE);
+        loc += HEX_BLOCK_SIZE;
+        if ((HEX_PARSE_OK != status) && (HEX_PARSE_EOF != status)) {
+            fprintf(stderr, "parse failure %d at offset %ld\n", status, (long)(loc - hex));
+            return 1;
+        }
+    } while ((HEX_PARSE_EOF != status) && (loc < hex + hex_size));
+    pipeline.flush();
+    fclose(out);
+    free(hex);
+
+    const hex_pipeline_stats_t &s = pipeline.stats();
+    printf("blocks     %lu\n", (unsigned long)s.blocks);
+    printf("parse      %lu us\n", (unsigned long)s.parse_us);
+    printf("sink       %lu us\n", (unsigned long)sink.busy_us());
+    printf("hidden     %lu us (%.1f%% of parse)\n", (unsigned long)s.hidden_us,
+           s.parse_us ? 100.0 * s.hidden_us / s.parse_us : 0.0);
+    printf("stall      %lu us\n", (unsigned long)s.stall_us);
+    printf("total      %lu us (lockstep %lu us)\n", (unsigned long)s.total_us,
+           (unsigned long)(s.parse_us + sink.busy_us()));
+    return (HEX_PARSE_EOF == status) ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/* Replays the sector writes of a file copied onto a USB mass storage disk
+ * through SectorReorder into ImageLoader, PageWriter and SimFlash, and
+ * compares the flash with a reference binary. The write orders are the ones
+ * hosts produce, or a recorded trace.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o reorder_sim host/reorder_sim.cpp sector_reorder.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp srec_decoder.cpp uf2_decoder.cpp elf_decoder.cpp bin_loader.cpp image_loader.cpp page_writer.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   reorder_sim <image> <reference.bin> [trace]
+ *
+ * A trace is a text file with one write per line, "<sector> [count]" with the
+ * sectors numbered from the start of the file, '#' starts a comment. Without
+ * one every built in order is replayed. A refused write goes to the back of
+ * the host's queue, like a command retried after a busy status.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "hex_pipeline.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "page_writer.h"
+#include "sector_reorder.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+typedef std::vector<uint32_t> order_t;
+
+/** Every sector once, front to back
+ */
+static order_t in_order(uint32_t sectors)
+{
+    order_t order;
+    for (uint32_t i = 0; i < sectors; i++) {
+        order.push_back(i);
+    }
+    return order;
+}
+
+/** Neighbours swapped, 1 0 3 2 ...
+ */
+static order_t swapped_pairs(uint32_t sectors)
+{
+    order_t order = in_order(sectors);
+    for (uint32_t i = 0; i + 1 < sectors; i += 2) {
+        order[i] = i + 1;
+        order[i + 1] = i;
+    }
+    return order;
+}
+
+/** 4 KB clusters flushed two at a time, the second one first
+ */
+static order_t clusters_flipped(uint32_t sectors)
+{
+    order_t order;
+    for (uint32_t c = 0; c < sectors; c += 16) {
+        for (uint32_t half = 8; ; half = 0) {
+            for (uint32_t i = c + half; (i < c + half + 8) && (i < sectors); i++) {
+                order.push_back(i);
+            }
+            if (!half) {
+                break;
+            }
+        }
+    }
+    return order;
+}
+
+/** Shuffled within windows of the pool size
+ */
+static order_t shuffled(uint32_t sectors)
+{
+    order_t order = in_order(sectors);
+    for (uint32_t w = 0; w < sectors; w += REORDER_SLOTS) {
+        uint32_t n = ((sectors - w) < REORDER_SLOTS) ? (sectors - w) : REORDER_SLOTS;
+        for (uint32_t i = n - 1; i > 0; i--) {
+            uint32_t j = rand() % (i + 1);
+            uint32_t s = order[w + i];
+            order[w + i] = order[w + j];
+            order[w + j] = s;
+        }
+    }
+    return order;
+}
+
+/** In order, each 16th sector followed by the one before it again, and the
+ *  last sector written ahead of the one before it and again while it is held
+ */
+static order_t rewritten(uint32_t sectors)
+{
+    order_t order;
+    for (uint32_t i = 0; (i + 2) < sectors; i++) {
+        order.push_back(i);
+        if (i && !(i % 16)) {
+            order.push_back(i - 1);
+        }
+    }
+    if (sectors > 1) {
+        order.push_back(sectors - 1);
+        order.push_back(sectors - 1);
+        order.push_back(sectors - 2);
+    } else {
+        order.push_back(0);
+    }
+    return order;
+}
+
+/** Count the writes of a sector already written before in an order
+ */
+static uint32_t repeats(const order_t &order)
+{
+    std::vector<uint8_t> seen;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < order.size(); i++) {
+        if (order[i] >= seen.size()) {
+            seen.resize(order[i] + 1, 0);
+        }
+        count += seen[order[i]];
+        seen[order[i]] = 1;
+    }
+    return count;
+}
+
+/** The last sector first, then the rest
+ */
+static order_t tail_first(uint32_t sectors)
+{
+    order_t order;
+    order.push_back(sectors - 1);
+    for (uint32_t i = 0; i + 1 < sectors; i++) {
+        order.push_back(i);
+    }
+    return order;
+}
+
+static int read_trace(const char *path, order_t *order)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        uint32_t sector = strtoul(line, &end, 0);
+        if ((end == line) || ('#' == line[0])) {
+            continue;
+        }
+        uint32_t count = strtoul(end, 0, 0);
+        for (uint32_t i = 0; i < (count ? count : 1); i++) {
+            order->push_back(sector + i);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+/** Write the sectors in the order given and check the flash, and that every
+ *  sector written again before the end counted as a rewrite
+ *  @param check_rewrites is 0 for a trace, which can write past the end
+ *  @return 1 if it matched the reference
+ */
+static int replay(const char *label, const order_t &order, const uint8_t *data, uint32_t size, const char *reference, int check_rewrites = 1)
+{
+    SimFlash flash(0, 0);
+    PageWriter pages(flash);
+    HexPipeline hex(pages, host_us);
+    SrecDecoder srec(pages);
+    Uf2Decoder uf2(pages);
+    ElfDecoder elf(pages);
+    BinLoader bin(pages, 0);
+    ImageLoader image;
+    image.add(hex);
+    image.add(srec);
+    image.add(uf2);
+    image.add(elf);
+    image.add(bin);
+    SectorReorder reorder(image);
+
+    uint32_t sectors = (size + REORDER_SECTOR_SIZE - 1) / REORDER_SECTOR_SIZE;
+    std::deque<uint32_t> queue(order.begin(), order.end());
+    uint32_t retried = 0;
+    uint32_t refused = 0;
+    uint32_t t = host_us();
+    while (!queue.empty()) {
+        uint32_t sector = queue.front();
+        queue.pop_front();
+        if (sector >= sectors) {
+            continue;
+        }
+        uint32_t n = ((size - sector * REORDER_SECTOR_SIZE) < REORDER_SECTOR_SIZE) ? (size - sector * REORDER_SECTOR_SIZE) : REORDER_SECTOR_SIZE;
+        if (!reorder.write(sector, &data[sector * REORDER_SECTOR_SIZE], n)) {
+            refused = 0;
+            continue;
+        }
+        // the host tries again after the rest of its queue
+        queue.push_back(sector);
+        retried++;
+        if (++refused > queue.size()) {
+            // nothing left in the queue can fill the hole
+            break;
+        }
+    }
+    int ok = !image.flush() && ((HEX_PARSE_EOF == reorder.status()) || ((HEX_PARSE_OK == reorder.status()) && (image.decoder() == &bin)));
+    uint32_t us = host_us() - t;
+    char out[] = "/tmp/reorder_sim.bin";
+    flash.save(out);
+    ok &= !flash.faults() && !pages.stats().rejected && image_files_match(out, reference);
+    const sector_reorder_stats_t &s = reorder.stats();
+    if (check_rewrites) {
+        ok &= (s.rewrites == repeats(order));
+    }
+    printf("%-16s %7lu %7lu %7lu %7lu %7lu %7lu %9lu %s\n", label, (unsigned long)order.size(), (unsigned long)s.held,
+           (unsigned long)s.peak, (unsigned long)s.stalls, (unsigned long)retried, (unsigned long)s.rewrites, (unsigned long)us,
+           ok ? "match" : "MISMATCH");
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image> <reference.bin> [trace]\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    uint32_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (fread(data, 1, size, in) != size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+    uint32_t sectors = (size + REORDER_SECTOR_SIZE - 1) / REORDER_SECTOR_SIZE;
+
+    printf("file       %lu bytes, %lu sectors, pool of %lu\n", (unsigned long)size, (unsigned long)sectors, (unsigned long)REORDER_SLOTS);
+    printf("%-16s %7s %7s %7s %7s %7s %7s %9s\n", "order", "writes", "held", "peak", "stalls", "retried", "rewrite", "us");
+    int ok = 1;
+    if (argc > 3) {
+        order_t order;
+        if (read_trace(argv[3], &order)) {
+            perror("fopen");
+            return 1;
+        }
+        ok &= replay(argv[3], order, data, size, argv[2], 0);
+    } else {
+        ok &= replay("in order", in_order(sectors), data, size, argv[2]);
+        ok &= replay("swapped pairs", swapped_pairs(sectors), data, size, argv[2]);
+        ok &= replay("clusters flipped", clusters_flipped(sectors), data, size, argv[2]);
+        ok &= replay("shuffled", shuffled(sectors), data, size, argv[2]);
+        ok &= replay("rewritten", rewritten(sectors), data, size, argv[2]);
+        ok &= replay("tail first", tail_first(sectors), data, size, argv[2]);
+    }
+    free(data);
+    return ok ? 0 : 1;
+}
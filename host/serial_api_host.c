@@ -0,0 +1,335 @@
+/* Host implementation of serial_api.h. serial_init() opens $SERIAL_HOST_PATH
+ * (default /dev/null), serial_host_open() takes the path directly. The
+ * transmitter is paced at the configured baud rate: serial_writable() follows
+ * THRE (the whole FIFO is empty) and a worker thread raises the TX interrupt
+ * when the FIFO drains, with the handler run under the host_irq lock.
+ *
+ * When the path is a terminal (e.g. a pty) the same thread also receives: it
+ * takes bytes from the terminal no faster than the baud rate into a 16 byte
+ * FIFO and raises the RX interrupt. A byte that finds the FIFO full is lost
+ * and counted in rx_overrun, unless RTS flow control is on, in which case the
+ * line pauses while the FIFO is at its trigger level.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "serial_api.h"
+#include "serial_host.h"
+
+#define HOST_UART_SPIN_NS       100000
+// level at which auto-RTS holds off the sender
+#define HOST_UART_RTS_LEVEL     14
+// bytes taken from the line per wakeup at most
+#define HOST_UART_RX_BURST      64
+
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void host_irq_disable(void)
+{
+    pthread_mutex_lock(&irq_lock);
+}
+
+void host_irq_enable(void)
+{
+    pthread_mutex_unlock(&irq_lock);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t, int spin)
+{
+    struct timespec ts;
+    // the scheduler wakes us late so sleep short and spin the rest to keep interrupt latency low
+    uint64_t s = spin ? t - HOST_UART_SPIN_NS : t;
+    if (s > now_ns()) {
+        ts.tv_sec = s / 1000000000ull;
+        ts.tv_nsec = s % 1000000000ull;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while (spin && (now_ns() < t));
+}
+
+static void tx_flush(serial_t *obj)
+{
+    uint32_t off = 0;
+    while (off < obj->tx_len) {
+        ssize_t n = write(obj->fd, obj->tx_buf + off, obj->tx_len - off);
+        if (n <= 0) {
+            break;
+        }
+        off += n;
+    }
+    obj->tx_len = 0;
+}
+
+/** Bytes still waiting in the FIFO, not counting the one in the shift register
+ */
+static uint32_t tx_fifo_level(serial_t *obj, uint64_t now)
+{
+    if (now >= obj->tx_done_ns) {
+        return 0;
+    }
+    return (uint32_t)((obj->tx_done_ns - now - 1) / obj->byte_ns);
+}
+
+static void raise_irq(serial_t *obj, SerialIrq irq)
+{
+    if (obj->irq_enabled[irq] && obj->handler) {
+        ((uart_irq_handler)obj->handler)(obj->id, irq);
+    }
+}
+
+static void tx_service(serial_t *obj)
+{
+    uint8_t thre;
+    host_irq_disable();
+    pthread_mutex_lock(&obj->lock);
+    thre = obj->thre_armed && (now_ns() + obj->byte_ns >= obj->tx_done_ns);
+    if (thre) {
+        obj->thre_armed = 0;
+        tx_flush(obj);
+    }
+    pthread_mutex_unlock(&obj->lock);
+    if (thre) {
+        raise_irq(obj, TxIrq);
+    }
+    host_irq_enable();
+}
+
+static void rx_service(serial_t *obj)
+{
+    uint8_t line[HOST_UART_RX_BURST];
+    uint64_t now = now_ns();
+    uint64_t due;
+    ssize_t n;
+    if (now < obj->rx_next_ns) {
+        return;
+    }
+    // what the line could have carried since the last byte
+    due = (now - obj->rx_next_ns) / obj->byte_ns + 1;
+    if (due > HOST_UART_RX_BURST) {
+        due = HOST_UART_RX_BURST;
+    }
+    host_irq_disable();
+    pthread_mutex_lock(&obj->lock);
+    if ((FlowControlRTS == obj->flow) || (FlowControlRTSCTS == obj->flow)) {
+        uint32_t level = obj->rx_head - obj->rx_tail;
+        uint32_t room = (level < HOST_UART_RTS_LEVEL) ? HOST_UART_RTS_LEVEL - level : 0;
+        if (due > room) {
+            due = room;
+        }
+    }
+    n = due ? read(obj->rx_fd, line, due) : 0;
+    if (n < 0) {
+        n = 0;
+    }
+    if ((uint64_t)n < due) {
+        // the sender went quiet, no catching up later
+        obj->rx_next_ns = now;
+    } else {
+        obj->rx_next_ns += n * obj->byte_ns;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+        if ((obj->rx_head - obj->rx_tail) == HOST_UART_FIFO_DEPTH) {
+            // give the handler its chance before the byte is lost
+            pthread_mutex_unlock(&obj->lock);
+            raise_irq(obj, RxIrq);
+            pthread_mutex_lock(&obj->lock);
+        }
+        if ((obj->rx_head - obj->rx_tail) == HOST_UART_FIFO_DEPTH) {
+            obj->rx_overrun++;
+            continue;
+        }
+        obj->rx_fifo[obj->rx_head++ % HOST_UART_FIFO_DEPTH] = line[i];
+    }
+    n = obj->rx_head - obj->rx_tail;
+    pthread_mutex_unlock(&obj->lock);
+    if (n) {
+        raise_irq(obj, RxIrq);
+    }
+    host_irq_enable();
+}
+
+static void *uart_thread(void *arg)
+{
+    serial_t *obj = (serial_t *)arg;
+    while (obj->running) {
+        uint64_t thre_ns, wake_ns;
+        uint8_t armed;
+        pthread_mutex_lock(&obj->lock);
+        armed = obj->thre_armed && obj->irq_enabled[TxIrq];
+        // THRE is set once the last byte moves into the shift register
+        thre_ns = obj->tx_done_ns - obj->byte_ns;
+        pthread_mutex_unlock(&obj->lock);
+
+        if (obj->rx_fd >= 0) {
+            // look at the line every few byte times
+            wake_ns = now_ns() + 8 * obj->byte_ns;
+            if (armed && (thre_ns < wake_ns)) {
+                sleep_until(thre_ns, 1);
+                tx_service(obj);
+            } else {
+                sleep_until(wake_ns, 0);
+            }
+            rx_service(obj);
+        } else if (armed) {
+            sleep_until(thre_ns, 1);
+            tx_service(obj);
+        } else {
+            // nothing to do until the interrupt is enabled or a byte is queued
+            usleep(obj->irq_enabled[TxIrq] ? 20 : 1000);
+        }
+    }
+    return NULL;
+}
+
+int serial_host_open(serial_t *obj, const char *path, int baud)
+{
+    memset(obj, 0, sizeof(*obj));
+    obj->rx_fd = -1;
+    obj->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+    if (obj->fd < 0) {
+        return -1;
+    }
+    if (isatty(obj->fd)) {
+        obj->rx_fd = open(path, O_RDONLY | O_NONBLOCK | O_NOCTTY);
+    }
+    pthread_mutex_init(&obj->lock, NULL);
+    serial_baud(obj, baud);
+    obj->rx_next_ns = now_ns();
+    obj->running = 1;
+    pthread_create(&obj->thread, NULL, uart_thread, obj);
+    return 0;
+}
+
+void serial_init(serial_t *obj, PinName tx, PinName rx)
+{
+    const char *path = getenv("SERIAL_HOST_PATH");
+    (void)tx;
+    (void)rx;
+    serial_host_open(obj, path ? path : "/dev/null", 9600);
+}
+
+void serial_free(serial_t *obj)
+{
+    obj->running = 0;
+    pthread_join(obj->thread, NULL);
+    pthread_mutex_lock(&obj->lock);
+    tx_flush(obj);
+    pthread_mutex_unlock(&obj->lock);
+    if (obj->rx_fd >= 0) {
+        close(obj->rx_fd);
+    }
+    close(obj->fd);
+}
+
+void serial_baud(serial_t *obj, int baudrate)
+{
+    obj->baud = baudrate;
+    // 8N1 is 10 bits a byte
+    obj->byte_ns = 10000000000ull / baudrate;
+}
+
+void serial_format(serial_t *obj, int data_bits, SerialParity parity, int stop_bits)
+{
+    (void)obj;
+    (void)data_bits;
+    (void)parity;
+    (void)stop_bits;
+}
+
+void serial_irq_handler(serial_t *obj, uart_irq_handler handler, uint32_t id)
+{
+    obj->handler = (void (*)(uint32_t, int))handler;
+    obj->id = id;
+}
+
+void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
+{
+    obj->irq_enabled[irq] = enable ? 1 : 0;
+}
+
+int serial_getc(serial_t *obj)
+{
+    int c;
+    while (!serial_readable(obj));
+    pthread_mutex_lock(&obj->lock);
+    c = obj->rx_fifo[obj->rx_tail++ % HOST_UART_FIFO_DEPTH];
+    pthread_mutex_unlock(&obj->lock);
+    return c;
+}
+
+void serial_putc(serial_t *obj, int c)
+{
+    uint64_t now;
+    pthread_mutex_lock(&obj->lock);
+    now = now_ns();
+    if (tx_fifo_level(obj, now) >= HOST_UART_FIFO_DEPTH) {
+        // the byte would have been dropped by the hardware
+        obj->tx_overrun++;
+        pthread_mutex_unlock(&obj->lock);
+        return;
+    }
+    obj->tx_done_ns = ((now > obj->tx_done_ns) ? now : obj->tx_done_ns) + obj->byte_ns;
+    obj->thre_armed = 1;
+    obj->tx_buf[obj->tx_len++] = (uint8_t)c;
+    if (obj->tx_len == HOST_UART_TX_BATCH) {
+        tx_flush(obj);
+    }
+    pthread_mutex_unlock(&obj->lock);
+}
+
+int serial_readable(serial_t *obj)
+{
+    int readable;
+    pthread_mutex_lock(&obj->lock);
+    readable = (obj->rx_head != obj->rx_tail);
+    pthread_mutex_unlock(&obj->lock);
+    return readable;
+}
+
+int serial_writable(serial_t *obj)
+{
+    int writable;
+    pthread_mutex_lock(&obj->lock);
+    writable = (now_ns() + obj->byte_ns >= obj->tx_done_ns);
+    pthread_mutex_unlock(&obj->lock);
+    return writable;
+}
+
+void serial_clear(serial_t *obj)
+{
+    pthread_mutex_lock(&obj->lock);
+    obj->rx_tail = obj->rx_head;
+    pthread_mutex_unlock(&obj->lock);
+}
+
+void serial_break_set(serial_t *obj)
+{
+    (void)obj;
+}
+
+void serial_break_clear(serial_t *obj)
+{
+    (void)obj;
+}
+
+void serial_pinout_tx(PinName tx)
+{
+    (void)tx;
+}
+
+void serial_set_flow_control(serial_t *obj, FlowControl type, PinName rxflow, PinName txflow)
+{
+    (void)rxflow;
+    (void)txflow;
+    obj->flow = type;
+}
@@ -0,0 +1,102 @@
+/* Compares sending a file with a putc() per byte against the interrupt driven
+ * transmit ring (serial_tx), on the simulated UART from serial_api_host.c.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -Imbed -o serial_bench host/serial_bench.cpp serial_tx.cpp -x c host/serial_api_host.c -lpthread
+ *
+ * Usage:
+ *   serial_bench <file> <putc|ring> [baud] [out]
+ *
+ * out may be a pseudo-terminal (e.g. one end of socat -d -d pty,raw pty,raw).
+ * CPU is the share of the run the sending loop spent inside the serial code;
+ * in ring mode the rest is free for parsing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "serial_tx.h"
+#include "serial_host.h"
+#include "host_clock.h"
+
+static serial_t uart;
+static serial_tx_ring_t tx;
+
+static void uart_irq(uint32_t id, SerialIrq event)
+{
+    (void)id;
+    if (TxIrq == event) {
+        serial_tx_fifo_fill(&uart, &tx);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <file> <putc|ring> [baud] [out]\n", argv[0]);
+        return 2;
+    }
+    int ring_mode = !strcmp(argv[2], "ring");
+    int baud = (argc > 3) ? atoi(argv[3]) : 921600;
+    const char *out = (argc > 4) ? argv[4] : "/dev/null";
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (fread(data, 1, size, in) != (size_t)size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+
+    if (serial_host_open(&uart, out, baud)) {
+        perror(out);
+        return 1;
+    }
+    serial_tx_ring_init(&tx);
+    serial_irq_handler(&uart, uart_irq, 0);
+    serial_irq_set(&uart, TxIrq, ring_mode);
+
+    uint32_t busy_us = 0;
+    uint32_t start = host_us();
+    if (ring_mode) {
+        long sent = 0;
+        while (sent < size) {
+            uint32_t t = host_us();
+            sent += serial_tx_ring_put(&tx, data + sent, size - sent);
+            host_irq_disable();
+            serial_tx_fifo_fill(&uart, &tx);
+            host_irq_enable();
+            busy_us += host_us() - t;
+            // the main loop would go back to parsing here
+            while ((sent < size) && (serial_tx_ring_used(&tx) > SERIAL_TX_RING_SIZE / 2));
+        }
+        while (serial_tx_ring_used(&tx));
+    } else {
+        for (long i = 0; i < size; i++) {
+            uint32_t t = host_us();
+            while (!serial_writable(&uart));
+            serial_putc(&uart, data[i]);
+            busy_us += host_us() - t;
+        }
+    }
+    // let the last FIFO load leave the wire
+    while (!serial_writable(&uart));
+    uint32_t total_us = host_us() - start;
+    serial_free(&uart);
+
+    double line_us = (double)size * 10 * 1000000 / baud;
+    printf("mode       %s\n", ring_mode ? "ring" : "putc");
+    printf("bytes      %ld\n", size);
+    printf("time       %lu us (line minimum %.0f us)\n", (unsigned long)total_us, line_us);
+    printf("throughput %.0f B/s (%.1f%% of line rate)\n", size * 1e6 / total_us, 100.0 * line_us / total_us);
+    printf("cpu        %lu us (%.1f%%)\n", (unsigned long)busy_us, 100.0 * busy_us / total_us);
+    printf("overruns   %lu\n", (unsigned long)uart.tx_overrun);
+    free(data);
+    return uart.tx_overrun ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef SERIAL_HOST_H
+#define SERIAL_HOST_H
+
+#include "serial_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Open a host serial port on a file, fifo or pseudo-terminal
+ *  @param obj is the serial port to set up
+ *  @param path is the file to send to
+ *  @param baud is the simulated line rate
+ *  @return 0 on success, -1 if path could not be opened
+ */
+int serial_host_open(serial_t *obj, const char *path, int baud);
+
+/** Host stand-ins for __disable_irq()/__enable_irq(). The simulated interrupt
+ *   handlers only run while the lock is free.
+ */
+void host_irq_disable(void);
+void host_irq_enable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
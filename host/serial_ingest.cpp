@@ -0,0 +1,216 @@
+/* Streams a hex image into HexPipeline through the receive ring (serial_rx),
+ * over a pseudo-terminal driven by serial_api_host.c. A sender thread writes
+ * the image into the other end of the pty at the baud rate and honours
+ * XON/XOFF; the decoded output goes to a SimSink.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -Imbed -o serial_ingest host/serial_ingest.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp serial_rx.cpp serial_tx.cpp -x c host/serial_api_host.c -lpthread
+ *
+ * Usage:
+ *   serial_ingest <image.hex> <out.bin> [baud] [none|xonxoff|rts] [sink_latency_us]
+ *
+ * A sink latency that makes the parser slower than the line shows the flow
+ * control at work: with "none" bytes are lost, with xonxoff or rts they are not.
+ */
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include "hex_pipeline.h"
+#include "serial_rx.h"
+#include "serial_tx.h"
+#include "serial_host.h"
+#include "sim_sink.h"
+#include "host_clock.h"
+
+enum {
+    FLOW_NONE = 0,
+    FLOW_XONXOFF,
+    FLOW_RTS
+};
+
+static serial_t uart;
+static serial_tx_ring_t tx;
+static serial_rx_ring_t rx;
+static int flow;
+
+typedef struct {
+    int fd;
+    const uint8_t *data;
+    long size;
+    uint32_t baud;
+    uint32_t xoff_cnt;
+} sender_t;
+
+static void uart_irq(uint32_t id, SerialIrq event)
+{
+    (void)id;
+    if (TxIrq == event) {
+        serial_tx_fifo_fill(&uart, &tx);
+        return;
+    }
+    if (!serial_rx_fifo_drain(&uart, &rx)) {
+        return;
+    }
+    if (FLOW_XONXOFF == flow) {
+        serial_tx_send_urgent(&uart, &tx, XOFF);
+    } else if (FLOW_RTS == flow) {
+        serial_irq_set(&uart, RxIrq, 0);
+    }
+}
+
+/** The host end of the link: a UART sending the image at the baud rate
+ */
+static void *sender_thread(void *arg)
+{
+    sender_t *s = (sender_t *)arg;
+    const uint32_t chunk = 16;
+    uint32_t chunk_us = chunk * 10 * 1000000 / s->baud;
+    uint32_t next = host_us();
+    int stopped = 0;
+    long off = 0;
+    while (off < s->size) {
+        uint8_t c;
+        while (read(s->fd, &c, 1) == 1) {
+            if ((XOFF == c) && !stopped) {
+                stopped = 1;
+                s->xoff_cnt++;
+            } else if (XON == c) {
+                stopped = 0;
+            }
+        }
+        if (stopped || ((int32_t)(host_us() - next) < 0)) {
+            usleep(10);
+            continue;
+        }
+        uint32_t n = ((s->size - off) < chunk) ? (s->size - off) : chunk;
+        // blocks when the line is held off by RTS
+        ssize_t w = write(s->fd, s->data + off, n);
+        if (w > 0) {
+            off += w;
+        }
+        next += chunk_us;
+        if ((int32_t)(host_us() - next) > (int32_t)(8 * chunk_us)) {
+            // fell behind, e.g. while stopped, restart the pacing from now
+            next = host_us();
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <image.hex> <out.bin> [baud] [none|xonxoff|rts] [sink_latency_us]\n", argv[0]);
+        return 2;
+    }
+    uint32_t baud = (argc > 3) ? strtoul(argv[3], 0, 0) : 921600;
+    flow = (argc > 4) ? (!strcmp(argv[4], "rts") ? FLOW_RTS : !strcmp(argv[4], "none") ? FLOW_NONE : FLOW_XONXOFF) : FLOW_XONXOFF;
+    uint32_t latency_us = (argc > 5) ? strtoul(argv[5], 0, 0) : 0;
+
+    FILE *in = fopen(argv[1], "rb");
+    FILE *out = fopen(argv[2], "wb");
+    if (!in || !out) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long hex_size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *hex = (uint8_t *)malloc(hex_size);
+    if (fread(hex, 1, hex_size, in) != (size_t)hex_size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+
+    // a raw pty pair, the slave side is the target's UART
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || grantpt(master) || unlockpt(master)) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char *slave_path = ptsname(master);
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (serial_host_open(&uart, slave_path, baud)) {
+        perror(slave_path);
+        return 1;
+    }
+    serial_tx_ring_init(&tx);
+    serial_rx_ring_init(&rx);
+    if (FLOW_RTS == flow) {
+        serial_set_flow_control(&uart, FlowControlRTS, NC, NC);
+    }
+    serial_irq_handler(&uart, uart_irq, 0);
+    serial_irq_set(&uart, TxIrq, 1);
+    serial_irq_set(&uart, RxIrq, 1);
+
+    SimSink sink(out, latency_us, 0);
+    HexPipeline pipeline(sink, host_us);
+
+    sender_t sender = {master, hex, hex_size, baud, 0};
+    pthread_t thread;
+    uint32_t start = host_us();
+    pthread_create(&thread, NULL, sender_thread, &sender);
+
+    hex_parse_status_t status = HEX_PARSE_OK;
+    uint32_t received = 0;
+    // the target's main loop
+    while (HEX_PARSE_OK == status) {
+        const uint8_t *data;
+        uint32_t size = serial_rx_peek(&rx, &data);
+        if (!size) {
+            usleep(50);
+            if ((int32_t)(host_us() - start) > 60 * 1000000) {
+                fprintf(stderr, "stalled after %lu bytes\n", (unsigned long)received);
+                break;
+            }
+            continue;
+        }
+        status = pipeline.feed(data, size);
+        received += size;
+        if (serial_rx_consume(&rx, size)) {
+            host_irq_disable();
+            if (FLOW_XONXOFF == flow) {
+                serial_tx_send_urgent(&uart, &tx, XON);
+            } else if (FLOW_RTS == flow) {
+                serial_irq_set(&uart, RxIrq, 1);
+                serial_rx_fifo_drain(&uart, &rx);
+            }
+            host_irq_enable();
+        }
+    }
+    pipeline.flush();
+    uint32_t total_us = host_us() - start;
+    pthread_join(thread, NULL);
+    serial_free(&uart);
+    close(slave);
+    close(master);
+    fclose(out);
+
+    double line_us = (double)received * 10 * 1000000 / baud;
+    const hex_pipeline_stats_t &s = pipeline.stats();
+    printf("status     %s\n", (HEX_PARSE_EOF == status) ? "eof" : "failed");
+    printf("received   %lu of %ld bytes\n", (unsigned long)received, hex_size);
+    printf("time       %lu us (line minimum %.0f us)\n", (unsigned long)total_us, line_us);
+    printf("ingest     %.0f B/s (%.1f%% of line rate)\n", received * 1e6 / total_us, 100.0 * line_us / total_us);
+    printf("parse      %lu us\n", (unsigned long)s.parse_us);
+    printf("ring peak  %lu of %u\n", (unsigned long)rx.peak, SERIAL_RX_RING_SIZE);
+    printf("xoff       %lu\n", (unsigned long)sender.xoff_cnt);
+    printf("overruns   ring %lu uart %lu\n", (unsigned long)rx.overrun, (unsigned long)uart.rx_overrun);
+    free(hex);
+    return ((HEX_PARSE_EOF == status) && !rx.overrun && !uart.rx_overrun) ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block_sink.h"
+#include "flash_layout.h"
+#include "host_clock.h"
+
+/** Host stand-in for the target's flash. It starts out full of old data, an
+ *  erase sets a sector to 0xff and a page can only be programmed once after
+ *  that, anything else is counted as a fault. Erases and page programs take
+ *  erase_us and program_us like the IAP calls do.
+ */
+class SimFlash : public BlockSink {
+
+public:
+    SimFlash(uint32_t program_us, uint32_t erase_us) :
+        _program_us(program_us), _erase_us(erase_us), _done(host_us()), _end(0), _faults(0), _busy_us(0) {
+        _image = (uint8_t *)malloc(FLASH_SIZE);
+        _programmed = (uint8_t *)calloc(FLASH_PAGES, 1);
+        _erased = (uint8_t *)calloc(FLASH_SECTORS, 1);
+        for (uint32_t i = 0; i < FLASH_SIZE; i++) {
+            _image[i] = (uint8_t)(i * 7);
+        }
+    }
+
+    ~SimFlash() {
+        free(_image);
+        free(_programmed);
+        free(_erased);
+    }
+
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size) {
+        if (busy()) {
+            return -1;
+        }
+        uint32_t start, sector_size;
+        int32_t sector = flash_sector(addr, &start, &sector_size);
+        uint32_t page = addr / FLASH_PAGE_SIZE;
+        if ((sector < 0) || (addr % FLASH_PAGE_SIZE) || (FLASH_PAGE_SIZE != size) || !_erased[sector] || _programmed[page]) {
+            _faults++;
+            return 0;
+        }
+        memcpy(&_image[addr], data, size);
+        _programmed[page] = 1;
+        if (addr + size > _end) {
+            _end = addr + size;
+        }
+        start_op(_program_us);
+        return 0;
+    }
+
+    virtual int erase(uint32_t addr, uint32_t size) {
+        if (busy()) {
+            return -1;
+        }
+        uint32_t start, sector_size;
+        int32_t sector = flash_sector(addr, &start, &sector_size);
+        if ((sector < 0) || (start != addr) || (sector_size != size)) {
+            _faults++;
+            return 0;
+        }
+        memset(&_image[start], 0xff, sector_size);
+        memset(&_programmed[start / FLASH_PAGE_SIZE], 0, sector_size / FLASH_PAGE_SIZE);
+        _erased[sector] = 1;
+        start_op(_erase_us);
+        return 0;
+    }
+
+    virtual int busy() {
+        return (int32_t)(host_us() - _done) < 0;
+    }
+
+    /** Save flash from 0 up to the end of the highest page programmed
+     */
+    int save(const char *path) const {
+        FILE *f = fopen(path, "wb");
+        if (!f) {
+            return -1;
+        }
+        fwrite(_image, 1, _end, f);
+        fclose(f);
+        return 0;
+    }
+
+    /** Get the flash contents, programmed up to size()
+     */
+    const uint8_t *image() const {
+        return _image;
+    }
+
+    uint32_t size() const {
+        return _end;
+    }
+
+    uint32_t faults() const {
+        return _faults;
+    }
+
+    uint32_t busy_us() const {
+        return _busy_us;
+    }
+
+private:
+    void start_op(uint32_t us) {
+        _done = host_us() + us;
+        _busy_us += us;
+    }
+
+    uint32_t _program_us;
+    uint32_t _erase_us;
+    uint32_t _done;
+    uint32_t _end;
+    uint32_t _faults;
+    uint32_t _busy_us;
+    uint8_t *_image;
+    uint8_t *_programmed;
+    uint8_t *_erased;
+};
+
+/** Compare a loaded image with a reference binary. Flash past the end of the
+ *  shorter one reads as erased, so the other must be 0xff there
+ *  @return 1 if they match, otherwise 0
+ */
+static inline int image_files_match(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int match = fa && fb;
+    while (match) {
+        int ca = fgetc(fa);
+        int cb = fgetc(fb);
+        if ((EOF == ca) && (EOF == cb)) {
+            break;
+        }
+        match = (((EOF == ca) ? 0xff : ca) == ((EOF == cb) ? 0xff : cb));
+    }
+    if (fa) {
+        fclose(fa);
+    }
+    if (fb) {
+        fclose(fb);
+    }
+    return match;
+}
+
+#endif
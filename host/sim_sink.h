@@ -0,0 +1,65 @@
+#ifndef SIM_SINK_H
+#define SIM_SINK_H
+
+#include <stdio.h>
+#include "block_sink.h"
+#include "host_clock.h"
+
+/** Host stand-in for a slow sink. A block takes latency_us plus its transfer
+ *  time at the given baud rate to drain. The data is only written to the
+ *  output file once the block completes, so a caller that reuses a buffer
+ *  before busy() returns 0 corrupts the output just like on the target.
+ */
+class SimSink : public BlockSink {
+
+public:
+    SimSink(FILE *out, uint32_t latency_us, uint32_t baud) :
+        _out(out), _latency_us(latency_us), _baud(baud), _data(0), _size(0), _done(0), _busy_us(0) {
+    }
+
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size) {
+        (void)addr;
+        if (busy()) {
+            return -1;
+        }
+        uint32_t drain_us = _latency_us;
+        if (_baud) {
+            // 10 bits a byte on the wire
+            drain_us += (uint32_t)((uint64_t)size * 10 * 1000000 / _baud);
+        }
+        _data = data;
+        _size = size;
+        _done = host_us() + drain_us;
+        _busy_us += drain_us;
+        return 0;
+    }
+
+    virtual int busy() {
+        if (!_data) {
+            return 0;
+        }
+        if ((int32_t)(host_us() - _done) < 0) {
+            return 1;
+        }
+        fwrite(_data, 1, _size, _out);
+        _data = 0;
+        return 0;
+    }
+
+    /** Total time the sink spent draining blocks
+     */
+    uint32_t busy_us() const {
+        return _busy_us;
+    }
+
+private:
+    FILE *_out;
+    uint32_t _latency_us;
+    uint32_t _baud;
+    const uint8_t *_data;
+    uint32_t _size;
+    uint32_t _done;
+    uint32_t _busy_us;
+};
+
+#endif
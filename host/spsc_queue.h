@@ -0,0 +1,112 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <atomic>
+
+/** A bounded queue between one producer thread and one consumer thread.
+ *  push() and pop() take no lock, each side only writes its own index. The
+ *  blocking put() and get() spin a little and then sleep on a futex until
+ *  the other side moves, so a stage waiting for the disk does not burn a
+ *  core.
+ *
+ *  SIZE must be a power of two, all SIZE slots can be used.
+ *
+ * Example:
+ * @code
+ * SpscQueue<chunk_t, 8> full;
+ * // reader thread
+ * full.put(chunk);
+ * // decoder thread
+ * chunk_t chunk = full.get();
+ * @endcode
+ */
+template <typename T, uint32_t SIZE>
+class SpscQueue {
+
+public:
+    SpscQueue() : _head(0), _tail(0), _wants_item(0), _wants_room(0) {
+    }
+
+    /** Add an item if there is room, from the producer
+     *  @return 0 on success, -1 when the queue is full
+     */
+    int push(const T &item) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if ((tail - _head.load(std::memory_order_acquire)) == SIZE) {
+            return -1;
+        }
+        _items[tail & (SIZE - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_seq_cst);
+        wake(_tail, _wants_item);
+        return 0;
+    }
+
+    /** Take the oldest item if there is one, from the consumer
+     *  @return 0 on success, -1 when the queue is empty
+     */
+    int pop(T &item) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return -1;
+        }
+        item = _items[head & (SIZE - 1)];
+        _head.store(head + 1, std::memory_order_seq_cst);
+        wake(_head, _wants_room);
+        return 0;
+    }
+
+    /** Add an item, waiting for room
+     */
+    void put(const T &item) {
+        while (push(item)) {
+            uint32_t head = _head.load();
+            wait(_head, _wants_room, head, (_tail.load(std::memory_order_relaxed) - head) == SIZE);
+        }
+    }
+
+    /** Take the oldest item, waiting for one
+     */
+    T get() {
+        T item;
+        while (pop(item)) {
+            uint32_t tail = _tail.load();
+            wait(_tail, _wants_item, tail, tail == _head.load(std::memory_order_relaxed));
+        }
+        return item;
+    }
+
+private:
+    void wait(std::atomic<uint32_t> &index, std::atomic<uint32_t> &waiting, uint32_t seen, int blocked) {
+        for (int i = 0; blocked && (i < 100) && (index.load(std::memory_order_acquire) == seen); i++) {
+        }
+        if (!blocked || (index.load(std::memory_order_acquire) != seen)) {
+            return;
+        }
+        waiting.store(1);
+        // the other side checks waiting after it moves the index
+        if (index.load() == seen) {
+            syscall(SYS_futex, (uint32_t *)&index, FUTEX_WAIT_PRIVATE, seen, (void *)0, (void *)0, 0);
+        }
+        waiting.store(0);
+    }
+
+    void wake(std::atomic<uint32_t> &index, std::atomic<uint32_t> &waiting) {
+        if (waiting.load()) {
+            syscall(SYS_futex, (uint32_t *)&index, FUTEX_WAKE_PRIVATE, 1, (void *)0, (void *)0, 0);
+        }
+    }
+
+    // the consumer's and the producer's positions, on lines of their own
+    alignas(64) std::atomic<uint32_t> _head;
+    alignas(64) std::atomic<uint32_t> _tail;
+    // the consumer is asleep on _tail, the producer on _head
+    alignas(64) std::atomic<uint32_t> _wants_item;
+    std::atomic<uint32_t> _wants_room;
+    T _items[SIZE];
+};
+
+#endif
@@ -0,0 +1,279 @@
+/* Replays MSC write traces (see msc_trace.h) the way the target would see
+ * them: every write of a sector of the dropped file goes through
+ * SectorReorder into the decoder, PageWriter and SimFlash, a write the
+ * reorder stage refuses is retried after the rest of the host's queue. The
+ * decoder is ImageLoader, or with -legacy the old parse_hex_blob() behind an
+ * ImageDecoder.
+ *
+ * For each trace it prints the throughput over the file, the RAM the stage
+ * needs (the decoder state plus the most of the reorder pool in use), the
+ * longest a single write command took and how many took longer than the gap
+ * to the next one, and checks the flash against the reference.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o trace_bench host/trace_bench.cpp sector_reorder.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp srec_decoder.cpp uf2_decoder.cpp elf_decoder.cpp bin_loader.cpp image_loader.cpp page_writer.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   trace_bench [-legacy] <reference> <trace>...
+ *
+ * The reference is a binary (test/testapp.bin) or an old serial dump
+ * (test/test_app_validate.txt). A dump has the data in order but the gaps
+ * padded out to the end of a 512 byte block rather than to the next
+ * address, so it is compared with every run of 0xff taken as one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "hex_pipeline.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "page_writer.h"
+#include "sector_reorder.h"
+#include "msc_trace.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+#define RUNS    20
+
+/** parse_hex_blob() as an ImageDecoder. Its state is static, so there can
+ *  only be one and an image has to be finished before the next one starts
+ */
+class LegacyHexDecoder : public ImageDecoder {
+
+public:
+    LegacyHexDecoder(BlockSink &sink) : _sink(sink) {
+    }
+
+    virtual int detect(const uint8_t *data, uint32_t size) {
+        return size ? (':' == data[0]) : -1;
+    }
+
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size) {
+        while (size) {
+            uint32_t used, addr, cnt;
+            hex_parse_status_t status = parse_hex_blob((uint8_t *)data, size, &used, _bin, sizeof(_bin), &addr, &cnt);
+            if (cnt) {
+                // _bin is decoded into again right away
+                while (_sink.busy());
+                if (_sink.write(addr, _bin, cnt)) {
+                    return HEX_PARSE_REJECTED;
+                }
+                while (_sink.busy());
+            }
+            data += used;
+            size -= used;
+            if ((HEX_PARSE_OK != status) && (HEX_PARSE_UNALIGNED != status)) {
+                return status;
+            }
+        }
+        return HEX_PARSE_OK;
+    }
+
+    virtual int flush() {
+        return _sink.sync();
+    }
+
+    virtual const char *name() const {
+        return "legacy hex";
+    }
+
+private:
+    BlockSink &_sink;
+    // the size the old main() used
+    uint8_t _bin[256];
+};
+
+typedef struct {
+    uint32_t bytes;         // of the file decoded in one replay
+    uint32_t us;            // all replays
+    uint32_t ram;           // decoder state and the reorder pool at its peak
+    uint32_t worst_us;      // longest write command, the best of the runs for each
+    uint32_t overruns;      // commands that took longer than the gap to the next
+    uint32_t retried;       // commands refused by the reorder stage and sent again
+    int match;              // the flash matched the reference
+    int done;               // and the decoder saw the end of the image
+} replay_result_t;
+
+/** Compare a flash image with the reference, with every run of 0xff taken as
+ *  one for an old serial dump
+ */
+static int reference_match(const uint8_t *image, uint32_t size, const std::vector<uint8_t> &ref, int dump)
+{
+    uint32_t i = 0, j = 0;
+    while ((i < size) || (j < ref.size())) {
+        uint8_t a = (i < size) ? image[i] : 0xff;
+        uint8_t b = (j < ref.size()) ? ref[j] : 0xff;
+        if (dump && (0xff == a) && (0xff == b)) {
+            while ((i < size) && (0xff == image[i])) {
+                i++;
+            }
+            while ((j < ref.size()) && (0xff == ref[j])) {
+                j++;
+            }
+            continue;
+        }
+        if (a != b) {
+            return 0;
+        }
+        i++;
+        j++;
+    }
+    return 1;
+}
+
+typedef struct {
+    uint32_t index;     // in the trace, for the time of the next write
+    uint32_t lba;
+    uint32_t count;
+    const uint8_t *data;
+} command_t;
+
+/** Replay a trace once
+ *  @param cost is set to the time spent on each write of the trace, retries included
+ *  @return 1 if the decoder finished the image
+ */
+static int replay(const MscTrace &trace, ImageDecoder &decoder, SectorReorder &reorder, replay_result_t *r, std::vector<uint32_t> &cost)
+{
+    const msc_trace_header_t &h = trace.header;
+    uint32_t sectors = (h.file_size + h.sector_size - 1) / h.sector_size;
+    std::deque<command_t> queue;
+    for (uint32_t i = 0; i < trace.writes.size(); i++) {
+        command_t c = {i, trace.writes[i].lba, trace.writes[i].count, trace.writes[i].data};
+        queue.push_back(c);
+    }
+    uint32_t refused = 0;
+    uint32_t retried = 0;
+    uint32_t start = host_us();
+    while (!queue.empty()) {
+        command_t c = queue.front();
+        queue.pop_front();
+        uint32_t t = host_us();
+        uint32_t i = 0;
+        for (; i < c.count; i++) {
+            uint32_t lba = c.lba + i;
+            if ((lba < h.file_lba) || (lba >= (h.file_lba + sectors))) {
+                // FAT, directory or another file
+                continue;
+            }
+            uint32_t offset = (lba - h.file_lba) * h.sector_size;
+            uint32_t n = ((h.file_size - offset) < h.sector_size) ? (h.file_size - offset) : h.sector_size;
+            if (reorder.write(lba - h.file_lba, &c.data[i * h.sector_size], n)) {
+                break;
+            }
+        }
+        cost[c.index] += host_us() - t;
+        if (i < c.count) {
+            // busy, the host sends the rest again after its other commands
+            command_t rest = {c.index, c.lba + i, c.count - i, &c.data[i * h.sector_size]};
+            queue.push_back(rest);
+            retried++;
+            if (++refused > queue.size()) {
+                break;
+            }
+        } else {
+            refused = 0;
+        }
+    }
+    int ok = !decoder.flush();
+    r->us += host_us() - start;
+    r->bytes = h.file_size;
+    r->retried = retried;
+    return ok;
+}
+
+static void run(const char *path, int legacy, const std::vector<uint8_t> &ref, int dump, int *ok)
+{
+    MscTrace trace;
+    if (trace.load(path)) {
+        printf("%-34s not a trace\n", path);
+        *ok = 0;
+        return;
+    }
+    replay_result_t r;
+    memset(&r, 0, sizeof(r));
+    // the host is not quiet, so each write counts with its quickest run
+    std::vector<uint32_t> best(trace.writes.size(), 0xffffffff);
+    for (int run = 0; run < RUNS; run++) {
+        SimFlash flash(0, 0);
+        PageWriter pages(flash);
+        HexPipeline hex(pages, host_us);
+        SrecDecoder srec(pages);
+        Uf2Decoder uf2(pages);
+        ElfDecoder elf(pages);
+        ImageLoader image;
+        image.add(hex);
+        image.add(srec);
+        image.add(uf2);
+        image.add(elf);
+        LegacyHexDecoder fresh(pages);
+        ImageDecoder &decoder = legacy ? (ImageDecoder &)fresh : (ImageDecoder &)image;
+        SectorReorder reorder(decoder);
+        std::vector<uint32_t> cost(trace.writes.size(), 0);
+        int done = replay(trace, decoder, reorder, &r, cost);
+        for (size_t i = 0; i < cost.size(); i++) {
+            best[i] = (cost[i] < best[i]) ? cost[i] : best[i];
+        }
+        hex_parse_status_t status = reorder.status();
+        done &= (HEX_PARSE_EOF == status);
+        uint32_t state = sizeof(pages) + sizeof(reorder) - sizeof(uint8_t[REORDER_SLOTS][REORDER_SECTOR_SIZE]);
+        if (legacy) {
+            state += sizeof(fresh) + sizeof(hex_line_t);
+        } else {
+            ImageDecoder *picked = image.decoder();
+            state += sizeof(image) + ((picked == &hex) ? sizeof(hex) : (picked == &srec) ? sizeof(srec) : (picked == &uf2) ? sizeof(uf2) : sizeof(elf));
+        }
+        r.ram = state + reorder.stats().peak * REORDER_SECTOR_SIZE;
+        r.match = !flash.faults() && !pages.stats().rejected && reference_match(flash.image(), flash.size(), ref, dump);
+        r.done = done;
+        if (!r.match || !r.done) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < best.size(); i++) {
+        if (best[i] > r.worst_us) {
+            r.worst_us = best[i];
+        }
+        if ((i + 1 < best.size()) && (best[i] > (trace.writes[i + 1].time_us - trace.writes[i].time_us))) {
+            r.overruns++;
+        }
+    }
+    const char *base = strrchr(path, '/');
+    printf("%-34s %-8s %8lu %8.1f %7lu %8lu %8lu %7lu %s\n", base ? base + 1 : path, trace.header.host,
+           (unsigned long)r.bytes, (double)r.bytes * RUNS / (r.us ? r.us : 1), (unsigned long)r.ram,
+           (unsigned long)r.worst_us, (unsigned long)r.overruns, (unsigned long)r.retried, !r.match ? "MISMATCH" : (r.done ? "match" : "match, no end"));
+    *ok &= r.match && r.done;
+}
+
+int main(int argc, char *argv[])
+{
+    int legacy = (argc > 1) && !strcmp(argv[1], "-legacy");
+    int first = legacy ? 2 : 1;
+    if (argc < first + 2) {
+        fprintf(stderr, "usage: %s [-legacy] <reference> <trace>...\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[first], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    std::vector<uint8_t> ref;
+    int c;
+    while (EOF != (c = fgetc(in))) {
+        ref.push_back((uint8_t)c);
+    }
+    fclose(in);
+    int dump = !!strstr(argv[first], "_validate");
+
+    printf("%-34s %-8s %8s %8s %7s %8s %8s %7s\n", "trace", "host", "bytes", "MB/s", "ram", "worst us", "overruns", "retried");
+    int ok = 1;
+    for (int i = first + 1; i < argc; i++) {
+        run(argv[i], legacy, ref, dump, &ok);
+    }
+    return ok ? 0 : 1;
+}
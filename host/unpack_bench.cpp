@@ -0,0 +1,224 @@
+/* Checks and times unpack.cpp. The hex image is packed with zlib (gzip, with
+ * the window limited to UNPACK_WINDOW) and with heatshrink_pack.h, unpacked
+ * again in randomly sized pieces and compared with the original. The unpacked
+ * stream is also parsed by HexPipeline straight out of the window into a
+ * SimFlash, the way main() does it, and the flash compared with a reference
+ * binary such as test/mbed.bin. Last, streams cut short at a few places have
+ * to stop with UNPACK_ERROR (gzip) or come up short (heatshrink, which has no
+ * end marker) rather than wait for input forever.
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o unpack_bench host/unpack_bench.cpp unpack.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp page_writer.cpp flash_layout.cpp -lz
+ *
+ * Usage:
+ *   unpack_bench <image.hex> [reference.bin] [out_prefix]
+ *
+ * With out_prefix the packed images are kept as <out_prefix>.gz and .hs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "unpack.h"
+#include "hex_pipeline.h"
+#include "heatshrink_pack.h"
+#include "page_writer.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+#define RUNS    20
+
+/** Unpack a stream fed in randomly sized pieces
+ *   @return the number of bytes unpacked, -1 on error or -2 if it stops
+ *    getting anywhere without ending
+ */
+static long unpack_all(unpack_format_t format, const uint8_t *in, uint32_t size, uint8_t *out, uint32_t out_size)
+{
+    static unpack_t s;
+    uint32_t pos = 0, n = 0, idle = 0;
+    unpack_init(&s, format);
+    while (1) {
+        uint32_t before = pos;
+        uint32_t chunk = 1 + rand() % 512;
+        if (chunk > (size - pos)) {
+            chunk = size - pos;
+        }
+        pos += unpack_write(&s, &in[pos], chunk);
+        if (pos == size) {
+            unpack_finish(&s);
+        }
+        const uint8_t *data;
+        uint32_t cnt = unpack_read(&s, &data);
+        if ((n + cnt) > out_size) {
+            return -1;
+        }
+        memcpy(&out[n], data, cnt);
+        n += cnt;
+        unpack_consume(&s, cnt);
+        if (!cnt && (UNPACK_OK != s.status)) {
+            break;
+        }
+        idle = (cnt || (pos != before)) ? 0 : (idle + 1);
+        if (idle > 16) {
+            return -2;
+        }
+    }
+    return (UNPACK_DONE == s.status) ? (long)n : -1;
+}
+
+/** Unpack and parse in one pass the way main() does
+ *   @return the parse status at the end
+ */
+static hex_parse_status_t unpack_parse(unpack_format_t format, const uint8_t *in, uint32_t size, const char *out)
+{
+    static unpack_t s;
+    SimFlash flash(0, 0);
+    PageWriter pages(flash);
+    HexPipeline pipeline(pages, host_us);
+    hex_parse_status_t status = HEX_PARSE_OK;
+    uint32_t pos = 0;
+    unpack_init(&s, format);
+    while (HEX_PARSE_OK == status) {
+        pos += unpack_write(&s, &in[pos], size - pos);
+        if (pos == size) {
+            unpack_finish(&s);
+        }
+        const uint8_t *data;
+        uint32_t cnt = unpack_read(&s, &data);
+        if (!cnt) {
+            if (UNPACK_OK != s.status) {
+                break;
+            }
+            continue;
+        }
+        status = pipeline.feed(data, cnt);
+        unpack_consume(&s, cnt);
+    }
+    pipeline.flush();
+    flash.save(out);
+    return status;
+}
+
+static void save(const char *prefix, const char *ext, const uint8_t *data, uint32_t size)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", prefix, ext);
+    FILE *f = fopen(path, "wb");
+    if (f) {
+        fwrite(data, 1, size, f);
+        fclose(f);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <image.hex> [reference.bin] [out_prefix]\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen");
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    uint32_t size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *hex = (uint8_t *)malloc(size);
+    if (fread(hex, 1, size, in) != size) {
+        perror("fread");
+        return 1;
+    }
+    fclose(in);
+
+    // gzip with the window the target can hold
+    uLongf gz_size = compressBound(size) + 64;
+    uint8_t *gz = (uint8_t *)malloc(gz_size);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    deflateInit2(&z, 9, Z_DEFLATED, 16 + UNPACK_WINDOW_BITS, 9, Z_DEFAULT_STRATEGY);
+    z.next_in = hex;
+    z.avail_in = size;
+    z.next_out = gz;
+    z.avail_out = gz_size;
+    deflate(&z, Z_FINISH);
+    gz_size = z.total_out;
+    deflateEnd(&z);
+
+    uint8_t *hs = (uint8_t *)malloc(size * 9 / 8 + 1);
+    uint32_t hs_size = heatshrink_pack(hex, size, hs);
+
+    if (argc > 3) {
+        save(argv[3], ".gz", gz, gz_size);
+        save(argv[3], ".hs", hs, hs_size);
+    }
+
+    printf("decoder state %lu bytes (window %lu)\n", (unsigned long)sizeof(unpack_t), (unsigned long)UNPACK_WINDOW);
+    printf("%-10s %8s %7s %10s %s\n", "format", "size", "ratio", "MB/s", "check");
+    printf("%-10s %8lu %6.2fx %10s\n", "hex", (unsigned long)size, 1.0, "-");
+
+    uint8_t *out = (uint8_t *)malloc(size);
+    int ok = 1;
+    struct {
+        const char *name;
+        unpack_format_t format;
+        const uint8_t *data;
+        uint32_t size;
+    } streams[2] = {
+        {"gzip", UNPACK_GZIP, gz, (uint32_t)gz_size},
+        {"heatshrink", UNPACK_HEATSHRINK, hs, hs_size},
+    };
+    for (int i = 0; i < 2; i++) {
+        long n = 0;
+        uint32_t t = host_us();
+        for (int r = 0; r < RUNS; r++) {
+            n = unpack_all(streams[i].format, streams[i].data, streams[i].size, out, size);
+        }
+        t = host_us() - t;
+        int match = (n == (long)size) && !memcmp(out, hex, size);
+        ok &= match;
+        printf("%-10s %8lu %6.2fx %10.1f %s\n", streams[i].name, (unsigned long)streams[i].size, (double)size / streams[i].size,
+               (double)size * RUNS / t, match ? "match" : "MISMATCH");
+    }
+
+    // cut short in the header, the middle, the last block and the trailer
+    for (int i = 0; i < 2; i++) {
+        uint32_t cuts[4] = {5, streams[i].size / 2, streams[i].size - 12, streams[i].size - 1};
+        int stopped = 1;
+        for (int c = 0; c < 4; c++) {
+            long n = unpack_all(streams[i].format, streams[i].data, cuts[c], out, size);
+            stopped &= (UNPACK_GZIP == streams[i].format) ? (-1 == n) : ((n != -2) && (n != (long)size));
+        }
+        ok &= stopped;
+        printf("%-10s cut short: %s\n", streams[i].name, stopped ? "stops" : "DOES NOT STOP");
+    }
+
+    // zlib itself on the same stream for reference
+    uint32_t t = host_us();
+    for (int r = 0; r < RUNS; r++) {
+        memset(&z, 0, sizeof(z));
+        inflateInit2(&z, 16 + 15);
+        z.next_in = gz;
+        z.avail_in = gz_size;
+        z.next_out = out;
+        z.avail_out = size;
+        inflate(&z, Z_FINISH);
+        inflateEnd(&z);
+    }
+    t = host_us() - t;
+    printf("%-10s %8s %7s %10.1f\n", "zlib", "", "", (double)size * RUNS / t);
+
+    if (argc > 2) {
+        for (int i = 0; i < 2; i++) {
+            hex_parse_status_t status = unpack_parse(streams[i].format, streams[i].data, streams[i].size, "/tmp/unpack_bench.bin");
+            int match = (HEX_PARSE_EOF == status) && image_files_match("/tmp/unpack_bench.bin", argv[2]);
+            ok &= match;
+            printf("%s into the parser: %s\n", streams[i].name, match ? "matches" : "DOES NOT MATCH");
+        }
+    }
+    free(hex);
+    free(gz);
+    free(hs);
+    free(out);
+    return ok ? 0 : 1;
+}
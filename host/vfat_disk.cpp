@@ -0,0 +1,227 @@
+/* Runs VirtualFat on the host, as a disk an image is copied onto.
+ *
+ *   trace   replays an MSC write trace (see msc_trace.h) through
+ *           disk_write(), after the reads a host mounting the volume makes,
+ *           with a refused write sent again after the rest of the host's
+ *           queue, and checks the flash against the reference
+ *   image   saves the volume as it reads when nothing is on it, a sparse file
+ *           Linux can loop mount and copy an image onto
+ *   load    writes every sector of such a file through disk_write() in LBA
+ *           order, which is what the target would have seen had the host
+ *           written the sectors front to back, and checks the flash
+ *
+ * To time the whole copy to programmed flash path on Linux:
+ *   vfat_disk image disk.img
+ *   mount -o loop disk.img /mnt && cp test/mbed.hex /mnt && umount /mnt
+ *   vfat_disk load disk.img test/mbed.bin
+ *
+ * Build from the project root:
+ *   g++ -O2 -I. -Ihost -o vfat_disk host/vfat_disk.cpp virtual_fat.cpp sector_reorder.cpp hex_parser.cpp hex_pipeline.cpp run_buffer.cpp srec_decoder.cpp uf2_decoder.cpp elf_decoder.cpp bin_loader.cpp image_loader.cpp page_writer.cpp flash_layout.cpp
+ *
+ * Usage:
+ *   vfat_disk trace <trace.msct> <reference.bin>
+ *   vfat_disk image <disk.img>
+ *   vfat_disk load <disk.img> <reference.bin>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+#include "hex_pipeline.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "page_writer.h"
+#include "virtual_fat.h"
+#include "msc_trace.h"
+#include "sim_flash.h"
+#include "host_clock.h"
+
+/** The decoders behind the disk, the same as the target's
+ */
+class Target {
+
+public:
+    Target() : flash(0, 0), pages(flash), hex(pages, host_us), srec(pages), uf2(pages), elf(pages), bin(pages, 0), disk(image) {
+        image.add(hex);
+        image.add(srec);
+        image.add(uf2);
+        image.add(elf);
+        image.add(bin);
+    }
+
+    /** Read what a host reads when it mounts the volume
+     */
+    void mount() {
+        uint8_t sector[VFAT_SECTOR_SIZE];
+        for (uint32_t lba = 0; lba < disk.image_lba(); lba++) {
+            disk.disk_read(sector, lba);
+        }
+    }
+
+    /** Print the counts and check the flash against the reference
+     *  @return 1 if it matches
+     */
+    int report(const char *label, uint32_t us, uint32_t retried, const char *reference) {
+        char out[] = "/tmp/vfat_disk.bin";
+        flash.save(out);
+        int ok = (1 == disk.done()) && !flash.faults() && !pages.stats().rejected && image_files_match(out, reference);
+        const virtual_fat_stats_t &s = disk.stats();
+        const sector_reorder_stats_t &r = disk.reorder_stats();
+        printf("%-28s %-10s %6lu %6lu %6lu %6lu %6lu %5lu %7lu %9lu %s\n", label, image.decoder() ? image.decoder()->name() : "-",
+               (unsigned long)s.reads, (unsigned long)s.writes, (unsigned long)s.streamed, (unsigned long)s.ignored,
+               (unsigned long)s.refused, (unsigned long)r.peak, (unsigned long)retried, (unsigned long)us, ok ? "match" : "MISMATCH");
+        return ok;
+    }
+
+    SimFlash flash;
+    PageWriter pages;
+    HexPipeline hex;
+    SrecDecoder srec;
+    Uf2Decoder uf2;
+    ElfDecoder elf;
+    BinLoader bin;
+    ImageLoader image;
+    VirtualFat disk;
+};
+
+static void header()
+{
+    printf("%-28s %-10s %6s %6s %6s %6s %6s %5s %7s %9s\n", "source", "decoder", "reads", "writes", "image", "other", "busy", "peak", "retried", "us");
+}
+
+typedef struct {
+    uint32_t lba;
+    uint32_t count;
+    const uint8_t *data;
+} command_t;
+
+static int trace(const char *path, const char *reference)
+{
+    MscTrace t;
+    if (t.load(path)) {
+        fprintf(stderr, "%s: not a trace\n", path);
+        return 1;
+    }
+    if (VFAT_SECTOR_SIZE != t.header.sector_size) {
+        fprintf(stderr, "%s: %lu byte sectors\n", path, (unsigned long)t.header.sector_size);
+        return 1;
+    }
+    Target target;
+    target.mount();
+    std::deque<command_t> queue;
+    for (size_t i = 0; i < t.writes.size(); i++) {
+        command_t c = {t.writes[i].lba, t.writes[i].count, t.writes[i].data};
+        queue.push_back(c);
+    }
+    uint32_t retried = 0;
+    uint32_t refused = 0;
+    uint32_t start = host_us();
+    while (!queue.empty()) {
+        command_t c = queue.front();
+        queue.pop_front();
+        uint32_t i = 0;
+        for (; i < c.count; i++) {
+            if (target.disk.disk_write(&c.data[i * VFAT_SECTOR_SIZE], c.lba + i)) {
+                break;
+            }
+        }
+        if (i == c.count) {
+            refused = 0;
+            continue;
+        }
+        // busy, the host sends the rest again after its other commands
+        command_t rest = {c.lba + i, c.count - i, &c.data[i * VFAT_SECTOR_SIZE]};
+        queue.push_back(rest);
+        retried++;
+        if (++refused > queue.size()) {
+            break;
+        }
+    }
+    uint32_t us = host_us() - start;
+    const char *base = strrchr(path, '/');
+    header();
+    return target.report(base ? base + 1 : path, us, retried, reference) ? 0 : 1;
+}
+
+static int image(const char *path)
+{
+    Target target;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    // only the sectors with something in them, the rest is a hole
+    int ok = !ftruncate(fd, target.disk.disk_size());
+    uint8_t sector[VFAT_SECTOR_SIZE];
+    for (uint32_t lba = 0; ok && (lba < target.disk.image_lba()); lba++) {
+        target.disk.disk_read(sector, lba);
+        uint32_t i = 0;
+        while ((i < sizeof(sector)) && !sector[i]) {
+            i++;
+        }
+        if (i < sizeof(sector)) {
+            ok = (pwrite(fd, sector, sizeof(sector), (off_t)lba * VFAT_SECTOR_SIZE) == (ssize_t)sizeof(sector));
+        }
+    }
+    ok &= !close(fd);
+    if (!ok) {
+        perror(path);
+        return 1;
+    }
+    printf("%s: %lu sectors, image expected at sector %lu\n", path, (unsigned long)target.disk.disk_sectors(), (unsigned long)target.disk.image_lba());
+    return 0;
+}
+
+static int load(const char *path, const char *reference)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    Target target;
+    target.mount();
+    std::vector<uint8_t> data(VFAT_SECTOR_SIZE * 64);
+    uint32_t lba = 0;
+    uint32_t retried = 0;
+    uint32_t us = 0;
+    size_t n;
+    while ((n = fread(&data[0], VFAT_SECTOR_SIZE, 64, in)) > 0) {
+        uint32_t t = host_us();
+        for (size_t i = 0; i < n; i++, lba++) {
+            // in LBA order only a fragmented file can be refused, and then never taken
+            if (target.disk.disk_write(&data[i * VFAT_SECTOR_SIZE], lba)) {
+                retried++;
+            }
+        }
+        us += host_us() - t;
+    }
+    fclose(in);
+    const char *base = strrchr(path, '/');
+    header();
+    return target.report(base ? base + 1 : path, us, retried, reference) ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc == 4) && !strcmp(argv[1], "trace")) {
+        return trace(argv[2], argv[3]);
+    }
+    if ((argc == 3) && !strcmp(argv[1], "image")) {
+        return image(argv[2]);
+    }
+    if ((argc == 4) && !strcmp(argv[1], "load")) {
+        return load(argv[2], argv[3]);
+    }
+    fprintf(stderr, "usage: %s trace <trace.msct> <reference.bin>\n"
+            "       %s image <disk.img>\n"
+            "       %s load <disk.img> <reference.bin>\n", argv[0], argv[0], argv[0]);
+    return 2;
+}
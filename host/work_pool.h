@@ -0,0 +1,249 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool;
+
+/** A piece of work for a WorkPool. Allocate it with new, the pool deletes it
+ *  once it has run
+ */
+class WorkTask {
+
+public:
+    WorkTask() : _deps(1) {
+    }
+
+    virtual ~WorkTask() {
+    }
+
+    /** Do the work, on one of the pool's threads. It may submit more tasks
+     *  @param pool is the pool running it
+     */
+    virtual void run(WorkPool &pool) = 0;
+
+    /** Wait for another task before running. Call it before before is
+     *   submitted, or from before's own run()
+     *  @param before is the task to wait for
+     */
+    void after(WorkTask &before) {
+        _deps++;
+        before._next.push_back(this);
+    }
+
+    /** Hand the tasks waiting for this one over to another, which this one
+     *   has just made to finish its work. Call it from run()
+     *  @param to is the task they wait for instead
+     */
+    void forward(WorkTask &to) {
+        for (size_t i = 0; i < _next.size(); i++) {
+            to._next.push_back(_next[i]);
+        }
+        _next.clear();
+    }
+
+private:
+    friend class WorkPool;
+    // tasks not done yet and the hold until submit()
+    std::atomic<uint32_t> _deps;
+    std::vector<WorkTask *> _next;
+};
+
+typedef struct {
+    uint64_t busy_ns;   // time spent running tasks
+    uint32_t tasks;     // tasks run
+    uint32_t steals;    // tasks taken from another thread's queue
+} work_pool_stats_t;
+
+/** A work stealing thread pool. Every thread has a queue of its own, tasks
+ *  submitted from a task go on the back of it and the thread takes its next
+ *  task from there too, so a task that splits itself works through its
+ *  pieces depth first with warm caches. A thread with nothing left takes
+ *  from the front of another thread's queue, the oldest and usually biggest
+ *  work there, so no thread idles while another has a backlog. Tasks can
+ *  wait for other tasks, see WorkTask::after().
+ *
+ * Example:
+ * @code
+ * WorkPool pool(std::thread::hardware_concurrency());
+ * Decode *decode = new Decode(job);
+ * Verify *verify = new Verify(job);
+ * verify->after(*decode);
+ * pool.submit(verify);
+ * pool.submit(decode);
+ * pool.wait();
+ * @endcode
+ */
+class WorkPool {
+
+public:
+    /** @param threads is the number of threads to run tasks on
+     */
+    WorkPool(uint32_t threads) : _queues(threads ? threads : 1), _stats(_queues.size()), _queued(0), _sleepers(0), _pending(0), _stop(0) {
+        for (uint32_t i = 0; i < _queues.size(); i++) {
+            _stats[i].busy_ns = 0;
+            _stats[i].tasks = 0;
+            _stats[i].steals = 0;
+        }
+        for (uint32_t i = 0; i < _queues.size(); i++) {
+            _threads.push_back(std::thread(&WorkPool::worker, this, i));
+        }
+    }
+
+    ~WorkPool() {
+        {
+            std::lock_guard<std::mutex> lock(_sleep);
+            _stop = 1;
+        }
+        _wake.notify_all();
+        for (size_t i = 0; i < _threads.size(); i++) {
+            _threads[i].join();
+        }
+    }
+
+    /** Let a task run, as soon as the tasks it waits for are done
+     *  @param task is the task, the pool deletes it once it has run
+     */
+    void submit(WorkTask *task) {
+        _pending++;
+        release(task);
+    }
+
+    /** Wait for every task submitted so far, and every task they submit
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(_sleep);
+        while (_pending) {
+            _idle.wait(lock);
+        }
+    }
+
+    uint32_t threads() const {
+        return _queues.size();
+    }
+
+    /** @param thread is the thread, from 0 to threads() - 1
+     */
+    const work_pool_stats_t &stats(uint32_t thread) const {
+        return _stats[thread];
+    }
+
+    static uint64_t now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex lock;
+        std::deque<WorkTask *> tasks;
+    };
+
+    void release(WorkTask *task) {
+        if (--task->_deps) {
+            return;
+        }
+        // onto the back of this thread's queue, or the first queue from outside
+        Self &self = current();
+        Queue &q = _queues[(self.pool == this) ? self.index : 0];
+        {
+            std::lock_guard<std::mutex> lock(q.lock);
+            _queued++;
+            q.tasks.push_back(task);
+        }
+        if (_sleepers) {
+            std::lock_guard<std::mutex> lock(_sleep);
+            _wake.notify_one();
+        }
+    }
+
+    WorkTask *take(uint32_t index) {
+        {
+            Queue &q = _queues[index];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if (!q.tasks.empty()) {
+                WorkTask *task = q.tasks.back();
+                q.tasks.pop_back();
+                _queued--;
+                return task;
+            }
+        }
+        for (uint32_t i = 1; i < _queues.size(); i++) {
+            Queue &q = _queues[(index + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if (!q.tasks.empty()) {
+                WorkTask *task = q.tasks.front();
+                q.tasks.pop_front();
+                _queued--;
+                _stats[index].steals++;
+                return task;
+            }
+        }
+        return 0;
+    }
+
+    void worker(uint32_t index) {
+        current().pool = this;
+        current().index = index;
+        while (1) {
+            WorkTask *task = take(index);
+            if (!task) {
+                std::unique_lock<std::mutex> lock(_sleep);
+                _sleepers++;
+                while (!_queued && !_stop) {
+                    _wake.wait(lock);
+                }
+                _sleepers--;
+                if (_stop) {
+                    return;
+                }
+                continue;
+            }
+            uint64_t t = now_ns();
+            task->run(*this);
+            _stats[index].busy_ns += now_ns() - t;
+            _stats[index].tasks++;
+            for (size_t i = 0; i < task->_next.size(); i++) {
+                release(task->_next[i]);
+            }
+            delete task;
+            if (!--_pending) {
+                std::lock_guard<std::mutex> lock(_sleep);
+                _idle.notify_all();
+            }
+        }
+    }
+
+    // which pool and queue the calling thread works for
+    struct Self {
+        WorkPool *pool;
+        uint32_t index;
+    };
+
+    static Self &current() {
+        static thread_local Self self = {0, 0};
+        return self;
+    }
+
+    std::vector<Queue> _queues;
+    std::vector<work_pool_stats_t> _stats;
+    std::vector<std::thread> _threads;
+    // tasks in the queues, threads waiting for one, tasks submitted and not done
+    std::atomic<uint32_t> _queued;
+    std::atomic<uint32_t> _sleepers;
+    std::atomic<uint32_t> _pending;
+    int _stop;
+    std::mutex _sleep;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+};
+
+#endif
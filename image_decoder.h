@@ -0,0 +1,77 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include "stdint.h"
+#include "hex_parser.h"
+
+/** Push interface shared by the image formats (Intel HEX, S-record, UF2, raw
+ *  binary). However it is encoded, a decoder writes the image to its sink as
+ *  runs of data at their address, so everything behind it (PageWriter, the
+ *  flash, a link) sees the same writes for the same image.
+ *
+ *  Zero-copy decoders hand the sink pointers into the input, so what is fed
+ *  must stay valid until busy() returns 0.
+ */
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() {}
+
+    /** Check if a stream starts the way this format does. IMAGE_DETECT_SIZE
+     *   bytes must be enough to tell
+     *  @param data is the start of the stream
+     *  @param size is the number of bytes in data
+     *  @return 1 if it does, 0 if it does not, -1 if more than size bytes are needed to tell
+     */
+    virtual int detect(const uint8_t *data, uint32_t size) = 0;
+
+    /** Decode the next piece of the stream. Pieces can be any size
+     *  @param data is the input
+     *  @param size is the number of bytes in data
+     *  @return HEX_PARSE_OK when it was consumed, HEX_PARSE_EOF at the end of the
+     *   image, HEX_PARSE_SEEK to go on from seek_offset() instead,
+     *   HEX_PARSE_REJECTED if the sink refused data or the format's error
+     */
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size) = 0;
+
+    /** Decode the next pieces of the stream where they lie, e.g. packets still
+     *   in their receive buffers. Formats that can read across the pieces
+     *   override this, the rest are fed one piece at a time
+     *  @param iov is the pieces in stream order
+     *  @param count is the number of pieces
+     *  @return the same as feed()
+     */
+    virtual hex_parse_status_t feedv(const hex_iovec_t *iov, uint32_t count) {
+        hex_parse_status_t status = HEX_PARSE_OK;
+        for (uint32_t i = 0; (i < count) && (HEX_PARSE_OK == status); i++) {
+            status = feed(iov[i].data, iov[i].size);
+        }
+        return status;
+    }
+
+    /** Get where the stream has to continue from after feed() returned
+     *   HEX_PARSE_SEEK. Only formats that can point backwards in the stream
+     *   ask for that, and only callers with random access can do it
+     *  @return the offset from the start of the stream
+     */
+    virtual uint32_t seek_offset() const {
+        return 0;
+    }
+
+    /** Check if the sink may still be reading from what was fed
+     *  @return 1 while it may, otherwise 0
+     */
+    virtual int busy() {
+        return 0;
+    }
+
+    /** Decode anything held back at the end of the stream and wait for the sink
+     *  @return 0 on success, -1 on failure
+     */
+    virtual int flush() = 0;
+
+    /** Get the name of the format for messages
+     */
+    virtual const char *name() const = 0;
+};
+
+#endif
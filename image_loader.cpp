@@ -0,0 +1,133 @@
+#include "string.h"
+#include "image_loader.h"
+
+ImageLoader::ImageLoader() : _count(0), _decoder(0), _head_cnt(0)
+{
+}
+
+int ImageLoader::add(ImageDecoder &decoder)
+{
+    if (_count >= IMAGE_MAX_DECODERS) {
+        return -1;
+    }
+    _decoders[_count++] = &decoder;
+    return 0;
+}
+
+hex_parse_status_t ImageLoader::feed(const uint8_t *data, uint32_t size)
+{
+    if (!_decoder) {
+        const uint8_t *head = data;
+        uint32_t head_size = size;
+        if (_head_cnt || (size < IMAGE_DETECT_SIZE)) {
+            // too little to go on, collect the start of the stream
+            uint32_t n = IMAGE_DETECT_SIZE - _head_cnt;
+            if (n > size) {
+                n = size;
+            }
+            memcpy(&_head[_head_cnt], data, n);
+            _head_cnt += n;
+            data += n;
+            size -= n;
+            head = _head;
+            head_size = _head_cnt;
+        }
+        // every format can tell by IMAGE_DETECT_SIZE bytes
+        int found = select(head, head_size, head_size >= IMAGE_DETECT_SIZE);
+        if (found < 0) {
+            return HEX_PARSE_OK;
+        }
+        if (!found) {
+            return HEX_PARSE_UNINIT;
+        }
+        if (_head_cnt) {
+            // the decoder is handed _head once, so it stays put for the sink
+            hex_parse_status_t status = _decoder->feed(_head, _head_cnt);
+            if ((HEX_PARSE_OK != status) || !size) {
+                return status;
+            }
+        }
+    }
+    return _decoder->feed(data, size);
+}
+
+hex_parse_status_t ImageLoader::feedv(const hex_iovec_t *iov, uint32_t count)
+{
+    hex_parse_status_t status = HEX_PARSE_OK;
+    // until the format is known the pieces go through feed() to collect the head
+    while (count && !_decoder && (HEX_PARSE_OK == status)) {
+        status = feed(iov->data, iov->size);
+        iov++;
+        count--;
+    }
+    if (!count || (HEX_PARSE_OK != status)) {
+        return status;
+    }
+    return _decoder->feedv(iov, count);
+}
+
+uint32_t ImageLoader::seek_offset() const
+{
+    return _decoder ? _decoder->seek_offset() : 0;
+}
+
+int ImageLoader::busy()
+{
+    return _decoder ? _decoder->busy() : 0;
+}
+
+int ImageLoader::flush()
+{
+    if (!_decoder) {
+        if (!_head_cnt || (select(_head, _head_cnt, 1) <= 0)) {
+            return -1;
+        }
+        hex_parse_status_t status = _decoder->feed(_head, _head_cnt);
+        if ((HEX_PARSE_OK != status) && (HEX_PARSE_EOF != status)) {
+            return -1;
+        }
+    }
+    return _decoder->flush();
+}
+
+int ImageLoader::detect(const uint8_t *data, uint32_t size)
+{
+    int ret = 0;
+    for (uint32_t i = 0; i < _count; i++) {
+        int found = _decoders[i]->detect(data, size);
+        if (found > 0) {
+            return 1;
+        }
+        if (found < 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+const char *ImageLoader::name() const
+{
+    return _decoder ? _decoder->name() : "none";
+}
+
+/** Pick the first decoder that takes the stream
+ *   @param data is the start of the stream
+ *   @param size is the number of bytes in data
+ *   @param end is 1 when there will be no more, so a decoder that wants more is passed over
+ *   @return 1 when a decoder was picked, 0 if none takes the stream, -1 to wait for more
+ */
+int ImageLoader::select(const uint8_t *data, uint32_t size, int end)
+{
+    for (uint32_t i = 0; i < _count; i++) {
+        int found = _decoders[i]->detect(data, size);
+        if (found > 0) {
+            _decoder = _decoders[i];
+            return 1;
+        }
+        if ((found < 0) && !end) {
+            // a later decoder must not take what this one may still claim
+            return -1;
+        }
+    }
+    return 0;
+}
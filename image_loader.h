@@ -0,0 +1,91 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include "stdint.h"
+#include "image_decoder.h"
+
+// bytes needed to tell the formats apart, the UF2 magic is the longest
+#define IMAGE_DETECT_SIZE   8
+#ifndef IMAGE_MAX_DECODERS
+#define IMAGE_MAX_DECODERS  6
+#endif
+
+/** Picks the decoder for a stream from its first bytes and passes the whole
+ *  stream to it. Decoders are asked in the order they were added and the
+ *  first to say yes gets the image, so add a BinLoader, which takes
+ *  anything, last. Only add it when the stream has a known length, a binary
+ *  has no end record.
+ *
+ * Example:
+ * @code
+ * ImageLoader image;
+ * image.add(hex);
+ * image.add(srec);
+ * image.add(uf2);
+ *
+ * do {
+ *     status = image.feed(data, size);
+ *     while (image.busy());
+ * } while (HEX_PARSE_OK == status);
+ * image.flush();
+ * @endcode
+ */
+class ImageLoader : public ImageDecoder {
+
+public:
+    ImageLoader();
+
+    /** Add a decoder to pick from
+     *  @param decoder is the decoder
+     *  @return 0 on success, -1 if there are already IMAGE_MAX_DECODERS
+     */
+    int add(ImageDecoder &decoder);
+
+    /** Decode the next piece of the stream, holding back the first few bytes
+     *  until the format is known
+     *  @return the status of the decoder, or HEX_PARSE_UNINIT if none of them
+     *   takes the stream
+     */
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size);
+
+    /** Decode the next pieces of the stream, the same way as feed()
+     */
+    virtual hex_parse_status_t feedv(const hex_iovec_t *iov, uint32_t count);
+
+    virtual uint32_t seek_offset() const;
+
+    virtual int busy();
+
+    /** Decode what is left, even a stream too short to be sure of its format,
+     *  and wait for the sink
+     *  @return 0 on success, -1 on failure
+     */
+    virtual int flush();
+
+    /** Check if any of the decoders takes the stream
+     */
+    virtual int detect(const uint8_t *data, uint32_t size);
+
+    /** Get the name of the format picked, or "none" before that
+     */
+    virtual const char *name() const;
+
+    /** Get the decoder picked
+     *  @return the decoder, or 0 until the format is known
+     */
+    ImageDecoder *decoder() const {
+        return _decoder;
+    }
+
+private:
+    int select(const uint8_t *data, uint32_t size, int end);
+
+    ImageDecoder *_decoders[IMAGE_MAX_DECODERS];
+    uint32_t _count;
+    ImageDecoder *_decoder;
+    // the start of a stream that came in too small a piece to tell the format
+    uint32_t _head_cnt;
+    uint8_t _head[IMAGE_DETECT_SIZE];
+};
+
+#endif
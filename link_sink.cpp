@@ -0,0 +1,176 @@
+#include "string.h"
+#include "link_sink.h"
+
+LinkSink::LinkSink(LinkPort &port, clock_fn now_us) : _port(port), _now(now_us), _base(0), _send(0), _next(0), _pos(0), _last_us(0), _retries(0), _rewound(0), _out_pos(0), _out_len(0)
+{
+    link_rx_init(&_rx);
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int LinkSink::write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    if ((size > LINK_MAX_PAYLOAD) || busy()) {
+        return -1;
+    }
+    uint32_t packed = block_compress(data, size, _packed);
+    _stats.frames++;
+    _stats.raw_bytes += size;
+    if (packed < size) {
+        _stats.packed++;
+        return queue(LINK_PACKED, addr, _packed, packed, size);
+    }
+    return queue(LINK_DATA, addr, data, size, size);
+}
+
+int LinkSink::busy()
+{
+    poll();
+    return ((uint8_t)(_next - _base) >= LINK_WINDOW);
+}
+
+int LinkSink::sync()
+{
+    while (queue(LINK_END, 0, 0, 0, 0)) {
+        poll();
+        if (_retries > LINK_MAX_RETRIES) {
+            return -1;
+        }
+    }
+    while (_base != _next) {
+        poll();
+        if (_retries > LINK_MAX_RETRIES) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** Encode a frame into the next free window slot
+ *   @param type is the frame type
+ *   @param addr is the target address of the block
+ *   @param data is the payload
+ *   @param size is the number of bytes in data
+ *   @param raw_len is the size of the block once the payload is expanded
+ *   @return 0 if the frame was queued, -1 if the window is full
+ */
+int LinkSink::queue(uint8_t type, uint32_t addr, const uint8_t *data, uint32_t size, uint32_t raw_len)
+{
+    if ((uint8_t)(_next - _base) >= LINK_WINDOW) {
+        return -1;
+    }
+    link_frame_t frame;
+    uint8_t slot = _next % LINK_WINDOW;
+    frame.type = type;
+    frame.seq = _next;
+    frame.addr = addr;
+    frame.raw_len = (uint16_t)raw_len;
+    frame.len = (uint16_t)size;
+    frame.payload = data;
+    _len[slot] = link_frame_pack(&frame, _frame[slot]);
+    if (_base == _next) {
+        // nothing was outstanding so the timeout starts now
+        _last_us = _now();
+    }
+    _next++;
+    pump();
+    return 0;
+}
+
+/** Hand as much of the queued frames to the port as it takes
+ */
+void LinkSink::pump()
+{
+    while (1) {
+        if (_out_pos == _out_len) {
+            if (_send == _next) {
+                break;
+            }
+            // escape the next piece of the frame, leaving room for the closing flag
+            uint8_t slot = _send % LINK_WINDOW;
+            uint32_t used;
+            _out_pos = 0;
+            _out_len = 0;
+            if (0 == _pos) {
+                _out[_out_len++] = LINK_FLAG;
+            }
+            _out_len += link_escape(&_frame[slot][_pos], _len[slot] - _pos, &_out[_out_len], sizeof(_out) - 1 - _out_len, &used);
+            _pos += used;
+            if (_pos == _len[slot]) {
+                _out[_out_len++] = LINK_FLAG;
+                _pos = 0;
+                _send++;
+                _last_us = _now();
+            }
+        }
+        uint32_t n = _port.send(&_out[_out_pos], _out_len - _out_pos);
+        if (!n) {
+            break;
+        }
+        _out_pos += n;
+        _stats.wire_bytes += n;
+    }
+}
+
+/** Process acks, keep the port busy and go back to the oldest unacknowledged
+ *  frame when the host has gone quiet
+ */
+void LinkSink::poll()
+{
+    uint8_t buf[32];
+    uint32_t n;
+    while ((n = _port.recv(buf, sizeof(buf))) > 0) {
+        uint32_t used = 0;
+        while (used < n) {
+            link_frame_t frame;
+            used += link_rx_feed(&_rx, &buf[used], n - used, &frame);
+            if (LINK_ACK != frame.type) {
+                continue;
+            }
+            uint8_t acked = frame.seq - _base;
+            if (!acked && (_send != _base) && !_rewound) {
+                // the host is still waiting for _base so it lost a frame. Go back now
+                //  rather than on the timeout, once until the window moves again
+                go_back();
+                continue;
+            }
+            if (!acked || (acked > (uint8_t)(_next - _base))) {
+                // duplicate or stale ack
+                continue;
+            }
+            _stats.acks++;
+            _base = frame.seq;
+            _retries = 0;
+            _rewound = 0;
+            _last_us = _now();
+            if ((uint8_t)(_send - _base) > (uint8_t)(_next - _base)) {
+                // a resend got overtaken by the ack. Dropping the rest of the frame is
+                //  safe, the host throws it away at the next flag
+                _send = _base;
+                _pos = 0;
+            }
+        }
+    }
+    pump();
+    if ((_base != _next) && ((int32_t)(_now() - _last_us) > LINK_TIMEOUT_US) && go_back()) {
+        _retries++;
+    }
+}
+
+/** Send everything from the oldest unacknowledged frame again
+ *  @return 1 if it went back, 0 if a frame is still on its way out
+ */
+int LinkSink::go_back()
+{
+    if (_pos || (_out_pos != _out_len)) {
+        // let the frame on its way finish first, and give the host the whole
+        //  timeout from there. A slow or held off link is not a lost frame
+        _last_us = _now();
+        return 0;
+    }
+    _stats.resends += (uint8_t)(_send - _base);
+    _send = _base;
+    _rewound = 1;
+    _last_us = _now();
+    pump();
+    return 1;
+}
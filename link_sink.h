@@ -0,0 +1,123 @@
+#ifndef LINK_SINK_H
+#define LINK_SINK_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "frame_link.h"
+#include "block_codec.h"
+
+// frames sent before the first one has to be acknowledged
+#ifndef LINK_WINDOW
+#define LINK_WINDOW         8
+#endif
+// frames are resent from the oldest unacknowledged one after this long without
+//  progress. It has to cover a full transmit ring draining at the baud rate
+#ifndef LINK_TIMEOUT_US
+#define LINK_TIMEOUT_US     200000
+#endif
+// timeouts in a row before sync() gives up
+#define LINK_MAX_RETRIES    10
+
+/** Byte transport under a LinkSink. Both calls must return straight away.
+ */
+class LinkPort {
+public:
+    virtual ~LinkPort() {}
+
+    /** Queue bytes to send
+     *  @param data is the data to send
+     *  @param size is the number of bytes in data
+     *  @return the number of bytes taken, can be less than size
+     */
+    virtual uint32_t send(const uint8_t *data, uint32_t size) = 0;
+
+    /** Get received bytes
+     *  @param data is where the bytes are copied
+     *  @param size is the space in data
+     *  @return the number of bytes copied, 0 if none are waiting
+     */
+    virtual uint32_t recv(uint8_t *data, uint32_t size) = 0;
+};
+
+typedef struct {
+    uint32_t frames;        // data frames sent, not counting resends
+    uint32_t packed;        // data frames that went out compressed
+    uint32_t raw_bytes;     // block bytes written to the sink
+    uint32_t wire_bytes;    // encoded bytes sent including resends
+    uint32_t resends;       // frames sent again after a timeout
+    uint32_t acks;          // good acks received
+} link_stats_t;
+
+/** Sends blocks as CRC checked frames with a go-back-N window of LINK_WINDOW.
+ *  Every block is compressed with block_compress() and goes out packed when
+ *  that is smaller. The block is encoded on write() so the caller gets its
+ *  buffer back straight away; busy() is 1 while the window is full.
+ *
+ * Example:
+ * @code
+ * SerialLinkPort port(pc);
+ * LinkSink sink(port, us_ticker_read);
+ * HexPipeline pipeline(sink, us_ticker_read);
+ * ...
+ * if (pipeline.flush()) {
+ *     error("host did not acknowledge the image\n");
+ * }
+ * @endcode
+ */
+class LinkSink : public BlockSink {
+
+public:
+    typedef uint32_t (*clock_fn)(void);
+
+    /** Create a sink sending over a port
+     *  @param port is the byte transport
+     *  @param now_us returns a free running microsecond count for the timeouts
+     */
+    LinkSink(LinkPort &port, clock_fn now_us);
+
+    /** Queue a block, at most LINK_MAX_PAYLOAD bytes
+     */
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size);
+
+    /** Handle acks and resends, 1 while the window is full
+     */
+    virtual int busy();
+
+    /** Send the end frame and wait for the host to acknowledge everything
+     */
+    virtual int sync();
+
+    const link_stats_t &stats() const {
+        return _stats;
+    }
+
+private:
+    int queue(uint8_t type, uint32_t addr, const uint8_t *data, uint32_t size, uint32_t raw_len);
+    void poll();
+    void pump();
+    int go_back();
+
+    LinkPort &_port;
+    clock_fn _now;
+    // oldest unacknowledged, next to send and next to queue sequence numbers
+    uint8_t _base;
+    uint8_t _send;
+    uint8_t _next;
+    // bytes of frame _send already escaped into _out
+    uint32_t _pos;
+    uint32_t _last_us;
+    uint32_t _retries;
+    // set by a go back until an ack moves the window
+    uint8_t _rewound;
+    uint32_t _len[LINK_WINDOW];
+    // frames are kept packed and escaped on the way out through _out
+    uint8_t _frame[LINK_WINDOW][LINK_MAX_PACKED];
+    uint8_t _out[64];
+    uint32_t _out_pos;
+    uint32_t _out_len;
+    uint8_t _packed[BLOCK_CODEC_BOUND(LINK_MAX_PAYLOAD)];
+    link_rx_t _rx;
+    link_stats_t _stats;
+};
+
+#endif
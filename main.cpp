@@ -1,251 +1,244 @@
 #include "mbed.h"
 #include "stdio.h"
 #include "string.h"
+#include "hex_parser.h"
+#include "hex_pipeline.h"
+#include "buffered_serial.h"
+#include "serial_sink.h"
+#include "link_sink.h"
+#include "serial_link_port.h"
+#include "unpack.h"
+#include "page_writer.h"
+#include "srec_decoder.h"
+#include "uf2_decoder.h"
+#include "elf_decoder.h"
+#include "bin_loader.h"
+#include "image_loader.h"
+#include "digest_sink.h"
+#include "page_hash.h"
+
+// 1 to receive the hex image over the serial port instead of using hex_file.h
+#ifndef HEX_FROM_SERIAL
+#define HEX_FROM_SERIAL     0
+#endif
+#define HEX_SERIAL_BAUD     921600
+// 1 to send the decoded image as acknowledged, compressed frames (see host/link_recv.cpp)
+//  instead of raw bytes. It stalls without host/link_recv on the other end sending acks,
+//  and they come back on RX so this only works when the hex is not arriving there
+#ifndef HEX_LINK_OUTPUT
+#define HEX_LINK_OUTPUT     0
+#endif
+#if HEX_LINK_OUTPUT && HEX_FROM_SERIAL
+#error "HEX_LINK_OUTPUT needs the serial receive line for acks"
+#endif
+// 1 when the image is compressed (see unpack.h), in HEX_PACKED_FORMAT. Packed in
+//  hex_file.h it comes from e.g. host/unpack_bench and
+//  xxd -i -n hex_file mbed.hex.gz | sed 's/unsigned char/uint8_t const/;s/unsigned int/uint32_t const/'
+#ifndef HEX_PACKED
+#define HEX_PACKED          0
+#endif
+#ifndef HEX_PACKED_FORMAT
+#define HEX_PACKED_FORMAT   UNPACK_GZIP
+#endif
+// The format of the image (Intel HEX, S-record, UF2 or the ELF from the build) is told
+//  from its first bytes.
+//  1 when hex_file.h also has hex_file_len, so it can hold a raw .bin image as well,
+//  loaded at HEX_BIN_BASE. A binary has no end record, it ends at hex_file_len
+#ifndef HEX_FILE_BIN
+#define HEX_FILE_BIN        0
+#endif
+#define HEX_BIN_BASE        0
+#if HEX_FILE_BIN && (HEX_FROM_SERIAL || HEX_PACKED)
+#error "HEX_FILE_BIN loads straight from hex_file"
+#endif
+// Define HEX_IMAGE_CRC32 as the CRC-32 of the build's .bin to check the decoded image
+//  against it, e.g. -DHEX_IMAGE_CRC32=0x$(crc32 mbed.bin), and HEX_IMAGE_SHA256 as the
+//  SHA-256 the release was signed with, e.g. -DHEX_IMAGE_SHA256=\"$(sha256sum mbed.bin | cut -c1-64)\".
+//  The .bin must start at the image's first address, as objcopy and host/hexconv write it.
+//  Define HEX_IMAGE_ROOT as the page hash root from host/page_manifest build to check the
+//  pages as they are programmed, pages it does not change can then be left unread
+
+#if !HEX_FROM_SERIAL
 #include "hex_file.h"
 
 extern uint8_t const hex_file[];
 
-typedef enum hex_parse_status_t hex_parse_status_t;
-enum hex_parse_status_t {
-    HEX_PARSE_OK = 0,
-    HEX_PARSE_EOF,
-    HEX_PARSE_UNALIGNED,
-    HEX_PARSE_LINE_OVERRUN,
-    HEX_PARSE_CKSUM_FAIL,
-    HEX_PARSE_UNINIT
-};
+uint8_t *hex_file_loc = (uint8_t *)hex_file;
+#if HEX_PACKED || HEX_FILE_BIN
+uint8_t *hex_file_end = (uint8_t *)hex_file + hex_file_len;
+#endif
+#endif
 
-typedef enum hex_record_t hex_record_t;
-enum hex_record_t {
-    DATA_RECORD = 0,
-    EOF_RECORD = 1,
-    EXT_SEG_ADDR_RECORD = 2,
-    START_SEG_ADDR_RECORD = 3,
-    EXT_LINEAR_ADDR_RECORD = 4,
-    START_LINEAR_ADDR_RECORD = 5
-};
-    
+BufferedSerial pc(USBTX, USBRX);
+#if HEX_LINK_OUTPUT
+SerialLinkPort pc_port(pc);
+LinkSink pc_sink(pc_port, us_ticker_read);
+#else
+SerialSink pc_sink(pc);
+#endif
+// the page hash tree of what reaches the flash
+PageHashSink page_hashes(pc_sink);
+// erases, 0xff page elision and page assembly for every image format
+PageWriter pages(page_hashes);
+// CRC-32 and SHA-256 of the image on its way to the pages
+DigestSink digest(pages);
+HexPipeline pipeline(digest, us_ticker_read);
+SrecDecoder srec(digest);
+Uf2Decoder uf2(digest);
+ElfDecoder elf(digest);
+#if HEX_FILE_BIN
+BinLoader loader(digest, HEX_BIN_BASE);
+#endif
+ImageLoader image;
 
-typedef union hex_line_t hex_line_t;
-union __attribute__((packed)) hex_line_t {
-    uint8_t buf[0x25];
-    struct __attribute__((packed)) {
-        uint8_t  byte_count;
-        uint16_t address;
-        uint8_t  record_type;
-        uint8_t  data[0x20];
-        uint8_t  checksum;
-    };
-};
+#if HEX_PACKED
+unpack_t unpacker;
 
-/** Swap 16bit value - let compiler figure out the best way
- *  @param val a variable of size uint16_t to be swapped
- *  @return the swapped value
+/** Unpack what fits of the next piece of input and parse what came out, straight
+ *   out of the unpack window
+ *  @param data is the packed input
+ *  @param size is the number of bytes in data
+ *  @param status is set to the parse status
+ *  @return the number of bytes of data used
  */
-static uint16_t swap16(uint16_t a)
+static uint32_t feed_packed(const uint8_t *data, uint32_t size, hex_parse_status_t *status)
 {
-    return ((a & 0x00ff) << 8) | ((a & 0xff00) >> 8);
-}
-
-/** Converts a character representation of a hex to real value.
- *   @param c is the hex value in char format
- *   @return the value of the hex
- */
-static uint8_t ctoh(char c)
-{
-    return (c & 0x10) ? /*0-9*/ c & 0xf : /*A-F, a-f*/ (c & 0xf) + 9;
-}
-
-/** Calculate checksum on a hex record
- *   @param data is the line of hex record
- *   @param size is the length of the data array
- *   @return 1 if the data provided is a valid hex record otherwise 0
- */
-static uint8_t validate_checksum(hex_line_t *record)
-{
-    uint8_t result = 0;
-    //uint8_t a;
-    for (uint8_t i=0; i < (record->byte_count+4); i++) {
-        result += record->buf[i];
-    }
-    result = (uint8_t)((~result)+1);
-    return ((uint8_t)result == (uint8_t)record->buf[record->byte_count+4]);
-    //b = record->buf[record->byte_count+4];
-    //return (a == b);
-}
-
-hex_parse_status_t parse_hex_blob(uint8_t *hex_blob, uint32_t hex_blob_size, uint32_t *hex_parse_cnt, uint8_t *bin_buf, uint32_t bin_buf_size, uint32_t *bin_buf_address, uint32_t *bin_buf_cnt)
-{
-    static hex_line_t line = {0}, shadow_line = {0};
-    static uint8_t low_nibble = 0, idx = 0, record_processed = 0;
-    static uint32_t last_known_address = 0;
-    static uint8_t load_unaligned_record = 0;
-    uint8_t *end = hex_blob + hex_blob_size;
-    hex_parse_status_t status = HEX_PARSE_UNINIT;
-    // reset the amount of data that is being return'd
-    *bin_buf_cnt = (uint32_t)0;
-
-    // we had an exit state where the address was unaligned to the previous record and data count.
-    //  Need to pop the last record into the buffer before decoding anthing else since it was 
-    //  already decoded.
-    if (load_unaligned_record) {
-        // need some help...
-        load_unaligned_record = 0;
-        // move from line buffer back to input buffer
-        memcpy((uint8_t *)bin_buf, (uint8_t *)line.data, line.byte_count);
-        bin_buf += line.byte_count;
-        *bin_buf_cnt = (uint32_t)(*bin_buf_cnt) + line.byte_count;
-        // this stores the last known start address of decoded data
-        last_known_address = ((last_known_address & 0xffff0000) | line.address) + line.byte_count;
-    }
-    
-    while (hex_blob != end) {
-        switch ((uint8_t)(*hex_blob)) {
-            // junk we dont care about could also just run the validate_checksum on &line
-            case '\r':
-            case '\n':
-                // we've hit the end of an ascii line
-                if (validate_checksum(&line)) {
-                     if (!record_processed) {
-                        record_processed = 1;
-                        // address byteswap...
-                        line.address = swap16(line.address);
-                        switch (line.record_type) {
-                            case DATA_RECORD:
-                                // verify this is a continous block of memory or need to exit and dump
-                                if (((last_known_address & 0xffff0000) | line.address) > (last_known_address + shadow_line.byte_count)) {
-                                    // keeping a record of the last hex record
-                                    //memcpy(shadow_line.buf, line.buf, sizeof(hex_line_t));
-                                    //*bin_buf_address = last_known_address - (uint32_t)(*bin_buf_num_bytes);
-                                    //*hex_amt_parsed = (uint32_t)(hex_buf_size - (end - hex_blob));
-                                    load_unaligned_record = 1;
-                                    //return HEX_PARSE_UNALIGNED;
-                                    status = HEX_PARSE_UNALIGNED;
-                                    goto hex_parser_exit;
-                                }
-                            
-                                // keeping a record of the last hex record
-                                memcpy(shadow_line.buf, line.buf, sizeof(hex_line_t));
-                                // move from line buffer back to input buffer
-                                memcpy(bin_buf, line.data, line.byte_count);
-                                bin_buf += line.byte_count;
-                                *bin_buf_cnt = (uint32_t)(*bin_buf_cnt) + line.byte_count;
-                                // this stores the last known start address of decoded data
-                                last_known_address = ((last_known_address & 0xffff0000) | line.address) + line.byte_count;
-                                break;
-                            
-                            case EOF_RECORD:
-                                // fill in all FF here and force a return (or break from this logic)
-                                memset(bin_buf, 0xff, (bin_buf_size - (uint32_t)(*bin_buf_cnt)));
-                                // figure the start address before returning        
-                                //*bin_buf_address = last_known_address - (uint32_t)(*bin_buf_num_bytes);    
-                                //*hex_amt_parsed = (uint32_t)(hex_buf_size - (end - hex_blob));
-                                *bin_buf_cnt = bin_buf_size;
-                                //return HEX_PARSE_EOF;
-                                status = HEX_PARSE_EOF;
-                                goto hex_parser_exit;
-                            
-                            case EXT_LINEAR_ADDR_RECORD:
-                                // update the address msb's
-                                last_known_address = (last_known_address & 0x0000ffff) | ((line.data[0] << 24) | (line.data[1] << 16));
-                                break;
-                            
-                            default:
-                                break;
-                        }
-                    }
-                } else {
-                    //return HEX_PARSE_CKSUM_FAIL;
-                    status = HEX_PARSE_CKSUM_FAIL;
-                    goto hex_parser_exit;
-                }
-                break;
-        
-            // found start of a new record. reset state variables
-            case ':':
-                memset(line.buf, 0, sizeof(hex_line_t));
-                low_nibble = 0;
-                idx = 0;
-                record_processed = 0;
-                break;
-            
-            // decoding lines
-            default:
-                if (low_nibble) {
-                    line.buf[idx] |= ctoh((uint8_t)(*hex_blob)) & 0xf;
-                    idx++;
-                }
-                else {
-                    if (idx < sizeof(hex_line_t)) {
-                        line.buf[idx] = ctoh((uint8_t)(*hex_blob)) << 4;
-                    }
-                }
-                low_nibble = !low_nibble;
-                break;
-        }
-        hex_blob++;
+    const uint8_t *hex;
+    uint32_t used = unpack_write(&unpacker, data, size);
+    uint32_t cnt = unpack_read(&unpacker, &hex);
+    *status = HEX_PARSE_OK;
+    if (cnt) {
+        *status = image.feed(hex, cnt);
+        // a zero-copy decoder's sink reads from the window
+        while (image.busy());
+        unpack_consume(&unpacker, cnt);
+    } else if (UNPACK_OK != unpacker.status) {
+        // corrupt, or the stream ended before the hex EOF record
+        error("packed image is bad\n");
     }
-    status = HEX_PARSE_OK;
-hex_parser_exit:
-    memset(bin_buf, 0xff, (bin_buf_size - (uint32_t)(*bin_buf_cnt)));
-    // figure the start address for the buffer before returning
-    *bin_buf_address = last_known_address - (uint32_t)(*bin_buf_cnt);
-    *hex_parse_cnt = (uint32_t)(hex_blob_size - (end - hex_blob));
-    //return HEX_PARSE_OK;
-    return status;
+    return used;
 }
-
-uint8_t *hex_file_loc = (uint8_t *)hex_file;
-uint8_t bin_buffer[256] = {0};
-
-RawSerial pc(USBTX, USBRX);
+#endif
     
 int main()
 {
-    uint32_t bin_start_address = 0, bin_buf_written = 512, block_size = 512, block_amt_parsed = 0;
-    
-    int size_bin_file = sizeof(bin_buffer);
-    size_bin_file = size_bin_file;
-    
+#if HEX_FROM_SERIAL
+    pc.baud(HEX_SERIAL_BAUD);
+    // the USB serial port has no RTS line. The sender must skip XON/XOFF in what comes back
+    pc.set_rx_flow(BufferedSerial::XonXoff);
+#endif
+    image.add(pipeline);
+    image.add(srec);
+    image.add(uf2);
+    image.add(elf);
+#if HEX_FILE_BIN
+    // anything else is a binary, so this goes last
+    image.add(loader);
+#endif
     while(1) {
         hex_parse_status_t status;
+        digest.reset();
+        page_hashes.reset();
+#if HEX_PACKED
+        unpack_init(&unpacker, HEX_PACKED_FORMAT);
+#endif
         do {
-            status = parse_hex_blob(hex_file_loc, block_size, &block_amt_parsed, bin_buffer, sizeof(bin_buffer), &bin_start_address, &bin_buf_written);
-            if ((HEX_PARSE_EOF == status) || (HEX_PARSE_OK == status)) {
-                if ((block_size != block_amt_parsed) && (status != HEX_PARSE_EOF)) {
-                    // error state in parsing or record type
-                    block_amt_parsed = block_amt_parsed;
-                    error("block parse amt failure\n");
-                }
-                //print the decoded file contents here
-                for(int i = 0; i < bin_buf_written; i++) {
-                    pc.putc(bin_buffer[i]);
-                }
-                block_size = 512;
-                hex_file_loc += block_amt_parsed;
+#if HEX_FROM_SERIAL
+            // hand the parser whatever the RX interrupt has collected, straight out of the ring
+            const uint8_t *data;
+            uint32_t size = pc.rx_peek(&data);
+            if (!size) {
+                status = HEX_PARSE_OK;
+#if HEX_PACKED
+                // there may still be output waiting for window space
+                feed_packed(data, 0, &status);
+#endif
+                continue;
+            }
+#if HEX_PACKED
+            pc.rx_consume(feed_packed(data, size, &status));
+#else
+            status = image.feed(data, size);
+            // a zero-copy decoder's sink reads from the ring
+            while (image.busy());
+            pc.rx_consume(size);
+#endif
+#elif HEX_PACKED
+            hex_file_loc += feed_packed(hex_file_loc, hex_file_end - hex_file_loc, &status);
+            if (hex_file_loc == hex_file_end) {
+                unpack_finish(&unpacker);
             }
-            if (HEX_PARSE_UNALIGNED == status) {
-                //try to program the data here
-                for(int i = 0; i < bin_buf_written; i++) {
-                    pc.putc(bin_buffer[i]);
-                }
-                // pad the rest of the flash buffer with 0xff
-                for(int i = bin_buf_written; i < 512; i++) {
-                    pc.putc(0xff);
-                }
-                // incrememntal offset to finish the block
-                block_size = (512 - block_amt_parsed);
-                hex_file_loc += block_amt_parsed;
+#else
+            // decode the next block while the previous one drains out of the serial port
+            uint32_t size = HEX_BLOCK_SIZE;
+#if HEX_FILE_BIN
+            if (size > (uint32_t)(hex_file_end - hex_file_loc)) {
+                size = hex_file_end - hex_file_loc;
             }
-            if (HEX_PARSE_CKSUM_FAIL == status) {
+#endif
+            status = image.feed(hex_file_loc, size);
+            hex_file_loc += size;
+            if (HEX_PARSE_SEEK == status) {
+                // an axf from armlink has its program headers after the data
+                hex_file_loc = (uint8_t *)hex_file + image.seek_offset();
+                status = HEX_PARSE_OK;
+            }
+#endif
+            if ((HEX_PARSE_CKSUM_FAIL == status) || (HEX_PARSE_LINE_OVERRUN == status)) {
                 // programming failure recorded to usere here
                 error("cksum failure\n");
             }
             if (HEX_PARSE_UNINIT == status) {
-                error("parser logic failure\n");
+                error("unknown image format or parser logic failure\n");
+            }
+            if (HEX_PARSE_REJECTED == status) {
+                error("image overlaps itself or runs outside flash\n");
             }
+            if (HEX_PARSE_SEEK == status) {
+                // only hex_file can be read out of order
+                error("image can not be streamed\n");
+            }
+            if (HEX_PARSE_WRAP == status) {
+                error("image runs past the top of the address space\n");
+            }
+#if HEX_FILE_BIN
+            if (hex_file_loc == hex_file_end) {
+                // a binary has no end record
+                break;
+            }
+#endif
             
         } while(HEX_PARSE_EOF != status);
+        if (image.flush()) {
+            error("host did not acknowledge the image\n");
+        }
+#ifdef HEX_IMAGE_CRC32
+        if (!digest.valid() || (digest.crc32() != (uint32_t)(HEX_IMAGE_CRC32))) {
+            error("image CRC32 does not match\n");
+        }
+#endif
+#ifdef HEX_IMAGE_SHA256
+        uint8_t hash[SHA256_SIZE];
+        char text[2 * SHA256_SIZE + 1];
+        digest.sha256(hash);
+        for (int i = 0; i < SHA256_SIZE; i++) {
+            sprintf(&text[2 * i], "%02x", hash[i]);
+        }
+        if (!digest.valid() || strcmp(text, HEX_IMAGE_SHA256)) {
+            error("image SHA-256 does not match\n");
+        }
+#endif
+#ifdef HEX_IMAGE_ROOT
+        uint8_t root[PAGE_HASH_SIZE];
+        char root_text[2 * PAGE_HASH_SIZE + 1];
+        page_hashes.root(root);
+        for (int i = 0; i < PAGE_HASH_SIZE; i++) {
+            sprintf(&root_text[2 * i], "%02x", root[i]);
+        }
+        if (!page_hashes.valid() || strcmp(root_text, HEX_IMAGE_ROOT)) {
+            error("page hash root does not match\n");
+        }
+#endif
         // eject msc
         error("");
     }
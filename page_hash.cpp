@@ -0,0 +1,137 @@
+#include "string.h"
+#include "page_hash.h"
+
+void page_hash_leaf(const uint8_t *page, uint8_t *leaf)
+{
+    static const uint8_t prefix = 0x00;
+    sha256_t sha;
+    sha256_init(&sha);
+    sha256_update(&sha, &prefix, 1);
+    sha256_update(&sha, page, FLASH_PAGE_SIZE);
+    sha256_final(&sha, leaf);
+}
+
+void page_hash_node(const uint8_t *left, const uint8_t *right, uint8_t *parent)
+{
+    static const uint8_t prefix = 0x01;
+    sha256_t sha;
+    sha256_init(&sha);
+    sha256_update(&sha, &prefix, 1);
+    sha256_update(&sha, left, PAGE_HASH_SIZE);
+    sha256_update(&sha, right, PAGE_HASH_SIZE);
+    sha256_final(&sha, parent);
+}
+
+int page_hash_check(uint32_t index, const uint8_t *page, const uint8_t *proof, const uint8_t *root)
+{
+    uint8_t node[PAGE_HASH_SIZE];
+    if (index >= FLASH_PAGES) {
+        return -1;
+    }
+    page_hash_leaf(page, node);
+    for (uint32_t level = 0; level < PAGE_HASH_DEPTH; level++) {
+        const uint8_t *sibling = &proof[level * PAGE_HASH_SIZE];
+        if ((index >> level) & 1) {
+            page_hash_node(sibling, node, node);
+        } else {
+            page_hash_node(node, sibling, node);
+        }
+    }
+    return memcmp(node, root, PAGE_HASH_SIZE) ? -1 : 0;
+}
+
+PageHashSink::PageHashSink(BlockSink &flash, uint8_t *leaves) : _flash(flash), _leaves(leaves)
+{
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xff, sizeof(page));
+    page_hash_leaf(page, _erased[0]);
+    for (uint32_t level = 1; level <= PAGE_HASH_DEPTH; level++) {
+        page_hash_node(_erased[level - 1], _erased[level - 1], _erased[level]);
+    }
+    reset();
+}
+
+void PageHashSink::reset()
+{
+    _ordered = 1;
+    _pages = 0;
+    _next = 0;
+    if (_leaves) {
+        for (uint32_t i = 0; i < FLASH_PAGES; i++) {
+            memcpy(&_leaves[i * PAGE_HASH_SIZE], _erased[0], PAGE_HASH_SIZE);
+        }
+    }
+}
+
+int PageHashSink::write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    // a busy flash gets the same page again, so only hash what it took
+    if (_flash.write(addr, data, size)) {
+        return -1;
+    }
+    uint32_t index = addr / FLASH_PAGE_SIZE;
+    if ((addr % FLASH_PAGE_SIZE) || (FLASH_PAGE_SIZE != size) || (index >= FLASH_PAGES)) {
+        _ordered = 0;
+        return 0;
+    }
+    uint8_t leaf[PAGE_HASH_SIZE];
+    page_hash_leaf(data, leaf);
+    _pages++;
+    if (_leaves) {
+        memcpy(&_leaves[index * PAGE_HASH_SIZE], leaf, PAGE_HASH_SIZE);
+    }
+    if (index < _next) {
+        _ordered = 0;
+    }
+    if (!_ordered) {
+        return 0;
+    }
+    // the erased pages skipped over, as few whole subtrees as will do
+    while (_next < index) {
+        uint32_t level = 0;
+        while ((level < PAGE_HASH_DEPTH) && !(_next & (1UL << level)) && ((_next + (2UL << level)) <= index)) {
+            level++;
+        }
+        add(level, _erased[level], _nodes, &_next);
+    }
+    add(0, leaf, _nodes, &_next);
+    return 0;
+}
+
+void PageHashSink::root(uint8_t *root) const
+{
+    // finish a copy with erased pages so the image can go on
+    uint8_t nodes[PAGE_HASH_DEPTH + 1][PAGE_HASH_SIZE];
+    uint32_t next = _next;
+    memcpy(nodes, _nodes, sizeof(nodes));
+    while (next < FLASH_PAGES) {
+        uint32_t level = 0;
+        while ((level < PAGE_HASH_DEPTH) && !(next & (1UL << level))) {
+            level++;
+        }
+        add(level, _erased[level], nodes, &next);
+    }
+    memcpy(root, nodes[PAGE_HASH_DEPTH], PAGE_HASH_SIZE);
+}
+
+/** Put a whole subtree in place after the ones before it, joining it with
+ *   the left node waiting at each level it completes
+ *   @param level is the height of the subtree, next must be a multiple of 2^level
+ *   @param hash is its root
+ *   @param nodes is the left node waiting at each level
+ *   @param next is the first leaf it covers, moved past it
+ */
+void PageHashSink::add(uint32_t level, const uint8_t *hash, uint8_t (*nodes)[PAGE_HASH_SIZE], uint32_t *next) const
+{
+    uint8_t node[PAGE_HASH_SIZE];
+    uint32_t at = *next >> level;
+    *next += 1UL << level;
+    memcpy(node, hash, PAGE_HASH_SIZE);
+    // a right child joins the left one and goes up
+    while ((level < PAGE_HASH_DEPTH) && (at & 1)) {
+        page_hash_node(nodes[level], node, node);
+        level++;
+        at >>= 1;
+    }
+    memcpy(nodes[level], node, PAGE_HASH_SIZE);
+}
@@ -0,0 +1,132 @@
+#ifndef PAGE_HASH_H
+#define PAGE_HASH_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "flash_layout.h"
+#include "sha256.h"
+
+/* A hash tree over the flash pages, for verifying an image a page at a time.
+ *
+ * A leaf is SHA-256(0x00 | page) and a node SHA-256(0x01 | left | right),
+ * the prefixes keep a page from passing for a node. The tree has a leaf for
+ * every one of FLASH_PAGES pages, pages the image does not write count as
+ * erased (all 0xff). The root stands for the whole image, and one page is
+ * checked against it with its PAGE_HASH_DEPTH sibling hashes, the proof,
+ * without reading anything else.
+ *
+ * The manifest of an image is its root and leaves (host/page_manifest.cpp
+ * makes one). Between two manifests the pages whose leaves differ are the
+ * only ones that need reading back after an update.
+ */
+
+#define PAGE_HASH_SIZE      SHA256_SIZE
+
+// levels above the leaves, FLASH_PAGES has to be 2^PAGE_HASH_DEPTH
+#define PAGE_HASH_DEPTH     10
+#if (1 << PAGE_HASH_DEPTH) != FLASH_PAGES
+#error "PAGE_HASH_DEPTH does not match FLASH_PAGES"
+#endif
+
+/** Hash a page into a leaf
+ *   @param page is FLASH_PAGE_SIZE bytes
+ *   @param leaf is where the PAGE_HASH_SIZE byte hash is written
+ */
+void page_hash_leaf(const uint8_t *page, uint8_t *leaf);
+
+/** Hash two nodes into their parent
+ *   @param left is the left node
+ *   @param right is the right node
+ *   @param parent is where the hash is written, it may be left or right
+ */
+void page_hash_node(const uint8_t *left, const uint8_t *right, uint8_t *parent);
+
+/** Check a page against the root
+ *   @param index is the page number
+ *   @param page is the FLASH_PAGE_SIZE bytes read from it
+ *   @param proof is the PAGE_HASH_DEPTH sibling hashes from the leaf up
+ *   @param root is the root of the image
+ *   @return 0 if the page is what the image has there, otherwise -1
+ */
+int page_hash_check(uint32_t index, const uint8_t *page, const uint8_t *proof, const uint8_t *root);
+
+/** Passes pages on to the flash and builds the hash tree of the image from
+ *  them as they go, keeping only a node per level. Put it between a
+ *  PageWriter and the flash: the pages a PageWriter leaves erased are
+ *  hashed as erased.
+ *
+ *  Pages have to come in address order, as a PageWriter sends them for an
+ *  image in address order. A page that goes backwards leaves the root not
+ *  valid().
+ *
+ * Example:
+ * @code
+ * PageHashSink hashes(flash);
+ * PageWriter pages(hashes);
+ * ...
+ * uint8_t root[PAGE_HASH_SIZE];
+ * hashes.root(root);
+ * @endcode
+ */
+class PageHashSink : public BlockSink {
+
+public:
+    /** @param flash is where the pages go
+     *  @param leaves is FLASH_PAGES leaf hashes to fill in as well, for a
+     *   manifest on the host, or 0
+     */
+    PageHashSink(BlockSink &flash, uint8_t *leaves = 0);
+
+    /** Forget the image so far, for the next one
+     */
+    void reset();
+
+    /** Hash a page and pass it on. Writes that are not a whole page go on
+     *  unhashed and leave the root not valid()
+     */
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size);
+
+    virtual int busy() {
+        return _flash.busy();
+    }
+
+    virtual int erase(uint32_t addr, uint32_t size) {
+        return _flash.erase(addr, size);
+    }
+
+    virtual int sync() {
+        return _flash.sync();
+    }
+
+    /** Get the root of the image, with the pages not written so far as erased
+     *  @param root is where the PAGE_HASH_SIZE bytes are written
+     */
+    void root(uint8_t *root) const;
+
+    /** Check the root covers the image, 0 if a page went backwards
+     */
+    int valid() const {
+        return _ordered;
+    }
+
+    /** Get the number of pages hashed
+     */
+    uint32_t pages() const {
+        return _pages;
+    }
+
+private:
+    void add(uint32_t level, const uint8_t *hash, uint8_t (*nodes)[PAGE_HASH_SIZE], uint32_t *next) const;
+
+    BlockSink &_flash;
+    uint8_t *_leaves;
+    uint8_t _ordered;
+    uint32_t _pages;
+    // next leaf, and the left node waiting at each level
+    uint32_t _next;
+    uint8_t _nodes[PAGE_HASH_DEPTH + 1][PAGE_HASH_SIZE];
+    // the root of an all erased tree of each height
+    uint8_t _erased[PAGE_HASH_DEPTH + 1][PAGE_HASH_SIZE];
+};
+
+#endif
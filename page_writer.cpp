@@ -0,0 +1,121 @@
+#include "string.h"
+#include "page_writer.h"
+
+PageWriter::PageWriter(BlockSink &flash) : _flash(flash), _page(0), _open(0), _fill(0), _erased(0)
+{
+    memset(_done, 0, sizeof(_done));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int PageWriter::write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    int ret = 0;
+    while (size) {
+        uint32_t page = addr & ~(FLASH_PAGE_SIZE - 1);
+        uint32_t offset = addr - page;
+        uint32_t n = FLASH_PAGE_SIZE - offset;
+        if (n > size) {
+            n = size;
+        }
+        if ((FLASH_PAGE_SIZE == n) && !(_open && (_page == page))) {
+            // a whole page needs no copy, the page before it goes first
+            if (_open && (_page < page) && close()) {
+                ret = -1;
+            }
+            if (program(page, data)) {
+                ret = -1;
+            }
+        } else if (_open && (_page == page)) {
+            memcpy(&_buf[_fill][offset], data, n);
+        } else if (!open(page)) {
+            memcpy(&_buf[_fill][offset], data, n);
+        } else {
+            ret = -1;
+        }
+        addr += n;
+        data += n;
+        size -= n;
+    }
+    return ret;
+}
+
+int PageWriter::busy()
+{
+    return _flash.busy();
+}
+
+int PageWriter::sync()
+{
+    int ret = close();
+    return _flash.sync() ? -1 : ret;
+}
+
+/** Start filling a new page, programming the one before it
+ *   @param page is the address of the page
+ *   @return 0 on success, -1 if the page has already been programmed
+ */
+int PageWriter::open(uint32_t page)
+{
+    close();
+    if ((page >= FLASH_SIZE) || (_done[page / FLASH_PAGE_SIZE / 8] & (1 << ((page / FLASH_PAGE_SIZE) & 7)))) {
+        _stats.rejected++;
+        return -1;
+    }
+    memset(_buf[_fill], 0xff, FLASH_PAGE_SIZE);
+    _page = page;
+    _open = 1;
+    return 0;
+}
+
+/** Program the page being filled, if there is one
+ *   @return 0 on success, -1 if the page could not be programmed
+ */
+int PageWriter::close()
+{
+    int ret = 0;
+    if (_open) {
+        _open = 0;
+        ret = program(_page, _buf[_fill]);
+        // the flash owns that buffer now so fill the other one
+        _fill ^= 1;
+    }
+    return ret;
+}
+
+/** Erase the sector if this is the first page in it, then program the page
+ *   unless it is all 0xff
+ *   @param page is the address of the page
+ *   @param data is the page, it must stay valid until the flash is not busy
+ *   @return 0 on success, -1 if the page is outside flash or already programmed
+ */
+int PageWriter::program(uint32_t page, const uint8_t *data)
+{
+    uint32_t start, size;
+    uint32_t index = page / FLASH_PAGE_SIZE;
+    int32_t sector = flash_sector(page, &start, &size);
+    if ((sector < 0) || (_done[index / 8] & (1 << (index & 7)))) {
+        _stats.rejected++;
+        return -1;
+    }
+    _done[index / 8] |= 1 << (index & 7);
+    if (!(_erased & (1UL << sector))) {
+        while (_flash.erase(start, size));
+        _erased |= 1UL << sector;
+        _stats.erases++;
+    }
+    // an erased page already reads 0xff
+    uint32_t i = 0;
+    while ((i < FLASH_PAGE_SIZE) && (0xff == data[i])) {
+        i++;
+    }
+    if (FLASH_PAGE_SIZE == i) {
+        _stats.elided++;
+        return 0;
+    }
+    while (_flash.write(page, data, FLASH_PAGE_SIZE));
+    _stats.pages++;
+    if ((data < &_buf[0][0]) || (data >= (&_buf[0][0] + sizeof(_buf)))) {
+        _stats.direct++;
+    }
+    return 0;
+}
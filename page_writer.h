@@ -0,0 +1,64 @@
+#ifndef PAGE_WRITER_H
+#define PAGE_WRITER_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "flash_layout.h"
+
+typedef struct {
+    uint32_t pages;     // pages handed to the flash
+    uint32_t direct;    // of those, sent straight from the caller's buffer
+    uint32_t elided;    // all 0xff pages that were not programmed
+    uint32_t erases;    // sectors erased
+    uint32_t rejected;  // writes outside flash or into a page already programmed
+} page_writer_stats_t;
+
+/** Turns writes of any size and alignment into whole page writes to a flash
+ *  sink. Every sector is erased once, before the first page that lands in it.
+ *  Pages that are all 0xff are left as erased instead of programmed, and
+ *  whole aligned pages go to the flash straight from the caller's buffer.
+ *  Writes in address order reach the flash as pages in address order.
+ *
+ *  Writes follow the BlockSink rules, the buffer belongs to the writer until
+ *  busy() returns 0. Data for a page that has already been programmed is
+ *  rejected, flash can not be written twice without an erase.
+ *
+ * Example:
+ * @code
+ * PageWriter pages(flash);
+ * HexPipeline pipeline(pages, us_ticker_read);
+ * @endcode
+ */
+class PageWriter : public BlockSink {
+
+public:
+    PageWriter(BlockSink &flash);
+
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size);
+    virtual int busy();
+
+    /** Program the page still being filled and wait for the flash
+     */
+    virtual int sync();
+
+    const page_writer_stats_t &stats() const {
+        return _stats;
+    }
+
+private:
+    int open(uint32_t page);
+    int close();
+    int program(uint32_t page, const uint8_t *data);
+
+    BlockSink &_flash;
+    // page being filled in _buf[_fill], _open is 0 when there is none
+    uint32_t _page;
+    uint8_t _open;
+    uint8_t _fill;
+    uint32_t _erased;
+    uint8_t _done[FLASH_PAGES / 8];
+    uint8_t _buf[2][FLASH_PAGE_SIZE];
+    page_writer_stats_t _stats;
+};
+
+#endif
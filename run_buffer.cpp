@@ -0,0 +1,62 @@
+#include "string.h"
+#include "run_buffer.h"
+
+RunBuffer::RunBuffer(BlockSink &sink, uint8_t *buf, uint32_t size, clock_fn now_us) : _sink(sink), _now(now_us), _buf(buf), _size(size), _fill(0), _cnt(0), _addr(0), _blocks(0), _stall_us(0)
+{
+}
+
+uint8_t *RunBuffer::reserve(uint32_t addr, uint32_t size)
+{
+    if (_cnt && ((addr != (_addr + _cnt)) || ((_cnt + size) > _size))) {
+        // a gap or a full buffer ends the run
+        if (send()) {
+            return 0;
+        }
+    }
+    if (!_cnt) {
+        _addr = addr;
+    }
+    return &_buf[_fill * _size + _cnt];
+}
+
+int RunBuffer::add(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    uint8_t *out = reserve(addr, size);
+    if (!out) {
+        return -1;
+    }
+    memcpy(out, data, size);
+    commit(size);
+    return 0;
+}
+
+int RunBuffer::send()
+{
+    if (!_cnt) {
+        return 0;
+    }
+    // the other buffer is still owned by the sink until it goes idle
+    uint32_t t = _now ? _now() : 0;
+    while (_sink.busy());
+    if (_now) {
+        _stall_us += _now() - t;
+    }
+    int ret = _sink.write(_addr, &_buf[_fill * _size], _cnt);
+    _blocks++;
+    _fill ^= 1;
+    _cnt = 0;
+    return ret;
+}
+
+int RunBuffer::flush()
+{
+    int ret = send();
+    uint32_t t = _now ? _now() : 0;
+    if (_sink.sync()) {
+        ret = -1;
+    }
+    if (_now) {
+        _stall_us += _now() - t;
+    }
+    return ret;
+}
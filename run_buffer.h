@@ -0,0 +1,92 @@
+#ifndef RUN_BUFFER_H
+#define RUN_BUFFER_H
+
+#include "stdint.h"
+#include "block_sink.h"
+
+/** Collects contiguous data into a run in one of two buffers while the sink
+ *  drains the other one, for the decoders of text formats. A gap, a full
+ *  buffer or send() hands the run to the sink.
+ *
+ *  Data can be decoded straight into the buffer: reserve() gives the place
+ *  for it and only commit() counts it, so a record whose checksum turns out
+ *  bad leaves nothing behind.
+ *
+ * Example:
+ * @code
+ * uint8_t *out = runs.reserve(addr, len);
+ * if (!out) {
+ *     return HEX_PARSE_REJECTED;
+ * }
+ * ...decode len bytes into out and check them...
+ * runs.commit(len);
+ * @endcode
+ */
+class RunBuffer {
+
+public:
+    typedef uint32_t (*clock_fn)(void);
+
+    /** @param sink is where runs are sent
+     *  @param buf is two buffers of size bytes, one after the other
+     *  @param size is the largest run
+     *  @param now_us returns a free running microsecond count for stall_us(), or 0
+     */
+    RunBuffer(BlockSink &sink, uint8_t *buf, uint32_t size, clock_fn now_us = 0);
+
+    /** Get the place for data at an address, sending the run first if the
+     *  data does not continue it or does not fit
+     *  @param addr is the address of the data
+     *  @param size is the number of bytes, at most the size of a buffer
+     *  @return where to put the data, or 0 if the sink refused the run
+     */
+    uint8_t *reserve(uint32_t addr, uint32_t size);
+
+    /** Add data put where reserve() said to the run
+     *  @param size is the number of bytes, at most the ones reserved
+     */
+    void commit(uint32_t size) {
+        _cnt += size;
+    }
+
+    /** Copy data into the run
+     *  @return 0 on success, -1 if the sink refused the run before it
+     */
+    int add(uint32_t addr, const uint8_t *data, uint32_t size);
+
+    /** Hand the run being collected, if there is one, to the sink
+     *  @return 0 on success, -1 if the sink refused it
+     */
+    int send();
+
+    /** Send the run being collected and wait for the sink to deliver everything
+     *  @return 0 on success, -1 on failure
+     */
+    int flush();
+
+    /** Get the number of runs sent
+     */
+    uint32_t blocks() const {
+        return _blocks;
+    }
+
+    /** Get the time spent waiting for the sink, with a clock
+     */
+    uint32_t stall_us() const {
+        return _stall_us;
+    }
+
+private:
+    BlockSink &_sink;
+    clock_fn _now;
+    uint8_t *_buf;
+    uint32_t _size;
+    uint8_t _fill;
+    // bytes collected in the fill buffer and their address
+    uint32_t _cnt;
+    uint32_t _addr;
+    uint32_t _blocks;
+    uint32_t _stall_us;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "string.h"
+#include "sector_reorder.h"
+
+SectorReorder::SectorReorder(ImageDecoder &decoder) : _decoder(decoder), _status(HEX_PARSE_OK), _next(0), _held(0)
+{
+    memset(_sector, 0, sizeof(_sector));
+    memset(_size, 0, sizeof(_size));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int SectorReorder::write(uint32_t sector, const uint8_t *data, uint32_t size)
+{
+    if (HEX_PARSE_OK != _status) {
+        // the image is done, or broken, whatever else the host writes
+        _stats.ignored++;
+        return 0;
+    }
+    if (!size || (size > REORDER_SECTOR_SIZE)) {
+        return -1;
+    }
+    if (sector < _next) {
+        _stats.sectors++;
+        _stats.rewrites++;
+        return 0;
+    }
+    if (sector > _next) {
+        // slots hold _next + 1 to _next + REORDER_SLOTS, one sector each
+        if ((sector - _next) > REORDER_SLOTS) {
+            _stats.stalls++;
+            return -1;
+        }
+        uint32_t slot = sector % REORDER_SLOTS;
+        if (_size[slot]) {
+            _stats.rewrites++;
+        } else if (++_held > _stats.peak) {
+            _stats.peak = _held;
+        }
+        memcpy(_pool[slot], data, size);
+        _sector[slot] = sector;
+        _size[slot] = size;
+        _stats.sectors++;
+        _stats.held++;
+        return 0;
+    }
+    _stats.sectors++;
+    release(data, size);
+    // and everything it joins up with
+    uint32_t slot = _next % REORDER_SLOTS;
+    while ((HEX_PARSE_OK == _status) && _size[slot] && (_sector[slot] == _next)) {
+        uint32_t n = _size[slot];
+        _size[slot] = 0;
+        _held--;
+        release(_pool[slot], n);
+        slot = _next % REORDER_SLOTS;
+    }
+    if (HEX_PARSE_OK != _status) {
+        // nothing held can be used now
+        memset(_size, 0, sizeof(_size));
+        _held = 0;
+    }
+    return 0;
+}
+
+/** Feed the next sector of the file to the decoder
+ *   @param data is the sector
+ *   @param size is the number of bytes in data
+ */
+void SectorReorder::release(const uint8_t *data, uint32_t size)
+{
+    _status = _decoder.feed(data, size);
+    _next++;
+    // zero-copy decoders read from data until they are no longer busy
+    while (_decoder.busy());
+}
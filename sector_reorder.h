@@ -0,0 +1,101 @@
+#ifndef SECTOR_REORDER_H
+#define SECTOR_REORDER_H
+
+#include "stdint.h"
+#include "image_decoder.h"
+
+// sectors of the file as the disk sees them
+#ifndef REORDER_SECTOR_SIZE
+#define REORDER_SECTOR_SIZE 512
+#endif
+// sectors that can be held while an earlier one is missing
+#ifndef REORDER_SLOTS
+#define REORDER_SLOTS       8
+#endif
+
+typedef struct {
+    uint32_t sectors;   // writes taken
+    uint32_t held;      // of those, copied into the pool to wait for an earlier one
+    uint32_t peak;      // most sectors in the pool at once
+    uint32_t stalls;    // writes refused, too far ahead or the pool full
+    uint32_t rewrites;  // sectors written again, before or after they were decoded
+    uint32_t ignored;   // writes after the decoder finished or failed
+} sector_reorder_stats_t;
+
+/** Puts the sectors of a file written over USB mass storage back in order for
+ *  a decoder. Hosts do not write a dropped file front to back, they interleave
+ *  sectors, flush them in clusters out of order and rewrite the last one. A
+ *  sector that is next in the file goes to the decoder straight from the
+ *  caller's buffer. One that arrives early is copied into a pool of
+ *  REORDER_SLOTS sectors, and every run that becomes contiguous is released.
+ *
+ *  Sectors are numbered from the start of the file. A sector more than
+ *  REORDER_SLOTS past the next one is refused with -1, the mass storage layer
+ *  then reports the command as busy so the host retries it later. A sector
+ *  written again after it was decoded is dropped, a stream can not be taken
+ *  back.
+ *
+ *  The decoder must be done with a sector when write() returns, so it waits
+ *  for busy() after every sector it feeds. Decoders that ask to seek back
+ *  (HEX_PARSE_SEEK) can not be served, the status stays at that.
+ *
+ * Example:
+ * @code
+ * SectorReorder reorder(image);
+ *
+ * // in the MSC write callback, for sectors of the file
+ * if (reorder.write(lba - first_lba, data, size)) {
+ *     // no room, fail the command so the host retries
+ * }
+ * @endcode
+ */
+class SectorReorder {
+
+public:
+    SectorReorder(ImageDecoder &decoder);
+
+    /** Take a sector of the file in whatever order the host writes it
+     *  @param sector is the number of the sector within the file
+     *  @param data is the sector, only needed until write() returns
+     *  @param size is REORDER_SECTOR_SIZE, or less for the last sector of the file
+     *  @return 0 if it was taken, -1 if there is no room for it yet
+     */
+    int write(uint32_t sector, const uint8_t *data, uint32_t size);
+
+    /** Get the status of the decoder, HEX_PARSE_OK until it finishes or fails
+     */
+    hex_parse_status_t status() const {
+        return _status;
+    }
+
+    /** Get the number of the next sector the decoder needs
+     */
+    uint32_t next() const {
+        return _next;
+    }
+
+    /** Get the number of sectors waiting in the pool
+     */
+    uint32_t held() const {
+        return _held;
+    }
+
+    const sector_reorder_stats_t &stats() const {
+        return _stats;
+    }
+
+private:
+    void release(const uint8_t *data, uint32_t size);
+
+    ImageDecoder &_decoder;
+    hex_parse_status_t _status;
+    uint32_t _next;
+    uint32_t _held;
+    // a slot holds a sector when its size is not 0
+    uint32_t _sector[REORDER_SLOTS];
+    uint16_t _size[REORDER_SLOTS];
+    uint8_t _pool[REORDER_SLOTS][REORDER_SECTOR_SIZE];
+    sector_reorder_stats_t _stats;
+};
+
+#endif
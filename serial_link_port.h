@@ -0,0 +1,36 @@
+#ifndef SERIAL_LINK_PORT_H
+#define SERIAL_LINK_PORT_H
+
+#include "mbed.h"
+#include "string.h"
+#include "link_sink.h"
+#include "buffered_serial.h"
+
+/** Runs a LinkSink over the transmit and receive rings of a BufferedSerial
+ */
+class SerialLinkPort : public LinkPort {
+
+public:
+    SerialLinkPort(BufferedSerial &serial) : _serial(serial) {
+    }
+
+    virtual uint32_t send(const uint8_t *data, uint32_t size) {
+        return _serial.write(data, size);
+    }
+
+    virtual uint32_t recv(uint8_t *data, uint32_t size) {
+        const uint8_t *rx;
+        uint32_t n = _serial.rx_peek(&rx);
+        if (n > size) {
+            n = size;
+        }
+        memcpy(data, rx, n);
+        _serial.rx_consume(n);
+        return n;
+    }
+
+private:
+    BufferedSerial &_serial;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "serial_rx.h"
+
+// order the buffer access against the index that hands it to the other side
+#define RING_BARRIER()  __sync_synchronize()
+
+/** Check for a byte in the receive FIFO
+ *   @param obj is the serial port
+ *   @return 1 if a byte can be read, otherwise 0
+ */
+static inline uint8_t uart_fifo_readable(serial_t *obj)
+{
+#if defined(TARGET_LPC176X)
+    // LSR RDR
+    return (obj->uart->LSR & (1 << 0)) ? 1 : 0;
+#else
+    return serial_readable(obj) ? 1 : 0;
+#endif
+}
+
+/** Read a byte from the receive FIFO without waiting on the line status
+ *   @param obj is the serial port
+ *   @return the byte
+ */
+static inline uint8_t uart_fifo_get(serial_t *obj)
+{
+#if defined(TARGET_LPC176X)
+    return obj->uart->RBR;
+#else
+    return (uint8_t)serial_getc(obj);
+#endif
+}
+
+void serial_rx_ring_init(serial_rx_ring_t *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->stopped = 0;
+    ring->overrun = 0;
+    ring->peak = 0;
+}
+
+uint8_t serial_rx_fifo_drain(serial_t *obj, serial_rx_ring_t *ring)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
+    while (uart_fifo_readable(obj)) {
+        uint8_t c = uart_fifo_get(obj);
+        if ((head - tail) == SERIAL_RX_RING_SIZE) {
+            // still have to read it to clear the interrupt
+            ring->overrun++;
+            continue;
+        }
+        ring->buf[head & (SERIAL_RX_RING_SIZE - 1)] = c;
+        head++;
+    }
+    RING_BARRIER();
+    ring->head = head;
+    if ((head - tail) > ring->peak) {
+        ring->peak = head - tail;
+    }
+    if (!ring->stopped && ((head - tail) >= SERIAL_RX_STOP_LEVEL)) {
+        ring->stopped = 1;
+        return 1;
+    }
+    return 0;
+}
+
+uint32_t serial_rx_peek(serial_rx_ring_t *ring, const uint8_t **data)
+{
+    uint32_t tail = ring->tail;
+    uint32_t cnt = ring->head - tail;
+    uint32_t idx = tail & (SERIAL_RX_RING_SIZE - 1);
+    RING_BARRIER();
+    if (cnt > (SERIAL_RX_RING_SIZE - idx)) {
+        cnt = SERIAL_RX_RING_SIZE - idx;
+    }
+    *data = &ring->buf[idx];
+    return cnt;
+}
+
+uint8_t serial_rx_consume(serial_rx_ring_t *ring, uint32_t size)
+{
+    uint32_t tail = ring->tail + size;
+    RING_BARRIER();
+    ring->tail = tail;
+    if (ring->stopped && ((ring->head - tail) <= SERIAL_RX_START_LEVEL)) {
+        ring->stopped = 0;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef SERIAL_RX_H
+#define SERIAL_RX_H
+
+#include "stdint.h"
+#include "serial_api.h"
+
+// must be a power of 2
+#define SERIAL_RX_RING_SIZE     2048
+// ask the sender to stop once this much is buffered, the rest covers its reaction time
+#define SERIAL_RX_STOP_LEVEL    (SERIAL_RX_RING_SIZE - 512)
+// and to start again once the parser has caught up to here
+#define SERIAL_RX_START_LEVEL   (SERIAL_RX_RING_SIZE / 4)
+
+#define XON     0x11
+#define XOFF    0x13
+
+/** Receive ring filled by the RX interrupt and drained by the main loop.
+ *  head is only moved by the interrupt and tail only by the main loop.
+ */
+typedef struct {
+    uint8_t buf[SERIAL_RX_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    // the sender has been told to stop
+    volatile uint8_t stopped;
+    // bytes lost because the ring was full
+    uint32_t overrun;
+    // highest fill level seen
+    uint32_t peak;
+} serial_rx_ring_t;
+
+/** Empty a receive ring
+ *  @param ring is the ring to reset
+ */
+void serial_rx_ring_init(serial_rx_ring_t *ring);
+
+/** Move everything in the UART receive FIFO into the ring. Call from the RX interrupt.
+ *  @param obj is the serial port
+ *  @param ring is the ring to fill
+ *  @return 1 if the ring crossed SERIAL_RX_STOP_LEVEL and the sender must be stopped, otherwise 0
+ */
+uint8_t serial_rx_fifo_drain(serial_t *obj, serial_rx_ring_t *ring);
+
+/** Get the received data without copying it. Data that wraps around the end of
+ *   the ring is returned by the next call.
+ *  @param ring is the ring to read
+ *  @param data is set to the oldest unread byte
+ *  @return the number of contiguous bytes at data
+ */
+uint32_t serial_rx_peek(serial_rx_ring_t *ring, const uint8_t **data);
+
+/** Release data returned by serial_rx_peek
+ *  @param ring is the ring to release from
+ *  @param size is the number of bytes that have been used
+ *  @return 1 if the ring fell to SERIAL_RX_START_LEVEL and the sender can restart, otherwise 0
+ */
+uint8_t serial_rx_consume(serial_rx_ring_t *ring, uint32_t size);
+
+#endif
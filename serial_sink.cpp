@@ -0,0 +1,24 @@
+#include "serial_sink.h"
+
+SerialSink::SerialSink(BufferedSerial &serial) : _serial(serial), _pos(0), _end(0)
+{
+}
+
+int SerialSink::write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    if (busy()) {
+        return -1;
+    }
+    _end = data + size;
+    _pos = data + _serial.write(data, size);
+    return 0;
+}
+
+int SerialSink::busy()
+{
+    // top up the ring with whatever did not fit last time
+    if (_pos != _end) {
+        _pos += _serial.write(_pos, _end - _pos);
+    }
+    return (_pos != _end);
+}
@@ -0,0 +1,25 @@
+#ifndef SERIAL_SINK_H
+#define SERIAL_SINK_H
+
+#include "mbed.h"
+#include "block_sink.h"
+#include "buffered_serial.h"
+
+/** Sends decoded blocks out of a serial port through its transmit ring.
+ *  A block is released as soon as all of it has been copied into the ring.
+ */
+class SerialSink : public BlockSink {
+
+public:
+    SerialSink(BufferedSerial &serial);
+
+    virtual int write(uint32_t addr, const uint8_t *data, uint32_t size);
+    virtual int busy();
+
+private:
+    BufferedSerial &_serial;
+    const uint8_t *_pos;
+    const uint8_t *_end;
+};
+
+#endif
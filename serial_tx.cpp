@@ -0,0 +1,94 @@
+#include "string.h"
+#include "serial_tx.h"
+
+// order the buffer access against the index that hands it to the other side
+#define RING_BARRIER()  __sync_synchronize()
+
+/** Check the transmit holding register (and so the whole FIFO) is empty
+ *   @param obj is the serial port
+ *   @return 1 if UART_TX_FIFO_DEPTH bytes can be written, otherwise 0
+ */
+static inline uint8_t uart_fifo_empty(serial_t *obj)
+{
+#if defined(TARGET_LPC176X)
+    // LSR THRE
+    return (obj->uart->LSR & (1 << 5)) ? 1 : 0;
+#else
+    return serial_writable(obj) ? 1 : 0;
+#endif
+}
+
+/** Write a byte to the transmit FIFO without waiting on the line status
+ *   @param obj is the serial port
+ *   @param c is the byte to send
+ */
+static inline void uart_fifo_put(serial_t *obj, uint8_t c)
+{
+#if defined(TARGET_LPC176X)
+    obj->uart->THR = c;
+#else
+    serial_putc(obj, c);
+#endif
+}
+
+void serial_tx_ring_init(serial_tx_ring_t *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->urgent = 0;
+}
+
+uint32_t serial_tx_ring_used(serial_tx_ring_t *ring)
+{
+    return ring->head - ring->tail;
+}
+
+uint32_t serial_tx_ring_put(serial_tx_ring_t *ring, const uint8_t *data, uint32_t size)
+{
+    uint32_t head = ring->head;
+    uint32_t space = SERIAL_TX_RING_SIZE - (head - ring->tail);
+    uint32_t cnt = (size < space) ? size : space;
+    uint32_t idx = head & (SERIAL_TX_RING_SIZE - 1);
+    // copy up to the end of the buffer then wrap
+    uint32_t first = SERIAL_TX_RING_SIZE - idx;
+    if (first > cnt) {
+        first = cnt;
+    }
+    memcpy(&ring->buf[idx], data, first);
+    memcpy(&ring->buf[0], data + first, cnt - first);
+    // publish the data before moving head
+    RING_BARRIER();
+    ring->head = head + cnt;
+    return cnt;
+}
+
+void serial_tx_send_urgent(serial_t *obj, serial_tx_ring_t *ring, uint8_t c)
+{
+    ring->urgent = c;
+    // goes out now if the transmitter is idle, otherwise first thing on the next THRE
+    serial_tx_fifo_fill(obj, ring);
+}
+
+uint32_t serial_tx_fifo_fill(serial_t *obj, serial_tx_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    uint32_t cnt = ring->head - tail;
+    uint32_t room = UART_TX_FIFO_DEPTH;
+    if ((!cnt && !ring->urgent) || !uart_fifo_empty(obj)) {
+        return 0;
+    }
+    if (ring->urgent) {
+        uart_fifo_put(obj, ring->urgent);
+        ring->urgent = 0;
+        room--;
+    }
+    if (cnt > room) {
+        cnt = room;
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        uart_fifo_put(obj, ring->buf[(tail + i) & (SERIAL_TX_RING_SIZE - 1)]);
+    }
+    RING_BARRIER();
+    ring->tail = tail + cnt;
+    return cnt;
+}
@@ -0,0 +1,59 @@
+#ifndef SERIAL_TX_H
+#define SERIAL_TX_H
+
+#include "stdint.h"
+#include "serial_api.h"
+
+// must be a power of 2
+#define SERIAL_TX_RING_SIZE     1024
+// depth of the LPC UART transmit FIFO
+#define UART_TX_FIFO_DEPTH      16
+
+/** Transmit ring shared by one writer (main loop) and the TX interrupt.
+ *  head is only moved by the writer and tail only by the interrupt.
+ */
+typedef struct {
+    uint8_t buf[SERIAL_TX_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    // flow control byte that goes out ahead of the ring, 0 if none
+    volatile uint8_t urgent;
+} serial_tx_ring_t;
+
+/** Empty a transmit ring
+ *  @param ring is the ring to reset
+ */
+void serial_tx_ring_init(serial_tx_ring_t *ring);
+
+/** Queue as much data as there is room for
+ *  @param ring is the ring to add to
+ *  @param data is the data to send
+ *  @param size is the number of bytes in data
+ *  @return the number of bytes queued
+ */
+uint32_t serial_tx_ring_put(serial_tx_ring_t *ring, const uint8_t *data, uint32_t size);
+
+/** Get the number of bytes waiting to be sent
+ *  @param ring is the ring to check
+ *  @return the number of queued bytes
+ */
+uint32_t serial_tx_ring_used(serial_tx_ring_t *ring);
+
+/** Send a byte ahead of everything queued, e.g. XON/XOFF. Call from an
+ *   interrupt or with the TX interrupt masked.
+ *  @param obj is the serial port
+ *  @param ring is the ring the byte jumps ahead of
+ *  @param c is the byte to send
+ */
+void serial_tx_send_urgent(serial_t *obj, serial_tx_ring_t *ring, uint8_t c);
+
+/** Move queued data into the UART. Once the transmit holding register is empty
+ *   the whole FIFO is free, so up to UART_TX_FIFO_DEPTH bytes are loaded without
+ *   polling the line status between them. Call from the TX interrupt or with it masked.
+ *  @param obj is the serial port
+ *  @param ring is the data to send
+ *  @return the number of bytes loaded from the ring
+ */
+uint32_t serial_tx_fifo_fill(serial_t *obj, serial_tx_ring_t *ring);
+
+#endif
@@ -0,0 +1,195 @@
+#include "string.h"
+#include "sha256.h"
+#if SHA256_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+/** Run the rounds over whole blocks, a 16 word window of the message
+ *  schedule keeps the stack small on the target
+ *   @param state is the hash state
+ *   @param data is the blocks
+ *   @param blocks is the number of SHA256_BLOCK_SIZE blocks
+ */
+static void sha256_blocks_c(uint32_t *state, const uint8_t *data, uint32_t blocks)
+{
+    uint32_t w[16];
+    while (blocks--) {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t x;
+            if (i < 16) {
+                x = ((uint32_t)data[4 * i] << 24) | ((uint32_t)data[4 * i + 1] << 16) | ((uint32_t)data[4 * i + 2] << 8) | data[4 * i + 3];
+            } else {
+                uint32_t s0 = w[(i + 1) & 15], s1 = w[(i + 14) & 15];
+                x = w[i & 15] + (ROR(s0, 7) ^ ROR(s0, 18) ^ (s0 >> 3)) + w[(i + 9) & 15] + (ROR(s1, 17) ^ ROR(s1, 19) ^ (s1 >> 10));
+            }
+            w[i & 15] = x;
+            uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + x;
+            uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += SHA256_BLOCK_SIZE;
+    }
+}
+
+#if SHA256_SHANI
+/** The rounds with the SHA extensions, two at a time on the state held as
+ *  ABEF and CDGH, four schedule words at a time
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_blocks_shani(uint32_t *state, const uint8_t *data, uint32_t blocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+    __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+    __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+    while (blocks--) {
+        __m128i abef_in = abef;
+        __m128i cdgh_in = cdgh;
+        __m128i m[4];
+        for (int i = 0; i < 4; i++) {
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), bswap);
+        }
+        for (int i = 0; i < 16; i++) {
+            __m128i &w = m[i & 3];
+            if (i >= 4) {
+                w = _mm_sha256msg1_epu32(w, m[(i - 3) & 3]);
+                w = _mm_add_epi32(w, _mm_alignr_epi8(m[(i - 1) & 3], m[(i - 2) & 3], 4));
+                w = _mm_sha256msg2_epu32(w, m[(i - 1) & 3]);
+            }
+            __m128i wk = _mm_add_epi32(w, _mm_loadu_si128((const __m128i *)&sha256_k[4 * i]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+        }
+        abef = _mm_add_epi32(abef, abef_in);
+        cdgh = _mm_add_epi32(cdgh, cdgh_in);
+        data += SHA256_BLOCK_SIZE;
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1b);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+static int have_shani()
+{
+    static int have = -1;
+    if (have < 0) {
+        unsigned int a, b, c, d;
+        have = __get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_1) && (c & bit_SSSE3) &&
+               __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA);
+    }
+    return have;
+}
+#endif
+
+static void sha256_blocks(uint32_t *state, const uint8_t *data, uint32_t blocks)
+{
+#if SHA256_SHANI
+    if (have_shani()) {
+        sha256_blocks_shani(state, data, blocks);
+        return;
+    }
+#endif
+    sha256_blocks_c(state, data, blocks);
+}
+
+void sha256_init(sha256_t *ctx)
+{
+    static const uint32_t h0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, h0, sizeof(h0));
+    ctx->count = 0;
+}
+
+void sha256_update(sha256_t *ctx, const uint8_t *data, uint32_t size)
+{
+    uint32_t held = (uint32_t)ctx->count & (SHA256_BLOCK_SIZE - 1);
+    ctx->count += size;
+    if (held) {
+        uint32_t n = SHA256_BLOCK_SIZE - held;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(&ctx->buf[held], data, n);
+        data += n;
+        size -= n;
+        if ((held + n) < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sha256_blocks(ctx->state, ctx->buf, 1);
+    }
+    // whole blocks straight from data
+    if (size >= SHA256_BLOCK_SIZE) {
+        sha256_blocks(ctx->state, data, size / SHA256_BLOCK_SIZE);
+        data += size & ~(uint32_t)(SHA256_BLOCK_SIZE - 1);
+        size &= SHA256_BLOCK_SIZE - 1;
+    }
+    memcpy(ctx->buf, data, size);
+}
+
+void sha256_fill(sha256_t *ctx, uint8_t value, uint32_t size)
+{
+    uint8_t block[SHA256_BLOCK_SIZE];
+    uint32_t n = (size < sizeof(block)) ? size : sizeof(block);
+    memset(block, value, n);
+    while (size) {
+        n = (size < sizeof(block)) ? size : sizeof(block);
+        sha256_update(ctx, block, n);
+        size -= n;
+    }
+}
+
+void sha256_final(sha256_t *ctx, uint8_t *digest)
+{
+    uint64_t bits = ctx->count * 8;
+    uint8_t pad[SHA256_BLOCK_SIZE + 8];
+    // 0x80, zeros up to 8 bytes short of a block, then the length in bits
+    uint32_t n = SHA256_BLOCK_SIZE - (((uint32_t)ctx->count + 8) & (SHA256_BLOCK_SIZE - 1));
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        pad[n + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    sha256_update(ctx, pad, n + 8);
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
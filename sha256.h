@@ -0,0 +1,56 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include "stdint.h"
+
+/* SHA-256 fed a piece at a time, for hashing an image while it is decoded
+ * instead of reading it back. The state is 108 bytes and the round
+ * constants 256 bytes of flash, the rounds are plain C that the Cortex-M3
+ * runs as they are. On x86 hosts built with GCC blocks go through the SHA
+ * extensions when the CPU has them.
+ */
+
+#define SHA256_SIZE         32
+#define SHA256_BLOCK_SIZE   64
+
+// 1 to use the SHA extensions on x86 hosts that have them
+#ifndef SHA256_SHANI
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SHA256_SHANI        1
+#else
+#define SHA256_SHANI        0
+#endif
+#endif
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t count;     // bytes hashed
+    uint8_t buf[SHA256_BLOCK_SIZE];
+} sha256_t;
+
+/** Start a hash
+ *   @param ctx is the hash to start
+ */
+void sha256_init(sha256_t *ctx);
+
+/** Add data to a hash
+ *   @param ctx is the hash
+ *   @param data is the data to add
+ *   @param size is the number of bytes in data
+ */
+void sha256_update(sha256_t *ctx, const uint8_t *data, uint32_t size);
+
+/** Add a run of the same byte to a hash, e.g. the 0xff between records
+ *   @param ctx is the hash
+ *   @param value is the byte
+ *   @param size is the number of bytes in the run
+ */
+void sha256_fill(sha256_t *ctx, uint8_t value, uint32_t size);
+
+/** Finish a hash. ctx has to be started again to be used after this
+ *   @param ctx is the hash
+ *   @param digest is where the SHA256_SIZE byte digest is written
+ */
+void sha256_final(sha256_t *ctx, uint8_t *digest);
+
+#endif
@@ -0,0 +1,125 @@
+#include "string.h"
+#include "srec_decoder.h"
+#include "hex_push_parser.h"
+
+// address bytes in each record type, 0 for the reserved S4
+static const uint8_t srec_addr_size[10] = {2, 2, 3, 4, 0, 2, 3, 4, 3, 2};
+
+SrecDecoder::SrecDecoder(BlockSink &sink) : _eof(0), _runs(sink, _buf[0], SREC_BUF_SIZE), _line_cnt(0)
+{
+}
+
+hex_parse_status_t SrecDecoder::feed(const uint8_t *data, uint32_t size)
+{
+    hex_parse_status_t status = _eof ? HEX_PARSE_EOF : HEX_PARSE_OK;
+    while (size && (HEX_PARSE_OK == status)) {
+        const uint8_t *eol = (const uint8_t *)memchr(data, '\n', size);
+        uint32_t n = eol ? (uint32_t)(eol - data) : size;
+        if (_line_cnt || !eol) {
+            // the line continues in the next call, keep what there is of it
+            if ((_line_cnt + n) > sizeof(_line)) {
+                return HEX_PARSE_LINE_OVERRUN;
+            }
+            memcpy(&_line[_line_cnt], data, n);
+            _line_cnt += n;
+            if (eol) {
+                status = record(_line, _line_cnt);
+                _line_cnt = 0;
+            }
+        } else {
+            status = record(data, n);
+        }
+        if (eol) {
+            n++;
+        }
+        data += n;
+        size -= n;
+    }
+    return status;
+}
+
+int SrecDecoder::flush()
+{
+    int ret = 0;
+    if (_line_cnt && !_eof) {
+        // the last line had no line end
+        hex_parse_status_t status = record(_line, _line_cnt);
+        ret = ((HEX_PARSE_OK == status) || (HEX_PARSE_EOF == status)) ? 0 : -1;
+        _line_cnt = 0;
+    }
+    return _runs.flush() ? -1 : ret;
+}
+
+int SrecDecoder::detect(const uint8_t *data, uint32_t size)
+{
+    if (!size || ((1 == size) && ('S' == data[0]))) {
+        return -1;
+    }
+    return ('S' == data[0]) && (data[1] >= '0') && (data[1] <= '3');
+}
+
+/** Check and decode one record, adding its data to the run being collected
+ *   @param line is the record without its '\n'
+ *   @param size is the number of characters in line
+ *   @return HEX_PARSE_OK, HEX_PARSE_EOF at a termination record or the error
+ */
+hex_parse_status_t SrecDecoder::record(const uint8_t *line, uint32_t size)
+{
+    // '\r' and any other trailing blanks
+    while (size && (line[size - 1] <= ' ')) {
+        size--;
+    }
+    if (!size) {
+        return HEX_PARSE_OK;
+    }
+    if ((size < 4) || ('S' != line[0]) || (line[1] < '0') || (line[1] > '9')) {
+        return HEX_PARSE_CKSUM_FAIL;
+    }
+    uint8_t type = line[1] - '0';
+    uint8_t count = hex_nibbles(&line[2]);
+    uint8_t addr_size = srec_addr_size[type];
+    if (!addr_size || (count <= addr_size) || (size != (4 + (uint32_t)count * 2))) {
+        return HEX_PARSE_CKSUM_FAIL;
+    }
+    // every byte from the count on adds up to 0xff with the checksum
+    uint8_t sum = count;
+    uint32_t addr = 0;
+    const uint8_t *p = &line[4];
+    for (uint8_t i = 0; i < addr_size; i++, p += 2) {
+        uint8_t b = hex_nibbles(p);
+        sum += b;
+        addr = (addr << 8) | b;
+    }
+    uint32_t len = count - addr_size - 1;
+    if ((type >= 1) && (type <= 3)) {
+        // decoded straight into the fill buffer, it only counts once the checksum is good
+        uint8_t *out = _runs.reserve(addr, len);
+        if (!out) {
+            return HEX_PARSE_REJECTED;
+        }
+        for (uint32_t i = 0; i < len; i++, p += 2) {
+            out[i] = hex_nibbles(p);
+            sum += out[i];
+        }
+        if (0xff != (uint8_t)(sum + hex_nibbles(p))) {
+            return HEX_PARSE_CKSUM_FAIL;
+        }
+        _runs.commit(len);
+        return HEX_PARSE_OK;
+    }
+    // header, count or termination, only the checksum matters
+    for (uint32_t i = 0; i < len; i++, p += 2) {
+        sum += hex_nibbles(p);
+    }
+    if (0xff != (uint8_t)(sum + hex_nibbles(p))) {
+        return HEX_PARSE_CKSUM_FAIL;
+    }
+    if (type >= 7) {
+        _eof = 1;
+        if (_runs.send()) {
+            return HEX_PARSE_REJECTED;
+        }
+        return HEX_PARSE_EOF;
+    }
+    return HEX_PARSE_OK;
+}
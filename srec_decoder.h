@@ -0,0 +1,80 @@
+#ifndef SREC_DECODER_H
+#define SREC_DECODER_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "image_decoder.h"
+#include "run_buffer.h"
+
+// largest run of contiguous data collected before it goes to the sink
+#ifndef SREC_BUF_SIZE
+#define SREC_BUF_SIZE   512
+#endif
+// longest record, S and the type, then up to 255 bytes in hex, and the line end
+#define SREC_LINE_SIZE  (4 + 255 * 2 + 2)
+
+#if SREC_BUF_SIZE < 252
+#error "SREC_BUF_SIZE must hold the data of the longest record"
+#endif
+
+/** Decodes a Motorola S-record image (S19, S28 or S37) into one of two
+ *  buffers while the sink drains the other one, the same way HexPipeline
+ *  does for Intel HEX. Contiguous data records are collected into a run and
+ *  a gap, a full buffer or the termination record (S7, S8 or S9) sends it.
+ *
+ *  Lines are decoded where they sit in the input, only a line split across
+ *  two calls is copied.
+ *
+ * Example:
+ * @code
+ * SrecDecoder srec(pages);
+ *
+ * do {
+ *     status = srec.feed(data, size);
+ * } while (HEX_PARSE_OK == status);
+ * srec.flush();
+ * @endcode
+ */
+class SrecDecoder : public ImageDecoder {
+
+public:
+    /** Create a decoder in front of a sink
+     *  @param sink is where decoded runs are sent, usually a PageWriter
+     */
+    SrecDecoder(BlockSink &sink);
+
+    /** Decode a chunk of S-records
+     *  @param data is the ascii records
+     *  @param size is the number of bytes in data
+     *  @return HEX_PARSE_OK when the chunk was consumed, HEX_PARSE_EOF at the
+     *   termination record, HEX_PARSE_CKSUM_FAIL on a bad record,
+     *   HEX_PARSE_LINE_OVERRUN on a line too long to be a record or
+     *   HEX_PARSE_REJECTED if the sink refused a run
+     */
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size);
+
+    /** Decode a last line that had no line end, send the run being collected
+     *  and wait for the sink
+     *  @return 0 on success, -1 on failure
+     */
+    virtual int flush();
+
+    /** An S-record image starts with an S and the record type, S0 or S1 to S3
+     */
+    virtual int detect(const uint8_t *data, uint32_t size);
+
+    virtual const char *name() const {
+        return "srec";
+    }
+
+private:
+    hex_parse_status_t record(const uint8_t *line, uint32_t size);
+
+    uint8_t _eof;
+    RunBuffer _runs;
+    uint32_t _line_cnt;
+    uint8_t _line[SREC_LINE_SIZE];
+    uint8_t _buf[2][SREC_BUF_SIZE];
+};
+
+#endif
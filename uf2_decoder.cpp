@@ -0,0 +1,95 @@
+#include "string.h"
+#include "uf2_decoder.h"
+
+/** Read a little endian word from any alignment
+ *   @param p is the first byte
+ *   @return the word
+ */
+static inline uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+Uf2Decoder::Uf2Decoder(BlockSink &sink) : _sink(sink), _eof(0), _blocks(0), _cnt(0)
+{
+}
+
+hex_parse_status_t Uf2Decoder::feed(const uint8_t *data, uint32_t size)
+{
+    hex_parse_status_t status = _eof ? HEX_PARSE_EOF : HEX_PARSE_OK;
+    while (size && (HEX_PARSE_OK == status)) {
+        if (_cnt || (size < UF2_BLOCK_SIZE)) {
+            // the block continues in the next call, keep what there is of it
+            if (!_cnt) {
+                // the sink may still be reading the last block put together here
+                while (_sink.busy());
+            }
+            uint32_t n = UF2_BLOCK_SIZE - _cnt;
+            if (n > size) {
+                n = size;
+            }
+            memcpy(&_block[_cnt], data, n);
+            _cnt += n;
+            data += n;
+            size -= n;
+            if (UF2_BLOCK_SIZE == _cnt) {
+                _cnt = 0;
+                status = block(_block);
+            }
+        } else {
+            status = block(data);
+            data += UF2_BLOCK_SIZE;
+            size -= UF2_BLOCK_SIZE;
+        }
+    }
+    return status;
+}
+
+int Uf2Decoder::busy()
+{
+    return _sink.busy();
+}
+
+int Uf2Decoder::flush()
+{
+    int ret = _sink.sync();
+    return _cnt ? -1 : ret;
+}
+
+int Uf2Decoder::detect(const uint8_t *data, uint32_t size)
+{
+    static const uint8_t magic[8] = {0x55, 0x46, 0x32, 0x0a, 0x57, 0x51, 0x5d, 0x9e};
+    uint32_t n = (size < sizeof(magic)) ? size : sizeof(magic);
+    if (memcmp(data, magic, n)) {
+        return 0;
+    }
+    return (n < sizeof(magic)) ? -1 : 1;
+}
+
+/** Check a block and send its payload to the sink
+ *   @param data is the block, the sink reads the payload from here
+ *   @return HEX_PARSE_OK, HEX_PARSE_EOF after the last block or the error
+ */
+hex_parse_status_t Uf2Decoder::block(const uint8_t *data)
+{
+    uint32_t flags = le32(&data[8]);
+    uint32_t addr = le32(&data[12]);
+    uint32_t size = le32(&data[16]);
+    uint32_t blocks = le32(&data[24]);
+    if ((UF2_MAGIC_START0 != le32(&data[0])) || (UF2_MAGIC_START1 != le32(&data[4])) ||
+        (UF2_MAGIC_END != le32(&data[UF2_BLOCK_SIZE - 4])) || (size > UF2_MAX_PAYLOAD)) {
+        return HEX_PARSE_CKSUM_FAIL;
+    }
+    if (!(flags & UF2_FLAG_NOT_MAIN_FLASH) && size) {
+        while (_sink.busy());
+        if (_sink.write(addr, &data[UF2_HEADER_SIZE], size)) {
+            return HEX_PARSE_REJECTED;
+        }
+    }
+    // blocks may come in any order so count them rather than look for the last number
+    if (++_blocks >= blocks) {
+        _eof = 1;
+        return HEX_PARSE_EOF;
+    }
+    return HEX_PARSE_OK;
+}
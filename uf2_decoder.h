@@ -0,0 +1,79 @@
+#ifndef UF2_DECODER_H
+#define UF2_DECODER_H
+
+#include "stdint.h"
+#include "block_sink.h"
+#include "image_decoder.h"
+
+#define UF2_BLOCK_SIZE          512
+#define UF2_HEADER_SIZE         32
+#define UF2_MAX_PAYLOAD         476
+#define UF2_MAGIC_START0        0x0A324655UL
+#define UF2_MAGIC_START1        0x9E5D5157UL
+#define UF2_MAGIC_END           0x0AB16F30UL
+// the block is for something other than the main flash, e.g. a comment
+#define UF2_FLAG_NOT_MAIN_FLASH 0x00000001UL
+
+/** Decodes a UF2 image. Every 512 byte block carries its own address, so the
+ *  payload goes to the sink straight from the input, nothing is copied
+ *  unless a block is split across two calls. The image ends once as many
+ *  blocks as the header counts have arrived.
+ *
+ *  Like BinLoader the sink reads from the caller's buffer, keep it until
+ *  busy() returns 0.
+ *
+ * Example:
+ * @code
+ * Uf2Decoder uf2(pages);
+ *
+ * do {
+ *     status = uf2.feed(data, size);
+ *     while (uf2.busy());
+ * } while (HEX_PARSE_OK == status);
+ * uf2.flush();
+ * @endcode
+ */
+class Uf2Decoder : public ImageDecoder {
+
+public:
+    /** Create a decoder in front of a sink
+     *  @param sink is where the payloads are sent, usually a PageWriter
+     */
+    Uf2Decoder(BlockSink &sink);
+
+    /** Decode the next piece of the image
+     *  @param data is the input, it must stay valid until busy() returns 0
+     *  @param size is the number of bytes in data
+     *  @return HEX_PARSE_OK when it was consumed, HEX_PARSE_EOF after the last
+     *   block, HEX_PARSE_CKSUM_FAIL on a block without the UF2 magic or
+     *   HEX_PARSE_REJECTED if the sink refused a payload
+     */
+    virtual hex_parse_status_t feed(const uint8_t *data, uint32_t size);
+
+    virtual int busy();
+
+    /** Wait for the sink
+     *  @return 0 on success, -1 on failure or a partial block at the end
+     */
+    virtual int flush();
+
+    /** A UF2 image starts with the two start magic numbers
+     */
+    virtual int detect(const uint8_t *data, uint32_t size);
+
+    virtual const char *name() const {
+        return "uf2";
+    }
+
+private:
+    hex_parse_status_t block(const uint8_t *data);
+
+    BlockSink &_sink;
+    uint8_t _eof;
+    uint32_t _blocks;
+    // bytes of a split block collected in _block
+    uint32_t _cnt;
+    uint8_t _block[UF2_BLOCK_SIZE];
+};
+
+#endif
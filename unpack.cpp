@@ -0,0 +1,700 @@
+#include "string.h"
+#include "unpack.h"
+
+#define WINDOW_MASK     (UNPACK_WINDOW - 1)
+
+// gzip header flags
+#define GZ_FHCRC        0x02
+#define GZ_FEXTRA       0x04
+#define GZ_FNAME        0x08
+#define GZ_FCOMMENT     0x10
+
+typedef enum {
+    S_GZ_HEAD = 0,
+    S_GZ_EXTRA_LEN,
+    S_GZ_EXTRA,
+    S_GZ_NAME,
+    S_GZ_COMMENT,
+    S_GZ_HCRC,
+    S_ZLIB_HEAD,
+    S_BLOCK,
+    S_STORED_LEN,
+    S_STORED,
+    S_DYN_COUNTS,
+    S_DYN_CLEN,
+    S_DYN_LENS,
+    S_CODES,
+    S_COPY,
+    S_TRAILER,
+    S_HS,
+    S_END
+} unpack_state_t;
+
+// what a step returns
+typedef enum {
+    STEP_NEXT = 0,      // moved on, run the next step
+    STEP_IN,            // out of input
+    STEP_OUT,           // out of window space
+    STEP_FAIL           // corrupt stream
+} step_t;
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/** Load input until n bits are ready, DEFLATE order (lsb first)
+ *   @param s is the decompressor
+ *   @param n is the number of bits needed, at most 24
+ *   @return 1 if the bits are there, 0 if the input ran out
+ */
+static inline uint8_t need(unpack_t *s, uint32_t n)
+{
+    while (s->bit_cnt < n) {
+        if (s->in_pos == s->in_len) {
+            return 0;
+        }
+        s->bits |= (uint32_t)s->in[s->in_pos++] << s->bit_cnt;
+        s->bit_cnt += 8;
+    }
+    return 1;
+}
+
+/** Take n bits loaded by need()
+ */
+static inline uint32_t take(unpack_t *s, uint32_t n)
+{
+    uint32_t v = s->bits & ((1UL << n) - 1);
+    s->bits >>= n;
+    s->bit_cnt -= n;
+    return v;
+}
+
+/** Load input until n bits are ready, heatshrink order (msb first)
+ *   @param s is the decompressor
+ *   @param n is the number of bits needed, at most 24
+ *   @return 1 if the bits are there, 0 if the input ran out
+ */
+static inline uint8_t need_msb(unpack_t *s, uint32_t n)
+{
+    while (s->bit_cnt < n) {
+        if (s->in_pos == s->in_len) {
+            return 0;
+        }
+        s->bits = (s->bits << 8) | s->in[s->in_pos++];
+        s->bit_cnt += 8;
+    }
+    return 1;
+}
+
+/** Take n bits loaded by need_msb()
+ */
+static inline uint32_t take_msb(unpack_t *s, uint32_t n)
+{
+    s->bit_cnt -= n;
+    return (s->bits >> s->bit_cnt) & ((1UL << n) - 1);
+}
+
+/** Mark everything read so far as used, a later stall rolls back to here
+ */
+static inline void commit(unpack_t *s)
+{
+    s->commit_pos = s->in_pos;
+    s->commit_bits = s->bits;
+    s->commit_cnt = s->bit_cnt;
+}
+
+static inline uint32_t window_free(unpack_t *s)
+{
+    return UNPACK_WINDOW - (s->out - s->read);
+}
+
+static inline void put(unpack_t *s, uint8_t c)
+{
+    s->win[s->out++ & WINDOW_MASK] = c;
+}
+
+/** Build a canonical Huffman decoding table
+ *   @param count is filled with the number of codes of each length
+ *   @param symbol is filled with the symbols ordered by code
+ *   @param lens is the code length of each symbol
+ *   @param n is the number of symbols
+ *   @return 0 if the code is usable, -1 if it is over-subscribed
+ */
+static int construct(uint16_t *count, uint16_t *symbol, const uint8_t *lens, uint32_t n)
+{
+    uint16_t offs[16];
+    int32_t left = 1;
+    memset(count, 0, 16 * sizeof(uint16_t));
+    for (uint32_t i = 0; i < n; i++) {
+        count[lens[i]]++;
+    }
+    if (count[0] == n) {
+        return 0;
+    }
+    for (uint32_t len = 1; len < 16; len++) {
+        left = (left << 1) - count[len];
+        if (left < 0) {
+            return -1;
+        }
+    }
+    offs[1] = 0;
+    for (uint32_t len = 1; len < 15; len++) {
+        offs[len + 1] = offs[len] + count[len];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (lens[i]) {
+            symbol[offs[lens[i]]++] = (uint16_t)i;
+        }
+    }
+    return 0;
+}
+
+/** Decode one Huffman coded symbol
+ *   @return the symbol, -1 if the input ran out or -2 for an unused code
+ */
+static int32_t decode(unpack_t *s, const uint16_t *count, const uint16_t *symbol)
+{
+    int32_t code = 0, first = 0, index = 0;
+    for (uint32_t len = 1; len < 16; len++) {
+        if (!need(s, 1)) {
+            return -1;
+        }
+        code |= take(s, 1);
+        int32_t cnt = count[len];
+        if (code - cnt < first) {
+            return symbol[index + (code - first)];
+        }
+        index += cnt;
+        first += cnt;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+/** Pick the next gzip header field to skip, or go on to the data
+ */
+static void gz_next(unpack_t *s)
+{
+    if (s->flags & GZ_FEXTRA) {
+        s->state = S_GZ_EXTRA_LEN;
+    } else if (s->flags & GZ_FNAME) {
+        s->state = S_GZ_NAME;
+    } else if (s->flags & GZ_FCOMMENT) {
+        s->state = S_GZ_COMMENT;
+    } else if (s->flags & GZ_FHCRC) {
+        s->state = S_GZ_HCRC;
+    } else {
+        s->state = S_BLOCK;
+    }
+}
+
+static step_t step_header(unpack_t *s)
+{
+    switch (s->state) {
+        case S_GZ_HEAD:
+            // magic, method, flags, mtime, xfl, os
+            if (!need(s, 24)) {
+                return STEP_IN;
+            }
+            if ((take(s, 8) != 0x1f) || (take(s, 8) != 0x8b) || (take(s, 8) != 8)) {
+                return STEP_FAIL;
+            }
+            if (!need(s, 8)) {
+                return STEP_IN;
+            }
+            s->flags = take(s, 8);
+            s->len = 6;
+            s->state = S_GZ_EXTRA;
+            commit(s);
+            return STEP_NEXT;
+        case S_GZ_EXTRA_LEN:
+            if (!need(s, 16)) {
+                return STEP_IN;
+            }
+            s->len = take(s, 16);
+            s->flags &= ~GZ_FEXTRA;
+            s->state = S_GZ_EXTRA;
+            commit(s);
+            return STEP_NEXT;
+        case S_GZ_EXTRA:
+            // the rest of the fixed header and the extra field are skipped alike
+            while (s->len) {
+                if (!need(s, 8)) {
+                    return STEP_IN;
+                }
+                take(s, 8);
+                s->len--;
+                commit(s);
+            }
+            gz_next(s);
+            return STEP_NEXT;
+        case S_GZ_NAME:
+        case S_GZ_COMMENT:
+            while (1) {
+                if (!need(s, 8)) {
+                    return STEP_IN;
+                }
+                uint8_t c = take(s, 8);
+                commit(s);
+                if (!c) {
+                    break;
+                }
+            }
+            s->flags &= (S_GZ_NAME == s->state) ? ~GZ_FNAME : ~GZ_FCOMMENT;
+            gz_next(s);
+            return STEP_NEXT;
+        case S_GZ_HCRC:
+            if (!need(s, 16)) {
+                return STEP_IN;
+            }
+            take(s, 16);
+            s->flags &= ~GZ_FHCRC;
+            s->state = S_BLOCK;
+            commit(s);
+            return STEP_NEXT;
+        case S_ZLIB_HEAD: {
+            if (!need(s, 16)) {
+                return STEP_IN;
+            }
+            uint32_t cmf = take(s, 8);
+            uint32_t flg = take(s, 8);
+            // deflate, a window that fits and no preset dictionary
+            if (((cmf & 0xf) != 8) || (((cmf >> 4) + 8) > UNPACK_WINDOW_BITS) || ((cmf * 256 + flg) % 31) || (flg & 0x20)) {
+                return STEP_FAIL;
+            }
+            s->state = S_BLOCK;
+            commit(s);
+            return STEP_NEXT;
+        }
+        default:
+            return STEP_FAIL;
+    }
+}
+
+static step_t step_dynamic(unpack_t *s)
+{
+    switch (s->state) {
+        case S_DYN_COUNTS:
+            if (!need(s, 14)) {
+                return STEP_IN;
+            }
+            s->nlen = take(s, 5) + 257;
+            s->ndist = take(s, 5) + 1;
+            s->ncode = take(s, 4) + 4;
+            if ((s->nlen > 286) || (s->ndist > 30)) {
+                return STEP_FAIL;
+            }
+            memset(s->lens, 0, 19);
+            s->idx = 0;
+            s->state = S_DYN_CLEN;
+            commit(s);
+            return STEP_NEXT;
+        case S_DYN_CLEN:
+            while (s->idx < s->ncode) {
+                if (!need(s, 3)) {
+                    return STEP_IN;
+                }
+                s->lens[clen_order[s->idx++]] = take(s, 3);
+                commit(s);
+            }
+            // the code length code lives in the distance table until the real one is built
+            if (construct(s->dist_count, s->dist_symbol, s->lens, 19)) {
+                return STEP_FAIL;
+            }
+            s->idx = 0;
+            s->state = S_DYN_LENS;
+            return STEP_NEXT;
+        case S_DYN_LENS:
+            while (s->idx < (s->nlen + s->ndist)) {
+                int32_t sym = decode(s, s->dist_count, s->dist_symbol);
+                if (sym < 0) {
+                    return (-1 == sym) ? STEP_IN : STEP_FAIL;
+                }
+                if (sym < 16) {
+                    s->lens[s->idx++] = (uint8_t)sym;
+                    commit(s);
+                    continue;
+                }
+                uint8_t len = 0;
+                uint32_t rep;
+                if (16 == sym) {
+                    if (!s->idx || !need(s, 2)) {
+                        return s->idx ? STEP_IN : STEP_FAIL;
+                    }
+                    len = s->lens[s->idx - 1];
+                    rep = 3 + take(s, 2);
+                } else if (17 == sym) {
+                    if (!need(s, 3)) {
+                        return STEP_IN;
+                    }
+                    rep = 3 + take(s, 3);
+                } else {
+                    if (!need(s, 7)) {
+                        return STEP_IN;
+                    }
+                    rep = 11 + take(s, 7);
+                }
+                if ((s->idx + rep) > (uint32_t)(s->nlen + s->ndist)) {
+                    return STEP_FAIL;
+                }
+                memset(&s->lens[s->idx], len, rep);
+                s->idx += rep;
+                commit(s);
+            }
+            // a block with no end of block code can never finish
+            if (!s->lens[256] || construct(s->lit_count, s->lit_symbol, s->lens, s->nlen) ||
+                    construct(s->dist_count, s->dist_symbol, &s->lens[s->nlen], s->ndist)) {
+                return STEP_FAIL;
+            }
+            s->state = S_CODES;
+            return STEP_NEXT;
+        default:
+            return STEP_FAIL;
+    }
+}
+
+static step_t step_block(unpack_t *s)
+{
+    if (!need(s, 3)) {
+        return STEP_IN;
+    }
+    s->last = take(s, 1);
+    switch (take(s, 2)) {
+        case 0:
+            // stored blocks start on a byte boundary
+            take(s, s->bit_cnt & 7);
+            s->state = S_STORED_LEN;
+            break;
+        case 1: {
+            uint32_t i = 0;
+            for (; i < 144; i++) {
+                s->lens[i] = 8;
+            }
+            for (; i < 256; i++) {
+                s->lens[i] = 9;
+            }
+            for (; i < 280; i++) {
+                s->lens[i] = 7;
+            }
+            for (; i < 288; i++) {
+                s->lens[i] = 8;
+            }
+            construct(s->lit_count, s->lit_symbol, s->lens, 288);
+            memset(s->lens, 5, 30);
+            construct(s->dist_count, s->dist_symbol, s->lens, 30);
+            s->state = S_CODES;
+            break;
+        }
+        case 2:
+            s->state = S_DYN_COUNTS;
+            break;
+        default:
+            return STEP_FAIL;
+    }
+    commit(s);
+    return STEP_NEXT;
+}
+
+static step_t step_stored(unpack_t *s)
+{
+    if (S_STORED_LEN == s->state) {
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        s->len = take(s, 16);
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        if ((s->len ^ 0xffff) != take(s, 16)) {
+            return STEP_FAIL;
+        }
+        s->state = S_STORED;
+        commit(s);
+    }
+    while (s->len) {
+        if (!window_free(s)) {
+            return STEP_OUT;
+        }
+        if (!need(s, 8)) {
+            return STEP_IN;
+        }
+        put(s, take(s, 8));
+        s->len--;
+        commit(s);
+    }
+    s->state = s->last ? S_TRAILER : S_BLOCK;
+    return STEP_NEXT;
+}
+
+static step_t step_codes(unpack_t *s)
+{
+    while (1) {
+        if (!window_free(s)) {
+            return STEP_OUT;
+        }
+        int32_t sym = decode(s, s->lit_count, s->lit_symbol);
+        if (sym < 0) {
+            return (-1 == sym) ? STEP_IN : STEP_FAIL;
+        }
+        if (sym < 256) {
+            put(s, (uint8_t)sym);
+            commit(s);
+            continue;
+        }
+        if (256 == sym) {
+            s->state = s->last ? S_TRAILER : S_BLOCK;
+            commit(s);
+            return STEP_NEXT;
+        }
+        sym -= 257;
+        if (sym >= 29) {
+            return STEP_FAIL;
+        }
+        if (!need(s, len_extra[sym])) {
+            return STEP_IN;
+        }
+        s->len = len_base[sym] + take(s, len_extra[sym]);
+        sym = decode(s, s->dist_count, s->dist_symbol);
+        if (sym < 0) {
+            return (-1 == sym) ? STEP_IN : STEP_FAIL;
+        }
+        if (sym >= 30) {
+            return STEP_FAIL;
+        }
+        if (!need(s, dist_extra[sym])) {
+            return STEP_IN;
+        }
+        s->dist = dist_base[sym] + take(s, dist_extra[sym]);
+        if ((s->dist > s->out) || (s->dist > UNPACK_WINDOW)) {
+            // before the start of the stream or further back than the window
+            return STEP_FAIL;
+        }
+        s->state = S_COPY;
+        commit(s);
+        return STEP_NEXT;
+    }
+}
+
+static step_t step_copy(unpack_t *s)
+{
+    uint32_t n = window_free(s);
+    if (n > s->len) {
+        n = s->len;
+    }
+    // the source may overlap what is being written so go a byte at a time
+    for (uint32_t i = 0; i < n; i++) {
+        put(s, s->win[(s->out - s->dist) & WINDOW_MASK]);
+    }
+    s->len -= n;
+    if (s->len) {
+        return STEP_OUT;
+    }
+    s->state = (UNPACK_HEATSHRINK == s->format) ? S_HS : S_CODES;
+    return STEP_NEXT;
+}
+
+static step_t step_trailer(unpack_t *s)
+{
+    // gzip ends with the crc32 and length, zlib with the adler32. The hex records
+    //  carry their own checksums so only the length is checked
+    take(s, s->bit_cnt & 7);
+    if (UNPACK_GZIP == s->format) {
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        take(s, 16);
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        take(s, 16);
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        uint32_t size = take(s, 16);
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        size |= take(s, 16) << 16;
+        if (size != s->out) {
+            return STEP_FAIL;
+        }
+    } else {
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        take(s, 16);
+        if (!need(s, 16)) {
+            return STEP_IN;
+        }
+        take(s, 16);
+    }
+    s->state = S_END;
+    commit(s);
+    return STEP_NEXT;
+}
+
+static step_t step_heatshrink(unpack_t *s)
+{
+    while (1) {
+        if (!window_free(s)) {
+            return STEP_OUT;
+        }
+        if (!need_msb(s, 1)) {
+            return STEP_IN;
+        }
+        if (take_msb(s, 1)) {
+            if (!need_msb(s, 8)) {
+                return STEP_IN;
+            }
+            put(s, take_msb(s, 8));
+            commit(s);
+            continue;
+        }
+        if (!need_msb(s, HEATSHRINK_WINDOW_BITS)) {
+            return STEP_IN;
+        }
+        s->dist = take_msb(s, HEATSHRINK_WINDOW_BITS) + 1;
+        if (!need_msb(s, HEATSHRINK_LOOKAHEAD_BITS)) {
+            return STEP_IN;
+        }
+        s->len = take_msb(s, HEATSHRINK_LOOKAHEAD_BITS) + 1;
+        if (s->dist > s->out) {
+            return STEP_FAIL;
+        }
+        s->state = S_COPY;
+        commit(s);
+        return STEP_NEXT;
+    }
+}
+
+/** Run the decoder until it needs more input, more window space or the stream ends
+ */
+static void run(unpack_t *s)
+{
+    while (UNPACK_OK == s->status) {
+        step_t r;
+        switch (s->state) {
+            case S_BLOCK:
+                r = step_block(s);
+                break;
+            case S_STORED_LEN:
+            case S_STORED:
+                r = step_stored(s);
+                break;
+            case S_DYN_COUNTS:
+            case S_DYN_CLEN:
+            case S_DYN_LENS:
+                r = step_dynamic(s);
+                break;
+            case S_CODES:
+                r = step_codes(s);
+                break;
+            case S_COPY:
+                r = step_copy(s);
+                break;
+            case S_TRAILER:
+                r = step_trailer(s);
+                break;
+            case S_HS:
+                r = step_heatshrink(s);
+                break;
+            case S_END:
+                s->status = UNPACK_DONE;
+                return;
+            default:
+                r = step_header(s);
+                break;
+        }
+        if (STEP_NEXT == r) {
+            continue;
+        }
+        // give back whatever the unfinished piece read
+        s->in_pos = s->commit_pos;
+        s->bits = s->commit_bits;
+        s->bit_cnt = s->commit_cnt;
+        if (STEP_FAIL == r) {
+            s->status = UNPACK_ERROR;
+        } else if ((STEP_IN == r) && s->finished) {
+            // no more input is coming. heatshrink pads the last byte with bits that
+            //  never make a whole token, anything else left over is a cut short stream
+            int padding = (UNPACK_HEATSHRINK == s->format) && (s->in_pos == s->in_len);
+            s->status = padding ? UNPACK_DONE : UNPACK_ERROR;
+        }
+        return;
+    }
+}
+
+void unpack_init(unpack_t *s, unpack_format_t format)
+{
+    s->format = format;
+    s->state = (UNPACK_GZIP == format) ? S_GZ_HEAD : (UNPACK_ZLIB == format) ? S_ZLIB_HEAD : S_HS;
+    s->status = UNPACK_OK;
+    s->last = 0;
+    s->finished = 0;
+    s->flags = 0;
+    s->in_pos = 0;
+    s->in_len = 0;
+    s->bits = 0;
+    s->bit_cnt = 0;
+    commit(s);
+    s->out = 0;
+    s->read = 0;
+    s->len = 0;
+}
+
+uint32_t unpack_write(unpack_t *s, const uint8_t *data, uint32_t size)
+{
+    // the decoder always stops at a commit point so everything before in_pos is done with
+    uint32_t left = s->in_len - s->in_pos;
+    if (s->in_pos) {
+        memmove(s->in, &s->in[s->in_pos], left);
+        s->in_pos = 0;
+        s->commit_pos = 0;
+        s->in_len = left;
+    }
+    if (size > (UNPACK_IN_SIZE - left)) {
+        size = UNPACK_IN_SIZE - left;
+    }
+    memcpy(&s->in[left], data, size);
+    s->in_len += size;
+    return size;
+}
+
+void unpack_finish(unpack_t *s)
+{
+    s->finished = 1;
+}
+
+uint32_t unpack_read(unpack_t *s, const uint8_t **data)
+{
+    run(s);
+    uint32_t start = s->read & WINDOW_MASK;
+    uint32_t n = s->out - s->read;
+    if (n > (UNPACK_WINDOW - start)) {
+        n = UNPACK_WINDOW - start;
+    }
+    *data = &s->win[start];
+    return n;
+}
+
+void unpack_consume(unpack_t *s, uint32_t size)
+{
+    s->read += size;
+}
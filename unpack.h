@@ -0,0 +1,117 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include "stdint.h"
+
+/* Streaming decompression of a packed image in front of the hex parser.
+ *
+ * Compressed bytes go in with unpack_write() and come out of the history
+ * window itself with unpack_read()/unpack_consume(), so the only RAM used is
+ * the window, a small input buffer and the Huffman tables (about 6 KB with
+ * the default 4 KB window).
+ *
+ * DEFLATE (gzip or zlib wrapped) streams must be made with a window no
+ * larger than UNPACK_WINDOW, e.g. zlib's deflateInit2() with windowBits 12.
+ * A back-reference further than that stops the stream with UNPACK_ERROR.
+ * heatshrink streams must use HEATSHRINK_WINDOW_BITS/HEATSHRINK_LOOKAHEAD_BITS.
+ */
+
+#ifndef UNPACK_WINDOW_BITS
+#define UNPACK_WINDOW_BITS          12
+#endif
+#define UNPACK_WINDOW               (1UL << UNPACK_WINDOW_BITS)
+// enough for the longest indivisible piece of a stream, the 10 byte gzip header
+#define UNPACK_IN_SIZE              256
+
+#ifndef HEATSHRINK_WINDOW_BITS
+#define HEATSHRINK_WINDOW_BITS      10
+#endif
+#ifndef HEATSHRINK_LOOKAHEAD_BITS
+#define HEATSHRINK_LOOKAHEAD_BITS   4
+#endif
+
+#if HEATSHRINK_WINDOW_BITS > UNPACK_WINDOW_BITS
+#error "the heatshrink window does not fit in UNPACK_WINDOW"
+#endif
+
+typedef enum {
+    UNPACK_GZIP = 0,
+    UNPACK_ZLIB,
+    UNPACK_HEATSHRINK
+} unpack_format_t;
+
+typedef enum {
+    UNPACK_OK = 0,      // more output may follow
+    UNPACK_DONE,        // the stream has ended, what is left in the window is the last of it
+    UNPACK_ERROR        // corrupt stream, or a window larger than UNPACK_WINDOW
+} unpack_status_t;
+
+typedef struct {
+    uint8_t format;
+    uint8_t state;
+    uint8_t status;
+    uint8_t last;           // working on the final DEFLATE block
+    uint8_t finished;       // unpack_finish() has been called
+    uint8_t flags;          // gzip header fields still to skip
+    // input and the bit reader, rolled back to the commit point when a
+    //  piece of the stream is only partly there
+    uint8_t in[UNPACK_IN_SIZE];
+    uint32_t in_pos;
+    uint32_t in_len;
+    uint32_t bits;
+    uint32_t bit_cnt;
+    uint32_t commit_pos;
+    uint32_t commit_bits;
+    uint32_t commit_cnt;
+    // output ring, also the history for back-references
+    uint8_t win[UNPACK_WINDOW];
+    uint32_t out;           // bytes written to win since the start
+    uint32_t read;          // bytes consumed from win since the start
+    // back-reference, stored block or header field in progress
+    uint32_t len;
+    uint32_t dist;
+    uint16_t idx;
+    uint16_t nlen;
+    uint16_t ndist;
+    uint16_t ncode;
+    uint8_t lens[320];
+    uint16_t lit_count[16];
+    uint16_t lit_symbol[288];
+    uint16_t dist_count[16];
+    uint16_t dist_symbol[32];
+} unpack_t;
+
+/** Start a new stream
+ *   @param s is the decompressor
+ *   @param format is the format of the stream
+ */
+void unpack_init(unpack_t *s, unpack_format_t format);
+
+/** Add compressed data
+ *   @param s is the decompressor
+ *   @param data is the compressed data
+ *   @param size is the number of bytes in data
+ *   @return the number of bytes taken, less than size when the input buffer is full
+ */
+uint32_t unpack_write(unpack_t *s, const uint8_t *data, uint32_t size);
+
+/** Mark the end of the compressed data. heatshrink has no end marker so
+ *   this is what ends those streams
+ *   @param s is the decompressor
+ */
+void unpack_finish(unpack_t *s);
+
+/** Decompress as far as the input and the free window space allow
+ *   @param s is the decompressor
+ *   @param data is set to the oldest unconsumed output byte
+ *   @return the number of contiguous bytes at data, 0 when no output is ready
+ */
+uint32_t unpack_read(unpack_t *s, const uint8_t **data);
+
+/** Release output returned by unpack_read()
+ *   @param s is the decompressor
+ *   @param size is the number of bytes that have been used
+ */
+void unpack_consume(unpack_t *s, uint32_t size);
+
+#endif
@@ -0,0 +1,263 @@
+#include "string.h"
+#include "virtual_fat.h"
+
+#define RESERVED_SECTORS    1
+#define ROOT_SECTORS        (VFAT_ROOT_ENTRIES * 32 / VFAT_SECTOR_SIZE)
+#define CLUSTER_SIZE        (VFAT_CLUSTER_SECTORS * VFAT_SECTOR_SIZE)
+
+static void put16(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(&p[2], v >> 16);
+}
+
+static uint32_t get16(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | (get16(&p[2]) << 16);
+}
+
+/** Check if a directory entry is for an image, by its extension. Names that
+ *  start with '_' are the Mac's AppleDouble files
+ */
+static int image_entry(const uint8_t *e)
+{
+    static const char ext[][4] = {"HEX", "SRE", "S19", "S28", "S37", "MOT", "UF2", "ELF", "AXF", "BIN"};
+    if ('_' == e[0]) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < sizeof(ext) / sizeof(ext[0]); i++) {
+        if (!memcmp(&e[8], ext[i], 3)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+VirtualFat::VirtualFat(ImageDecoder &decoder) : _decoder(decoder), _reorder(decoder), _fat_sectors(1), _fed(0), _done(0), _files(0)
+{
+    // the FAT has to cover the clusters left once it is taken out, which settles in a few rounds
+    for (int i = 0; i < 4; i++) {
+        _clusters = (VFAT_SECTORS - RESERVED_SECTORS - ROOT_SECTORS - 2 * _fat_sectors) / VFAT_CLUSTER_SECTORS;
+        _fat16 = (_clusters >= 4085);
+        uint32_t bytes = _fat16 ? ((_clusters + 2) * 2) : (((_clusters + 2) * 3 + 1) / 2);
+        _fat_sectors = (bytes + VFAT_SECTOR_SIZE - 1) / VFAT_SECTOR_SIZE;
+    }
+    _data_lba = RESERVED_SECTORS + 2 * _fat_sectors + ROOT_SECTORS;
+    memset(_root, 0, sizeof(_root));
+    memcpy(_root, "HEX_PARSER ", 11);
+    _root[11] = 0x08;
+    memset(&_stats, 0, sizeof(_stats));
+    scan();
+}
+
+int VirtualFat::disk_read(uint8_t *data, uint64_t block)
+{
+    if (block >= VFAT_SECTORS) {
+        return -1;
+    }
+    uint32_t sector = (uint32_t)block;
+    _stats.reads++;
+    memset(data, 0, VFAT_SECTOR_SIZE);
+    if (!sector) {
+        boot_sector(data);
+    } else if (sector < (RESERVED_SECTORS + 2 * _fat_sectors)) {
+        fat_sector(data, (sector - RESERVED_SECTORS) % _fat_sectors);
+    } else if (sector == (RESERVED_SECTORS + 2 * _fat_sectors)) {
+        memcpy(data, _root, sizeof(_root));
+    }
+    // the rest of the root directory and every cluster read as zeros
+    return 0;
+}
+
+int VirtualFat::disk_write(const uint8_t *data, uint64_t block)
+{
+    if (block >= VFAT_SECTORS) {
+        return -1;
+    }
+    uint32_t sector = (uint32_t)block;
+    _stats.writes++;
+    if (sector == (RESERVED_SECTORS + 2 * _fat_sectors)) {
+        memcpy(_root, data, sizeof(_root));
+        scan();
+        finish();
+        return 0;
+    }
+    uint32_t first = lba(_start);
+    if ((sector < first) || (_bound && (sector >= lba(_bound)))) {
+        // boot sector, FAT, the rest of the root directory or another file
+        _stats.ignored++;
+        return 0;
+    }
+    uint32_t offset = (sector - first) * VFAT_SECTOR_SIZE;
+    uint32_t n = VFAT_SECTOR_SIZE;
+    if (_size) {
+        if (offset >= _size) {
+            _stats.ignored++;
+            return 0;
+        }
+        n = ((_size - offset) < n) ? (_size - offset) : n;
+    }
+    if (_reorder.write(sector - first, data, n)) {
+        _stats.refused++;
+        return -1;
+    }
+    _fed = 1;
+    _stats.streamed++;
+    finish();
+    return 0;
+}
+
+/** Make up the boot sector with the BIOS parameter block
+ */
+void VirtualFat::boot_sector(uint8_t *data)
+{
+    memcpy(data, "\xeb\x3c\x90MSDOS5.0", 11);
+    put16(&data[11], VFAT_SECTOR_SIZE);
+    data[13] = VFAT_CLUSTER_SECTORS;
+    put16(&data[14], RESERVED_SECTORS);
+    data[16] = 2;
+    put16(&data[17], VFAT_ROOT_ENTRIES);
+    if (VFAT_SECTORS < 0x10000) {
+        put16(&data[19], VFAT_SECTORS);
+    } else {
+        put32(&data[32], VFAT_SECTORS);
+    }
+    data[21] = 0xf8;
+    put16(&data[22], _fat_sectors);
+    put16(&data[24], 63);
+    put16(&data[26], 255);
+    data[36] = 0x80;
+    data[38] = 0x29;
+    put32(&data[39], 0x48455821);
+    memcpy(&data[43], "HEX_PARSER ", 11);
+    memcpy(&data[54], _fat16 ? "FAT16   " : "FAT12   ", 8);
+    data[510] = 0x55;
+    data[511] = 0xaa;
+}
+
+/** Make up a sector of the FAT, the files in the root directory are taken
+ *  to have contiguous clusters like a fresh volume gives them
+ *  @param sector is the number of the sector within the FAT
+ */
+void VirtualFat::fat_sector(uint8_t *data, uint32_t sector)
+{
+    // FAT12 entries can straddle sectors, so work out each one that lands here
+    uint32_t bits = _fat16 ? 16 : 12;
+    uint32_t first = (sector * VFAT_SECTOR_SIZE * 8) / bits;
+    uint32_t last = (((sector + 1) * VFAT_SECTOR_SIZE * 8) + bits - 1) / bits;
+    for (uint32_t c = first; (c < last) && (c < _clusters + 2); c++) {
+        uint32_t v = 0;
+        if (c < 2) {
+            v = c ? 0xffff : 0xfff8;
+        } else {
+            for (uint32_t f = 0; f < _files; f++) {
+                uint32_t end = _file_cluster[f] + _file_clusters[f];
+                if ((c >= _file_cluster[f]) && (c < end)) {
+                    v = ((c + 1) < end) ? (c + 1) : 0xffff;
+                    break;
+                }
+            }
+        }
+        if (_fat16) {
+            put16(&data[c * 2 - sector * VFAT_SECTOR_SIZE], v);
+            continue;
+        }
+        v &= 0xfff;
+        // the 12 bits of the entry, nibble aligned, at their byte offset in the FAT
+        uint32_t pos = (c * 3) / 2;
+        uint32_t shift = (c & 1) ? 4 : 0;
+        for (uint32_t b = 0; b < 2; b++) {
+            int32_t i = (int32_t)(pos + b) - (int32_t)(sector * VFAT_SECTOR_SIZE);
+            if ((i < 0) || (i >= VFAT_SECTOR_SIZE)) {
+                continue;
+            }
+            uint16_t mask = (uint16_t)(0xfff << shift);
+            uint16_t val = (uint16_t)(v << shift);
+            data[i] = (data[i] & ~(uint8_t)(mask >> (b * 8))) | (uint8_t)(val >> (b * 8));
+        }
+    }
+}
+
+/** Find the image and the files around it in the root directory sector
+ */
+void VirtualFat::scan()
+{
+    uint32_t image = 0;
+    uint32_t size = 0;
+    _files = 0;
+    for (uint32_t i = 0; i < VFAT_FILES; i++) {
+        const uint8_t *e = &_root[i * 32];
+        if (!e[0]) {
+            break;
+        }
+        // deleted, long name parts and the volume label
+        if ((0xe5 == e[0]) || (0x0f == e[11]) || (e[11] & 0x08)) {
+            continue;
+        }
+        uint32_t cluster = get16(&e[26]);
+        if ((cluster < 2) || (cluster >= (_clusters + 2))) {
+            continue;
+        }
+        uint32_t count = (get32(&e[28]) + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+        _file_cluster[_files] = cluster;
+        _file_clusters[_files] = count ? count : 1;
+        _files++;
+        if (!image && !(e[11] & 0x10) && image_entry(e)) {
+            image = cluster;
+            size = get32(&e[28]);
+        }
+    }
+    if (!_fed || (image == _start)) {
+        if (image) {
+            _start = image;
+            _size = size;
+        } else {
+            // the first cluster no other file has
+            _start = 2;
+            for (uint32_t f = 0; f < _files; f++) {
+                for (uint32_t g = 0; g < _files; g++) {
+                    if ((_start >= _file_cluster[g]) && (_start < (uint32_t)(_file_cluster[g] + _file_clusters[g]))) {
+                        _start = _file_cluster[g] + _file_clusters[g];
+                    }
+                }
+            }
+            _size = 0;
+        }
+    }
+    // the image ends before the next file
+    _bound = 0;
+    for (uint32_t f = 0; f < _files; f++) {
+        if ((_file_cluster[f] > _start) && (!_bound || (_file_cluster[f] < _bound))) {
+            _bound = _file_cluster[f];
+        }
+    }
+}
+
+/** Flush the decoder once the image is complete, at its end record, or for
+ *  a format without one when every sector up to the size has arrived
+ */
+void VirtualFat::finish()
+{
+    if (_done) {
+        return;
+    }
+    hex_parse_status_t status = _reorder.status();
+    int complete = (HEX_PARSE_EOF == status) ||
+                   ((HEX_PARSE_OK == status) && _size && ((_reorder.next() * VFAT_SECTOR_SIZE) >= _size));
+    if (complete) {
+        _done = _decoder.flush() ? -1 : 1;
+    } else if ((HEX_PARSE_OK != status) && (HEX_PARSE_EOF != status)) {
+        _done = -1;
+    }
+}
@@ -0,0 +1,148 @@
+#ifndef VIRTUAL_FAT_H
+#define VIRTUAL_FAT_H
+
+#include "stdint.h"
+#include "image_decoder.h"
+#include "sector_reorder.h"
+
+// size of the volume in sectors, 32 MB makes it FAT16 and under 4085 clusters FAT12
+#ifndef VFAT_SECTORS
+#define VFAT_SECTORS        65536
+#endif
+#ifndef VFAT_CLUSTER_SECTORS
+#define VFAT_CLUSTER_SECTORS 8
+#endif
+#define VFAT_ROOT_ENTRIES   512
+#define VFAT_SECTOR_SIZE    512
+// entries in the root directory sector that is kept
+#define VFAT_FILES          (VFAT_SECTOR_SIZE / 32)
+
+typedef struct {
+    uint32_t reads;     // sectors read by the host
+    uint32_t writes;    // sectors written by the host
+    uint32_t streamed;  // of those, sectors of the image handed to the decoder
+    uint32_t ignored;   // FAT, other files, slack past the end of the image
+    uint32_t refused;   // writes the reorder stage had no room for
+} virtual_fat_stats_t;
+
+/** An empty FAT12/16 volume that is never stored. The boot sector, the FATs
+ *  and the root directory are made up when the host reads them, only the
+ *  first root directory sector is kept so the host sees its own entries.
+ *  The sectors of a file dropped onto it go through SectorReorder into the
+ *  decoder as they are written, the file itself is never held.
+ *
+ *  The volume starts out empty, so the host puts the file in the first free
+ *  cluster. Its directory entry confirms that, or moves it, if the host wrote
+ *  the entry first, and entries of other files (a Mac's ._ and .fseventsd)
+ *  mark where the image can not go on. The file size from the entry trims
+ *  the last sector, without it the slack goes to the decoder, which only
+ *  matters for a raw binary.
+ *
+ *  The block interface is the one USBMSD and FATFileSystem use, so a USBMSD
+ *  subclass hands it to the host and FATFileSystem mounts it as a
+ *  FileSystemLike on the target.
+ *
+ * Example:
+ * @code
+ * VirtualFat disk(image);
+ *
+ * // in the MSC callbacks
+ * disk.disk_read(data, block);
+ * if (disk.disk_write(data, block)) {
+ *     // no room, fail the command so the host retries
+ * }
+ * @endcode
+ */
+class VirtualFat {
+
+public:
+    VirtualFat(ImageDecoder &decoder);
+
+    int disk_initialize() {
+        return 0;
+    }
+
+    int disk_status() {
+        return 0;
+    }
+
+    /** Make up a sector of the volume
+     *  @param data is filled with VFAT_SECTOR_SIZE bytes
+     *  @param block is the sector number
+     *  @return 0 on success, -1 past the end of the volume
+     */
+    int disk_read(uint8_t *data, uint64_t block);
+
+    /** Take a sector the host writes
+     *  @param data is the sector, only needed until disk_write() returns
+     *  @param block is the sector number
+     *  @return 0 on success, -1 if it can not be taken now and has to be retried
+     */
+    int disk_write(const uint8_t *data, uint64_t block);
+
+    uint64_t disk_sectors() {
+        return VFAT_SECTORS;
+    }
+
+    uint64_t disk_size() {
+        return (uint64_t)VFAT_SECTORS * VFAT_SECTOR_SIZE;
+    }
+
+    /** Get the status of the decoder, HEX_PARSE_OK until the image is done or broken
+     */
+    hex_parse_status_t status() const {
+        return _reorder.status();
+    }
+
+    /** Check if the whole image has been decoded and the decoder flushed
+     *  @return 1 on success, -1 if the flush failed, 0 while it is going on
+     */
+    int done() const {
+        return _done;
+    }
+
+    /** Get the first sector of the image on the volume, where it is expected
+     *   until it is known
+     */
+    uint32_t image_lba() const {
+        return lba(_start);
+    }
+
+    const virtual_fat_stats_t &stats() const {
+        return _stats;
+    }
+
+    const sector_reorder_stats_t &reorder_stats() const {
+        return _reorder.stats();
+    }
+
+private:
+    uint32_t lba(uint32_t cluster) const {
+        return _data_lba + (cluster - 2) * VFAT_CLUSTER_SECTORS;
+    }
+    void boot_sector(uint8_t *data);
+    void fat_sector(uint8_t *data, uint32_t sector);
+    void scan();
+    void finish();
+
+    ImageDecoder &_decoder;
+    SectorReorder _reorder;
+    uint32_t _fat_sectors;
+    uint32_t _data_lba;
+    uint32_t _clusters;
+    uint8_t _fat16;
+    // where the image is, how far it can go and its size, 0 until known
+    uint32_t _start;
+    uint32_t _bound;
+    uint32_t _size;
+    uint8_t _fed;
+    int _done;
+    uint8_t _root[VFAT_SECTOR_SIZE];
+    // clusters of the files in _root, for the FAT
+    uint32_t _files;
+    uint16_t _file_cluster[VFAT_FILES];
+    uint16_t _file_clusters[VFAT_FILES];
+    virtual_fat_stats_t _stats;
+};
+
+#endif